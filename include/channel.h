@@ -32,6 +32,9 @@
 #ifndef INCLUDED_res_h
 #include "res.h"
 #endif
+#ifndef INCLUDED_expiry_h
+#include "expiry.h"
+#endif
 
 struct SLink;
 struct Client;
@@ -268,10 +271,11 @@ struct Channel {
   struct Channel*    next;	/**< next channel in the global channel list */
   struct Channel*    prev;	/**< previous channel */
   struct Channel*    hnext;	/**< Next channel in the hash table */
-  struct DestructEvent* destruct_event;	
+  struct Expiry      destruct_event; /**< Scheduled destruction, if empty */
   time_t             creationtime; /**< Creation time of this channel */
   time_t             topic_time;   /**< Modification time of the topic */
   unsigned int       users;	   /**< Number of clients on this channel */
+  unsigned int       zombies;	   /**< Number of those that are zombies */
   struct Membership* members;	   /**< Pointer to the clients on this channel*/
   struct Invite*     invites;	   /**< List of invites on this channel */
   struct Ban*        banlist;      /**< List of bans on this channel */
@@ -48,8 +48,25 @@ struct ConnectionClass {
   unsigned int            max_sendq;      /**< Maximum client SendQ in bytes. */
   unsigned int            max_links;      /**< Maximum connections allowed. */
   unsigned int            ref_count;      /**< Number of references to class. */
+  unsigned int            send_rate;      /**< Bytes per second sent to each
+                                             client, or 0 for no limit. */
+  unsigned int            send_burst;     /**< Most bytes sent at once. */
+  unsigned int            msg_rate;       /**< Messages per second processed
+                                             for each client, or 0 for no
+                                             limit. */
+  unsigned int            msg_burst;      /**< Most messages processed at
+                                             once. */
+  unsigned int            send_shaped;    /**< Stats: times output was held
+                                             back by #send_rate. */
+  unsigned int            msg_shaped;     /**< Stats: times input was held
+                                             back by #msg_rate. */
+  unsigned int            sendq_dropped;  /**< Stats: channel messages
+                                             dropped by #sendq_drop. */
   unsigned short          ping_freq;      /**< Ping frequency for clients. */
   unsigned short          conn_freq;      /**< Auto-connect frequency. */
+  unsigned char           sendq_drop;     /**< Drop channel chatter rather
+                                             than disconnect users whose
+                                             SendQ is full. */
   unsigned char           valid;          /**< Valid flag (cleared after this
                                              class is removed from the config).*/
 };
@@ -72,6 +89,16 @@ struct ConnectionClass {
 #define Links(x)        ((x)->ref_count)
 /** Get default usermode for \a x. */
 #define CCUmode(x)      ((x)->default_umode)
+/** Get per-client send rate limit for \a x. */
+#define SendRate(x)     ((x)->send_rate)
+/** Get per-client send burst size for \a x. */
+#define SendBurst(x)    ((x)->send_burst)
+/** Get per-client message rate limit for \a x. */
+#define MsgRate(x)      ((x)->msg_rate)
+/** Get per-client message burst size for \a x. */
+#define MsgBurst(x)     ((x)->msg_burst)
+/** Get whether \a x drops channel chatter for slow users. */
+#define SendqDrop(x)    ((x)->sendq_drop)
 
 /** Get class name for ConfItem \a x. */
 #define ConfClass(x)    ((x)->conn_class->cc_name)
@@ -110,6 +137,10 @@ extern void add_class(char *name, unsigned int ping,
 extern void report_classes(struct Client *sptr, const struct StatDesc *sd,
                            char *param);
 extern unsigned int get_sendq(struct Client* cptr);
+extern unsigned int class_send_tokens(struct Client* cptr);
+extern void class_send_charge(struct Client* cptr, unsigned int bytes);
+extern int class_msg_take(struct Client* cptr);
+extern struct ConnectionClass *class_sendq_drop(struct Client* cptr);
 
 extern void class_send_meminfo(struct Client* cptr);
 #endif /* INCLUDED_class_h */
@@ -53,11 +53,13 @@ struct Listener;
 struct ListingArgs;
 struct SLink;
 struct Server;
+struct TargetSet;
 struct User;
 struct Whowas;
 struct hostent;
 struct Privs;
 struct AuthRequest;
+struct CryptRequest;
 
 /*
  * Structures
@@ -119,6 +121,9 @@ enum Flag
     FLAG_DEADSOCKET,                /**< Local socket is dead--Exiting soon */
     FLAG_KILLED,                    /**< Prevents "QUIT" from being sent for this */
     FLAG_BLOCKED,                   /**< socket is in a blocked condition */
+    FLAG_SHAPED,                    /**< output waits for send tokens */
+    FLAG_SHEDDING,                  /**< channel chatter is being dropped */
+    FLAG_ZEROCOPY,                  /**< socket may send without copying */
     FLAG_CLOSING,                   /**< set when closing to suppress errors */
     FLAG_UPING,                     /**< has active UDP ping request */
     FLAG_HUB,                       /**< server is a hub */
@@ -155,6 +160,15 @@ DECLARE_FLAGSET(Flags, FLAG_LAST_FLAG);
 
 #include "capab.h" /* client capabilities */
 
+/** Token bucket limiting the rate at which a connection uses some
+ * resource.  Tokens are added lazily, at the rate set by the
+ * connection's class, whenever the bucket is used.
+ */
+struct TokenBucket {
+  unsigned int        tb_tokens;     /**< Tokens currently available */
+  time_t              tb_last;       /**< Time tokens were last added */
+};
+
 /** Represents a local connection.
  * This contains a lot of stuff irrelevant to server connections, but
  * those are so rare as to not be worth special-casing.
@@ -164,11 +178,18 @@ struct Connection
   unsigned long       con_magic;     /**< magic number */
   struct Connection*  con_next;      /**< Next connection with queued data */
   struct Connection** con_prev_p;    /**< What points to us */
+  struct Connection*  con_inq_next;  /**< Next connection with pending
+                                        input */
+  struct Connection** con_inq_prev_p;/**< What points to us on the input
+                                        queue */
+  int                 con_deficit;   /**< Input bytes left for this turn */
   struct Client*      con_client;    /**< Client associated with connection */
   unsigned int        con_count;     /**< Amount of data in buffer */
   int                 con_freeflag;  /**< indicates if connection can be freed */
   int                 con_error;     /**< last socket level error for client */
   int                 con_sentalong; /**< sentalong marker for connection */
+  unsigned int        con_sendmask;  /**< Channels reached by a batched
+                                        message */
   unsigned int        con_snomask;   /**< mask for server messages */
   time_t              con_nextnick;  /**< Next time a nick change is allowed */
   time_t              con_nexttarget;/**< Next time a target change is allowed */
@@ -194,8 +215,17 @@ struct Connection
   unsigned int        con_ping_freq; /**< cached ping freq */
   unsigned short      con_lastsq;    /**< # 2k blocks when sendqueued
                                         called last. */
-  unsigned char       con_targets[MAXTARGETS]; /**< Hash values of
-						  current targets. */
+  struct TargetSet*   con_targets;   /**< Recent targets, if any. */
+  unsigned int        con_dropped;   /**< Channel messages dropped since
+                                        the send queue last drained. */
+  unsigned int        con_zc_next;   /**< Kernel's number for our next
+                                        zero-copy send. */
+  unsigned int        con_zc_sends;  /**< Writes sent with zero-copy. */
+  unsigned int        con_zc_copied; /**< Zero-copy writes the kernel
+                                        copied after all. */
+  unsigned int        con_zc_small;  /**< Writes copied for being small. */
+  struct TokenBucket  con_sendtb;    /**< Bytes we may send */
+  struct TokenBucket  con_msgtb;     /**< Messages we may process */
   char con_sock_ip[SOCKIPLEN + 1];   /**< Remote IP address as a string. */
   char con_sockhost[HOSTLEN + 1];    /**< This is the host name from
                                         the socket and after which the
@@ -206,12 +236,11 @@ struct Connection
                                         clients socket to close. */
   struct Socket       con_socket;    /**< socket descriptor for
                                       client */
-  struct Timer        con_proc;      /**< process latent messages from
-                                      client */
   struct Privs        con_privs;     /**< Oper privileges */
   struct CapSet       con_capab;     /**< Client capabilities (from us) */
   struct CapSet       con_active;    /**< Active capabilities (to us) */
   struct AuthRequest* con_auth;      /**< Auth request for client */
+  struct CryptRequest* con_crypt;    /**< Pending OPER password check */
   const struct wline* con_wline;     /**< WebIRC authorization for client */
 };
 
@@ -240,6 +269,10 @@ struct Client {
   char cli_name[HOSTLEN + 1];     /**< Unique name of the client, nick or host */
   char cli_username[USERLEN + 1]; /**< Username determined by ident lookup */
   char cli_info[REALLEN + 1];     /**< Free form additional client information */
+  unsigned char  cli_prefixlen;   /**< Length of cli_prefix, 0 if not valid */
+  char cli_prefix[NICKLEN + USERLEN + HOSTLEN + 3]; /**< Cached nick!user@host */
+  char           cli_numnick[6];  /**< Cached YYXXX numnick of a user */
+  unsigned int   cli_serial;      /**< Changes with nick, host or account */
 };
 
 /** Magic constant to identify valid Client structures. */
@@ -301,6 +334,17 @@ struct Client {
 #define cli_username(cli)	((cli)->cli_username)
 /** Get client realname (information field). */
 #define cli_info(cli)		((cli)->cli_info)
+/** Get client's cached nick!user@host prefix (see client_prefix()). */
+#define cli_prefix(cli)		((cli)->cli_prefix)
+/** Get length of client's cached prefix. */
+#define cli_prefixlen(cli)	((cli)->cli_prefixlen)
+/** Get client's identity serial number (see #ClientSerial). */
+#define cli_serial(cli)		((cli)->cli_serial)
+/** Forget a client's cached prefix after a nick, user or host change. */
+#define ClearPrefix(cli)	(cli_prefixlen(cli) = 0, \
+				 cli_serial(cli) = ++ClientSerial)
+/** Get client's cached full numnick (see client_numnick()). */
+#define cli_numnick(cli)	((cli)->cli_numnick)
 /** Get client's last channel join time. */
 #define cli_last_join(cli)      (cli_connect(cli)->con_last_join)
 /** Get client's last channel part time. */
@@ -354,6 +398,20 @@ struct Client {
 #define cli_lastsq(cli)		con_lastsq(cli_connect(cli))
 /** Get the array of current targets for the client.  */
 #define cli_targets(cli)	con_targets(cli_connect(cli))
+/** Get the number of channel messages dropped for the client. */
+#define cli_dropped(cli)	con_dropped(cli_connect(cli))
+/** Get the kernel's number for the client's next zero-copy write. */
+#define cli_zc_next(cli)	con_zc_next(cli_connect(cli))
+/** Get the number of zero-copy writes to the client. */
+#define cli_zc_sends(cli)	con_zc_sends(cli_connect(cli))
+/** Get the number of zero-copy writes to the client that were copied. */
+#define cli_zc_copied(cli)	con_zc_copied(cli_connect(cli))
+/** Get the number of small writes to a zero-copy client. */
+#define cli_zc_small(cli)	con_zc_small(cli_connect(cli))
+/** Get token bucket for bytes sent to client. */
+#define cli_sendtb(cli)		con_sendtb(cli_connect(cli))
+/** Get token bucket for messages received from client. */
+#define cli_msgtb(cli)		con_msgtb(cli_connect(cli))
 /** Get the string form of the client's IP address. */
 #define cli_sock_ip(cli)	con_sock_ip(cli_connect(cli))
 /** Get the resolved hostname for the client. */
@@ -364,14 +422,16 @@ struct Client {
 #define cli_buffer(cli)		con_buffer(cli_connect(cli))
 /** Get the Socket structure for sending to a client. */
 #define cli_socket(cli)		con_socket(cli_connect(cli))
-/** Get Timer for processing waiting messages from the client. */
-#define cli_proc(cli)		con_proc(cli_connect(cli))
 /** Get auth request for client. */
 #define cli_auth(cli)		con_auth(cli_connect(cli))
+/** Get pending OPER password check for client. */
+#define cli_crypt(cli)		con_crypt(cli_connect(cli))
 /** Get WebIRC authorization for client. */
 #define cli_wline(cli)          con_wline(cli_connect(cli))
 /** Get sentalong marker for client. */
 #define cli_sentalong(cli)      con_sentalong(cli_connect(cli))
+/** Get batched message target mask for client. */
+#define cli_sendmask(cli)       con_sendmask(cli_connect(cli))
 
 /** Verify that a connection is valid. */
 #define con_verify(con)		((con)->con_magic == CONNECTION_MAGIC)
@@ -381,6 +441,12 @@ struct Client {
 #define con_next(con)		((con)->con_next)
 /** Get global previous connection. */
 #define con_prev_p(con)		((con)->con_prev_p)
+/** Get next connection with pending input. */
+#define con_inq_next(con)	((con)->con_inq_next)
+/** Get what points to connection on the input queue. */
+#define con_inq_prev_p(con)	((con)->con_inq_prev_p)
+/** Get input bytes the connection may still parse this turn. */
+#define con_deficit(con)	((con)->con_deficit)
 /** Get locally connected client for connection. */
 #define con_client(con)		((con)->con_client)
 /** Get number of unprocessed data bytes from connection. */
@@ -393,6 +459,8 @@ struct Client {
 #define con_error(con)		((con)->con_error)
 /** Get sentalong marker for connection. */
 #define con_sentalong(con)      ((con)->con_sentalong)
+/** Get batched message target mask for connection. */
+#define con_sendmask(con)       ((con)->con_sendmask)
 /** Get server notice mask for connection. */
 #define con_snomask(con)	((con)->con_snomask)
 /** Get next nick change time for connection. */
@@ -431,6 +499,20 @@ struct Client {
 #define con_lastsq(con)		((con)->con_lastsq)
 /** Get the current targets array for the connection. */
 #define con_targets(con)	((con)->con_targets)
+/** Get the number of channel messages dropped for the connection. */
+#define con_dropped(con)	((con)->con_dropped)
+/** Get the kernel's number for the connection's next zero-copy write. */
+#define con_zc_next(con)	((con)->con_zc_next)
+/** Get the number of zero-copy writes on the connection. */
+#define con_zc_sends(con)	((con)->con_zc_sends)
+/** Get the number of zero-copy writes the kernel copied after all. */
+#define con_zc_copied(con)	((con)->con_zc_copied)
+/** Get the number of small writes to a zero-copy connection. */
+#define con_zc_small(con)	((con)->con_zc_small)
+/** Get token bucket for bytes sent on connection. */
+#define con_sendtb(con)		(&(con)->con_sendtb)
+/** Get token bucket for messages received on connection. */
+#define con_msgtb(con)		(&(con)->con_msgtb)
 /** Get the string-formatted IP address for the connection. */
 #define con_sock_ip(con)	((con)->con_sock_ip)
 /** Get the resolved hostname for the connection. */
@@ -441,8 +523,6 @@ struct Client {
 #define con_buffer(con)		((con)->con_buffer)
 /** Get the Socket for the connection. */
 #define con_socket(con)		((con)->con_socket)
-/** Get the Timer for processing more data from the connection. */
-#define con_proc(con)		((con)->con_proc)
 /** Get the oper privilege set for the connection. */
 #define con_privs(con)          (&(con)->con_privs)
 /** Get the peer's capabilities for the connection. */
@@ -451,6 +531,8 @@ struct Client {
 #define con_active(con)         (&(con)->con_active)
 /** Get the auth request for the connection. */
 #define con_auth(con)		((con)->con_auth)
+/** Get the pending OPER password check for the connection. */
+#define con_crypt(con)		((con)->con_crypt)
 /** Get the WebIRC block (if any) used by the connection. */
 #define con_wline(con)          ((con)->con_wline)
 
@@ -536,6 +618,12 @@ struct Client {
 #define IsAnOper(x)             (IsOper(x) || IsLocOp(x))
 /** Return non-zero if the client's connection is blocked. */
 #define IsBlocked(x)            HasFlag(x, FLAG_BLOCKED)
+/** Return non-zero if the client's output waits for send tokens. */
+#define IsShaped(x)             HasFlag(x, FLAG_SHAPED)
+/** Return non-zero if channel chatter to the client is being dropped. */
+#define IsShedding(x)           HasFlag(x, FLAG_SHEDDING)
+/** Return non-zero if the client's socket may send without copying. */
+#define IsZeroCopy(x)           HasFlag(x, FLAG_ZEROCOPY)
 /** Return non-zero if the client's connection is still being burst. */
 #define IsBurst(x)              HasFlag(x, FLAG_BURST)
 /** Return non-zero if we have received the peer's entire burst but
@@ -667,7 +755,6 @@ struct Client {
 
 /* free flags */
 #define FREEFLAG_SOCKET	0x0001	/**< socket needs to be freed */
-#define FREEFLAG_TIMER	0x0002	/**< timer needs to be freed */
 
 /* server notice stuff */
 
@@ -729,6 +816,8 @@ struct Client {
 #define HIDE_IP 0 /**< Do not show IP address in get_client_name() */
 #define SHOW_IP 1 /**< Show ident and IP address in get_client_name() */
 
+extern unsigned int ClientSerial;
+
 extern const char* get_client_name(const struct Client* sptr, int showip);
 extern const char* client_get_default_umode(const struct Client* sptr);
 extern int client_get_ping(const struct Client* local_client);
@@ -23,5 +23,9 @@ extern struct CRuleNode* crule_make_via(char *neighbor,
                                         char *server);
 extern struct CRuleNode* crule_make_directop(void);
 extern void crule_free(struct CRuleNode* elem);
+extern int crule_flatten(struct CRuleNode *rule, const char **words,
+                         int max);
+extern struct CRuleNode* crule_unflatten(const char * const *words,
+                                         int count);
 
 #endif /* INCLUDED_crule_h */
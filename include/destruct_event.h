@@ -32,6 +32,5 @@
 extern void schedule_destruct_event_1m(struct Channel* chptr);
 extern void schedule_destruct_event_48h(struct Channel* chptr);
 extern void remove_destruct_event(struct Channel* chptr);
-extern void exec_expired_destruct_events(struct Event* ev);
 
 #endif /* INCLUDED_destruct_event_h */
@@ -0,0 +1,62 @@
+/*
+ * IRC - Internet Relay Chat, include/expiry.h
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Timing wheel for deferred expiry of long-lived objects.
+ */
+#ifndef INCLUDED_expiry_h
+#define INCLUDED_expiry_h
+#ifndef INCLUDED_sys_types_h
+#include <sys/types.h>		/* time_t */
+#define INCLUDED_sys_types_h
+#endif
+
+struct Expiry;
+
+/** Function called when an entry expires.  The entry is no longer
+ * scheduled when it is called, so it may be freed or added again.
+ */
+typedef void (*ExpiryCallBack)(struct Expiry* ex);
+
+/** Expiry entry.  Objects embed one of these rather than allocating
+ * it, so scheduling and cancelling never touch the heap.  A zeroed
+ * entry is valid and not scheduled.
+ */
+struct Expiry {
+  struct Expiry*  ex_next;	/**< Next entry in the same wheel slot. */
+  struct Expiry** ex_prev_p;	/**< What points to us (NULL if idle). */
+  time_t          ex_when;	/**< When the entry expires. */
+  ExpiryCallBack  ex_call;	/**< Function to call at that time. */
+  void*           ex_data;	/**< Object the entry belongs to. */
+};
+
+/** Check whether an entry is scheduled. */
+#define ex_active(ex)	((ex)->ex_prev_p != 0)
+/** Get the time at which an entry expires. */
+#define ex_when(ex)	((ex)->ex_when)
+/** Get the object an entry belongs to. */
+#define ex_data(ex)	((ex)->ex_data)
+
+/*
+ * Prototypes
+ */
+extern void expiry_add(struct Expiry* ex, ExpiryCallBack call, void* data,
+		       time_t when);
+extern void expiry_del(struct Expiry* ex);
+
+#endif /* INCLUDED_expiry_h */
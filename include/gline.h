@@ -31,6 +31,9 @@
 #ifndef INCLUDED_res_h
 #include "res.h"
 #endif
+#ifndef INCLUDED_expiry_h
+#include "expiry.h"
+#endif
 
 struct Client;
 struct StatDesc;
@@ -58,6 +61,7 @@ struct Gline {
   unsigned char gl_bits;	/**< Bits in gl_addr used in the mask. */
   unsigned int	gl_flags;	/**< G-line status flags. */
   enum GlineLocalState gl_state;/**< G-line local state. */
+  struct Expiry gl_expiry;	/**< Next deactivation or expiration. */
 };
 
 /** Action to perform on a G-line. */
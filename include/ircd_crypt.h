@@ -35,8 +35,14 @@ struct crypt_mech_s {
                         as belonging to this mechanism */
 
  unsigned int crypt_token_size; /* how long is the token */
+
+ unsigned int crypt_flags; /* CRYPT_* flags for the mechanism */
 };
 
+/** Mechanism is too slow to run on the event loop; passwords using it
+ * are checked by a crypt worker process. */
+#define CRYPT_SLOW 0x0001
+
 typedef struct crypt_mech_s crypt_mech_t;
 
 struct crypt_mechs_s;
@@ -55,12 +61,27 @@ struct crypt_mechs_s {
 #define CryptFunc(x) x->crypt_function
 #define CryptTok(x) x->crypt_token
 #define CryptTokSize(x) x->crypt_token_size
+#define CryptFlags(x) x->crypt_flags
+
+struct CryptRequest;
+
+/** Called when an asynchronous password check completes.
+ * @param ctx Context pointer passed to ircd_crypt_check().
+ * @param match 1 if the password matched, 0 if not, or -1 if the
+ * check was cancelled (only \a ctx may then be used).
+ */
+typedef void (*crypt_check_call)(void* ctx, int match);
 
 /* exported functions */
 extern void ircd_crypt_init(void);
 extern char* ircd_crypt(const char* key, const char* salt);
 extern int ircd_crypt_register_mech(crypt_mech_t* mechanism);
 extern int ircd_crypt_unregister_mech(crypt_mech_t* mechanism);
+extern struct CryptRequest* ircd_crypt_check(const char* key,
+                                             const char* hash,
+                                             crypt_check_call call,
+                                             void* ctx);
+extern void ircd_crypt_cancel(struct CryptRequest* req);
 
 /* exported variables */
 extern crypt_mechs_t* crypt_mechs_root;
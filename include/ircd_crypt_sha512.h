@@ -0,0 +1,28 @@
+/*
+ * IRC - Internet Relay Chat, include/ircd_crypt_sha512.h
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Declarations for SHA-512 crypt password hashing.
+ */
+#ifndef INCLUDED_ircd_crypt_sha512_h
+#define INCLUDED_ircd_crypt_sha512_h
+
+extern const char* ircd_crypt_sha512(const char* key, const char* salt);
+extern void ircd_register_crypt_sha512(void);
+
+#endif /* INCLUDED_ircd_crypt_sha512_h */
@@ -59,7 +59,8 @@ enum EventType {
   ET_ACCEPT,		/**< Connection can be accepted */
   ET_CONNECT,		/**< Connection completed */
   ET_EOF,		/**< End-of-file on connection */
-  ET_ERROR,		/**< Error condition detected */
+  ET_ERROR,		/**< Error condition detected (0: error queue only,
+			   see socket_errqueue()) */
   ET_SIGNAL,		/**< A signal was received */
   ET_EXPIRE,		/**< A timer expired */
   ET_DESTROY		/**< The generator is being destroyed */
@@ -90,6 +91,7 @@ struct GenHeader {
 #define GEN_ACTIVE	0x0004	/**< generator is active */
 #define GEN_READD	0x0008	/**< generator (timer) must be re-added */
 #define GEN_ERROR	0x0010	/**< an error occurred on the generator */
+#define GEN_ERRQUEUE	0x0020	/**< socket wants error queue events */
 
 /** Socket event generator.
  * Note: The socket state overrides the socket event mask; that is, if
@@ -123,6 +125,8 @@ struct Socket {
 #define s_events(sock)	((sock)->s_events)
 /** Retrieve file descriptor of the Socket \a sock. */
 #define s_fd(sock)	((sock)->s_fd)
+/** Test whether the Socket \a sock wants error queue events. */
+#define s_errqueue(sock) ((sock)->s_header.gh_flags & GEN_ERRQUEUE)
 /** Retrieve user data pointer of the Socket \a sock. */
 #define s_data(sock)	((sock)->s_header.gh_data)
 /** Retrieve engine data integer of the Socket \a sock. */
@@ -293,6 +297,7 @@ int socket_add(struct Socket* sock, EventCallBack call, void* data,
 void socket_del(struct Socket* sock);
 void socket_state(struct Socket* sock, enum SocketState state);
 void socket_events(struct Socket* sock, unsigned int events);
+void socket_errqueue(struct Socket* sock);
 
 const char* engine_name(void);
 
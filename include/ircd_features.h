@@ -38,6 +38,10 @@ enum Feature {
   FEAT_BUFFERPOOL,
   FEAT_HAS_FERGUSON_FLUSHER,
   FEAT_CLIENT_FLOOD,
+  FEAT_INPUT_QUANTUM,
+  FEAT_SEND_COALESCE,
+  FEAT_SERVER_ZEROCOPY,
+  FEAT_ZEROCOPY_MIN,
   FEAT_SERVER_PORT,
   FEAT_NODEFAULTMOTD,
   FEAT_MOTD_BANNER,
@@ -55,6 +59,8 @@ enum Feature {
   FEAT_HIDDEN_HOST,
   FEAT_HIDDEN_IP,
   FEAT_CONNEXIT_NOTICES,
+  FEAT_SNOTICE_AGGREGATE_INTERVAL,
+  FEAT_SNOTICE_AGGREGATE_THRESHOLD,
   FEAT_OPLEVELS,
   FEAT_ZANNELS,
   FEAT_LOCAL_CHANNELS,
@@ -84,6 +90,7 @@ enum Feature {
   FEAT_IPCHECK_48_CLONE_LIMIT,
   FEAT_IPCHECK_48_CLONE_PERIOD,
   FEAT_IPCHECK_CLONE_DELAY,
+  FEAT_TARGET_HISTORY,
   FEAT_CHANNELLEN,
 
   /* Some misc. default paths */
@@ -98,6 +105,7 @@ enum Feature {
   FEAT_IRCD_RES_RETRIES,
   FEAT_IRCD_RES_TIMEOUT,
   FEAT_AUTH_TIMEOUT,
+  FEAT_CRYPT_WORKERS,
   FEAT_ANNOUNCE_INVITES,
 
   /* features that affect all operators */
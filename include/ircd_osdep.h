@@ -42,6 +42,12 @@ extern IOResult os_send_nonb(int fd, const char* buf, unsigned int length,
                         unsigned int* length_out);
 extern IOResult os_sendv_nonb(int fd, struct MsgQ* buf,
 			      unsigned int* len_in, unsigned int* len_out);
+extern IOResult os_send_coalesced(int fd, struct MsgQ* buf, unsigned int size,
+                                  unsigned int* len_in, unsigned int* len_out);
+extern IOResult os_sendv_zerocopy(int fd, struct MsgQ* buf,
+				  unsigned int* len_in, unsigned int* len_out);
+extern int os_zerocopy_done(int fd, unsigned int* lo, unsigned int* hi,
+                            int* copied);
 extern IOResult os_recvfrom_nonb(int fd, char* buf, unsigned int len,
                                  unsigned int* length_out,
                                  struct irc_sockaddr* from_out);
@@ -52,6 +58,7 @@ extern int os_set_nonblocking(int fd);
 extern int os_set_reuseaddr(int fd);
 extern int os_set_sockbufs(int fd, unsigned int ssize, unsigned int rsize);
 extern int os_set_tos(int fd,int tos);
+extern int os_set_zerocopy(int fd);
 extern int os_socketpair(int sv[2]);
 
 #endif /* INCLUDED_ircd_osdep_h */
@@ -0,0 +1,47 @@
+/*
+ * IRC - Internet Relay Chat, include/ircd_sha512.h
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief SHA-512 implementation for ircu.
+ */
+#ifndef INCLUDED_ircd_sha512_h
+#define INCLUDED_ircd_sha512_h
+#ifndef INCLUDED_stdint_h
+#include <stdint.h>
+#define INCLUDED_stdint_h
+#endif
+
+/** Size of a SHA-512 digest in bytes. */
+#define SHA512_DIGEST_LENGTH 64
+/** Size of a SHA-512 input block in bytes. */
+#define SHA512_BLOCK_LENGTH 128
+
+/** SHA-512 context structure. */
+struct SHA512Context {
+  uint64_t state[8];                      /**< Current digest state. */
+  uint64_t count;                         /**< Number of bytes hashed. */
+  unsigned char buf[SHA512_BLOCK_LENGTH]; /**< Residual input buffer. */
+};
+
+extern void SHA512Init(struct SHA512Context *ctx);
+extern void SHA512Update(struct SHA512Context *ctx, const void *data,
+                         unsigned int len);
+extern void SHA512Final(unsigned char digest[SHA512_DIGEST_LENGTH],
+                        struct SHA512Context *ctx);
+
+#endif /* INCLUDED_ircd_sha512_h */
@@ -53,6 +53,8 @@ extern int ircd_snprintf(struct Client *dest, char *buf, size_t buf_len,
 			 const char *format, ...);
 extern int ircd_vsnprintf(struct Client *dest, char *buf, size_t buf_len,
 			  const char *format, va_list args);
+extern const char *client_prefix(struct Client *cptr, unsigned int *len);
+extern const char *client_numnick(struct Client *cptr);
 
 /** @fn int ircd_snprintf(struct Client *dest, char *buf, size_t
 			 buf_len, const char *format, ...)
@@ -18,7 +18,23 @@ struct irc_in_addr;
 /** Check whether \a x is a NULL or empty string. */
 #define EmptyString(x) (!(x) || !(*x))
 
+/** Message text contains mIRC colors or ANSI escapes. */
+#define TEXT_COLOR      0x0001
+/** Message text contains bold, underline or other formatting codes. */
+#define TEXT_FORMAT     0x0002
+/** Message text contains a CTCP other than a leading ACTION. */
+#define TEXT_CTCP       0x0004
+/** Message text is a CTCP ACTION. */
+#define TEXT_ACTION     0x0008
+/** Message text contains bytes with the high bit set. */
+#define TEXT_HIGHBIT    0x0010
+/** Message text is mostly capital letters. */
+#define TEXT_CAPS       0x0020
+/** Flag for callers caching string_classify() results. */
+#define TEXT_CLASSIFIED 0x8000
+
 extern int string_has_wildcards(const char* str);
+extern unsigned int string_classify(const char* text);
 
 extern char*       ircd_strncpy(char* dest, const char* src, size_t len);
 extern int         ircd_strcmp(const char *a, const char *b);
@@ -27,6 +27,9 @@
 #include <sys/types.h>
 #define INCLUDED_sys_types_h
 #endif
+#ifndef INCLUDED_expiry_h
+#include "expiry.h"
+#endif
 
 
 struct Client;
@@ -44,6 +47,7 @@ struct Jupe {
   time_t         ju_expire;  /**< Expiration time of the jupe. */
   time_t         ju_lastmod; /**< Last modification time (if any) for the jupe. */
   unsigned int   ju_flags;   /**< Status flags for the jupe. */
+  struct Expiry  ju_expiry;  /**< Expiration of the jupe. */
 };
 
 #define JUPE_ACTIVE	0x0001  /**< Jupe is globally active. */
@@ -37,6 +37,7 @@
 #endif
 
 struct Client;
+struct MsgBuf;
 struct TRecord;
 struct StatDesc;
 
@@ -62,23 +63,32 @@ struct Motd {
   struct MotdCache*	cache;    /**< MOTD cache entry. */
 };
 
-/** Length of one MOTD line(80 chars + '\\0'). */
+/** Length of one MOTD line(80 chars + '\\0'); longer lines are split. */
 #define MOTD_LINESIZE	81
 /** Maximum number of lines for local MOTD */
 #define MOTD_MAXLINES	100
 /** Maximum number of lines for remote MOTD */
 #define MOTD_MAXREMOTE	3
 
-/** Cache entry for the contents of a MOTD file. */
+/** Cache entry for the contents of a MOTD file.
+ * Entries are shared by all MOTDs with the same file and line limit.
+ * An entry whose reference count drops to zero is kept until the next
+ * rehash, so that it can be reused if its file has not changed.
+ */
 struct MotdCache {
   struct MotdCache*	next;     /**< Next MotdCache in list. */
   struct MotdCache**	prev_p;   /**< Pointer to previous node's next pointer. */
   int			ref;      /**< Number of references to this entry. */
   char*			path;     /**< Pathname of file. */
-  int			maxcount; /**< Number of lines allocated for message. */
+  int			maxcount; /**< Maximum number of lines for message. */
   struct tm		modtime;  /**< Last modification time from file. */
-  int			count;    /**< Actual number of lines used in message. */
-  char			motd[1][MOTD_LINESIZE]; /**< Message body. */
+  time_t		mtime;    /**< Modification time, to detect changes. */
+  off_t			size;     /**< File size, to detect changes. */
+  dev_t			dev;      /**< Device of file, to detect changes. */
+  ino_t			ino;      /**< Inode of file, to detect changes. */
+  int			count;    /**< Number of lines, or -1 if not read yet. */
+  struct MsgBuf**	lines;    /**< Preformatted RPL_MOTD texts, starting
+                                     with the modification time. */
 };
 
 /* motd_send sends a MOTD off to a user */
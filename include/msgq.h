@@ -40,6 +40,7 @@ struct StatDesc;
 
 struct Msg;
 struct MsgBuf;
+struct MsgHold;
 
 /** Queue of individual messages. */
 struct MsgQList {
@@ -48,12 +49,42 @@ struct MsgQList {
   unsigned int sent;		/**< Bytes in *head that have already been sent */
 };
 
-/** Entire two-priority message queue for a destination. */
+/** Priority classes of queued messages.  Each class has its own list
+ * in a struct MsgQ; msgq_mapiov() interleaves the lists by weight.
+ */
+enum MsgQClass {
+  MQ_NORMAL,			/**< Network state and chatter, in order */
+  MQ_ENFORCE,			/**< Network-wide bans: GLINE and JUPE */
+  MQ_CONTROL,			/**< Link upkeep: PING, PONG, SETTIME */
+  MQ_CLASSES			/**< Number of priority classes */
+};
+
+/** Flag for msgq_add(): no later message may be sent before this one.
+ * Used for server introductions, so that messages from those servers
+ * cannot overtake them in a higher priority class.
+ */
+#define MQ_BARRIER	0x100
+
+/** Flag for msgq_add(): the message is channel chatter that
+ * msgq_prune() may discard when the destination cannot keep up.
+ */
+#define MQ_DROPPABLE	0x200
+
+/** Extract the priority class from a msgq_add() priority. */
+#define MQ_CLASS(prio)	((prio) & 0xff)
+
+/** Entire multi-priority message queue for a destination. */
 struct MsgQ {
   unsigned int length;		/**< Current number of bytes stored */
   unsigned int count;		/**< Current number of messages stored */
-  struct MsgQList queue;	/**< Normal Msg queue */
-  struct MsgQList prio;		/**< Priority Msg queue */
+  unsigned int barriers;	/**< Number of barriers ever queued */
+  unsigned int passed;		/**< Number of barriers ever sent */
+  unsigned short cur;		/**< Class whose turn it is */
+  unsigned short left;		/**< Messages left in \a cur's turn */
+  struct MsgQList list[MQ_CLASSES]; /**< Msg queue for each class */
+  struct MsgHold *hold_head;	/**< Oldest buffers held for the kernel */
+  struct MsgHold *hold_tail;	/**< Newest buffers held for the kernel */
+  unsigned int held;		/**< Number of held sends */
 };
 
 /** Returns the current number of bytes stored in \a mq. */
@@ -62,6 +93,9 @@ struct MsgQ {
 /** Returns the current number of messages stored in \a mq. */
 #define MsgQCount(mq) ((mq)->count)
 
+/** Returns the number of sends whose buffers \a mq still holds. */
+#define MsgQHeld(mq) ((mq)->held)
+
 /** Scratch the current content of the buffer.
  * Release all allocated buffers and make it empty.
  */
@@ -75,12 +109,27 @@ extern void msgq_delete(struct MsgQ *mq, unsigned int length);
 extern int msgq_mapiov(const struct MsgQ *mq, struct iovec *iov, int count,
 		       unsigned int *len);
 extern struct MsgBuf *msgq_make(struct Client *dest, const char *format, ...);
+extern struct MsgBuf *msgq_make_text(struct Client *dest,
+				     struct Client *from, const char *cmd,
+				     const char *target, const char *text);
 extern struct MsgBuf *msgq_vmake(struct Client *dest, const char *format,
 				 va_list args);
+extern struct MsgBuf *msgq_make_head(struct Client *dest,
+				     const char *format, ...);
 extern void msgq_append(struct Client *dest, struct MsgBuf *mb,
 			const char *format, ...);
+extern struct MsgBuf *msgq_fit(struct MsgBuf *mb);
 extern void msgq_clean(struct MsgBuf *mb);
 extern void msgq_add(struct MsgQ *mq, struct MsgBuf *mb, int prio);
+extern void msgq_add_tail(struct MsgQ *mq, struct MsgBuf *head,
+			  struct MsgBuf *tail, int prio);
+extern unsigned int msgq_prune(struct MsgQ *mq);
+extern unsigned int msgq_flatten(const struct MsgQ *mq, char *buf,
+				 unsigned int size);
+extern void msgq_hold(struct MsgQ *mq, unsigned int length, unsigned int id);
+extern unsigned int msgq_release(struct MsgQ *mq, unsigned int lo,
+				 unsigned int hi);
+extern void msgq_move_holds(struct MsgQ *to, struct MsgQ *from);
 extern void msgq_count_memory(struct Client *cptr,
                               size_t *msg_alloc, size_t *msg_used);
 extern void msgq_histogram(struct Client *cptr, const struct StatDesc *sd,
@@ -52,7 +52,8 @@ extern struct irc_sockaddr VirtualHost_dns_v6;
 /*
  * Proto types
  */
-extern unsigned int deliver_it(struct Client *cptr, struct MsgQ *buf);
+extern unsigned int deliver_it(struct Client *cptr, struct MsgQ *buf,
+                               unsigned int limit);
 extern int connect_server(struct ConfItem* aconf, struct Client* by);
 extern int  net_close_unregistered_connections(struct Client* source);
 extern void close_connection(struct Client *cptr);
@@ -62,5 +63,7 @@ extern void init_server_identity(void);
 extern void close_connections(int close_stderr);
 extern int  init_connection_limits(int maxconn);
 extern void update_write(struct Client* cptr);
+extern void input_run(void);
+extern int  input_delay(int wait);
 
 #endif /* INCLUDED_s_bsd_h */
@@ -161,6 +161,51 @@ struct s_map {
   struct nick_host *services; /**< Linked list of possible targets. */
 };
 
+/** Kinds of configuration record.  The parser hands the result of
+ * each block or setting to conf_link() as one record, whose values
+ * are listed here in the order conf_link() takes them.
+ */
+enum ConfRecordType {
+  CRT_JUPE,        /**< Jupe nicks: nick list. */
+  CRT_GENERAL,     /**< Start of a General block: no values. */
+  CRT_NUMERIC,     /**< Server numeric: number. */
+  CRT_NAME,        /**< Server name: name. */
+  CRT_DESCRIPTION, /**< Server description: text. */
+  CRT_VHOST,       /**< Virtual host: address. */
+  CRT_DNS_VHOST,   /**< Resolver virtual host: use for IPv4, use for
+                      IPv6, address. */
+  CRT_DNS_SERVER,  /**< Resolver: address text. */
+  CRT_ADMIN,       /**< Admin block: two locations, contact. */
+  CRT_CLASS,       /**< Class block: name, ping frequency, connect
+                      frequency, maximum links, sendq, user modes,
+                      privileges, privileges set, send rate, send
+                      burst, message rate, message burst, sendq drop. */
+  CRT_CONNECT,     /**< Connect block: name, vhost, password, host,
+                      class name, port, maximum hops, hub mask, flags. */
+  CRT_UWORLD,      /**< UWorld server: name, flags. */
+  CRT_OPERATOR,    /**< One host of an Operator block: name, password,
+                      user@host, class name, privileges, privileges
+                      set. */
+  CRT_PORT,        /**< One address of a Port block: port, vhost, mask,
+                      listener flags. */
+  CRT_CLIENT,      /**< Client block: username, host, IP mask text, IP
+                      address, mask bits, port, class name, maximum
+                      links, password. */
+  CRT_KILL,        /**< Kill block: username, host, realname, reason,
+                      DENY_FLAGS_*, address, mask bits. */
+  CRT_CRULE,       /**< CRule block: host mask, rule text, CRULE_*,
+                      words of the rule from crule_flatten(). */
+  CRT_MOTD,        /**< One host of a Motd block: host mask, file. */
+  CRT_FEATURE,     /**< Feature setting: name and values. */
+  CRT_QUARANTINE,  /**< Quarantined channel: channel, reason. */
+  CRT_PSEUDO,      /**< Pseudo block: command, name, prepend text,
+                      SMAP_* flags, nick\@host targets. */
+  CRT_IAUTH,       /**< IAuth block: program and arguments. */
+  CRT_WEBIRC,      /**< WebIRC block: password, description, address,
+                      mask bits, hidden. */
+  CRT_LAST         /**< Number of record kinds. */
+};
+
 
 /*
  * GLOBALS
@@ -170,6 +215,7 @@ extern int              GlobalConfCount;
 extern struct s_map*    GlobalServiceMapList;
 extern struct qline*    GlobalQuarantineList;
 extern struct wline*    GlobalWebircList;
+extern int              conf_checking;
 
 /*
  * Proto types
@@ -190,6 +236,7 @@ extern struct ConfItem* conf_find_server(const char* name);
 
 extern void update_uworld_flags(struct Client *cptr);
 extern void conf_make_uworld(char *name, unsigned int flags);
+extern void conf_link(enum ConfRecordType type, ...);
 extern void stats_uworld(struct Client* to, const struct StatDesc* sd, char* param);
 
 extern void det_confs_butmask(struct Client *cptr, int mask);
@@ -11,18 +11,53 @@
 #include <time.h>	/* time_t */
 #define INCLUDED_time_h
 #endif
+#ifndef INCLUDED_res_h
+#include "res.h"		/* struct irc_in_addr */
+#endif
 
 struct Channel;
 struct Client;
 struct DBuf;
 struct MsgBuf;
 
+/** Number of address prefixes counted separately by a SnoAggregate. */
+#define SNO_AGG_PREFIXES 8
+
+/** Count of aggregated server notices for one address prefix. */
+struct SnoAggPrefix {
+  struct irc_in_addr addr;	/**< Prefix (/16 for IPv4, /48 for IPv6). */
+  unsigned int count;		/**< Notices seen for the prefix. */
+};
+
+/** State for collapsing a flood of one kind of server notice into
+ * periodic summaries.  Declare one statically per notice with
+ * SNO_AGGREGATE_INIT() and pass it to sendto_opmask_aggregate().
+ */
+struct SnoAggregate {
+  struct SnoAggregate *next;	/**< Next aggregate with a pending summary. */
+  const char *what;		/**< Plural noun used in summaries. */
+  unsigned int mask;		/**< Server notice mask of the notices. */
+  time_t start;			/**< Start of the current interval. */
+  unsigned int sent;		/**< Notices sent verbatim this interval. */
+  unsigned int suppressed;	/**< Notices withheld this interval. */
+  unsigned int other;		/**< Notices without a tracked prefix. */
+  unsigned int nprefix;		/**< Number of prefixes in use. */
+  struct SnoAggPrefix prefix[SNO_AGG_PREFIXES]; /**< Per-prefix counts. */
+};
+
+/** Static initializer for a SnoAggregate.
+ * @param[in] what Plural noun describing the notices, e.g. "connects".
+ */
+#define SNO_AGGREGATE_INIT(what) { 0, (what) }
+
 /*
  * Prototypes
  */
-extern struct SLink *opsarray[];
+extern void sno_subscribe(struct Client *cptr, unsigned int mask, int on);
 
 extern void send_buffer(struct Client* to, struct MsgBuf* buf, int prio);
+extern void send_buffer_tail(struct Client* to, struct MsgBuf* buf,
+                             struct MsgBuf* tail, int prio);
 
 extern void kill_highest_sendq(int servers_too);
 extern void flush_connections(struct Client* cptr);
@@ -38,6 +73,11 @@ extern void sendcmdto_one(struct Client *from, const char *cmd,
 			  const char *tok, struct Client *to,
 			  const char *pattern, ...);
 
+/* Send a PRIVMSG or NOTICE style text command to one client */
+extern void sendtextto_one(struct Client *from, const char *cmd,
+			   const char *tok, struct Client *to,
+			   const char *text);
+
 /* Same as above, except it puts the message on the priority queue */
 extern void sendcmdto_prio_one(struct Client *from, const char *cmd,
 			       const char *tok, struct Client *to,
@@ -67,6 +107,18 @@ extern void sendcmdto_channel(struct Client *from, const char *cmd,
                               struct Client *one, unsigned int skip,
                               const char *pattern, ...);
 
+/* Send a PRIVMSG or NOTICE style text command to a channel */
+extern void sendtextto_channel(struct Client *from, const char *cmd,
+                               const char *tok, struct Channel *to,
+                               struct Client *one, unsigned int skip,
+                               const char *text);
+
+/* Send a PRIVMSG or NOTICE style text command to several channels */
+extern void sendtextto_channels(struct Client *from, const char *cmd,
+                                const char *tok, struct Channel **to,
+                                unsigned int count, struct Client *one,
+                                unsigned int skip, const char *text);
+
 #define SKIP_DEAF	0x01	/**< skip users that are +d */
 #define SKIP_BURST	0x02	/**< skip users that are bursting */
 #define SKIP_NONOPS	0x04	/**< skip users that aren't chanops */
@@ -98,6 +150,12 @@ extern void sendto_opmask_ratelimited(struct Client *one,
                                       unsigned int mask, time_t *rate,
                                       const char *pattern, ...);
 
+/* Same as above, but collapsed into summaries during floods */
+extern void sendto_opmask_aggregate(struct Client *one, unsigned int mask,
+                                    struct SnoAggregate *agg,
+                                    const struct irc_in_addr *addr,
+                                    const char *pattern, ...);
+
 /* Send server notice to all local users */
 extern void sendto_lusers(const char *pattern, ...);
 
@@ -0,0 +1,38 @@
+/*
+ * IRC - Internet Relay Chat, include/silence.h
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Compiled SILENCE lists.
+ */
+#ifndef INCLUDED_silence_h
+#define INCLUDED_silence_h
+
+struct Ban;
+struct Client;
+struct User;
+
+/** Number of per-sender results cached for each silence list. */
+#define SILENCE_CACHE 8
+
+/*
+ * Prototypes
+ */
+extern void silence_update(struct User *user);
+extern struct Ban *silence_find(struct Client *sptr, struct User *user);
+
+#endif /* INCLUDED_silence_h */
@@ -37,6 +37,7 @@ struct User;
 struct Membership;
 struct Invite;
 struct SLink;
+struct SilenceIndex;
 
 /** Describes a server on the network. */
 struct Server {
@@ -73,6 +74,7 @@ struct User {
   struct Membership* channel;        /**< chain of channel pointer blocks */
   struct Invite*     invited;        /**< chain of invite pointer blocks */
   struct Ban*        silence;        /**< chain of silence pointer blocks */
+  struct SilenceIndex* silence_index; /**< compiled form of silence */
   char*              away;           /**< pointer to away message */
   time_t             last;           /**< last time user sent a message */
   unsigned int       refcnt;         /**< Number of times this block is referenced */
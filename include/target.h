@@ -0,0 +1,48 @@
+/*
+ * IRC - Internet Relay Chat, include/target.h
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Recent target sets used for target change limiting.
+ */
+#ifndef INCLUDED_target_h
+#define INCLUDED_target_h
+#ifndef INCLUDED_sys_types_h
+#include <sys/types.h>		/* time_t */
+#define INCLUDED_sys_types_h
+#endif
+
+/** Largest accepted value of the TARGET_HISTORY feature. */
+#define TARGET_HISTORY_MAX 128
+
+struct TargetSet;
+
+/*
+ * Prototypes
+ */
+extern int target_find(const struct TargetSet *set, const void *target);
+extern int target_touch(struct TargetSet *set, const void *target);
+extern void target_add(struct TargetSet **pset, const void *target,
+		       int reserved);
+extern struct TargetSet *target_copy(const struct TargetSet *set);
+extern void target_free(struct TargetSet *set);
+extern unsigned int target_count(const struct TargetSet *set);
+
+extern unsigned int target_free_count(time_t next);
+extern time_t target_next_time(unsigned int free_targets);
+
+#endif /* INCLUDED_target_h */
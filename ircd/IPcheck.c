@@ -27,27 +27,29 @@
 #include "match.h"
 #include "msg.h"
 #include "ircd_alloc.h"
-#include "ircd_events.h"
+#include "expiry.h"
 #include "ircd_features.h"
 #include "ircd_log.h"
 #include "ircd_string.h"    /* ircd_ntoa */
 #include "s_debug.h"        /* Debug */
 #include "s_user.h"         /* TARGET_DELAY */
 #include "send.h"
+#include "target.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
 #include <string.h>
 
 /** Stores free target information for a particular user. */
 struct IPTargetEntry {
-  unsigned int  count; /**< Number of free targets targets. */
-  unsigned char targets[MAXTARGETS]; /**< Array of recent targets. */
+  unsigned int      count;   /**< Number of free targets targets. */
+  struct TargetSet* targets; /**< Recent targets, if any. */
 };
 
 /** Stores recent information about a particular IP address. */
 struct IPRegistryEntry {
   struct IPRegistryEntry*  next;   /**< Next entry in the hash chain. */
   struct IPTargetEntry*    target; /**< Recent targets, if any. */
+  struct Expiry            expire; /**< Expiry while nobody is connected. */
   struct irc_in_addr       addr;   /**< IP address for this user. */
   int		           last_connect; /**< Last connection attempt timestamp. */
   unsigned short           connected; /**< Number of currently connected clients. */
@@ -57,6 +59,7 @@ struct IPRegistryEntry {
 /** Stores information about an IPv6/48 block's recent connections. */
 struct IPRegistry48 {
   struct IPRegistry48* next;     /**< Next entry in the hash chain. */
+  struct Expiry        expire;   /**< Expiry of the entry. */
   int              last_connect; /**< Last connection attempt timestamp. */
   uint16_t             addr[3];  /**< 48 MSBs of IP address. */
   unsigned short       attempts; /**< Number of recent connection attempts. */
@@ -69,6 +72,12 @@ struct IPRegistry48 {
 /** Time from \a x until now, in seconds. */
 #define CONNECTED_SINCE(x) (NOW - (x))
 
+/** Seconds after the last connection before an idle entry is removed. */
+#define IP_REGISTRY_EXPIRE 600
+/** Seconds after the last connection before an idle entry forgets its
+ * free targets. */
+#define IP_TARGET_EXPIRE 120
+
 /** Macro for easy access to configured IPcheck clone limit. */
 #define IPCHECK_CLONE_LIMIT feature_int(FEAT_IPCHECK_CLONE_LIMIT)
 /** Macro for easy access to configured IPcheck clone period. */
@@ -88,8 +97,6 @@ static struct IPRegistry48* hashTable48[IP_REGISTRY_TABLE_SIZE];
 static struct IPRegistryEntry* freeList;
 /** List of allocated but unused IPRegistry48 structs. */
 static struct IPRegistry48* freeList48;
-/** Periodic timer to look for too-old registry entries. */
-static struct Timer expireTimer;
 
 /** Convert IP addresses to canonical form for comparison.  IPv4
  * addresses are translated into 6to4 form; IPv6 addresses are
@@ -198,14 +205,25 @@ static struct IPRegistryEntry* ip_registry_new_entry(void)
   return entry;
 }
 
+/** Release the free target information of \a entry, if any.
+ * @param[in,out] entry IP registry entry to update.
+ */
+static void ip_registry_free_target(struct IPRegistryEntry* entry)
+{
+  if (entry->target) {
+    target_free(entry->target->targets);
+    MyFree(entry->target);
+    entry->target = 0;
+  }
+}
+
 /** Deallocate memory for \a entry.
  * The entry itself is prepended to #freeList.
  * @param[in] entry IP registry entry to release.
  */
 static void ip_registry_delete_entry(struct IPRegistryEntry* entry)
 {
-  if (entry->target)
-    MyFree(entry->target);
+  ip_registry_free_target(entry);
   entry->next = freeList;
   freeList = entry;
 }
@@ -226,32 +244,72 @@ static unsigned int ip_registry_update_free_targets(struct IPRegistryEntry* entr
   return free_targets;
 }
 
-/** Check whether all or part of \a entry needs to be expired.
+/** Calculate when to look at an entry again.
+ * @param[in] last_connect Time of the last connection attempt (as NOW).
+ * @param[in] limit Age at which the entry should be looked at.
+ * @return Time at which the entry will be more than \a limit seconds
+ * stale.
+ */
+static time_t ip_registry_due(int last_connect, int limit)
+{
+  int delay = limit + 1 - CONNECTED_SINCE(last_connect);
+
+  if (delay < 1)
+    delay = 1;
+  else if (delay > limit + 1)
+    delay = limit + 1;
+  return CurrentTime + delay;
+}
+
+static void ip_registry_expire_entry(struct Expiry* ex);
+
+/** Schedule expiry of \a entry if nobody is connected from it.  An
+ * entry that is already scheduled is rescheduled, since it may have
+ * just got a target record that expires sooner.
+ * @param[in] entry Registry entry that may have become idle.
+ */
+static void ip_registry_schedule(struct IPRegistryEntry* entry)
+{
+  if (entry->connected)
+    return;
+  expiry_add(&entry->expire, ip_registry_expire_entry, entry,
+             ip_registry_due(entry->last_connect, entry->target ?
+                             IP_TARGET_EXPIRE : IP_REGISTRY_EXPIRE));
+}
+
+/** Expire all or part of an idle registry entry.
  * If the entry is at least 600 seconds stale, free the entire thing.
  * If it is at least 120 seconds stale, expire its free targets list.
- * @param[in] entry Registry entry to check for expiration.
+ * Entries that are in use again are left alone until they next
+ * become idle.
+ * @param[in] ex Expired entry of the registry entry.
  */
-static void ip_registry_expire_entry(struct IPRegistryEntry* entry)
+static void ip_registry_expire_entry(struct Expiry* ex)
 {
+  struct IPRegistryEntry* entry = (struct IPRegistryEntry*) ex_data(ex);
+
+  if (entry->connected)
+    return;
   /*
    * Don't touch this number, it has statistical significance
    * XXX - blah blah blah
    */
-  if (CONNECTED_SINCE(entry->last_connect) > 600) {
+  if (CONNECTED_SINCE(entry->last_connect) > IP_REGISTRY_EXPIRE) {
     /*
      * expired
      */
     Debug((DEBUG_DNS, "IPcheck expiring registry for %s (no clients connected).", ircd_ntoa(&entry->addr)));
     ip_registry_remove(entry);
     ip_registry_delete_entry(entry);
+    return;
   }
-  else if (CONNECTED_SINCE(entry->last_connect) > 120 && 0 != entry->target) {
+  else if (CONNECTED_SINCE(entry->last_connect) > IP_TARGET_EXPIRE && 0 != entry->target) {
     /*
      * Expire storage of targets
      */
-    MyFree(entry->target);
-    entry->target = 0;
+    ip_registry_free_target(entry);
   }
+  ip_registry_schedule(entry);
 }
 
 /** Calculate hash value for an IP address's /48 block.
@@ -265,6 +323,30 @@ static unsigned int ip_48_hash(const struct irc_in_addr *ip)
   return res & (IP_REGISTRY_TABLE_SIZE - 1);
 }
 
+/** Remove a /48 entry that has seen no connections for a while.
+ * @param[in] ex Expired entry of the /48 entry.
+ */
+static void ip_48_expire(struct Expiry* ex)
+{
+  struct IPRegistry48* entry = (struct IPRegistry48*) ex_data(ex);
+  struct IPRegistry48** prev_p;
+  unsigned int idx;
+
+  if (CONNECTED_SINCE(entry->last_connect) <= IP_REGISTRY_EXPIRE) {
+    expiry_add(&entry->expire, ip_48_expire, entry,
+               ip_registry_due(entry->last_connect, IP_REGISTRY_EXPIRE));
+    return;
+  }
+
+  idx = (entry->addr[0] ^ entry->addr[1] ^ entry->addr[2])
+    & (IP_REGISTRY_TABLE_SIZE - 1);
+  for (prev_p = &hashTable48[idx]; *prev_p != entry; prev_p = &(*prev_p)->next)
+    assert(0 != *prev_p);
+  *prev_p = entry->next;
+  entry->next = freeList48;
+  freeList48 = entry;
+}
+
 /** Find or create an IPv6 /48 entry for the IP address.
  * @param[in] ip IPv6 address to search for.
  * @return Matching registry entry (possibly newly created).
@@ -300,52 +382,14 @@ static struct IPRegistry48* ip_48_find(const struct irc_in_addr *ip)
   /* Link it into the hash table. */
   entry->next = hashTable48[idx];
   hashTable48[idx] = entry;
+  memset(&entry->expire, 0, sizeof(entry->expire));
+  expiry_add(&entry->expire, ip_48_expire, entry,
+             ip_registry_due(entry->last_connect, IP_REGISTRY_EXPIRE));
 
 done:
   return entry;
 }
 
-/** Periodic timer callback to check for expired registry entries.
- * @param[in] ev Timer event (ignored).
- */
-static void ip_registry_expire(struct Event* ev)
-{
-  int i;
-  struct IPRegistryEntry* entry;
-  struct IPRegistryEntry* entry_next;
-
-  assert(ET_EXPIRE == ev_type(ev));
-  assert(0 != ev_timer(ev));
-
-  for (i = 0; i < IP_REGISTRY_TABLE_SIZE; ++i) {
-    for (entry = hashTable[i]; entry; entry = entry_next) {
-      entry_next = entry->next;
-      if (0 == entry->connected)
-        ip_registry_expire_entry(entry);
-    }
-  }
-
-  for (i = 0; i < IP_REGISTRY_TABLE_SIZE; ++i) {
-    struct IPRegistry48** prev_p;
-    struct IPRegistry48* entry;
-
-    for (prev_p = &hashTable48[i]; (entry = *prev_p); ) {
-      if (CONNECTED_SINCE(entry->last_connect) > 600) {
-        *prev_p = entry->next;
-        entry->next = freeList48;
-        freeList48 = entry;
-      } else
-        prev_p = &entry->next;
-    }
-  }
-}
-
-/** Initialize the IPcheck subsystem. */
-void IPcheck_init(void)
-{
-  timer_add(timer_init(&expireTimer), ip_registry_expire, 0, TT_PERIODIC, 60);
-}
-
 /** Check whether a new connection from a local client should be allowed.
  * A connection is rejected if someone from the "same" address (see
  * ip_registry_find()) connects IPCHECK_CLONE_LIMIT times, each time
@@ -417,7 +461,7 @@ int ip_registry_check_local(const struct irc_in_addr *addr, time_t* next_target_
 
   if (entry->attempts < IPCHECK_CLONE_LIMIT) {
     if (next_target_out)
-      *next_target_out = CurrentTime - (TARGET_DELAY * free_targets - 1);
+      *next_target_out = target_next_time(free_targets);
   }
 #ifndef NOTHROTTLE
   else if ((CurrentTime - cli_since(&me)) > IPCHECK_CLONE_DELAY) {
@@ -429,6 +473,7 @@ reject:
     {
       assert(entry->connected > 0);
       --entry->connected;
+      ip_registry_schedule(entry);
     }
     Debug((DEBUG_DNS, "IPcheck refusing local connection from %s: too fast.", ircd_ntoa(addr)));
     return 0;
@@ -481,6 +526,7 @@ int ip_registry_check_remote(struct Client* cptr, int is_burst)
   }
   /* Avoid overflowing the connection counter. */
   if (0 == ++entry->connected) {
+    ip_registry_schedule(entry);
     Debug((DEBUG_DNS, "IPcheck refusing remote connection from %s: counter overflow.", ircd_ntoa(&entry->addr)));
     return 0;
   }
@@ -525,6 +571,7 @@ void ip_registry_connect_fail(const struct irc_in_addr *addr, int disconnect)
     if (disconnect) {
       assert(entry->connected > 0);
       entry->connected--;
+      ip_registry_schedule(entry);
     }
   }
 }
@@ -544,7 +591,7 @@ void ip_registry_connect_succeeded(struct Client *cptr)
 
   assert(entry);
   if (entry->target) {
-    memcpy(cli_targets(cptr), entry->target->targets, MAXTARGETS);
+    cli_targets(cptr) = target_copy(entry->target->targets);
     free_targets = entry->target->count;
     tr = " tr";
   }
@@ -591,10 +638,14 @@ void ip_registry_disconnect(struct Client *cptr)
     if (0 == entry->target) {
       entry->target = (struct IPTargetEntry*) MyMalloc(sizeof(struct IPTargetEntry));
       entry->target->count = STARTTARGETS;
+      entry->target->targets = 0;
     }
     assert(0 != entry->target);
 
-    memcpy(entry->target->targets, cli_targets(cptr), MAXTARGETS);
+    /* The connection is going away, so take over its target set. */
+    target_free(entry->target->targets);
+    entry->target->targets = cli_targets(cptr);
+    cli_targets(cptr) = 0;
     /*
      * This calculation can be pretty unfair towards large multi-user hosts, but
      * there is "nothing" we can do without also allowing spam bots to send more
@@ -608,14 +659,7 @@ void ip_registry_disconnect(struct Client *cptr)
      * ALL should get no free targets when reconnecting.  We'd need to store an entry
      * per client (instead of per IP number) to avoid this.
      */
-    if (cli_nexttarget(cptr) < CurrentTime) {
-        /*
-         * Number of free targets
-         */
-      free_targets = (CurrentTime - cli_nexttarget(cptr)) / TARGET_DELAY + 1;
-    }
-    else
-      free_targets = 0;
+    free_targets = target_free_count(cli_nexttarget(cptr));
     /*
      * Add bonus, this is pretty fuzzy, but it will help in some cases.
      */
@@ -630,6 +674,7 @@ void ip_registry_disconnect(struct Client *cptr)
     if (free_targets < entry->target->count)
       entry->target->count = free_targets;
   }
+  ip_registry_schedule(entry);
 }
 
 /** Find number of clients from a particular IP address.
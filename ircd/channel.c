@@ -275,6 +275,7 @@ int sub1_from_channel(struct Channel* chptr)
   }
 
   chptr->users = 0;
+  assert(0 == chptr->zombies);
 
   /*
    * Also channels without Apass set need to be kept alive,
@@ -336,6 +337,9 @@ int destruct_channel(struct Channel* chptr)
 
   assert(0 == chptr->members);
 
+  if (ex_active(&chptr->destruct_event))
+    remove_destruct_event(chptr);
+
   /*
    * Now, find all invite links from channel structure
    */
@@ -503,9 +507,11 @@ void add_user_to_channel(struct Channel* chptr, struct Client* who,
     member->prev_channel = 0;
     (cli_user(who))->channel = member;
 
-    if (chptr->destruct_event)
+    if (ex_active(&chptr->destruct_event))
       remove_destruct_event(chptr);
     ++chptr->users;
+    if (flags & CHFL_ZOMBIE)
+      ++chptr->zombies;
     ++((cli_user(who))->joined);
   }
 }
@@ -536,6 +542,8 @@ static int remove_member_from_channel(struct Membership* member)
    */
   if (IsDelayedJoin(member))
     CheckDelayedJoins(chptr);
+  if (IsZombie(member))
+    --chptr->zombies;
 
   /*
    * unlink client channel list
@@ -555,6 +563,30 @@ static int remove_member_from_channel(struct Membership* member)
   return sub1_from_channel(chptr);
 }
 
+#ifdef DEBUGMODE
+/** Verify the member and zombie counts of a channel.
+ * This walks the whole member list, so it is only done in debug
+ * builds.  Any mismatch will lead to an assertion failure.
+ * @param chptr	Channel to check.
+ */
+static void verify_zombies(struct Channel* chptr)
+{
+  struct Membership* member;
+  unsigned int       users = 0;
+  unsigned int       zombies = 0;
+
+  for (member = chptr->members; member; member = member->next_member) {
+    ++users;
+    if (IsZombie(member))
+      ++zombies;
+  }
+  assert(zombies == chptr->zombies);
+  assert(users == chptr->users);
+}
+#else
+#define verify_zombies(chptr) ((void)0)
+#endif /* DEBUGMODE */
+
 /** Check if all the remaining members on the channel are zombies
  *
  * @returns False if the channel has any non zombie members, True otherwise.
@@ -562,13 +594,8 @@ static int remove_member_from_channel(struct Membership* member)
  */
 static int channel_all_zombies(struct Channel* chptr)
 {
-  struct Membership* member;
-
-  for (member = chptr->members; member; member = member->next_member) {
-    if (!IsZombie(member))
-      return 0;
-  }
-  return 1;
+  verify_zombies(chptr);
+  return chptr->zombies == chptr->users;
 }
       
 
@@ -1439,7 +1466,10 @@ void make_zombie(struct Membership* member, struct Client* who,
   assert(0 != chptr);
 
   /* Default for case a): */
-  SetZombie(member);
+  if (!IsZombie(member)) {
+    SetZombie(member);
+    ++chptr->zombies;
+  }
 
   /* Case b) or c) ?: */
   if (MyUser(who))      /* server 4 */
@@ -1477,15 +1507,9 @@ void make_zombie(struct Membership* member, struct Client* who,
  */
 int number_of_zombies(struct Channel *chptr)
 {
-  struct Membership* member;
-  int                count = 0;
-
   assert(0 != chptr);
-  for (member = chptr->members; member; member = member->next_member) {
-    if (IsZombie(member))
-      ++count;
-  }
-  return count;
+  verify_zombies(chptr);
+  return chptr->zombies;
 }
 
 /** Concatenate some strings together.
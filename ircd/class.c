@@ -36,6 +36,7 @@
 #include "send.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
+#include <limits.h>
 
 /** List of all connection classes. */
 static struct ConnectionClass* connClassList;
@@ -262,7 +263,10 @@ report_classes(struct Client *sptr, const struct StatDesc *sd,
     send_reply(sptr, RPL_STATSYLINE, (cltmp->valid ? 'Y' : 'y'),
                ConClass(cltmp), PingFreq(cltmp), ConFreq(cltmp),
                MaxLinks(cltmp), MaxSendq(cltmp), Links(cltmp) - 1,
-               CCUmode(cltmp) ? CCUmode(cltmp) : "+");
+               CCUmode(cltmp) ? CCUmode(cltmp) : "+",
+               SendRate(cltmp), SendBurst(cltmp), cltmp->send_shaped,
+               MsgRate(cltmp), MsgBurst(cltmp), cltmp->msg_shaped,
+               SendqDrop(cltmp), cltmp->sendq_dropped);
 }
 
 /** Return maximum SendQ length for a client.
@@ -294,6 +298,107 @@ get_sendq(struct Client *cptr)
   return feature_uint(FEAT_DEFAULTMAXSENDQLENGTH);
 }
 
+/** Find the connection class of a local client.
+ * @param[in] cptr Local client to check.
+ * @return Class of the first attached configuration item that has
+ * one, or NULL if there is none.
+ */
+static struct ConnectionClass*
+client_conn_class(struct Client *cptr)
+{
+  struct SLink *tmp;
+
+  for (tmp = cli_confs(cptr); tmp; tmp = tmp->next)
+    if (tmp->value.aconf && tmp->value.aconf->conn_class)
+      return tmp->value.aconf->conn_class;
+  return NULL;
+}
+
+/** Add the tokens earned since a token bucket was last filled.
+ * @param[in,out] tb Token bucket to fill.
+ * @param[in] rate Tokens earned per second.
+ * @param[in] burst Most tokens the bucket holds.
+ * @return Number of tokens now in the bucket.
+ */
+static unsigned int
+tb_fill(struct TokenBucket *tb, unsigned int rate, unsigned int burst)
+{
+  uint64_t tokens = tb->tb_tokens;
+
+  if (tb->tb_last < CurrentTime)
+    tokens += (uint64_t) (CurrentTime - tb->tb_last) * rate;
+  tb->tb_last = CurrentTime;
+  /* Also clamps the bucket when the class's burst was lowered. */
+  tb->tb_tokens = (tokens > burst) ? burst : (unsigned int) tokens;
+  return tb->tb_tokens;
+}
+
+/** Return how many bytes may be sent to a client right now.
+ * @param[in] cptr Local client to check.
+ * @return Number of bytes allowed by the client's class send rate,
+ * or UINT_MAX if the class does not limit it.
+ */
+unsigned int
+class_send_tokens(struct Client *cptr)
+{
+  struct ConnectionClass *cl = client_conn_class(cptr);
+
+  if (!cl || !SendRate(cl))
+    return UINT_MAX;
+  if (!tb_fill(cli_sendtb(cptr), SendRate(cl), SendBurst(cl))) {
+    cl->send_shaped++;
+    return 0;
+  }
+  return cli_sendtb(cptr)->tb_tokens;
+}
+
+/** Account for bytes sent to a client.
+ * @param[in] cptr Local client that was sent data.
+ * @param[in] bytes Number of bytes sent.
+ */
+void
+class_send_charge(struct Client *cptr, unsigned int bytes)
+{
+  struct TokenBucket *tb = cli_sendtb(cptr);
+
+  tb->tb_tokens = (bytes < tb->tb_tokens) ? tb->tb_tokens - bytes : 0;
+}
+
+/** Take a token for processing one message from a client.
+ * @param[in] cptr Local client that sent a message.
+ * @return 1 if the message may be processed now, 0 if the client must
+ * wait for its class message rate, or -1 if its class has none.
+ */
+int
+class_msg_take(struct Client *cptr)
+{
+  struct ConnectionClass *cl = client_conn_class(cptr);
+
+  if (!cl || !MsgRate(cl))
+    return -1;
+  if (!tb_fill(cli_msgtb(cptr), MsgRate(cl), MsgBurst(cl))) {
+    cl->msg_shaped++;
+    return 0;
+  }
+  cli_msgtb(cptr)->tb_tokens--;
+  return 1;
+}
+
+/** Check whether channel chatter may be dropped for a client.
+ * @param[in] cptr Local client whose SendQ is full.
+ * @return The client's class if it is a user whose class has
+ * sendqdrop enabled, else NULL.
+ */
+struct ConnectionClass *
+class_sendq_drop(struct Client *cptr)
+{
+  struct ConnectionClass *cl;
+
+  if (!IsUser(cptr) || !(cl = client_conn_class(cptr)) || !SendqDrop(cl))
+    return 0;
+  return cl;
+}
+
 /** Report connection class memory statistics to a client.
  * Send number of classes and number of bytes allocated for them.
  * @param[in] cptr Client requesting statistics.
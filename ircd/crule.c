@@ -295,3 +295,118 @@ char *crule_text(struct CRuleNode *rule)
   crule_cat(rule, buf, sizeof(buf) - 1);
   return DupString(res, buf);
 }
+
+/** Names of the functions and operators a rule can use, with the
+ * number of arguments each takes.
+ */
+static const struct {
+  crule_funcptr funcptr; /**< Evaluation function. */
+  const char *name;      /**< Name in a flattened rule. */
+  int numargs;           /**< Number of arguments. */
+  int strings;           /**< Non-zero if the arguments are strings. */
+} crule_words[] = {
+  { crule_and, "and", 2, 0 },
+  { crule_or, "or", 2, 0 },
+  { crule_not, "not", 1, 0 },
+  { crule_connected, "connected", 1, 1 },
+  { crule_directcon, "directcon", 1, 1 },
+  { crule_via, "via", 2, 1 },
+  { crule_directop, "directop", 0, 1 },
+  { 0, 0, 0, 0 }
+};
+
+/** Append the words of a connection rule to a list.
+ * @param[in] rule Rule to flatten.
+ * @param[out] words Receives up to \a max words.
+ * @param[in] max Number of words that fit in \a words.
+ * @param[in] used Number of words already in \a words.
+ * @return Number of words in the list, counting any that did not fit.
+ */
+static int crule_flatten_at(struct CRuleNode *rule, const char **words,
+                            int max, int used)
+{
+  int ii, jj;
+
+  for (ii = 0; crule_words[ii].funcptr != rule->funcptr; ++ii)
+    assert(crule_words[ii].funcptr != 0);
+  if (used < max)
+    words[used] = crule_words[ii].name;
+  used++;
+  for (jj = 0; jj < rule->numargs; ++jj) {
+    if (!crule_words[ii].strings)
+      used = crule_flatten_at(rule->arg[jj], words, max, used);
+    else {
+      if (used < max)
+        words[used] = rule->arg[jj];
+      used++;
+    }
+  }
+  return used;
+}
+
+/** Flatten a connection rule into a list of words in prefix order:
+ * each node is its name followed by its arguments.
+ * @param[in] rule Rule to flatten.
+ * @param[out] words Receives up to \a max words.
+ * @param[in] max Number of words that fit in \a words.
+ * @return Number of words in the whole rule.
+ */
+int crule_flatten(struct CRuleNode *rule, const char **words, int max)
+{
+  return crule_flatten_at(rule, words, max, 0);
+}
+
+/** Rebuild a connection rule from the words crule_flatten() made.
+ * @param[in] words Words of the rule.
+ * @param[in] count Number of entries in \a words.
+ * @param[in,out] pos Index of the next word to use.
+ * @return Newly allocated rule, or NULL if the words are not a rule.
+ */
+static struct CRuleNode *crule_unflatten_at(const char * const *words,
+                                            int count, int *pos)
+{
+  struct CRuleNode *res;
+  int ii, jj;
+
+  if (*pos >= count)
+    return NULL;
+  for (ii = 0; crule_words[ii].name; ++ii)
+    if (!strcmp(crule_words[ii].name, words[*pos]))
+      break;
+  if (!crule_words[ii].name
+      || (crule_words[ii].strings
+          && count - *pos - 1 < crule_words[ii].numargs))
+    return NULL;
+  (*pos)++;
+  res = crule_make(crule_words[ii].funcptr, crule_words[ii].numargs,
+                   NULL, NULL);
+  for (jj = 0; jj < res->numargs; ++jj) {
+    if (crule_words[ii].strings) {
+      DupString(res->arg[jj], words[*pos]);
+      (*pos)++;
+    } else if (!(res->arg[jj] = crule_unflatten_at(words, count, pos))) {
+      res->numargs = jj;
+      crule_free(res);
+      return NULL;
+    }
+  }
+  return res;
+}
+
+/** Rebuild a connection rule from the words crule_flatten() made.
+ * @param[in] words Words of the rule.
+ * @param[in] count Number of entries in \a words.
+ * @return Newly allocated rule, or NULL if the words are not exactly
+ * one rule.
+ */
+struct CRuleNode *crule_unflatten(const char * const *words, int count)
+{
+  struct CRuleNode *res;
+  int pos = 0;
+
+  if ((res = crule_unflatten_at(words, count, &pos)) && pos != count) {
+    crule_free(res);
+    res = NULL;
+  }
+  return res;
+}
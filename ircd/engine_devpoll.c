@@ -27,6 +27,7 @@
 #include "ircd_alloc.h"
 #include "ircd_features.h"
 #include "ircd_log.h"
+#include "s_bsd.h"
 #include "s_debug.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
@@ -306,8 +307,8 @@ engine_loop(struct Generators* gen)
     dopoll.dp_nfds = polls_count;
 
     /* calculate the proper timeout */
-    dopoll.dp_timeout = timer_next(gen) ?
-      (timer_next(gen) - CurrentTime) * 1000 : -1;
+    dopoll.dp_timeout = input_delay(timer_next(gen) ?
+      (timer_next(gen) - CurrentTime) * 1000 : -1);
 
     Debug((DEBUG_ENGINE, "devpoll: delay: %Tu (%Tu) %d", timer_next(gen),
 	   CurrentTime, dopoll.dp_timeout));
@@ -447,6 +448,7 @@ engine_loop(struct Generators* gen)
     }
 
     timer_run(); /* execute any pending timers */
+    input_run(); /* parse waiting client messages */
   }
 }
 
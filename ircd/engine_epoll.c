@@ -26,6 +26,7 @@
 #include "ircd_alloc.h"
 #include "ircd_features.h"
 #include "ircd_log.h"
+#include "s_bsd.h"
 #include "s_debug.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
@@ -214,7 +215,8 @@ engine_loop(struct Generators *gen)
       events_count = tmp;
     }
 
-    wait = timer_next(gen) ? (timer_next(gen) - CurrentTime) * 1000 : -1;
+    wait = input_delay(timer_next(gen) ?
+                       (timer_next(gen) - CurrentTime) * 1000 : -1);
     Debug((DEBUG_ENGINE, "epoll: delay: %d (%d) %d", timer_next(gen),
            CurrentTime, wait));
     events_used = epoll_wait(epoll_fd, events, events_count, wait);
@@ -248,7 +250,11 @@ engine_loop(struct Generators *gen)
         if (getsockopt(s_fd(sock), SOL_SOCKET, SO_ERROR, &errcode,
                        &codesize) < 0)
           errcode = errno;
-        if (errcode) {
+        /* With no socket error, only the error queue has something,
+         * such as zero-copy completions; ET_ERROR with zero says so to
+         * sockets that asked for it.
+         */
+        if (errcode || s_errqueue(sock)) {
           event_generate(ET_ERROR, sock, errcode);
           gen_ref_dec(sock);
           continue;
@@ -279,6 +285,7 @@ engine_loop(struct Generators *gen)
       gen_ref_dec(sock);
     }
     timer_run();
+    input_run();
   }
   MyFree(events);
 }
@@ -27,6 +27,7 @@
 #include "ircd_alloc.h"
 #include "ircd_features.h"
 #include "ircd_log.h"
+#include "s_bsd.h"
 #include "s_debug.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
@@ -317,6 +318,7 @@ engine_loop(struct Generators* gen)
   struct kevent *evt;
   struct Socket* sock;
   struct timespec wait;
+  int delay;
   int i;
   int errcode;
   socklen_t codesize;
@@ -332,8 +334,10 @@ engine_loop(struct Generators* gen)
     }
 
     /* set up the sleep time */
-    wait.tv_sec = timer_next(gen) ? (timer_next(gen) - CurrentTime) : -1;
-    wait.tv_nsec = 0;
+    delay = input_delay(timer_next(gen) ?
+                        (timer_next(gen) - CurrentTime) * 1000 : -1);
+    wait.tv_sec = delay < 0 ? -1 : delay / 1000;
+    wait.tv_nsec = delay < 0 ? 0 : (delay % 1000) * 1000000;
 
     Debug((DEBUG_ENGINE, "kqueue: delay: %Tu (%Tu) %Tu", timer_next(gen),
 	   CurrentTime, wait.tv_sec));
@@ -442,6 +446,7 @@ engine_loop(struct Generators* gen)
     }
 
     timer_run(); /* execute any pending timers */
+    input_run(); /* parse waiting client messages */
   }
 }
 
@@ -26,6 +26,7 @@
 #include "ircd.h"
 #include "ircd_alloc.h"
 #include "ircd_log.h"
+#include "s_bsd.h"
 #include "s_debug.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
@@ -281,7 +282,8 @@ engine_loop(struct Generators* gen)
   struct Socket *sock;
 
   while (running) {
-    wait = timer_next(gen) ? (timer_next(gen) - CurrentTime) * 1000 : -1;
+    wait = input_delay(timer_next(gen) ?
+                       (timer_next(gen) - CurrentTime) * 1000 : -1);
 
     Debug((DEBUG_INFO, "poll: delay: %Tu (%Tu) %d", timer_next(gen),
 	   CurrentTime, wait));
@@ -333,6 +335,12 @@ engine_loop(struct Generators* gen)
 	  gen_ref_dec(sock); /* careful not to leak ref counts */
 	  nfds--;
 	  continue;
+	} else if ((pollfdList[i].revents & POLLERR) && s_errqueue(sock)) {
+	  /* only the error queue has something, e.g. zero-copy completions */
+	  event_generate(ET_ERROR, sock, 0);
+	  gen_ref_dec(sock);
+	  nfds--;
+	  continue;
 	}
       }
 
@@ -422,6 +430,7 @@ engine_loop(struct Generators* gen)
     }
 
     timer_run(); /* execute any pending timers */
+    input_run(); /* parse waiting client messages */
   }
 }
 
@@ -32,6 +32,7 @@
 
 #include "ircd.h"
 #include "ircd_log.h"
+#include "s_bsd.h"
 #include "s_debug.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
@@ -259,6 +260,7 @@ static void
 engine_loop(struct Generators* gen)
 {
   struct timeval wait;
+  int delay;
   fd_set read_set;
   fd_set write_set;
   int nfds;
@@ -272,8 +274,10 @@ engine_loop(struct Generators* gen)
     write_set = global_write_set;
 
     /* set up the sleep time */
-    wait.tv_sec = timer_next(gen) ? (timer_next(gen) - CurrentTime) : -1;
-    wait.tv_usec = 0;
+    delay = input_delay(timer_next(gen) ?
+                        (timer_next(gen) - CurrentTime) * 1000 : -1);
+    wait.tv_sec = delay < 0 ? -1 : delay / 1000;
+    wait.tv_usec = delay < 0 ? 0 : (delay % 1000) * 1000;
 
     Debug((DEBUG_INFO, "select: delay: %Tu (%Tu) %Tu", timer_next(gen),
 	   CurrentTime, wait.tv_sec));
@@ -406,6 +410,7 @@ engine_loop(struct Generators* gen)
     }
 
     timer_run(); /* execute any pending timers */
+    input_run(); /* parse waiting client messages */
   }
 }
 
@@ -0,0 +1,218 @@
+/*
+ * IRC - Internet Relay Chat, ircd/expiry.c
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Timing wheel for deferred expiry of long-lived objects.
+ *
+ * Empty channels, IP registry entries, G-lines and jupes all expire
+ * minutes to months after they are created, and most of them are
+ * cancelled or rescheduled long before that.  They are kept on a
+ * hierarchical timing wheel with one second resolution: level 0 has
+ * one slot for each of the next EXPIRY_SLOTS seconds, and each higher
+ * level has slots EXPIRY_SLOTS times as wide as the one below.  When
+ * the lower levels wrap around, the next slot of the level above is
+ * redistributed ("cascaded") into them.  Scheduling and cancelling
+ * take constant time, and each entry is moved at most once per level.
+ *
+ * Entries further away than the wheel covers (about 194 days) are
+ * parked in the top level and rescheduled when they reach it.  The
+ * wheel is driven by a single timer that only runs while entries are
+ * scheduled, and which sleeps until the next occupied level 0 slot or
+ * cascade.  If the clock jumps back, entries fire late by the jump.
+ */
+#include "config.h"
+
+#include "expiry.h"
+#include "ircd.h"
+#include "ircd_events.h"
+#include "ircd_log.h"
+
+/* #include <assert.h> -- Now using assert in ircd_log.h */
+
+/** Number of bits of time covered by each wheel level. */
+#define EXPIRY_BITS	6
+/** Number of slots in each wheel level. */
+#define EXPIRY_SLOTS	(1 << EXPIRY_BITS)
+/** Mask for a slot index. */
+#define EXPIRY_MASK	(EXPIRY_SLOTS - 1)
+/** Number of wheel levels. */
+#define EXPIRY_LEVELS	4
+/** Number of seconds covered by the whole wheel. */
+#define EXPIRY_RANGE	((time_t) 1 << (EXPIRY_BITS * EXPIRY_LEVELS))
+
+/** Slot index of time \a t at wheel level \a level. */
+#define EXPIRY_INDEX(t, level) \
+  ((unsigned int) ((t) >> (EXPIRY_BITS * (level))) & EXPIRY_MASK)
+
+/** The wheel: lists of entries for each slot of each level. */
+static struct Expiry* expiry_wheel[EXPIRY_LEVELS][EXPIRY_SLOTS];
+/** Last second that has been processed. */
+static time_t expiry_now;
+/** Number of scheduled entries. */
+static unsigned int expiry_entries;
+/** Non-zero while expiry_run() is processing the wheel. */
+static int expiry_running;
+/** Timer that drives the wheel. */
+static struct Timer expiry_timer;
+
+/** Link an entry into the wheel slot for its expiration time.
+ * @param[in] ex Entry to link.
+ * @param[in] first Earliest second whose level 0 slot may be used;
+ * entries that are already due go there.
+ */
+static void expiry_link(struct Expiry* ex, time_t first)
+{
+  struct Expiry** slot_p;
+  time_t when = ex->ex_when;
+  unsigned int level;
+
+  if (when < first)
+    when = first;
+  else if (when - expiry_now >= EXPIRY_RANGE)
+    when = expiry_now + EXPIRY_RANGE - 1;
+
+  for (level = 0; level < EXPIRY_LEVELS - 1; ++level)
+    if (when - expiry_now < (time_t) 1 << (EXPIRY_BITS * (level + 1)))
+      break;
+
+  slot_p = &expiry_wheel[level][EXPIRY_INDEX(when, level)];
+  ex->ex_next = *slot_p;
+  ex->ex_prev_p = slot_p;
+  if (*slot_p)
+    (*slot_p)->ex_prev_p = &ex->ex_next;
+  *slot_p = ex;
+}
+
+/** Unlink an entry from its wheel slot.
+ * @param[in] ex Entry to unlink.
+ */
+static void expiry_unlink(struct Expiry* ex)
+{
+  if (ex->ex_next)
+    ex->ex_next->ex_prev_p = ex->ex_prev_p;
+  *ex->ex_prev_p = ex->ex_next;
+  ex->ex_next = 0;
+  ex->ex_prev_p = 0;
+}
+
+/** Find the next second at which the wheel needs attention.
+ * @return Next second with an occupied level 0 slot or a cascade.
+ */
+static time_t expiry_next(void)
+{
+  time_t t = expiry_now;
+
+  do
+    ++t;
+  while (EXPIRY_INDEX(t, 0) && !expiry_wheel[0][EXPIRY_INDEX(t, 0)]);
+  return t;
+}
+
+/** Process the wheel up to the current time.
+ * @param[in] ev Timer event (ignored unless it is ET_EXPIRE).
+ */
+static void expiry_run(struct Event* ev)
+{
+  struct Expiry* ex;
+  unsigned int level;
+  unsigned int slot;
+
+  if (ev_type(ev) != ET_EXPIRE)
+    return;
+
+  expiry_running = 1;
+  while (expiry_now < CurrentTime) {
+    if (!expiry_entries) {
+      expiry_now = CurrentTime;
+      break;
+    }
+    ++expiry_now;
+
+    /* Move entries down as the lower levels wrap around. */
+    for (level = 1; level < EXPIRY_LEVELS; ++level) {
+      if (EXPIRY_INDEX(expiry_now, level - 1))
+        break;
+      slot = EXPIRY_INDEX(expiry_now, level);
+      while ((ex = expiry_wheel[level][slot])) {
+        expiry_unlink(ex);
+        expiry_link(ex, expiry_now);
+      }
+    }
+
+    /* Everything left in this level 0 slot is due now. */
+    slot = EXPIRY_INDEX(expiry_now, 0);
+    while ((ex = expiry_wheel[0][slot])) {
+      assert(ex->ex_when <= expiry_now);
+      expiry_unlink(ex);
+      --expiry_entries;
+      (*ex->ex_call)(ex);
+    }
+  }
+  expiry_running = 0;
+
+  if (expiry_entries)
+    timer_add(&expiry_timer, expiry_run, 0, TT_ABSOLUTE, expiry_next());
+}
+
+/** Schedule an entry, or reschedule it if it is already scheduled.
+ * @param[in,out] ex Entry to schedule.
+ * @param[in] call Function to call when it expires.
+ * @param[in] data Object the entry belongs to.
+ * @param[in] when Time (in CurrentTime units) at which it expires.
+ */
+void expiry_add(struct Expiry* ex, ExpiryCallBack call, void* data,
+                time_t when)
+{
+  time_t wake;
+
+  assert(0 != ex);
+  assert(0 != call);
+
+  if (ex_active(ex))
+    expiry_del(ex);
+  else if (!expiry_entries && !expiry_running)
+    expiry_now = CurrentTime;
+
+  ex->ex_when = when;
+  ex->ex_call = call;
+  ex->ex_data = data;
+  expiry_link(ex, expiry_now + 1);
+  ++expiry_entries;
+
+  /* expiry_run() sets the timer itself when it is done. */
+  if (expiry_running)
+    return;
+  wake = expiry_next();
+  if (!t_active(&expiry_timer))
+    timer_add(timer_init(&expiry_timer), expiry_run, 0, TT_ABSOLUTE, wake);
+  else if (wake < t_value(&expiry_timer))
+    timer_chg(&expiry_timer, TT_ABSOLUTE, wake);
+}
+
+/** Cancel a scheduled entry.  Nothing happens if it is not scheduled.
+ * @param[in,out] ex Entry to cancel.
+ */
+void expiry_del(struct Expiry* ex)
+{
+  assert(0 != ex);
+
+  if (!ex_active(ex))
+    return;
+  expiry_unlink(ex);
+  --expiry_entries;
+}
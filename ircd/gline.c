@@ -70,31 +70,52 @@ static struct Gline* BadChanGlineList = 0;
 
 /** Iterate through \a list of G-lines.  Use this like a for loop,
  * i.e., follow it with braces and use whatever you passed as \a gl
- * as a single G-line to be acted upon.
+ * as a single G-line to be acted upon.  Expired G-lines are removed
+ * by gline_expire(), so the lists never change while walking them.
  *
  * @param[in] list List of G-lines to iterate over.
  * @param[in] gl Name of a struct Gline pointer variable that will be made to point to the G-lines in sequence.
- * @param[in] next Name of a scratch struct Gline pointer variable.
  */
-/* There is some subtlety here with the boolean operators:
- * (x || 1) is used to continue in a logical-and series even when !x.
- * (x && 0) is used to continue in a logical-or series even when x.
+#define gliter(list, gl)				\
+  for ((gl) = (list); (gl); (gl) = (gl)->gl_next)
+
+static void gline_expire(struct Expiry *ex);
+
+/** Schedule the next expiry event for a G-line.  That is its
+ * expiration time while it is (locally or globally) active, and the
+ * end of its record lifetime after that.
+ * @param[in] gline G-line to schedule.
  */
-#define gliter(list, gl, next)				\
-  /* Iterate through the G-lines in the list */		\
-  for ((gl) = (list); (gl); (gl) = (next))		\
-    /* Figure out the next pointer in list... */	\
-    if ((((next) = (gl)->gl_next) || 1) &&		\
-	/* Then see if it's expired */			\
-	(gl)->gl_lifetime <= CurrentTime)		\
-      /* Record has expired, so free the G-line */	\
-      gline_free((gl));					\
-    /* See if we need to expire the G-line */		\
-    else if ((((gl)->gl_expire > CurrentTime) ||        \
-	      (((gl)->gl_flags &= ~GLINE_ACTIVE) && 0) ||	\
-	      ((gl)->gl_state = GLOCAL_GLOBAL)) && 0)	\
-      ; /* empty statement */				\
-    else
+static void
+gline_schedule(struct Gline *gline)
+{
+  time_t when = gline->gl_lifetime;
+
+  if (gline->gl_expire < when &&
+      ((gline->gl_flags & GLINE_ACTIVE) || gline->gl_state != GLOCAL_GLOBAL))
+    when = gline->gl_expire;
+  expiry_add(&gline->gl_expiry, gline_expire, gline, when);
+}
+
+/** Deactivate a G-line that reached its expiration time, or free one
+ * that reached the end of its lifetime.
+ * @param[in] ex Expired entry of the G-line.
+ */
+static void
+gline_expire(struct Expiry *ex)
+{
+  struct Gline *gline = (struct Gline *) ex_data(ex);
+
+  if (gline->gl_lifetime <= CurrentTime) {
+    gline_free(gline);
+    return;
+  }
+  if (gline->gl_expire <= CurrentTime) {
+    gline->gl_flags &= ~GLINE_ACTIVE;
+    gline->gl_state = GLOCAL_GLOBAL;
+  }
+  gline_schedule(gline);
+}
 
 /** Find canonical user and host for a string.
  * If \a userhost starts with '$', assign \a userhost to *user_p and NULL to *host_p.
@@ -146,6 +167,7 @@ make_gline(char *user, char *host, char *reason, time_t expire, time_t lastmod,
 
   gline = (struct Gline *)MyMalloc(sizeof(struct Gline)); /* alloc memory */
   assert(0 != gline);
+  memset(&gline->gl_expiry, 0, sizeof(gline->gl_expiry));
 
   DupString(gline->gl_reason, reason); /* initialize gline... */
   gline->gl_expire = expire;
@@ -180,6 +202,8 @@ make_gline(char *user, char *host, char *reason, time_t expire, time_t lastmod,
     GlobalGlineList = gline;
   }
 
+  gline_schedule(gline);
+
   return gline;
 }
 
@@ -591,6 +615,8 @@ gline_activate(struct Client *cptr, struct Client *sptr, struct Gline *gline,
     }
   }
 
+  gline_schedule(gline);
+
   if ((saveflags & GLINE_ACTMASK) == GLINE_ACTIVE)
     return 0; /* was active to begin with */
 
@@ -857,6 +883,8 @@ gline_modify(struct Client *cptr, struct Client *sptr, struct Gline *gline,
 			   pos ? ";" : "", pos ? " and" : "", reason);
   }
 
+  gline_schedule(gline);
+
   /* All right, inform ops... */
   non_auto = non_auto || ircd_strncmp(gline->gl_reason, "AUTO", 4);
   sendto_opmask(0, non_auto ? SNO_GLINE : SNO_AUTO,
@@ -938,11 +966,10 @@ struct Gline *
 gline_find(char *userhost, unsigned int flags)
 {
   struct Gline *gline = 0;
-  struct Gline *sgline;
   char *user, *host, *t_uh;
 
   if (flags & (GLINE_BADCHAN | GLINE_ANY)) {
-    gliter(BadChanGlineList, gline, sgline) {
+    gliter(BadChanGlineList, gline) {
         if ((flags & (GlineIsLocal(gline) ? GLINE_GLOBAL : GLINE_LOCAL)) ||
 	  (flags & GLINE_LASTMOD && !gline->gl_lastmod))
 	continue;
@@ -959,7 +986,7 @@ gline_find(char *userhost, unsigned int flags)
   DupString(t_uh, userhost);
   canon_userhost(t_uh, &user, &host, "*");
 
-  gliter(GlobalGlineList, gline, sgline) {
+  gliter(GlobalGlineList, gline) {
     if ((flags & (GlineIsLocal(gline) ? GLINE_GLOBAL : GLINE_LOCAL)) ||
 	(flags & GLINE_LASTMOD && !gline->gl_lastmod))
       continue;
@@ -991,9 +1018,8 @@ struct Gline *
 gline_lookup(struct Client *cptr, unsigned int flags)
 {
   struct Gline *gline;
-  struct Gline *sgline;
 
-  gliter(GlobalGlineList, gline, sgline) {
+  gliter(GlobalGlineList, gline) {
     if ((flags & GLINE_GLOBAL && gline->gl_flags & GLINE_LOCAL) ||
         (flags & GLINE_LASTMOD && !gline->gl_lastmod))
       continue;
@@ -1033,6 +1059,8 @@ gline_free(struct Gline *gline)
 {
   assert(0 != gline);
 
+  expiry_del(&gline->gl_expiry);
+
   *gline->gl_prev_p = gline->gl_next; /* squeeze this gline out */
   if (gline->gl_next)
     gline->gl_next->gl_prev_p = gline->gl_prev_p;
@@ -1051,9 +1079,8 @@ void
 gline_burst(struct Client *cptr)
 {
   struct Gline *gline;
-  struct Gline *sgline;
 
-  gliter(GlobalGlineList, gline, sgline) {
+  gliter(GlobalGlineList, gline) {
     if (!GlineIsLocal(gline) && gline->gl_lastmod)
       sendcmdto_one(&me, CMD_GLINE, cptr, "* %c%s%s%s %Tu %Tu %Tu :%s",
 		    GlineIsRemActive(gline) ? '+' : '-', gline->gl_user,
@@ -1063,7 +1090,7 @@ gline_burst(struct Client *cptr)
                     gline->gl_lifetime, gline->gl_reason);
   }
 
-  gliter(BadChanGlineList, gline, sgline) {
+  gliter(BadChanGlineList, gline) {
     if (!GlineIsLocal(gline) && gline->gl_lastmod)
       sendcmdto_one(&me, CMD_GLINE, cptr, "* %c%s %Tu %Tu %Tu :%s",
 		    GlineIsRemActive(gline) ? '+' : '-', gline->gl_user,
@@ -1104,7 +1131,6 @@ int
 gline_list(struct Client *sptr, char *userhost)
 {
   struct Gline *gline;
-  struct Gline *sgline;
 
   if (userhost) {
     if (!(gline = gline_find(userhost, GLINE_ANY))) /* no such gline */
@@ -1121,7 +1147,7 @@ gline_list(struct Client *sptr, char *userhost)
 	       (gline->gl_state == GLOCAL_DEACTIVATED ? "<" : ""),
 	       GlineIsRemActive(gline) ? '+' : '-', gline->gl_reason);
   } else {
-    gliter(GlobalGlineList, gline, sgline) {
+    gliter(GlobalGlineList, gline) {
       send_reply(sptr, RPL_GLIST, gline->gl_user,
 		 gline->gl_host ? "@" : "",
 		 gline->gl_host ? gline->gl_host : "",
@@ -1133,7 +1159,7 @@ gline_list(struct Client *sptr, char *userhost)
 		 GlineIsRemActive(gline) ? '+' : '-', gline->gl_reason);
     }
 
-    gliter(BadChanGlineList, gline, sgline) {
+    gliter(BadChanGlineList, gline) {
       send_reply(sptr, RPL_GLIST, gline->gl_user, "", "",
 		 gline->gl_expire, gline->gl_lastmod,
 		 gline->gl_lifetime,
@@ -1158,9 +1184,8 @@ gline_stats(struct Client *sptr, const struct StatDesc *sd,
             char *param)
 {
   struct Gline *gline;
-  struct Gline *sgline;
 
-  gliter(GlobalGlineList, gline, sgline) {
+  gliter(GlobalGlineList, gline) {
     if (param) {
       char gl_mask[USERLEN+HOSTLEN+2];
       strcpy(gl_mask, gline->gl_user);
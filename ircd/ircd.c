@@ -27,7 +27,6 @@
 #include "class.h"
 #include "client.h"
 #include "crule.h"
-#include "destruct_event.h"
 #include "hash.h"
 #include "ircd_alloc.h"
 #include "ircd_events.h"
@@ -116,7 +115,6 @@ static char   *dbg_client;                /**< Client specifier for chkconf */
 
 static struct Timer connect_timer; /**< timer structure for try_connections() */
 static struct Timer ping_timer; /**< timer structure for check_pings() */
-static struct Timer destruct_event_timer; /**< timer structure for exec_expired_destruct_events() */
 static struct Timer countdown_timer; /**< timer structure for exit_countdown() */
 
 /** Daemon information. */
@@ -960,10 +958,8 @@ int main(int argc, char **argv) {
 
   stats_init();
 
-  IPcheck_init();
   timer_add(timer_init(&connect_timer), try_connections, 0, TT_RELATIVE, 1);
   timer_add(timer_init(&ping_timer), check_pings, 0, TT_RELATIVE, 1);
-  timer_add(timer_init(&destruct_event_timer), exec_expired_destruct_events, 0, TT_PERIODIC, 60);
   timer_init(&countdown_timer);
 
   CurrentTime = time(NULL);
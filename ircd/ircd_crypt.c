@@ -44,21 +44,65 @@
 
 #include "config.h"
 #include "ircd_crypt.h"
+#include "ircd.h"
 #include "ircd_alloc.h"
+#include "ircd_events.h"
 #include "ircd_features.h"
 #include "ircd_log.h"
+#include "ircd_osdep.h"
 #include "ircd_string.h"
 #include "s_debug.h"
 
 /* while we're not modular, we need their init functions */
 #include "ircd_crypt_native.h"
 #include "ircd_crypt_plain.h"
+#include "ircd_crypt_pbkdf2.h"
+#include "ircd_crypt_sha512.h"
 #include "ircd_crypt_smd5.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
+#include <sys/types.h>
 #include <unistd.h>
 #include <string.h>
 
+/** Largest number of crypt worker processes. */
+#define CRYPT_WORKERS_MAX 16
+/** Largest key plus hash handed to a crypt worker. */
+#define CRYPT_REQUEST_MAX 1024
+
+/** A password check waiting for or running in a crypt worker. */
+struct CryptRequest {
+ struct CryptRequest* next;    /**< Next request in the queue. */
+ crypt_check_call call;        /**< Completion callback, NULL once cancelled. */
+ void* ctx;                    /**< Context for \a call. */
+ int running;                  /**< Non-zero once handed to a worker. */
+ unsigned int length;          /**< Bytes used in \a data. */
+ char data[CRYPT_REQUEST_MAX]; /**< Key and hash, each NUL-terminated. */
+};
+
+/** A helper process that checks passwords for slow mechanisms. */
+struct CryptWorker {
+ struct Socket sock;           /**< Our end of the worker's socket. */
+ struct CryptRequest* req;     /**< Request being checked, or NULL. */
+ int state;                    /**< One of the CW_* states. */
+};
+
+/** Worker slot is unused. */
+#define CW_IDLE  0
+/** Worker process is running. */
+#define CW_READY 1
+/** Worker died; its socket is released after the current callback. */
+#define CW_DEAD  2
+
+/** Worker process slots. */
+static struct CryptWorker crypt_workers[CRYPT_WORKERS_MAX];
+/** Requests waiting for a worker. */
+static struct CryptRequest* crypt_queue;
+/** End of #crypt_queue. */
+static struct CryptRequest** crypt_queue_tail = &crypt_queue;
+/** Timer to restart dead workers. */
+static struct Timer crypt_timer;
+
 /* evil global */
 crypt_mechs_t* crypt_mechs_root;
 
@@ -125,7 +169,7 @@ return 0;
  *
  * This is a wrapper function which attempts to establish the password
  * format and funnel it off to the correct mechanism handler function.  The
- * returned password is compared in the oper_password_match() routine.
+ * returned password is compared in the crypt_match() routine.
 */
 char* ircd_crypt(const char* key, const char* salt)
 {
@@ -213,6 +257,361 @@ crypt_mechs_t* crypt_mech;
  return NULL;
 }
 
+/** Check a password synchronously.
+ * @param key Password to check.
+ * @param hash Hashed password to compare against.
+ * @return Non-zero if \a key matches \a hash.
+ */
+static int crypt_match(const char* key, const char* hash)
+{
+ char* crypted;
+ int res;
+
+ if (!(crypted = ircd_crypt(key, hash)))
+  return 0;
+ res = strcmp(crypted, hash);
+ MyFree(crypted);
+ return 0 == res;
+}
+
+/** Check whether a hashed password uses a slow mechanism.
+ * @param hash Hashed password.
+ * @return Non-zero if checking \a hash should not block the event loop.
+ */
+static int crypt_is_slow(const char* hash)
+{
+ crypt_mechs_t* crypt_mech;
+
+ for (crypt_mech = crypt_mechs_root->next; crypt_mech;
+      crypt_mech = crypt_mech->next)
+  if (0 == ircd_strncmp(crypt_mech->mech->crypt_token, hash,
+                        crypt_mech->mech->crypt_token_size))
+   return crypt_mech->mech->crypt_flags & CRYPT_SLOW;
+
+ /* untagged passwords go to the native crypt(), which may be slow */
+ return 1;
+}
+
+/** Main loop of a crypt worker process.  The worker reads a key and a
+ * hash, each terminated by a NUL, and answers '1' if they match or '0'
+ * if they do not.  It exits when the server closes the socket.
+ * @param fd Worker's end of the socket.
+ */
+static void crypt_worker_main(int fd)
+{
+ char buf[CRYPT_REQUEST_MAX];
+ unsigned int length = 0;
+ char* hash;
+ ssize_t res;
+ int i;
+
+ /* keep nothing of the server's open but our socket */
+ for (i = 3; i < maxconnections; ++i)
+  if (i != fd)
+   close(i);
+
+ for (;;)
+ {
+  if ((res = read(fd, buf + length, sizeof(buf) - length)) <= 0)
+   _exit(0);
+  length += res;
+  hash = memchr(buf, '\0', length);
+  if (!hash || !memchr(hash + 1, '\0', length - (hash + 1 - buf)))
+  {
+   if (length == sizeof(buf))
+    _exit(1);
+   continue;
+  }
+  hash++;
+  if (write(fd, crypt_match(buf, hash) ? "1" : "0", 1) != 1)
+   _exit(1);
+  length = 0;
+ }
+}
+
+static void crypt_worker_callback(struct Event* ev);
+static void crypt_worker_dead(struct CryptWorker* worker);
+
+/** Start a crypt worker process.
+ * @param worker Slot to start the worker in.
+ * @return Non-zero on success.
+ */
+static int crypt_worker_start(struct CryptWorker* worker)
+{
+ int fd[2];
+ pid_t pid;
+
+ if (os_socketpair(fd))
+  return 0;
+ if (!os_set_nonblocking(fd[0])
+     || !socket_add(&worker->sock, crypt_worker_callback, worker,
+                    SS_CONNECTED, SOCK_EVENT_READABLE, fd[0]))
+ {
+  close(fd[0]);
+  close(fd[1]);
+  return 0;
+ }
+ if ((pid = fork()) < 0)
+ {
+  close(fd[0]);
+  socket_del(&worker->sock);
+  close(fd[1]);
+  return 0;
+ }
+ if (pid == 0)
+  crypt_worker_main(fd[1]);
+ close(fd[1]);
+ worker->state = CW_READY;
+ worker->req = NULL;
+ return 1;
+}
+
+static void crypt_timer_callback(struct Event* ev);
+
+/** Hand queued requests to idle workers, starting workers as needed.
+ * If no worker can be started, the crypt timer checks what is left
+ * (see crypt_check_queued()), so that a request never completes
+ * before ircd_crypt_check() has returned its handle.
+ */
+static void crypt_dispatch(void)
+{
+ struct CryptRequest* req;
+ struct CryptWorker* worker;
+ unsigned int limit, i;
+ unsigned int count;
+
+ limit = feature_uint(FEAT_CRYPT_WORKERS);
+ if (limit > CRYPT_WORKERS_MAX)
+  limit = CRYPT_WORKERS_MAX;
+
+ while ((req = crypt_queue))
+ {
+  for (i = 0, worker = NULL; i < limit && !worker; i++)
+   if (crypt_workers[i].state == CW_READY && !crypt_workers[i].req)
+    worker = &crypt_workers[i];
+  for (i = 0; i < limit && !worker; i++)
+   if (crypt_workers[i].state == CW_IDLE
+       && crypt_worker_start(&crypt_workers[i]))
+    worker = &crypt_workers[i];
+  if (!worker)
+  {
+   /* all workers are busy, or none can run at all */
+   for (i = 0; i < limit; i++)
+    if (crypt_workers[i].state != CW_IDLE)
+     return;
+   break;
+  }
+
+  if (!(crypt_queue = req->next))
+   crypt_queue_tail = &crypt_queue;
+  if (IO_SUCCESS != os_send_nonb(s_fd(&worker->sock), req->data,
+                                 req->length, &count)
+      || count != req->length)
+  {
+   /* the worker is wedged; put the request back and restart it */
+   if (!(req->next = crypt_queue))
+    crypt_queue_tail = &req->next;
+   crypt_queue = req;
+   crypt_worker_dead(worker);
+   continue;
+  }
+  req->running = 1;
+  worker->req = req;
+ }
+
+ /* no worker can be started; check what is left from the timer */
+ if (crypt_queue && !t_active(&crypt_timer))
+  timer_add(timer_init(&crypt_timer), crypt_timer_callback, 0,
+            TT_RELATIVE, 0);
+}
+
+/** Check queued requests on the event loop if no worker is running.
+ */
+static void crypt_check_queued(void)
+{
+ struct CryptRequest* req;
+ unsigned int limit, i;
+
+ limit = feature_uint(FEAT_CRYPT_WORKERS);
+ if (limit > CRYPT_WORKERS_MAX)
+  limit = CRYPT_WORKERS_MAX;
+ for (i = 0; i < limit; i++)
+  if (crypt_workers[i].state != CW_IDLE)
+   return;
+ while ((req = crypt_queue))
+ {
+  if (!(crypt_queue = req->next))
+   crypt_queue_tail = &crypt_queue;
+  if (req->call)
+   req->call(req->ctx, crypt_match(req->data,
+                                   req->data + strlen(req->data) + 1));
+  MyFree(req);
+ }
+}
+
+/** Restart dead workers and hand them any queued requests.  Requests
+ * that still cannot be handed to a worker are checked directly.
+ * @param ev Timer event.
+ */
+static void crypt_timer_callback(struct Event* ev)
+{
+ unsigned int i;
+
+ if (ev_type(ev) != ET_EXPIRE)
+  return;
+ for (i = 0; i < CRYPT_WORKERS_MAX; i++)
+  if (crypt_workers[i].state == CW_DEAD)
+   crypt_workers[i].state = CW_IDLE;
+ crypt_dispatch();
+ crypt_check_queued();
+}
+
+/** Close a crypt worker that died or misbehaved.  Its request fails,
+ * and the slot is restarted from a timer once the socket is released.
+ * @param worker Worker to close.
+ */
+static void crypt_worker_dead(struct CryptWorker* worker)
+{
+ struct CryptRequest* req;
+
+ close(s_fd(&worker->sock));
+ socket_del(&worker->sock);
+ worker->state = CW_DEAD;
+ if ((req = worker->req))
+ {
+  worker->req = NULL;
+  if (req->call)
+   req->call(req->ctx, 0);
+  MyFree(req);
+ }
+ if (!t_active(&crypt_timer))
+  timer_add(timer_init(&crypt_timer), crypt_timer_callback, 0,
+            TT_RELATIVE, 1);
+}
+
+/** Handle the answer or the death of a crypt worker.
+ * @param ev Socket event.
+ */
+static void crypt_worker_callback(struct Event* ev)
+{
+ struct CryptWorker* worker;
+ struct CryptRequest* req;
+ unsigned int count;
+ char reply;
+
+ worker = (struct CryptWorker*) s_data(ev_socket(ev));
+ assert(0 != worker);
+
+ switch (ev_type(ev))
+ {
+ case ET_READ:
+ case ET_EOF:
+  /* a worker that exited may still have left its answer */
+  switch (os_recv_nonb(s_fd(&worker->sock), &reply, 1, &count))
+  {
+  case IO_SUCCESS:
+   if ((req = worker->req))
+   {
+    worker->req = NULL;
+    if (req->call)
+     req->call(req->ctx, reply == '1');
+    MyFree(req);
+   }
+   if (ev_type(ev) == ET_READ)
+   {
+    crypt_dispatch();
+    return;
+   }
+   break;
+  case IO_BLOCKED:
+   if (ev_type(ev) == ET_READ)
+    return;
+   break;
+  default:
+   break;
+  }
+  crypt_worker_dead(worker);
+  crypt_dispatch();
+  break;
+ case ET_ERROR:
+  crypt_worker_dead(worker);
+  crypt_dispatch();
+  break;
+ default:
+  break;
+ }
+}
+
+/** Check a password against a hash without blocking the event loop.
+ * Mechanisms flagged CRYPT_SLOW are handed to a pool of worker
+ * processes (at most CRYPT_WORKERS of them), and \a call runs from the
+ * event loop when a worker answers, or from a timer if no worker can
+ * be started.  Fast mechanisms, and every mechanism when
+ * CRYPT_WORKERS is 0, are checked at once and \a call runs before this
+ * function returns.
+ * @param key Password to check.
+ * @param hash Hashed password to compare against.
+ * @param call Function to call with the result.
+ * @param ctx Context pointer for \a call.
+ * @return Handle for ircd_crypt_cancel(), or NULL if \a call already ran.
+ */
+struct CryptRequest* ircd_crypt_check(const char* key, const char* hash,
+                                      crypt_check_call call, void* ctx)
+{
+ struct CryptRequest* req;
+ size_t klen, hlen;
+
+ assert(NULL != key);
+ assert(NULL != hash);
+ assert(NULL != call);
+
+ klen = strlen(key) + 1;
+ hlen = strlen(hash) + 1;
+ if (!feature_uint(FEAT_CRYPT_WORKERS) || !crypt_is_slow(hash)
+     || klen + hlen > CRYPT_REQUEST_MAX)
+ {
+  call(ctx, crypt_match(key, hash));
+  return NULL;
+ }
+
+ req = (struct CryptRequest*) MyMalloc(sizeof(struct CryptRequest));
+ req->next = NULL;
+ req->call = call;
+ req->ctx = ctx;
+ req->running = 0;
+ req->length = klen + hlen;
+ memcpy(req->data, key, klen);
+ memcpy(req->data + klen, hash, hlen);
+ *crypt_queue_tail = req;
+ crypt_queue_tail = &req->next;
+ crypt_dispatch();
+ return req;
+}
+
+/** Cancel a pending password check.  The callback is called with a
+ * match value of -1 so that it can release its context.
+ * @param req Request returned by ircd_crypt_check().
+ */
+void ircd_crypt_cancel(struct CryptRequest* req)
+{
+ struct CryptRequest** pp;
+ crypt_check_call call = req->call;
+ void* ctx = req->ctx;
+
+ assert(NULL != call);
+ req->call = NULL;
+ if (!req->running)
+ {
+  /* still queued; otherwise the worker's answer releases it */
+  for (pp = &crypt_queue; *pp != req; pp = &(*pp)->next)
+   assert(NULL != *pp);
+  if (!(*pp = req->next))
+   crypt_queue_tail = pp;
+  MyFree(req);
+ }
+ call(ctx, -1);
+}
+
 /** Some basic init.
  * This function loads initalises the crypt mechanisms linked list and 
  * currently loads the default mechanisms (Salted MD5, Crypt() and PLAIN).  
@@ -237,6 +636,8 @@ void ircd_crypt_init(void)
 
 /* temporary kludge until we're modular.  manually call the
    register functions for crypt mechanisms */
+ ircd_register_crypt_pbkdf2();
+ ircd_register_crypt_sha512();
  ircd_register_crypt_smd5();
  ircd_register_crypt_plain();
  ircd_register_crypt_native();
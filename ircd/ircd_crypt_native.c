@@ -77,6 +77,7 @@ crypt_mech_t* crypt_mech;
  crypt_mech->crypt_function = &ircd_crypt_native;
  crypt_mech->crypt_token = "$CRYPT$";
  crypt_mech->crypt_token_size = 7;
+ crypt_mech->crypt_flags = CRYPT_SLOW; /* crypt() may be any scheme */
 
  ircd_crypt_register_mech(crypt_mech);
  
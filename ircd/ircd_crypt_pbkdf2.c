@@ -0,0 +1,255 @@
+/*
+ * IRC - Internet Relay Chat, ircd/ircd_crypt_pbkdf2.c
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/**
+ * @file
+ * @brief Routines for PBKDF2-HMAC-SHA512 passwords
+ *
+ * Passwords are stored in the format used by Python's passlib:
+ * "$pbkdf2-sha512$<rounds>$<salt>$<hash>", where the salt and the
+ * 64-byte derived key are encoded in base64 with '.' in place of '+'
+ * and without padding.  A salt given without a rounds count (as
+ * umkpasswd does) uses PBKDF2_ROUNDS_DEFAULT rounds.
+ */
+#include "config.h"
+#include "ircd_crypt.h"
+#include "ircd_crypt_pbkdf2.h"
+#include "ircd_log.h"
+#include "ircd_sha512.h"
+#include "s_debug.h"
+#include "ircd_alloc.h"
+
+/* #include <assert.h> -- Now using assert in ircd_log.h */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of rounds used when the salt does not say. */
+#define PBKDF2_ROUNDS_DEFAULT 25000
+/** Largest number of rounds accepted. */
+#define PBKDF2_ROUNDS_MAX 100000000
+/** Longest decoded salt accepted, in bytes. */
+#define PBKDF2_SALT_MAX 64
+
+static const char ab64[] =
+"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789./";
+
+/** Precomputed HMAC-SHA512 state for one key. */
+struct HMACKey {
+ struct SHA512Context inner; /**< State after hashing key ^ ipad. */
+ struct SHA512Context outer; /**< State after hashing key ^ opad. */
+};
+
+/** Prepare the HMAC pads for \a key.
+ * @param hk HMAC state to initialize.
+ * @param key Key to use.
+ * @param len Length of \a key.
+ */
+static void hmac_init(struct HMACKey* hk, const char* key, unsigned int len)
+{
+unsigned char pad[SHA512_BLOCK_LENGTH];
+unsigned char digest[SHA512_DIGEST_LENGTH];
+unsigned int i;
+
+ if (len > SHA512_BLOCK_LENGTH)
+ {
+  SHA512Init(&hk->inner);
+  SHA512Update(&hk->inner, key, len);
+  SHA512Final(digest, &hk->inner);
+  key = (const char*)digest;
+  len = SHA512_DIGEST_LENGTH;
+ }
+
+ memset(pad, 0x36, sizeof(pad));
+ for (i = 0; i < len; i++)
+  pad[i] ^= key[i];
+ SHA512Init(&hk->inner);
+ SHA512Update(&hk->inner, pad, sizeof(pad));
+
+ memset(pad, 0x5c, sizeof(pad));
+ for (i = 0; i < len; i++)
+  pad[i] ^= key[i];
+ SHA512Init(&hk->outer);
+ SHA512Update(&hk->outer, pad, sizeof(pad));
+
+ memset(pad, 0, sizeof(pad));
+ memset(digest, 0, sizeof(digest));
+}
+
+/** Compute HMAC-SHA512 of a message using precomputed pads.
+ * @param hk HMAC state from hmac_init().
+ * @param data Message to authenticate.
+ * @param len Length of \a data.
+ * @param out Receives the MAC; may overlap \a data.
+ */
+static void hmac(const struct HMACKey* hk, const void* data, unsigned int len,
+                 unsigned char out[SHA512_DIGEST_LENGTH])
+{
+struct SHA512Context ctx;
+
+ ctx = hk->inner;
+ SHA512Update(&ctx, data, len);
+ SHA512Final(out, &ctx);
+ ctx = hk->outer;
+ SHA512Update(&ctx, out, SHA512_DIGEST_LENGTH);
+ SHA512Final(out, &ctx);
+}
+
+/** Decode an ab64 string.
+ * @param in Encoded text, terminated by '\\0' or '$'.
+ * @param out Receives the decoded bytes.
+ * @param max Size of \a out.
+ * @return Number of bytes decoded, or -1 if \a in is invalid.
+ */
+static int ab64_decode(const char* in, unsigned char* out, unsigned int max)
+{
+const char* c;
+unsigned long w = 0;
+unsigned int n = 0, bits = 0;
+
+ for (; *in && *in != '$'; in++)
+ {
+  if (!(c = strchr(ab64, *in)))
+   return -1;
+  w = (w << 6) | (c - ab64);
+  if ((bits += 6) >= 8)
+  {
+   if (n >= max)
+    return -1;
+   bits -= 8;
+   out[n++] = (w >> bits) & 0xff;
+  }
+ }
+ /* a single trailing character cannot encode a whole byte */
+ return bits >= 6 ? -1 : (int)n;
+}
+
+/** Encode bytes as ab64.
+ * @param out Receives the encoded text and a terminating '\\0'.
+ * @param in Bytes to encode.
+ * @param len Number of bytes at \a in.
+ * @return Pointer to the terminating '\\0' of \a out.
+ */
+static char* ab64_encode(char* out, const unsigned char* in, unsigned int len)
+{
+unsigned long w = 0;
+unsigned int i, bits = 0;
+
+ for (i = 0; i < len; i++)
+ {
+  w = (w << 8) | in[i];
+  for (bits += 8; bits >= 6; bits -= 6)
+   *out++ = ab64[(w >> (bits - 6)) & 0x3f];
+ }
+ if (bits)
+  *out++ = ab64[(w << (6 - bits)) & 0x3f];
+ *out = '\0';
+ return out;
+}
+
+/** Produces a PBKDF2-HMAC-SHA512 hash of a password
+ * @param key The password we're hashing
+ * @param salt Either "<rounds>$<salt>" optionally followed by '$' and
+ * an old hash, or a bare salt to hash with the default rounds
+ * @return "<rounds>$<salt>$<hash>", without the "$pbkdf2-sha512$" tag,
+ * or NULL if \a salt is malformed.
+ */
+const char* ircd_crypt_pbkdf2(const char* key, const char* salt)
+{
+static char passwd[256];
+struct HMACKey hk;
+unsigned char s[PBKDF2_SALT_MAX + 4];
+unsigned char u[SHA512_DIGEST_LENGTH], t[SHA512_DIGEST_LENGTH];
+unsigned long rounds = PBKDF2_ROUNDS_DEFAULT, r;
+const char *sp;
+char *end, *p;
+int sl;
+unsigned int i;
+
+ assert(NULL != key);
+ assert(NULL != salt);
+
+ Debug((DEBUG_DEBUG, "ircd_crypt_pbkdf2: salt = %s", salt));
+
+ if (strchr(salt, '$'))
+ {
+  rounds = strtoul(salt, &end, 10);
+  if (*end != '$' || end == salt || rounds < 1 || rounds > PBKDF2_ROUNDS_MAX)
+   return NULL;
+  sp = end + 1;
+ }
+ else
+  sp = salt;
+
+ if ((sl = ab64_decode(sp, s, PBKDF2_SALT_MAX)) < 1)
+  return NULL;
+
+ /* The derived key is exactly one block: T = U1 ^ U2 ^ ... ^ Urounds,
+  * where U1 = HMAC(key, salt || INT(1)) and Un = HMAC(key, Un-1). */
+ s[sl] = s[sl + 1] = s[sl + 2] = 0;
+ s[sl + 3] = 1;
+ hmac_init(&hk, key, strlen(key));
+ hmac(&hk, s, sl + 4, u);
+ memcpy(t, u, sizeof(t));
+ for (r = 1; r < rounds; r++)
+ {
+  hmac(&hk, u, sizeof(u), u);
+  for (i = 0; i < sizeof(t); i++)
+   t[i] ^= u[i];
+ }
+
+ /* Now make the output string. */
+ p = passwd + sprintf(passwd, "%lu$", rounds);
+ p = ab64_encode(p, s, sl);
+ *p++ = '$';
+ ab64_encode(p, t, sizeof(t));
+
+ /* Don't leave anything around in vm they could use. */
+ memset(&hk, 0, sizeof(hk));
+ memset(u, 0, sizeof(u));
+ memset(t, 0, sizeof(t));
+
+return passwd;
+}
+
+/** Register ourself with the list of crypt mechanisms
+ * Registers the PBKDF2-SHA512 mechanism in the list of available crypt
+ * mechanisms.
+ */
+void ircd_register_crypt_pbkdf2(void)
+{
+crypt_mech_t* crypt_mech;
+
+ if ((crypt_mech = (crypt_mech_t*)MyMalloc(sizeof(crypt_mech_t))) == NULL)
+ {
+  Debug((DEBUG_MALLOC, "Could not allocate space for crypt_pbkdf2"));
+  return;
+ }
+
+ crypt_mech->mechname = "pbkdf2";
+ crypt_mech->shortname = "crypt_pbkdf2";
+ crypt_mech->description = "PBKDF2-HMAC-SHA512 password hash mechanism.";
+ crypt_mech->crypt_function = &ircd_crypt_pbkdf2;
+ crypt_mech->crypt_token = "$pbkdf2-sha512$";
+ crypt_mech->crypt_token_size = 15;
+ crypt_mech->crypt_flags = CRYPT_SLOW;
+
+ ircd_crypt_register_mech(crypt_mech);
+
+return;
+}
@@ -77,6 +77,7 @@ crypt_mech_t* crypt_mech;
  crypt_mech->crypt_function = &ircd_crypt_plain;
  crypt_mech->crypt_token = "$PLAIN$";
  crypt_mech->crypt_token_size = 7;
+ crypt_mech->crypt_flags = 0;
 
  ircd_crypt_register_mech(crypt_mech);
  
@@ -0,0 +1,215 @@
+/*
+ * IRC - Internet Relay Chat, ircd/ircd_crypt_sha512.c
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/**
+ * @file
+ * @brief Routines for SHA-512 crypt passwords
+ *
+ * This implements the "$6$" scheme from Ulrich Drepper's "Unix crypt
+ * using SHA-256 and SHA-512" specification, so hashes are compatible
+ * with glibc's crypt(), "openssl passwd -6" and mkpasswd, but do not
+ * depend on the system crypt() supporting them.  The number of rounds
+ * is 5000 unless the salt starts with "rounds=N$".
+ */
+#include "config.h"
+#include "ircd_crypt.h"
+#include "ircd_crypt_sha512.h"
+#include "ircd_log.h"
+#include "ircd_sha512.h"
+#include "s_debug.h"
+#include "ircd_alloc.h"
+
+/* #include <assert.h> -- Now using assert in ircd_log.h */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Prefix of the salt that selects a non-default number of rounds. */
+#define ROUNDS_PREFIX "rounds="
+/** Number of rounds used when the salt does not say. */
+#define ROUNDS_DEFAULT 5000
+/** Smallest number of rounds accepted. */
+#define ROUNDS_MIN 1000
+/** Largest number of rounds accepted. */
+#define ROUNDS_MAX 999999999
+/** Longest salt used; longer salts are truncated. */
+#define SALT_LEN_MAX 16
+
+static const char itoa64[] = /* 0 ... 63 => ascii - 64 */
+"./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+/** Order in which the digest bytes are encoded, three at a time. */
+static const unsigned char encode_order[] = {
+ 0, 21, 42,  22, 43,  1,  44,  2, 23,   3, 24, 45,  25, 46,  4,
+ 47,  5, 26,   6, 27, 48,  28, 49,  7,  50,  8, 29,   9, 30, 51,
+ 31, 52, 10,  53, 11, 32,  12, 33, 54,  34, 55, 13,  56, 14, 35,
+ 15, 36, 57,  37, 58, 16,  59, 17, 38,  18, 39, 60,  40, 61, 19,
+ 62, 20, 41
+};
+
+/** Add \a len bytes of \a digest, repeated as needed, to a context.
+ * @param ctx Context to update.
+ * @param digest Digest to repeat.
+ * @param len Number of bytes to add.
+ */
+static void sha512_repeat(struct SHA512Context* ctx,
+                          const unsigned char* digest, unsigned int len)
+{
+ for (; len > SHA512_DIGEST_LENGTH; len -= SHA512_DIGEST_LENGTH)
+  SHA512Update(ctx, digest, SHA512_DIGEST_LENGTH);
+ SHA512Update(ctx, digest, len);
+}
+
+/** Produces a SHA-512 crypt of a password using the supplied salt
+ * @param key The password we're encrypting
+ * @param salt The salt, optionally preceded by "rounds=N$" and
+ * followed by '$' and an old hash
+ * @return The salt and hash, without the "$6$" tag, or NULL if the
+ * rounds specification is malformed.
+ */
+const char* ircd_crypt_sha512(const char* key, const char* salt)
+{
+static char passwd[128];
+struct SHA512Context ctx, alt;
+unsigned char final[SHA512_DIGEST_LENGTH];
+unsigned char dp[SHA512_DIGEST_LENGTH], ds[SHA512_DIGEST_LENGTH];
+unsigned long rounds = ROUNDS_DEFAULT, w, r;
+unsigned int kl, sl, i;
+int custom = 0;
+char *p, *end;
+
+ assert(NULL != key);
+ assert(NULL != salt);
+
+ Debug((DEBUG_DEBUG, "ircd_crypt_sha512: salt = %s", salt));
+
+ if (!strncmp(salt, ROUNDS_PREFIX, sizeof(ROUNDS_PREFIX) - 1))
+ {
+  r = strtoul(salt + sizeof(ROUNDS_PREFIX) - 1, &end, 10);
+  if (*end != '$' || end == salt + sizeof(ROUNDS_PREFIX) - 1)
+   return NULL;
+  rounds = r < ROUNDS_MIN ? ROUNDS_MIN : (r > ROUNDS_MAX ? ROUNDS_MAX : r);
+  custom = 1;
+  salt = end + 1;
+ }
+
+ for (sl = 0; sl < SALT_LEN_MAX && salt[sl] && salt[sl] != '$'; sl++)
+  continue;
+ kl = strlen(key);
+
+ /* B = SHA512(key, salt, key) */
+ SHA512Init(&alt);
+ SHA512Update(&alt, key, kl);
+ SHA512Update(&alt, salt, sl);
+ SHA512Update(&alt, key, kl);
+ SHA512Final(final, &alt);
+
+ /* A = SHA512(key, salt, B repeated, then key or B by the bits of kl) */
+ SHA512Init(&ctx);
+ SHA512Update(&ctx, key, kl);
+ SHA512Update(&ctx, salt, sl);
+ sha512_repeat(&ctx, final, kl);
+ for (i = kl; i > 0; i >>= 1)
+  if (i & 1)
+   SHA512Update(&ctx, final, SHA512_DIGEST_LENGTH);
+  else
+   SHA512Update(&ctx, key, kl);
+ SHA512Final(final, &ctx);
+
+ /* DP = SHA512(key repeated kl times) */
+ SHA512Init(&alt);
+ for (i = 0; i < kl; i++)
+  SHA512Update(&alt, key, kl);
+ SHA512Final(dp, &alt);
+
+ /* DS = SHA512(salt repeated 16 + A[0] times) */
+ SHA512Init(&alt);
+ for (i = 0; i < 16u + final[0]; i++)
+  SHA512Update(&alt, salt, sl);
+ SHA512Final(ds, &alt);
+
+ /* and now, to make dictionary attacks expensive... */
+ for (r = 0; r < rounds; r++)
+ {
+  SHA512Init(&ctx);
+  if (r & 1)
+   sha512_repeat(&ctx, dp, kl);
+  else
+   SHA512Update(&ctx, final, SHA512_DIGEST_LENGTH);
+  if (r % 3)
+   sha512_repeat(&ctx, ds, sl);
+  if (r % 7)
+   sha512_repeat(&ctx, dp, kl);
+  if (r & 1)
+   SHA512Update(&ctx, final, SHA512_DIGEST_LENGTH);
+  else
+   sha512_repeat(&ctx, dp, kl);
+  SHA512Final(final, &ctx);
+ }
+
+ /* Now make the output string. */
+ if (custom)
+  sprintf(passwd, ROUNDS_PREFIX "%lu$%.*s$", rounds, (int)sl, salt);
+ else
+  sprintf(passwd, "%.*s$", (int)sl, salt);
+ p = passwd + strlen(passwd);
+ for (i = 0; i < sizeof(encode_order); i += 3)
+ {
+  w = (final[encode_order[i]] << 16) | (final[encode_order[i + 1]] << 8)
+   | final[encode_order[i + 2]];
+  for (r = 0; r < 4; r++, w >>= 6)
+   *p++ = itoa64[w & 0x3f];
+ }
+ for (w = final[63], r = 0; r < 2; r++, w >>= 6)
+  *p++ = itoa64[w & 0x3f];
+ *p = '\0';
+
+ /* Don't leave anything around in vm they could use. */
+ memset(final, 0, sizeof final);
+ memset(dp, 0, sizeof dp);
+ memset(ds, 0, sizeof ds);
+
+return passwd;
+}
+
+/** Register ourself with the list of crypt mechanisms
+ * Registers the SHA-512 crypt mechanism in the list of available crypt
+ * mechanisms.
+ */
+void ircd_register_crypt_sha512(void)
+{
+crypt_mech_t* crypt_mech;
+
+ if ((crypt_mech = (crypt_mech_t*)MyMalloc(sizeof(crypt_mech_t))) == NULL)
+ {
+  Debug((DEBUG_MALLOC, "Could not allocate space for crypt_sha512"));
+  return;
+ }
+
+ crypt_mech->mechname = "sha512";
+ crypt_mech->shortname = "crypt_sha512";
+ crypt_mech->description = "SHA-512 crypt password hash mechanism.";
+ crypt_mech->crypt_function = &ircd_crypt_sha512;
+ crypt_mech->crypt_token = "$6$";
+ crypt_mech->crypt_token_size = 3;
+ crypt_mech->crypt_flags = CRYPT_SLOW;
+
+ ircd_crypt_register_mech(crypt_mech);
+
+return;
+}
@@ -225,6 +225,7 @@ crypt_mech_t* crypt_mech;
  crypt_mech->crypt_function = &ircd_crypt_smd5;
  crypt_mech->crypt_token = "$SMD5$";
  crypt_mech->crypt_token_size = 6 ;
+ crypt_mech->crypt_flags = 0;
 
  ircd_crypt_register_mech(crypt_mech);
  
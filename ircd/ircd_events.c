@@ -158,6 +158,10 @@ event_generate(enum EventType type, void* arg, int data)
   assert(0 != gen);
   assert(gen->gh_flags & GEN_ACTIVE);
 
+  /* don't create events (other than ET_DESTROY) for destroyed generators */
+  if (type != ET_DESTROY && (gen->gh_flags & GEN_DESTROY))
+    return;
+
   if (type == ET_DESTROY)
   {
     if (gen->gh_flags & GEN_DESTROY)
@@ -759,6 +763,18 @@ socket_events(struct Socket* sock, unsigned int events)
   sock->s_events = new_events; /* set new events */
 }
 
+/** Asks for ET_ERROR events when only a socket's error queue has
+ * something to read, such as zero-copy send completions.
+ * @param[in] sock Socket generator to update.
+ */
+void
+socket_errqueue(struct Socket* sock)
+{
+  assert(0 != sock);
+
+  sock->s_header.gh_flags |= GEN_ERRQUEUE;
+}
+
 /** Returns the current engine's name for informational purposes.
  * @return Pointer to a static buffer containing the engine name.
  */
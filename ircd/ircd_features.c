@@ -368,6 +368,10 @@ static struct FeatureDesc {
   F_U(BUFFERPOOL, 0, 27000000, 0),
   F_B(HAS_FERGUSON_FLUSHER, 0, 0, 0),
   F_U(CLIENT_FLOOD, 0, 1024, 0),
+  F_U(INPUT_QUANTUM, 0, 512, 0),
+  F_U(SEND_COALESCE, 0, 32768, 0),
+  F_B(SERVER_ZEROCOPY, 0, 0, 0),
+  F_U(ZEROCOPY_MIN, 0, 16384, 0),
   F_I(SERVER_PORT, FEAT_OPER, 4400, 0),
   F_B(NODEFAULTMOTD, 0, 1, 0),
   F_S(MOTD_BANNER, FEAT_NULL, 0, 0),
@@ -385,6 +389,8 @@ static struct FeatureDesc {
   F_S(HIDDEN_HOST, FEAT_CASE, "users.undernet.org", 0),
   F_S(HIDDEN_IP, 0, "127.0.0.1", 0),
   F_B(CONNEXIT_NOTICES, 0, 0, 0),
+  F_I(SNOTICE_AGGREGATE_INTERVAL, 0, 5, 0),
+  F_I(SNOTICE_AGGREGATE_THRESHOLD, 0, 20, 0),
   F_B(OPLEVELS, 0, 1, set_isupport_chanmodes),
   F_B(ZANNELS, 0, 1, 0),
   F_B(LOCAL_CHANNELS, 0, 1, set_isupport_chantypes),
@@ -414,6 +420,7 @@ static struct FeatureDesc {
   F_I(IPCHECK_48_CLONE_LIMIT, 0, 50, 0),
   F_I(IPCHECK_48_CLONE_PERIOD, 0, 10, 0),
   F_I(IPCHECK_CLONE_DELAY, 0, 600, 0),
+  F_U(TARGET_HISTORY, 0, MAXTARGETS, 0),
   F_U(CHANNELLEN, 0, 200, set_isupport_channellen),
 
   /* Some misc. default paths */
@@ -428,6 +435,7 @@ static struct FeatureDesc {
   F_I(IRCD_RES_RETRIES, 0, 2, 0),
   F_I(IRCD_RES_TIMEOUT, 0, 4, 0),
   F_I(AUTH_TIMEOUT, 0, 9, 0),
+  F_U(CRYPT_WORKERS, 0, 2, 0),
   F_B(ANNOUNCE_INVITES, 0, 0, 0),
 
   /* features that affect all operators */
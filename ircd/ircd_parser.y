@@ -62,19 +62,15 @@
 #define USE_IPV6 (1 << 17)
 
   extern struct LocalConf   localConf;
-  extern struct DenyConf*   denyConfList;
-  extern struct CRuleConf*  cruleConfList;
-  extern struct ServerConf* serverConfList;
-  extern struct s_map*      GlobalServiceMapList;
-  extern struct qline*      GlobalQuarantineList;
-  extern struct wline*      GlobalWebircList;
 
   int yylex(void);
   void lexer_include(const char *filename);
 
   /* Now all the globals we need :/... */
   static int tping, tconn, maxlinks, sendq, port, invert, stringno, flags;
+  static int sendrate, sendburst, msgrate, msgburst, sendqdrop;
   static char *name, *pass, *host, *ip, *username, *origin, *hub_limit;
+  static char *location1, *location2, *contact;
   struct SLink *hosts;
   static char *stringlist[MAX_STRINGS];
   struct ListenerFlags listen_flags;
@@ -167,6 +163,11 @@ static void free_slist(struct SLink **link) {
 %token MAXLINKS
 %token MAXHOPS
 %token SENDQ
+%token SENDQDROP
+%token SENDRATE
+%token SENDBURST
+%token MSGRATE
+%token MSGBURST
 %token NAME
 %token HOST
 %token IP
@@ -344,20 +345,14 @@ jupeitem: jupenick;
 jupenick: NICK '=' QSTRING ';'
 {
   if (permitted(BLOCK_JUPE, 0))
-  {
-    addNickJupes($3);
-    MyFree($3);
-  }
+    conf_link(CRT_JUPE, $3);
+  MyFree($3);
 };
 
 generalblock: GENERAL
 {
   if (permitted(BLOCK_GENERAL, 1))
-  {
-    /* Zero out the vhost addresses, in case they were removed. */
-    memset(&VirtualHost_v4.addr, 0, sizeof(VirtualHost_v4.addr));
-    memset(&VirtualHost_v6.addr, 0, sizeof(VirtualHost_v6.addr));
-  }
+    conf_link(CRT_GENERAL);
 } '{' generalitems '}' ';' {
   if (localConf.name == NULL)
     parse_error("Your General block must contain a name.");
@@ -373,7 +368,7 @@ generalnumeric: NUMERIC '=' NUMBER ';'
   if (!permitted(BLOCK_GENERAL, 0))
     ;
   else if (localConf.numeric == 0)
-    localConf.numeric = $3;
+    conf_link(CRT_NUMERIC, $3);
   else if (localConf.numeric != (unsigned int)$3)
     parse_error("Redefinition of server numeric %i (%i)", $3,
     		localConf.numeric);
@@ -382,28 +377,20 @@ generalnumeric: NUMERIC '=' NUMBER ';'
 generalname: NAME '=' QSTRING ';'
 {
   if (!permitted(BLOCK_GENERAL, 0))
-    MyFree($3);
+    ;
   else if (localConf.name == NULL)
-    localConf.name = $3;
-  else
-  {
-    if (strcmp(localConf.name, $3))
-      parse_error("Redefinition of server name %s (%s)", $3,
-                  localConf.name);
-    MyFree($3);
-  }
+    conf_link(CRT_NAME, $3);
+  else if (strcmp(localConf.name, $3))
+    parse_error("Redefinition of server name %s (%s)", $3,
+                localConf.name);
+  MyFree($3);
 };
 
 generaldesc: DESCRIPTION '=' QSTRING ';'
 {
-  if (!permitted(BLOCK_GENERAL, 0))
-    MyFree($3);
-  else
-  {
-    MyFree(localConf.description);
-    localConf.description = $3;
-    ircd_strncpy(cli_info(&me), $3, REALLEN);
-  }
+  if (permitted(BLOCK_GENERAL, 0))
+    conf_link(CRT_DESCRIPTION, $3);
+  MyFree($3);
 };
 
 generalvhost: VHOST '=' QSTRING ';'
@@ -418,10 +405,8 @@ generalvhost: VHOST '=' QSTRING ';'
      * from the default. */
   } else if (!ircd_aton(&addr, vhost))
     parse_error("Invalid virtual host '%s'.", vhost);
-  else if (irc_in_addr_is_ipv4(&addr))
-    memcpy(&VirtualHost_v4.addr, &addr, sizeof(addr));
   else
-    memcpy(&VirtualHost_v6.addr, &addr, sizeof(addr));
+    conf_link(CRT_VHOST, &addr);
   MyFree(vhost);
 };
 
@@ -436,14 +421,12 @@ generaldnsvhost: DNS VHOST '=' address_family QSTRING ';'
   } else if (!ircd_aton(&addr, vhost))
     parse_error("Invalid DNS virtual host '%s'.", vhost);
   else
-  {
-    if ((families & USE_IPV4)
-        || (!families && irc_in_addr_is_ipv4(&addr)))
-      memcpy(&VirtualHost_dns_v4.addr, &addr, sizeof(addr));
-    if ((families & USE_IPV6)
-        || (!families && !irc_in_addr_is_ipv4(&addr)))
-      memcpy(&VirtualHost_dns_v6.addr, &addr, sizeof(addr));
-  }
+    conf_link(CRT_DNS_VHOST,
+              (families & USE_IPV4)
+              || (!families && irc_in_addr_is_ipv4(&addr)),
+              (families & USE_IPV6)
+              || (!families && !irc_in_addr_is_ipv4(&addr)),
+              &addr);
   MyFree(vhost);
 };
 
@@ -451,51 +434,38 @@ generaldnsserver: DNS SERVER '=' QSTRING ';'
 {
   char *server = $4;
 
-  add_nameserver(server);
+  conf_link(CRT_DNS_SERVER, server);
   MyFree(server);
 };
 
 adminblock: ADMIN
 {
-  if (permitted(BLOCK_ADMIN, 1))
-  {
-    MyFree(localConf.location1);
-    MyFree(localConf.location2);
-    MyFree(localConf.contact);
-    localConf.location1 = localConf.location2 = localConf.contact = NULL;
-  }
+  (void)permitted(BLOCK_ADMIN, 1);
 }
 '{' adminitems '}' ';'
 {
-  if (localConf.location1 == NULL)
-    DupString(localConf.location1, "");
-  if (localConf.location2 == NULL)
-    DupString(localConf.location2, "");
-  if (localConf.contact == NULL)
-    DupString(localConf.contact, "");
+  if (permitted(BLOCK_ADMIN, 0))
+    conf_link(CRT_ADMIN, location1, location2, contact);
+  MyFree(location1);
+  MyFree(location2);
+  MyFree(contact);
+  location1 = location2 = contact = NULL;
 };
 adminitems: adminitems adminitem | adminitem;
 adminitem: adminlocation | admincontact;
 adminlocation: LOCATION '=' QSTRING ';'
 {
-  if (!permitted(BLOCK_ADMIN, 0))
-    MyFree($3);
-  else if (localConf.location1 == NULL)
-    localConf.location1 = $3;
-  else if (localConf.location2 == NULL)
-    localConf.location2 = $3;
+  if (location1 == NULL)
+    location1 = $3;
+  else if (location2 == NULL)
+    location2 = $3;
   else /* Otherwise just drop it. -A1kmm */
     MyFree($3);
 };
 admincontact: CONTACT '=' QSTRING ';'
 {
-  if (!permitted(BLOCK_ADMIN, 0))
-    MyFree($3);
-  else
-  {
-    MyFree(localConf.contact);
-    localConf.contact = $3;
-  }
+  MyFree(contact);
+  contact = $3;
 };
 
 classblock: CLASS {
@@ -505,29 +475,27 @@ classblock: CLASS {
   if (!permitted(BLOCK_CLASS, 1))
     ;
   else if (name != NULL)
-  {
-    struct ConnectionClass *c_class;
-    add_class(name, tping, tconn, maxlinks, sendq);
-    c_class = find_class(name);
-    MyFree(c_class->default_umode);
-    c_class->default_umode = pass;
-    memcpy(&c_class->privs, &privs, sizeof(c_class->privs));
-    memcpy(&c_class->privs_dirty, &privs_dirty, sizeof(c_class->privs_dirty));
-  }
+    conf_link(CRT_CLASS, name, tping, tconn, maxlinks, sendq, pass, &privs,
+              &privs_dirty, sendrate, sendburst ? sendburst : sendrate,
+              msgrate, msgburst ? msgburst : msgrate, sendqdrop);
   else {
    parse_error("Missing name in class block");
   }
+  MyFree(name);
+  MyFree(pass);
   name = NULL;
   pass = NULL;
   tconn = 0;
   maxlinks = 0;
   sendq = 0;
+  sendrate = sendburst = msgrate = msgburst = sendqdrop = 0;
   memset(&privs, 0, sizeof(privs));
   memset(&privs_dirty, 0, sizeof(privs_dirty));
 };
 classitems: classitem classitems | classitem;
 classitem: classname | classpingfreq | classconnfreq | classmaxlinks |
-           classsendq | classusermode | priv;
+           classsendq | classsendqdrop | classsendrate | classsendburst |
+           classmsgrate | classmsgburst | classusermode | priv;
 classname: NAME '=' QSTRING ';'
 {
   MyFree(name);
@@ -549,6 +517,29 @@ classsendq: SENDQ '=' sizespec ';'
 {
   sendq = $3;
 };
+classsendqdrop: SENDQDROP '=' YES ';'
+{
+  sendqdrop = 1;
+} | SENDQDROP '=' NO ';'
+{
+  sendqdrop = 0;
+};
+classsendrate: SENDRATE '=' sizespec ';'
+{
+  sendrate = $3;
+};
+classsendburst: SENDBURST '=' sizespec ';'
+{
+  sendburst = $3;
+};
+classmsgrate: MSGRATE '=' expr ';'
+{
+  msgrate = $3;
+};
+classmsgburst: MSGBURST '=' expr ';'
+{
+  msgburst = $3;
+};
 classusermode: USERMODE '=' QSTRING ';'
 {
   MyFree(pass);
@@ -560,7 +551,6 @@ connectblock: CONNECT
  flags = CONF_AUTOCONNECT;
 } '{' connectitems '}' ';'
 {
- struct ConfItem *aconf = NULL;
  if (!permitted(BLOCK_CONNECT, 1))
    ;
  else if (name == NULL)
@@ -576,28 +566,18 @@ connectblock: CONNECT
  else if (c_class == NULL)
   parse_error("Missing or non-existent class in connect block");
  else {
-   aconf = make_conf(CONF_SERVER);
-   aconf->name = name;
-   aconf->origin_name = origin;
-   aconf->passwd = pass;
-   aconf->conn_class = c_class;
-   aconf->address.port = port;
-   aconf->host = host;
    /* If the user specified a hub allowance, but not maximum links,
     * allow an effectively unlimited number of hops.
     */
-   aconf->maximum = (hub_limit != NULL && maxlinks == 0) ? 65535 : maxlinks;
-   aconf->hub_limit = hub_limit;
-   aconf->flags = flags;
-   lookup_confhost(aconf);
- }
- if (!aconf) {
-   MyFree(name);
-   MyFree(pass);
-   MyFree(host);
-   MyFree(origin);
-   MyFree(hub_limit);
+   conf_link(CRT_CONNECT, name, origin, pass, host, ConClass(c_class), port,
+             (hub_limit != NULL && maxlinks == 0) ? 65535 : maxlinks,
+             hub_limit, flags);
  }
+ MyFree(name);
+ MyFree(pass);
+ MyFree(host);
+ MyFree(origin);
+ MyFree(hub_limit);
  name = pass = host = origin = hub_limit = NULL;
  c_class = NULL;
  port = flags = maxlinks = 0;
@@ -666,29 +646,32 @@ uworlditem: uworldname | uworldoper;
 uworldname: NAME '=' QSTRING ';'
 {
   if (permitted(BLOCK_UWORLD, 0))
-    conf_make_uworld($3, 0);
+    conf_link(CRT_UWORLD, $3, 0);
+  MyFree($3);
 };
 uworldoper: OPER '=' QSTRING ';'
 {
   if (permitted(BLOCK_UWORLD, 0))
-    conf_make_uworld($3, CONF_UWORLD_OPER);
+    conf_link(CRT_UWORLD, $3, CONF_UWORLD_OPER);
+  MyFree($3);
 }
 
 uworldblock: UWORLD QSTRING ';'
 {
   if (permitted(BLOCK_UWORLD, 1))
-    conf_make_uworld($2, 0);
+    conf_link(CRT_UWORLD, $2, 0);
+  MyFree($2);
 }
 
 uworldblock: UWORLD OPER QSTRING ';'
 {
   if (permitted(BLOCK_UWORLD, 0))
-    conf_make_uworld($3, CONF_UWORLD_OPER);
+    conf_link(CRT_UWORLD, $3, CONF_UWORLD_OPER);
+  MyFree($3);
 }
 
 operblock: OPER '{' operitems '}' ';'
 {
-  struct ConfItem *aconf = NULL;
   struct SLink *link;
 
   if (!permitted(BLOCK_OPER, 1))
@@ -705,15 +688,9 @@ operblock: OPER '{' operitems '}' ';'
   else if (!FlagHas(&privs_dirty, PRIV_PROPAGATE)
            && !FlagHas(&c_class->privs_dirty, PRIV_PROPAGATE))
     parse_error("Operator block for %s and class %s have no LOCAL setting", name, c_class->cc_name);
-  else for (link = hosts; link != NULL; link = link->next) {
-    aconf = make_conf(CONF_OPERATOR);
-    DupString(aconf->name, name);
-    DupString(aconf->passwd, pass);
-    conf_parse_userhost(aconf, link->value.cp);
-    aconf->conn_class = c_class;
-    memcpy(&aconf->privs, &privs, sizeof(aconf->privs));
-    memcpy(&aconf->privs_dirty, &privs_dirty, sizeof(aconf->privs_dirty));
-  }
+  else for (link = hosts; link != NULL; link = link->next)
+    conf_link(CRT_OPERATOR, name, pass, link->value.cp, ConClass(c_class),
+              &privs, &privs_dirty);
   MyFree(name);
   MyFree(pass);
   free_slist(&hosts);
@@ -837,7 +814,7 @@ portblock: PORT '{' portitems '}' ';'
     }
     if (link->flags & 65535)
       port = link->flags & 65535;
-    add_listener(port, link->value.cp, pass, &flags_here);
+    conf_link(CRT_PORT, port, link->value.cp, pass, &flags_here);
   }
   free_slist(&hosts);
   MyFree(pass);
@@ -930,10 +907,10 @@ clientblock: CLIENT
 }
 '{' clientitems '}' ';'
 {
-  struct ConfItem *aconf = 0;
   struct irc_in_addr addr;
   unsigned char addrbits = 0;
 
+  memset(&addr, 0, sizeof(addr));
   if (!permitted(BLOCK_CLIENT, 1))
     ;
   else if (!c_class)
@@ -942,27 +919,13 @@ clientblock: CLIENT
     parse_error("Password too long in connect block");
   else if (ip && !ipmask_parse(ip, &addr, &addrbits))
     parse_error("Invalid IP address %s in Client block", ip);
-  else {
-    aconf = make_conf(CONF_CLIENT);
-    aconf->username = username;
-    aconf->host = host;
-    if (ip)
-      memcpy(&aconf->address.addr, &addr, sizeof(aconf->address.addr));
-    else
-      memset(&aconf->address.addr, 0, sizeof(aconf->address.addr));
-    aconf->address.port = port;
-    aconf->addrbits = addrbits;
-    aconf->name = ip;
-    aconf->conn_class = c_class;
-    aconf->maximum = maxlinks;
-    aconf->passwd = pass;
-  }
-  if (!aconf) {
-    MyFree(username);
-    MyFree(host);
-    MyFree(ip);
-    MyFree(pass);
-  }
+  else
+    conf_link(CRT_CLIENT, username, host, ip, &addr, addrbits, port,
+              ConClass(c_class), maxlinks, pass);
+  MyFree(username);
+  MyFree(host);
+  MyFree(ip);
+  MyFree(pass);
   host = NULL;
   username = NULL;
   c_class = NULL;
@@ -1032,27 +995,17 @@ killblock: KILL
 } '{' killitems '}' ';'
 {
   if (!permitted(BLOCK_KILL, 1))
-  {
-    MyFree(dconf->usermask);
-    MyFree(dconf->hostmask);
-    MyFree(dconf->realmask);
-    MyFree(dconf->message);
-    MyFree(dconf);
-  }
+    ;
   else if (dconf->usermask || dconf->hostmask ||dconf->realmask)
-  {
-    dconf->next = denyConfList;
-    denyConfList = dconf;
-  }
+    conf_link(CRT_KILL, dconf->usermask, dconf->hostmask, dconf->realmask,
+              dconf->message, dconf->flags, &dconf->address, dconf->bits);
   else
-  {
-    MyFree(dconf->usermask);
-    MyFree(dconf->hostmask);
-    MyFree(dconf->realmask);
-    MyFree(dconf->message);
-    MyFree(dconf);
     parse_error("Kill block must match on at least one of username, host or realname");
-  }
+  MyFree(dconf->usermask);
+  MyFree(dconf->hostmask);
+  MyFree(dconf->realmask);
+  MyFree(dconf->message);
+  MyFree(dconf);
   dconf = NULL;
 };
 killitems: killitem killitems | killitem;
@@ -1106,14 +1059,18 @@ cruleblock: CRULE optall QSTRING optall crule_expr ';'
 {
   if (permitted(BLOCK_CRULE, 1) && $5)
   {
-    struct CRuleConf *p = (struct CRuleConf*) MyMalloc(sizeof(*p));
-    p->hostmask = collapse($3);
-    p->rule = crule_text($5);
-    p->type = ($2 || $4) ? CRULE_ALL : CRULE_AUTO;
-    p->node = $5;
-    p->next = cruleConfList;
-    cruleConfList = p;
+    int count = crule_flatten($5, NULL, 0);
+    const char **words = MyMalloc(count * sizeof(*words));
+    char *text = crule_text($5);
+
+    crule_flatten($5, words, count);
+    conf_link(CRT_CRULE, collapse($3), text,
+              ($2 || $4) ? CRULE_ALL : CRULE_AUTO, count, words);
+    MyFree(words);
+    MyFree(text);
   }
+  MyFree($3);
+  crule_free($5);
 };
 
 optall: { $$ = 0; };
@@ -1136,7 +1093,7 @@ motdblock: MOTD '{' motditems '}' ';'
 
   if (permitted(BLOCK_MOTD, 1) && pass != NULL) {
     for (link = hosts; link != NULL; link = link->next)
-      motd_add(link->value.cp, pass);
+      conf_link(CRT_MOTD, link->value.cp, pass);
   }
 
   free_slist(&hosts);
@@ -1173,7 +1130,7 @@ featureitem: QSTRING
 } '=' stringlist ';' {
   int ii;
   if (permitted(BLOCK_FEATURES, 0))
-    feature_set(NULL, (const char * const *)stringlist, stringno);
+    conf_link(CRT_FEATURE, stringno, (const char **)stringlist);
   for (ii = 0; ii < stringno; ++ii)
     MyFree(stringlist[ii]);
 };
@@ -1193,19 +1150,10 @@ quarantineblock: QUARANTINE '{' {
 quarantineitems: quarantineitems quarantineitem | quarantineitem;
 quarantineitem: QSTRING '=' QSTRING ';'
 {
-  if (!permitted(BLOCK_QUARANTINE, 0))
-  {
-    MyFree($1);
-    MyFree($3);
-  }
-  else
-  {
-    struct qline *qconf = MyCalloc(1, sizeof(*qconf));
-    qconf->chname = $1;
-    qconf->reason = $3;
-    qconf->next = GlobalQuarantineList;
-    GlobalQuarantineList = qconf;
-  }
+  if (permitted(BLOCK_QUARANTINE, 0))
+    conf_link(CRT_QUARANTINE, $1, $3);
+  MyFree($1);
+  MyFree($3);
 };
 
 pseudoblock: PSEUDO QSTRING '{'
@@ -1216,6 +1164,9 @@ pseudoblock: PSEUDO QSTRING '{'
 pseudoitems '}' ';'
 {
   int valid = 0;
+  struct nick_host *nh;
+  const char **nicks;
+  int count;
 
   if (!permitted(BLOCK_PSEUDO, 1))
     ;
@@ -1227,15 +1178,18 @@ pseudoitems '}' ';'
     parse_error("Pseudo command %s invalid: must all be letters", smap->command);
   else
     valid = 1;
-  if (valid && register_mapping(smap))
+  if (valid)
   {
-    smap->next = GlobalServiceMapList;
-    GlobalServiceMapList = smap;
-  }
-  else
-  {
-    free_mapping(smap);
+    for (count = 0, nh = smap->services; nh; nh = nh->next)
+      count++;
+    nicks = MyMalloc(count * sizeof(*nicks));
+    for (count = 0, nh = smap->services; nh; nh = nh->next)
+      nicks[count++] = nh->nick;
+    conf_link(CRT_PSEUDO, smap->command, smap->name, smap->prepend,
+              smap->flags, count, nicks);
+    MyFree(nicks);
   }
+  free_mapping(smap);
   smap = NULL;
 };
 
@@ -1273,7 +1227,7 @@ pseudoflags: FAST ';'
 iauthblock: IAUTH '{' iauthitems '}' ';'
 {
   if (permitted(BLOCK_IAUTH, 1))
-    auth_spawn(stringno, stringlist);
+    conf_link(CRT_IAUTH, stringno, (const char **)stringlist);
   while (stringno > 0)
   {
     --stringno;
@@ -1345,7 +1299,6 @@ webircblock: WEBIRC
 }
 '{' webircitems '}' ';'
 {
-  struct wline *wline;
   struct irc_in_addr peer;
   unsigned char bits;
 
@@ -1355,35 +1308,12 @@ webircblock: WEBIRC
     parse_error("Missing password in WebIRC block");
   else if (!ipmask_parse(ip, &peer, &bits))
     parse_error("Invalid IP address in WebIRC block");
-  else {
-    /* Search for a wline with the same IP (mask) and password. */
-    for (wline = GlobalWebircList; wline; wline = wline->next) {
-      if ((bits == wline->bits)
-          && ipmask_check(&peer, &wline->ip, bits)
-          && (0 == strcmp(pass, wline->passwd)))
-        break;
-    }
-
-    /* Update it, or create a new structure. */
-    if (wline) {
-      MyFree(wline->description);
-    } else {
-      wline = (struct wline *) MyMalloc(sizeof(*wline));
-      memcpy(&wline->ip, &peer, sizeof(wline->ip));
-      wline->bits = bits;
-      wline->passwd = pass;
-      wline->next = GlobalWebircList;
-      GlobalWebircList = wline;
-    }
-    wline->stale = 0;
-    wline->hidden = (flags & 1) != 0;
-    wline->description = name;
-
-    MyFree(ip);
-    ip = NULL;
-    pass = NULL;
-    name = NULL;
-  }
+  else
+    conf_link(CRT_WEBIRC, pass, name, &peer, bits, (flags & 1) != 0);
+  MyFree(ip);
+  MyFree(pass);
+  MyFree(name);
+  ip = pass = name = NULL;
 };
 
 webircitems: webircitem | webircitems webircitem;
@@ -50,6 +50,7 @@
 #include "hash.h"
 #include "ircd.h"
 #include "ircd_chattr.h"
+#include "ircd_defs.h"
 #include "ircd_features.h"
 #include "ircd_log.h"
 #include "ircd_reply.h"
@@ -76,107 +77,176 @@
  * but not introduce any IsOper/IsUser/MyUser/IsServer etc. stuff.
  */
 
-/** Relay a local user's message to a channel.
+/** Channel modes that restrict message content, and the
+ * string_classify() flags that each of them rejects.
+ */
+static const struct {
+  unsigned int mode;		/**< Channel mode flag. */
+  unsigned int text;		/**< TEXT_* flags not allowed by it. */
+} content_modes[] = {
+  { MODE_NOCOLOR, TEXT_COLOR },
+  { MODE_NOCTCP, TEXT_CTCP }
+};
+
+/** Check whether a channel's modes forbid the content of a message.
+ * The text is classified at most once per message, however many
+ * channels it is sent to; callers start with \a *tclass set to 0.
+ * @param[in] chptr Target channel.
+ * @param[in] text %Message text.
+ * @param[in,out] tclass Cached string_classify() result for \a text.
+ * @return Non-zero if the message may not be sent to \a chptr.
+ */
+static int relay_content_blocked(struct Channel* chptr, const char* text,
+                                 unsigned int* tclass)
+{
+  unsigned int i;
+
+  for (i = 0; i < sizeof(content_modes) / sizeof(content_modes[0]); ++i) {
+    if (!(chptr->mode.mode & content_modes[i].mode))
+      continue;
+    if (!(*tclass & TEXT_CLASSIFIED))
+      *tclass = string_classify(text) | TEXT_CLASSIFIED;
+    if (*tclass & content_modes[i].text)
+      return 1;
+  }
+  return 0;
+}
+
+/** Check whether a local user may send a message to a channel.
  * Generates an error if the client cannot send to the channel.
  * @param[in] sptr Client that originated the message.
  * @param[in] name Name of target channel.
  * @param[in] text %Message to relay.
+ * @param[in,out] tclass Cached string_classify() result for \a text.
+ * @return Channel to relay the message to, or NULL.
  */
-void relay_channel_message(struct Client* sptr, const char* name, const char* text)
+static struct Channel* check_channel_message(struct Client* sptr,
+                                             const char* name,
+                                             const char* text,
+                                             unsigned int* tclass)
 {
   struct Channel* chptr;
-  const char *ch;
-
-  assert(0 != sptr);
-  assert(0 != name);
-  assert(0 != text);
 
   if (0 == (chptr = FindChannel(name))) {
     send_reply(sptr, ERR_NOSUCHCHANNEL, name);
-    return;
+    return 0;
   }
   /*
    * This first: Almost never a server/service
    */
   if (!client_can_send_to_channel(sptr, chptr, 0)) {
     send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
-    return;
+    return 0;
   }
   if ((chptr->mode.mode & MODE_NOPRIVMSGS) &&
       check_target_limit(sptr, chptr, chptr->chname, 0))
-    return;
-
-  if (chptr->mode.mode & MODE_NOCOLOR) {
-    for (ch = text; *ch != '\0'; ++ch) {
-      if (*ch == 3 || *ch == 27) {
-        send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
-        return;
-      }
-    }
-  }
+    return 0;
 
-  if ((chptr->mode.mode & MODE_NOCTCP) && ircd_strncmp(text, "\001ACTION ", 8)) {
-    for (ch = text; *ch != '\0'; ++ch) {
-      if (*ch == 1) {
-        send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
-        return;
-      }
-    }
+  if (relay_content_blocked(chptr, text, tclass)) {
+    send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
+    return 0;
   }
-
-  RevealDelayedJoinIfNeeded(sptr, chptr);
-  sendcmdto_channel(sptr, CMD_PRIVATE, chptr, cli_from(sptr),
-                    SKIP_DEAF | SKIP_BURST, "%H :%s", chptr, text);
+  return chptr;
 }
 
-/** Relay a local user's notice to a channel.
- * Silently exits if the client cannot send to the channel.
- * @param[in] sptr Client that originated the message.
+/** Check whether a local user may send a notice to a channel.
+ * Silently fails if the client cannot send to the channel.
+ * @param[in] sptr Client that originated the notice.
  * @param[in] name Name of target channel.
  * @param[in] text %Message to relay.
+ * @param[in,out] tclass Cached string_classify() result for \a text.
+ * @return Channel to relay the notice to, or NULL.
  */
-void relay_channel_notice(struct Client* sptr, const char* name, const char* text)
+static struct Channel* check_channel_notice(struct Client* sptr,
+                                            const char* name,
+                                            const char* text,
+                                            unsigned int* tclass)
 {
   struct Channel* chptr;
-  const char *ch;
-
-  assert(0 != sptr);
-  assert(0 != name);
-  assert(0 != text);
 
   if (0 == (chptr = FindChannel(name)))
-    return;
+    return 0;
   /*
    * This first: Almost never a server/service
    */
   if (!client_can_send_to_channel(sptr, chptr, 0))
-    return;
+    return 0;
 
   if ((chptr->mode.mode & MODE_NOPRIVMSGS) &&
       check_target_limit(sptr, chptr, chptr->chname, 0))
-    return;
+    return 0;
 
-  if (chptr->mode.mode & MODE_NOCOLOR) {
-    for (ch = text; *ch != '\0'; ++ch) {
-      if (*ch == 3 || *ch == 27) {
-        send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
-        return;
-      }
-    }
+  if (relay_content_blocked(chptr, text, tclass)) {
+    send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
+    return 0;
   }
+  return chptr;
+}
+
+/** Relay a local user's message to one or more channels.
+ * All targets are checked before anything is sent, so that the
+ * message can be delivered to every channel in one batch.
+ * Generates an error for each channel the client cannot send to.
+ * @param[in] sptr Client that originated the message.
+ * @param[in] names Names of target channels.
+ * @param[in] count Number of entries in \a names (at most MAXTARGETS).
+ * @param[in] text %Message to relay.
+ */
+void relay_channel_messages(struct Client* sptr, char* names[], int count,
+                            const char* text)
+{
+  struct Channel* targets[MAXTARGETS];
+  unsigned int    tclass = 0;
+  unsigned int    ntargets = 0;
+  int             i;
+
+  assert(0 != sptr);
+  assert(0 != names);
+  assert(0 != text);
+  assert(count <= MAXTARGETS);
 
-  if ((chptr->mode.mode & MODE_NOCTCP) && ircd_strncmp(text, "\001ACTION ", 8)) {
-    for (ch = text; *ch != '\0'; ++ch) {
-      if (*ch == 1) {
-        send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
-        return;
-      }
+  for (i = 0; i < count; ++i) {
+    if ((targets[ntargets] = check_channel_message(sptr, names[i], text,
+                                                   &tclass))) {
+      RevealDelayedJoinIfNeeded(sptr, targets[ntargets]);
+      ntargets++;
     }
   }
+  sendtextto_channels(sptr, CMD_PRIVATE, targets, ntargets, cli_from(sptr),
+                      SKIP_DEAF | SKIP_BURST, text);
+}
+
+/** Relay a local user's notice to one or more channels.
+ * All targets are checked before anything is sent, so that the
+ * notice can be delivered to every channel in one batch.
+ * Silently skips channels the client cannot send to.
+ * @param[in] sptr Client that originated the notice.
+ * @param[in] names Names of target channels.
+ * @param[in] count Number of entries in \a names (at most MAXTARGETS).
+ * @param[in] text %Message to relay.
+ */
+void relay_channel_notices(struct Client* sptr, char* names[], int count,
+                           const char* text)
+{
+  struct Channel* targets[MAXTARGETS];
+  unsigned int    tclass = 0;
+  unsigned int    ntargets = 0;
+  int             i;
+
+  assert(0 != sptr);
+  assert(0 != names);
+  assert(0 != text);
+  assert(count <= MAXTARGETS);
 
-  RevealDelayedJoinIfNeeded(sptr, chptr);
-  sendcmdto_channel(sptr, CMD_NOTICE, chptr, cli_from(sptr),
-                    SKIP_DEAF | SKIP_BURST, "%H :%s", chptr, text);
+  for (i = 0; i < count; ++i) {
+    if ((targets[ntargets] = check_channel_notice(sptr, names[i], text,
+                                                  &tclass))) {
+      RevealDelayedJoinIfNeeded(sptr, targets[ntargets]);
+      ntargets++;
+    }
+  }
+  sendtextto_channels(sptr, CMD_NOTICE, targets, ntargets, cli_from(sptr),
+                      SKIP_DEAF | SKIP_BURST, text);
 }
 
 /** Relay a message to a channel.
@@ -202,8 +272,8 @@ void server_relay_channel_message(struct Client* sptr, const char* name, const c
    * Servers may have channel services, need to check for it here
    */
   if (client_can_send_to_channel(sptr, chptr, 1) || IsChannelService(sptr)) {
-    sendcmdto_channel(sptr, CMD_PRIVATE, chptr, cli_from(sptr),
-                      SKIP_DEAF | SKIP_BURST, "%H :%s", chptr, text);
+    sendtextto_channel(sptr, CMD_PRIVATE, chptr, cli_from(sptr),
+                       SKIP_DEAF | SKIP_BURST, text);
   }
   else
     send_reply(sptr, ERR_CANNOTSENDTOCHAN, chptr->chname);
@@ -230,8 +300,8 @@ void server_relay_channel_notice(struct Client* sptr, const char* name, const ch
    * Servers may have channel services, need to check for it here
    */
   if (client_can_send_to_channel(sptr, chptr, 1) || IsChannelService(sptr)) {
-    sendcmdto_channel(sptr, CMD_NOTICE, chptr, cli_from(sptr),
-                      SKIP_DEAF | SKIP_BURST, "%H :%s", chptr, text);
+    sendtextto_channel(sptr, CMD_NOTICE, chptr, cli_from(sptr),
+                       SKIP_DEAF | SKIP_BURST, text);
   }
 }
 
@@ -390,7 +460,7 @@ void relay_private_message(struct Client* sptr, const char* name, const char* te
   if (MyUser(acptr))
     add_target(acptr, sptr);
 
-  sendcmdto_one(sptr, CMD_PRIVATE, acptr, "%C :%s", acptr, text);
+  sendtextto_one(sptr, CMD_PRIVATE, acptr, text);
 }
 
 /** Relay a private notice from a local user.
@@ -420,7 +490,7 @@ void relay_private_notice(struct Client* sptr, const char* name, const char* tex
   if (MyUser(acptr))
     add_target(acptr, sptr);
 
-  sendcmdto_one(sptr, CMD_NOTICE, acptr, "%C :%s", acptr, text);
+  sendtextto_one(sptr, CMD_NOTICE, acptr, text);
 }
 
 /** Relay a private message that arrived from a server.
@@ -450,7 +520,7 @@ void server_relay_private_message(struct Client* sptr, const char* name, const c
   if (MyUser(acptr))
     add_target(acptr, sptr);
 
-  sendcmdto_one(sptr, CMD_PRIVATE, acptr, "%C :%s", acptr, text);
+  sendtextto_one(sptr, CMD_PRIVATE, acptr, text);
 }
 
 
@@ -478,7 +548,7 @@ void server_relay_private_notice(struct Client* sptr, const char* name, const ch
   if (MyUser(acptr))
     add_target(acptr, sptr);
 
-  sendcmdto_one(sptr, CMD_NOTICE, acptr, "%C :%s", acptr, text);
+  sendtextto_one(sptr, CMD_NOTICE, acptr, text);
 }
 
 /** Relay a masked message from a local user.
@@ -0,0 +1,174 @@
+/*
+ * IRC - Internet Relay Chat, ircd/ircd_sha512.c
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief SHA-512 implementation for ircu.
+ *
+ * This is a straightforward implementation of SHA-512 as described in
+ * FIPS 180-4, used by the SHA-512 crypt and PBKDF2 password
+ * mechanisms.  To compute a digest, initialize a SHA512Context with
+ * SHA512Init(), feed it data with SHA512Update() and collect the
+ * digest with SHA512Final().
+ */
+#include "config.h"
+
+#include "ircd_sha512.h"
+
+#include <string.h>
+
+/** Round constants. */
+static const uint64_t K[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+  0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+  0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+  0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+  0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+  0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+  0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+  0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+  0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+  0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+  0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+  0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+  0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+  0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+  0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+  0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+  0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+  0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+  0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+  0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+  0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/** Rotate a 64-bit word right. */
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+/** Process one input block.
+ * @param[in,out] state Digest state to update.
+ * @param[in] block SHA512_BLOCK_LENGTH bytes of input.
+ */
+static void SHA512Transform(uint64_t state[8], const unsigned char *block)
+{
+  uint64_t W[80], a, b, c, d, e, f, g, h, t1, t2;
+  int i;
+
+  for (i = 0; i < 16; i++, block += 8)
+    W[i] = (uint64_t)block[0] << 56 | (uint64_t)block[1] << 48
+      | (uint64_t)block[2] << 40 | (uint64_t)block[3] << 32
+      | (uint64_t)block[4] << 24 | (uint64_t)block[5] << 16
+      | (uint64_t)block[6] << 8 | (uint64_t)block[7];
+  for (; i < 80; i++)
+    W[i] = (ROR(W[i - 2], 19) ^ ROR(W[i - 2], 61) ^ (W[i - 2] >> 6))
+      + W[i - 7]
+      + (ROR(W[i - 15], 1) ^ ROR(W[i - 15], 8) ^ (W[i - 15] >> 7))
+      + W[i - 16];
+
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+  for (i = 0; i < 80; i++) {
+    t1 = h + (ROR(e, 14) ^ ROR(e, 18) ^ ROR(e, 41)) + ((e & f) ^ (~e & g))
+      + K[i] + W[i];
+    t2 = (ROR(a, 28) ^ ROR(a, 34) ^ ROR(a, 39))
+      + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+/** Initialize a SHA-512 context.
+ * @param[out] ctx Context to initialize.
+ */
+void SHA512Init(struct SHA512Context *ctx)
+{
+  ctx->state[0] = 0x6a09e667f3bcc908ULL;
+  ctx->state[1] = 0xbb67ae8584caa73bULL;
+  ctx->state[2] = 0x3c6ef372fe94f82bULL;
+  ctx->state[3] = 0xa54ff53a5f1d36f1ULL;
+  ctx->state[4] = 0x510e527fade682d1ULL;
+  ctx->state[5] = 0x9b05688c2b3e6c1fULL;
+  ctx->state[6] = 0x1f83d9abfb41bd6bULL;
+  ctx->state[7] = 0x5be0cd19137e2179ULL;
+  ctx->count = 0;
+}
+
+/** Add data to a SHA-512 digest.
+ * @param[in,out] ctx Context to update.
+ * @param[in] data Data to hash.
+ * @param[in] len Number of bytes at \a data.
+ */
+void SHA512Update(struct SHA512Context *ctx, const void *data,
+                  unsigned int len)
+{
+  const unsigned char *in = (const unsigned char *) data;
+  unsigned int used = ctx->count % SHA512_BLOCK_LENGTH;
+  unsigned int fill;
+
+  ctx->count += len;
+  if (used) {
+    fill = SHA512_BLOCK_LENGTH - used;
+    if (len < fill) {
+      memcpy(ctx->buf + used, in, len);
+      return;
+    }
+    memcpy(ctx->buf + used, in, fill);
+    SHA512Transform(ctx->state, ctx->buf);
+    in += fill;
+    len -= fill;
+  }
+  for (; len >= SHA512_BLOCK_LENGTH; in += SHA512_BLOCK_LENGTH,
+         len -= SHA512_BLOCK_LENGTH)
+    SHA512Transform(ctx->state, in);
+  memcpy(ctx->buf, in, len);
+}
+
+/** Finish a SHA-512 digest.
+ * @param[out] digest Receives the digest.
+ * @param[in,out] ctx Context to finish; it is cleared afterwards.
+ */
+void SHA512Final(unsigned char digest[SHA512_DIGEST_LENGTH],
+                 struct SHA512Context *ctx)
+{
+  unsigned int used = ctx->count % SHA512_BLOCK_LENGTH;
+  uint64_t bits = ctx->count << 3;
+  int i;
+
+  ctx->buf[used++] = 0x80;
+  if (used > SHA512_BLOCK_LENGTH - 16) {
+    memset(ctx->buf + used, 0, SHA512_BLOCK_LENGTH - used);
+    SHA512Transform(ctx->state, ctx->buf);
+    used = 0;
+  }
+  /* The high 64 bits of the 128-bit length are always zero here. */
+  memset(ctx->buf + used, 0, SHA512_BLOCK_LENGTH - 8 - used);
+  for (i = 0; i < 8; i++)
+    ctx->buf[SHA512_BLOCK_LENGTH - 1 - i] = (unsigned char)(bits >> (8 * i));
+  SHA512Transform(ctx->state, ctx->buf);
+
+  for (i = 0; i < SHA512_DIGEST_LENGTH; i++)
+    digest[i] = (unsigned char)(ctx->state[i / 8] >> (56 - 8 * (i % 8)));
+  memset(ctx, 0, sizeof(*ctx));
+}
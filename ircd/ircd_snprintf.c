@@ -2046,6 +2046,8 @@ doprintf(struct Client *dest, struct BufData *buf_p, const char *fmt,
       if (dest && (IsServer(dest) || IsMe(dest))) {
 	if (IsServer(cptr) || IsMe(cptr))
 	  str1 = cli_yxx(cptr);
+	else if (IsUser(cptr))
+	  str1 = client_numnick(cptr);
 	else {
 	  str1 = cli_yxx(cli_user(cptr)->server);
 	  str2 = cli_yxx(cptr);
@@ -2056,8 +2058,13 @@ doprintf(struct Client *dest, struct BufData *buf_p, const char *fmt,
 	if (!IsServer(cptr) && !IsMe(cptr) && fld_s.flags & FLAG_ALT) {
 	  assert(0 != cli_user(cptr));
 	  assert(0 != *(cli_name(cptr)));
-	  str2 = cli_user(cptr)->username;
-	  str3 = cli_user(cptr)->host;
+	  if (IsUser(cptr) && fld_s.prec < 0) {
+	    str1 = client_prefix(cptr, 0); /* cached nick!user@host */
+	    fld_s.flags &= ~FLAG_ALT;
+	  } else {
+	    str2 = cli_user(cptr)->username;
+	    str3 = cli_user(cptr)->host;
+	  }
 	} else
 	  fld_s.flags &= ~FLAG_ALT;
       }
@@ -2166,3 +2173,50 @@ ircd_vsnprintf(struct Client *dest, char *buf, size_t buf_len,
 
   return TOTAL(&buf_s);
 }
+
+/** Get the nick!user@host prefix of a user.
+ * The prefix is rendered once and cached on the client until
+ * ClearPrefix() is called for it; set_nick_name() and hide_hostmask()
+ * do so when the name or host changes.  An account change alters the
+ * prefix only through hide_hostmask().
+ * @param[in] cptr User whose prefix is wanted.
+ * @param[out] len If non-NULL, receives the length of the prefix.
+ * @return Cached prefix for \a cptr.
+ */
+const char *
+client_prefix(struct Client *cptr, unsigned int *len)
+{
+  int res;
+
+  assert(0 != cli_user(cptr));
+
+  if (!cli_prefixlen(cptr)) {
+    res = ircd_snprintf(0, cli_prefix(cptr), sizeof(cli_prefix(cptr)),
+                        "%s!%s@%s", cli_name(cptr), cli_user(cptr)->username,
+                        cli_user(cptr)->host);
+    cli_prefixlen(cptr) = SNP_MIN(res, (int)sizeof(cli_prefix(cptr)) - 1);
+  }
+  if (len)
+    *len = cli_prefixlen(cptr);
+  return cli_prefix(cptr);
+}
+
+/** Get the full YYXXX numnick of a user, or the YY numnick of a server.
+ * The numnick of a user never changes, so it is built once and cached.
+ * @param[in] cptr Client whose numnick is wanted.
+ * @return Numnick of \a cptr.
+ */
+const char *
+client_numnick(struct Client *cptr)
+{
+  if (IsServer(cptr) || IsMe(cptr))
+    return cli_yxx(cptr);
+
+  assert(0 != cli_user(cptr));
+
+  if (!*cli_numnick(cptr)) {
+    strcpy(cli_numnick(cptr), cli_yxx(cli_user(cptr)->server));
+    strcat(cli_numnick(cptr), cli_yxx(cptr));
+  }
+  return cli_numnick(cptr);
+}
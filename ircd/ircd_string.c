@@ -56,6 +56,62 @@ int string_has_wildcards(const char* str)
   return 0;
 }
 
+/** Fewest letters a message needs before TEXT_CAPS applies. */
+#define CAPS_MIN_LETTERS 8
+/** Percentage of capital letters that makes a message TEXT_CAPS. */
+#define CAPS_PERCENT     75
+
+/** Classify the content of a message in a single pass.
+ * Channel content modes can then test the result instead of scanning
+ * the text again for each property.
+ * @param[in] text Message text.
+ * @return Bitmask of TEXT_* flags describing \a text.
+ */
+unsigned int string_classify(const char* text)
+{
+  const unsigned char *s;
+  unsigned int flags = 0;
+  unsigned int letters = 0;
+  unsigned int upper = 0;
+
+  assert(0 != text);
+  for (s = (const unsigned char *) text; *s; ++s) {
+    if (*s < 0x20) {
+      switch (*s) {
+      case 1:			/* CTCP delimiter */
+        flags |= TEXT_CTCP;
+        break;
+      case 3:			/* mIRC color */
+      case 27:			/* ANSI escape */
+        flags |= TEXT_COLOR;
+        break;
+      case 2:			/* bold */
+      case 15:			/* plain */
+      case 17:			/* monospace */
+      case 22:			/* reverse */
+      case 29:			/* italic */
+      case 30:			/* strikethrough */
+      case 31:			/* underline */
+        flags |= TEXT_FORMAT;
+        break;
+      }
+    } else if (*s & 0x80)
+      flags |= TEXT_HIGHBIT;
+    else if (*s >= 'A' && *s <= 'Z') {
+      letters++;
+      upper++;
+    } else if (*s >= 'a' && *s <= 'z')
+      letters++;
+  }
+
+  /* A leading ACTION may contain anything; it is not another CTCP. */
+  if ((flags & TEXT_CTCP) && !ircd_strncmp(text, "\001ACTION ", 8))
+    flags = (flags & ~TEXT_CTCP) | TEXT_ACTION;
+  if (letters >= CAPS_MIN_LETTERS && upper * 100 >= letters * CAPS_PERCENT)
+    flags |= TEXT_CAPS;
+  return flags;
+}
+
 /** Split a string on certain delimiters.
  * This is a reentrant version of normal strtok().  The first call for
  * a particular input string must use a non-NULL \a str; *save will be
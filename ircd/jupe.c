@@ -47,6 +47,15 @@
 /** List of jupes. */
 static struct Jupe *GlobalJupeList = 0;
 
+/** Free a jupe that reached its expiration time.
+ * @param[in] ex Expired entry of the jupe.
+ */
+static void
+jupe_expire(struct Expiry *ex)
+{
+  jupe_free((struct Jupe *) ex_data(ex));
+}
+
 /** Allocate a new jupe with the given parameters.
  * @param[in] server Server name to jupe.
  * @param[in] reason Reason for jupe.
@@ -76,6 +85,8 @@ make_jupe(char *server, char *reason, time_t expire, time_t lastmod,
     GlobalJupeList->ju_prev_p = &ajupe->ju_next;
   GlobalJupeList = ajupe;
 
+  expiry_add(&ajupe->ju_expiry, jupe_expire, ajupe, expire);
+
   return ajupe;
 }
 
@@ -283,16 +294,10 @@ struct Jupe *
 jupe_find(char *server)
 {
   struct Jupe* jupe;
-  struct Jupe* sjupe;
 
-  for (jupe = GlobalJupeList; jupe; jupe = sjupe) { /* go through jupes */
-    sjupe = jupe->ju_next;
-
-    if (jupe->ju_expire <= CurrentTime) /* expire any that need expiring */
-      jupe_free(jupe);
-    else if (0 == ircd_strcmp(server, jupe->ju_server)) /* found it yet? */
+  for (jupe = GlobalJupeList; jupe; jupe = jupe->ju_next) /* go through jupes */
+    if (0 == ircd_strcmp(server, jupe->ju_server)) /* found it yet? */
       return jupe;
-  }
 
   return 0;
 }
@@ -305,6 +310,8 @@ jupe_free(struct Jupe* jupe)
 {
   assert(0 != jupe);
 
+  expiry_del(&jupe->ju_expiry);
+
   *jupe->ju_prev_p = jupe->ju_next; /* squeeze this jupe out */
   if (jupe->ju_next)
     jupe->ju_next->ju_prev_p = jupe->ju_prev_p;
@@ -321,14 +328,9 @@ void
 jupe_burst(struct Client *cptr)
 {
   struct Jupe *jupe;
-  struct Jupe *sjupe;
 
-  for (jupe = GlobalJupeList; jupe; jupe = sjupe) { /* go through jupes */
-    sjupe = jupe->ju_next;
-
-    if (jupe->ju_expire <= CurrentTime) /* expire any that need expiring */
-      jupe_free(jupe);
-    else if (!JupeIsLocal(jupe)) /* forward global jupes */
+  for (jupe = GlobalJupeList; jupe; jupe = jupe->ju_next) { /* go through jupes */
+    if (!JupeIsLocal(jupe)) /* forward global jupes */
       sendcmdto_one(&me, CMD_JUPE, cptr, "* %c%s %Tu %Tu :%s",
 		    JupeIsRemActive(jupe) ? '+' : '-', jupe->ju_server,
 		    jupe->ju_expire - CurrentTime, jupe->ju_lastmod,
@@ -363,7 +365,6 @@ int
 jupe_list(struct Client *sptr, char *server)
 {
   struct Jupe *jupe;
-  struct Jupe *sjupe;
 
   if (server) {
     if (!(jupe = jupe_find(server))) /* no such jupe */
@@ -374,17 +375,11 @@ jupe_list(struct Client *sptr, char *server)
 	       JupeIsLocal(jupe) ? cli_name(&me) : "*",
 	       JupeIsActive(jupe) ? '+' : '-', jupe->ju_reason);
   } else {
-    for (jupe = GlobalJupeList; jupe; jupe = sjupe) { /* go through jupes */
-      sjupe = jupe->ju_next;
-
-      if (jupe->ju_expire <= CurrentTime) /* expire any that need expiring */
-	jupe_free(jupe);
-      else /* send jupe information along */
-	send_reply(sptr, RPL_JUPELIST, jupe->ju_server,
-		   jupe->ju_expire + TSoffset,
-		   JupeIsLocal(jupe) ? cli_name(&me) : "*",
-		   JupeIsActive(jupe) ? '+' : '-', jupe->ju_reason);
-    }
+    for (jupe = GlobalJupeList; jupe; jupe = jupe->ju_next) /* go through jupes */
+      send_reply(sptr, RPL_JUPELIST, jupe->ju_server,
+		 jupe->ju_expire + TSoffset,
+		 JupeIsLocal(jupe) ? cli_name(&me) : "*",
+		 JupeIsActive(jupe) ? '+' : '-', jupe->ju_reason);
   }
 
   /* end of jupe information */
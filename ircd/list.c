@@ -26,6 +26,7 @@
 #include "client.h"
 #include "ircd.h"
 #include "ircd_alloc.h"
+#include "ircd_crypt.h"
 #include "ircd_events.h"
 #include "ircd_log.h"
 #include "ircd_reply.h"
@@ -42,6 +43,7 @@
 #include "s_user.h"
 #include "send.h"
 #include "struct.h"
+#include "target.h"
 #include "whowas.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
@@ -65,6 +67,13 @@ static struct Connection* connectionFreeList;
 /** Linked list of currently unused SLink structures. */
 static struct SLink* slinkFreeList;
 
+/** Last identity serial number given to a client.  A client gets a
+ * new serial when it is created and whenever its nick, host or
+ * account changes, so (client, serial) pairs can be cached safely
+ * even after the Client structure is reused.
+ */
+unsigned int ClientSerial;
+
 static
 void send_liststats(struct Client *cptr, const struct liststats *lstats,
                     const char *itemname, struct liststats *totals);
@@ -149,30 +158,32 @@ static struct Connection* alloc_connection(void)
   connections.inuse++;
 
   memset(con, 0, sizeof(struct Connection));
-  timer_init(&(con_proc(con)));
 
   return con;
 }
 
 /** Release a Connection and all memory associated with it.
  * The connection's DNS reply field is freed, its file descriptor is
- * closed, its msgq and sendq are cleared, and its associated Listener
- * is dereferenced.  Then it is prepended to #connectionFreeList.
+ * closed, its msgq and sendq are cleared, its recent targets are
+ * freed, and its associated Listener is dereferenced.  Then it is prepended to #connectionFreeList.
  * @param[in] con Connection to free.
  */
 static void dealloc_connection(struct Connection* con)
 {
   assert(con_verify(con));
-  assert(!t_active(&(con_proc(con))));
-  assert(!t_onqueue(&(con_proc(con))));
+  assert(!con_inq_prev_p(con));
 
   Debug((DEBUG_LIST, "Deallocating connection %p", con));
 
   if (-1 < con_fd(con))
     close(con_fd(con));
   MsgQClear(&(con_sendQ(con)));
+  /* close_connection() hands buffers held for zero-copy sends over to
+   * the socket it keeps open for them. */
+  assert(0 == MsgQHeld(&(con_sendQ(con))));
   client_drop_sendq(con);
   DBufClear(&(con_recvQ(con)));
+  target_free(con_targets(con));
   if (con_listener(con))
     release_listener(con_listener(con));
 
@@ -230,6 +241,7 @@ struct Client* make_client(struct Client *from, int status)
   cli_magic(cptr) = CLIENT_MAGIC;
   cli_status(cptr) = status;
   cli_hnext(cptr) = cptr;
+  cli_serial(cptr) = ++ClientSerial;
   strcpy(cli_username(cptr), "");
 
   return cptr;
@@ -273,6 +285,8 @@ void free_client(struct Client* cptr)
 
   if (cli_auth(cptr))
     destroy_auth_request(cli_auth(cptr));
+  if (MyConnect(cptr) && cli_crypt(cptr))
+    ircd_crypt_cancel(cli_crypt(cptr));
 
   /* Make sure we didn't magically get re-added to the list */
   assert(cli_next(cptr) == 0);
@@ -280,15 +294,10 @@ void free_client(struct Client* cptr)
 
   if (cli_from(cptr) == cptr) { /* in other words, we're local */
     cli_from(cptr) = 0;
-    /* timer must be marked as not active */
-    if (!cli_freeflag(cptr) && !t_active(&(cli_proc(cptr))))
+    if (!cli_freeflag(cptr))
       dealloc_connection(cli_connect(cptr)); /* connection not open anymore */
-    else {
-      if (-1 < cli_fd(cptr) && cli_freeflag(cptr) & FREEFLAG_SOCKET)
-	socket_del(&(cli_socket(cptr))); /* queue a socket delete */
-      if (cli_freeflag(cptr) & FREEFLAG_TIMER)
-	timer_del(&(cli_proc(cptr))); /* queue a timer delete */
-    }
+    else if (-1 < cli_fd(cptr) && cli_freeflag(cptr) & FREEFLAG_SOCKET)
+      socket_del(&(cli_socket(cptr))); /* queue a socket delete */
   }
 
   cli_connect(cptr) = 0;
@@ -193,8 +193,6 @@ int ms_destruct(struct Client* cptr, struct Client* sptr, int parc, char* parv[]
   sendcmdto_serv(&me, CMD_DESTRUCT, 0, "%s %Tu", parv[1], chanTS);
 
   /* Remove the empty channel. */
-  if (chptr->destruct_event)
-    remove_destruct_event(chptr);
   destruct_channel(chptr);
 
   return 0;
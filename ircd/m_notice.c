@@ -60,6 +60,8 @@ int m_notice(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
   int             i;
   int             count;
   char*           vector[MAXTARGETS];
+  char*           channels[MAXTARGETS];
+  int             nchannels = 0;
 
   assert(0 != cptr);
   assert(cptr == sptr);
@@ -83,7 +85,7 @@ int m_notice(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
      * channel msg?
      */
     if (IsChannelPrefix(*name)) {
-      relay_channel_notice(sptr, name, parv[parc - 1]);
+      channels[nchannels++] = name;
     }
     /*
      * we have to check for the '@' at least once no matter what we do
@@ -94,6 +96,8 @@ int m_notice(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
     else 
       relay_private_notice(sptr, name, parv[parc - 1]);
   }
+  /* deliver to all the channels at once */
+  relay_channel_notices(sptr, channels, nchannels, parv[parc - 1]);
   return 0;
 }
 
@@ -165,6 +169,8 @@ int mo_notice(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
   int             i;
   int             count;
   char*           vector[MAXTARGETS];
+  char*           channels[MAXTARGETS];
+  int             nchannels = 0;
   assert(0 != cptr);
   assert(cptr == sptr);
 
@@ -187,7 +193,7 @@ int mo_notice(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
      * channel msg?
      */
     if (IsChannelPrefix(*name))
-      relay_channel_notice(sptr, name, parv[parc - 1]);
+      channels[nchannels++] = name;
 
     else if (*name == '$')
       relay_masked_notice(sptr, name, parv[parc - 1]);
@@ -198,5 +204,7 @@ int mo_notice(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
     else 
       relay_private_notice(sptr, name, parv[parc - 1]);
   }
+  /* deliver to all the channels at once */
+  relay_channel_notices(sptr, channels, nchannels, parv[parc - 1]);
   return 0;
 }
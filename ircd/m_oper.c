@@ -46,34 +46,80 @@
 #include <stdlib.h>
 #include <string.h>
 
-/** Check whether an oper password matches.
- * @param[in] to_match The configured password field.
- * @param[in] passwd The user's asserted password.
- * @return Non-zero on match, zero on mismatch.
+/** Pending check of an OPER password. */
+struct OperCheck {
+  struct Client *sptr;	/**< Client trying to become an operator. */
+  char *name;		/**< Operator block name given by the client. */
+  char *passwd;		/**< Password hash the check was made against. */
+};
+
+/** Reject an OPER attempt.
+ * @param[in] sptr Client that tried to oper.
+ * @param[in] numeric Error numeric to send.
  */
-static
-int oper_password_match(const char* to_match, const char* passwd)
+static void oper_fail(struct Client *sptr, int numeric)
 {
-  char *crypted;
-  int res;
-  /*
-   * use first two chars of the password they send in as salt
-   *
-   * passwd may be NULL. Head it off at the pass...
-   */
-  if (!to_match || !passwd)
-    return 0;
-
-  /* we no longer do a CRYPT_OPER_PASSWORD check because a clear 
-     text passwords just handled by a fallback mechanism called 
-     crypt_clear if it's enabled -- hikari */
-  crypted = ircd_crypt(to_match, passwd);
+  send_reply(sptr, numeric);
+  sendto_opmask(0, SNO_OLDREALOP, "Failed OPER attempt by %s (%s@%s)",
+                cli_name(sptr), cli_user(sptr)->username, cli_sockhost(sptr));
+}
 
-  if (!crypted)
-   return 0;
-  res = strcmp(crypted, passwd);
-  MyFree(crypted);
-  return 0 == res;
+/** Finish an OPER attempt once its password has been checked.  The
+ * Operator block is looked up again, since a rehash may have replaced
+ * it while the password was checked.
+ * @param[in] ctx Pending check.
+ * @param[in] match Result of the check, or -1 if it was cancelled.
+ */
+static void oper_check_done(void *ctx, int match)
+{
+  struct OperCheck *check = (struct OperCheck *) ctx;
+  struct Client *sptr = check->sptr;
+  struct ConfItem *aconf;
+
+  if (match >= 0) {
+    cli_crypt(sptr) = 0;
+    aconf = find_conf_exact(check->name, sptr, CONF_OPERATOR);
+    if (IsDead(sptr) || IsAnOper(sptr))
+      ;
+    else if (!aconf || IsIllegal(aconf) || !aconf->passwd
+             || strcmp(aconf->passwd, check->passwd))
+      oper_fail(sptr, ERR_NOOPERHOST);
+    else if (!match)
+      oper_fail(sptr, ERR_PASSWDMISMATCH);
+    else if (ACR_OK != attach_conf(sptr, aconf))
+      oper_fail(sptr, ERR_NOOPERHOST);
+    else {
+      struct Flags old_mode = cli_flags(sptr);
+
+      SetLocOp(sptr);
+      client_set_privs(sptr, aconf, 1);
+      if (HasPriv(sptr, PRIV_PROPAGATE))
+      {
+        ClearLocOp(sptr);
+        SetOper(sptr);
+        ++UserStats.opers;
+      }
+      cli_handler(sptr) = OPER_HANDLER;
+
+      SetFlag(sptr, FLAG_WALLOP);
+      SetFlag(sptr, FLAG_SERVNOTICE);
+      SetFlag(sptr, FLAG_DEBUG);
+
+      set_snomask(sptr, SNO_OPERDEFAULT, SNO_ADD);
+      cli_max_sendq(sptr) = 0; /* Get the sendq from the oper's class */
+      send_umode_out(sptr, sptr, &old_mode, HasPriv(sptr, PRIV_PROPAGATE));
+      send_reply(sptr, RPL_YOUREOPER);
+
+      sendto_opmask(0, SNO_OLDSNO, "%s (%s@%s) is now operator (%c)",
+                    cli_name(sptr), cli_user(sptr)->username,
+                    cli_sockhost(sptr), IsOper(sptr) ? 'O' : 'o');
+
+      log_write(LS_OPER, L_INFO, 0, "OPER (%s) by (%#C)", check->name, sptr);
+    }
+  }
+  MyFree(check->name);
+  MyFree(check->passwd);
+  MyFree(check);
 }
 
 /** Handle an OPER message from a local connection.
@@ -82,6 +128,10 @@ int oper_password_match(const char* to_match, const char* passwd)
  * \li \a parv[1] is the operator identifier string
  * \li \a parv[2] is the password
  *
+ * The password is checked by ircd_crypt_check(), which may hand it to
+ * a worker process; the rest of the command then runs when the check
+ * completes.
+ *
  * See @ref m_functions for discussion of the arguments.
  * @param[in] cptr Client that sent us the message.
  * @param[in] sptr Original source of message.
@@ -91,6 +141,7 @@ int oper_password_match(const char* to_match, const char* passwd)
 int m_oper(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
 {
   struct ConfItem* aconf;
+  struct OperCheck* check;
   char*            name;
   char*            password;
 
@@ -103,57 +154,32 @@ int m_oper(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
   if (EmptyString(name) || EmptyString(password))
     return need_more_params(sptr, "OPER");
 
+  if (cli_crypt(sptr)) { /* still checking an earlier attempt */
+    sendcmdto_one(&me, CMD_NOTICE, sptr, "%C :OPER: An earlier attempt is "
+                  "still being checked; try again when it completes", sptr);
+    return 0;
+  }
+
   aconf = find_conf_exact(name, sptr, CONF_OPERATOR);
   if (!aconf || IsIllegal(aconf))
   {
-    send_reply(sptr, ERR_NOOPERHOST);
-    sendto_opmask(0, SNO_OLDREALOP, "Failed OPER attempt by %s (%s@%s)",
-                  parv[0], cli_user(sptr)->username, cli_sockhost(sptr));
+    oper_fail(sptr, ERR_NOOPERHOST);
     return 0;
   }
   assert(0 != (aconf->status & CONF_OPERATOR));
 
-  if (oper_password_match(password, aconf->passwd))
-  {
-    struct Flags old_mode = cli_flags(sptr);
-
-    if (ACR_OK != attach_conf(sptr, aconf)) {
-      send_reply(sptr, ERR_NOOPERHOST);
-      sendto_opmask(0, SNO_OLDREALOP, "Failed OPER attempt by %s (%s@%s)",
-                    parv[0], cli_user(sptr)->username, cli_sockhost(sptr));
-      return 0;
-    }
-    SetLocOp(sptr);
-    client_set_privs(sptr, aconf, 1);
-    if (HasPriv(sptr, PRIV_PROPAGATE))
-    {
-      ClearLocOp(sptr);
-      SetOper(sptr);
-      ++UserStats.opers;
-    }
-    cli_handler(cptr) = OPER_HANDLER;
-
-    SetFlag(sptr, FLAG_WALLOP);
-    SetFlag(sptr, FLAG_SERVNOTICE);
-    SetFlag(sptr, FLAG_DEBUG);
-    
-    set_snomask(sptr, SNO_OPERDEFAULT, SNO_ADD);
-    cli_max_sendq(sptr) = 0; /* Get the sendq from the oper's class */
-    send_umode_out(cptr, sptr, &old_mode, HasPriv(sptr, PRIV_PROPAGATE));
-    send_reply(sptr, RPL_YOUREOPER);
-
-    sendto_opmask(0, SNO_OLDSNO, "%s (%s@%s) is now operator (%c)",
-                  parv[0], cli_user(sptr)->username, cli_sockhost(sptr),
-                  IsOper(sptr) ? 'O' : 'o');
-
-    log_write(LS_OPER, L_INFO, 0, "OPER (%s) by (%#C)", name, sptr);
-  }
-  else
+  if (!aconf->passwd)
   {
-    send_reply(sptr, ERR_PASSWDMISMATCH);
-    sendto_opmask(0, SNO_OLDREALOP, "Failed OPER attempt by %s (%s@%s)",
-                  parv[0], cli_user(sptr)->username, cli_sockhost(sptr));
+    oper_fail(sptr, ERR_PASSWDMISMATCH);
+    return 0;
   }
+
+  check = (struct OperCheck*) MyMalloc(sizeof(struct OperCheck));
+  check->sptr = sptr;
+  DupString(check->name, name);
+  DupString(check->passwd, aconf->passwd);
+  cli_crypt(sptr) = ircd_crypt_check(password, aconf->passwd,
+                                     oper_check_done, check);
   return 0;
 }
 
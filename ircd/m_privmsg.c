@@ -58,6 +58,8 @@ int m_privmsg(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
   int             i;
   int             count;
   char*           vector[MAXTARGETS];
+  char*           channels[MAXTARGETS];
+  int             nchannels = 0;
 
   assert(0 != cptr);
   assert(cptr == sptr);
@@ -80,7 +82,7 @@ int m_privmsg(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
      * channel msg?
      */
     if (IsChannelPrefix(*name)) {
-      relay_channel_message(sptr, name, parv[parc - 1]);
+      channels[nchannels++] = name;
     }
     /*
      * we have to check for the '@' at least once no matter what we do
@@ -91,6 +93,8 @@ int m_privmsg(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
     else 
       relay_private_message(sptr, name, parv[parc - 1]);
   }
+  /* deliver to all the channels at once */
+  relay_channel_messages(sptr, channels, nchannels, parv[parc - 1]);
   return 0;
 }
 
@@ -162,6 +166,8 @@ int mo_privmsg(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
   int             i;
   int             count;
   char*           vector[MAXTARGETS];
+  char*           channels[MAXTARGETS];
+  int             nchannels = 0;
   assert(0 != cptr);
   assert(cptr == sptr);
   assert(0 != cli_user(sptr));
@@ -183,7 +189,7 @@ int mo_privmsg(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
      * channel msg?
      */
     if (IsChannelPrefix(*name))
-      relay_channel_message(sptr, name, parv[parc - 1]);
+      channels[nchannels++] = name;
 
     else if (*name == '$')
       relay_masked_message(sptr, name, parv[parc - 1]);
@@ -194,5 +200,7 @@ int mo_privmsg(struct Client* cptr, struct Client* sptr, int parc, char* parv[])
     else 
       relay_private_message(sptr, name, parv[parc - 1]);
   }
+  /* deliver to all the channels at once */
+  relay_channel_messages(sptr, channels, nchannels, parv[parc - 1]);
   return 0;
 }
@@ -41,6 +41,7 @@
 #include "numnicks.h"
 #include "s_user.h"
 #include "send.h"
+#include "silence.h"
 #include "struct.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
@@ -262,6 +263,9 @@ forward_silences(struct Client *sptr, char *silences, struct Client *dest)
       free_ban(accepted[ii]);
     }
   }
+
+  /* Recompile the silence list and forget cached results. */
+  silence_update(cli_user(sptr));
 }
 
 /** Handle a SILENCE command from a local user.
@@ -29,7 +29,6 @@
 #include "motd.h"
 #include "class.h"
 #include "client.h"
-#include "fileio.h"
 #include "ircd.h"
 #include "ircd_alloc.h"
 #include "ircd_features.h"
@@ -38,6 +37,7 @@
 #include "ircd_string.h"
 #include "match.h"
 #include "msg.h"
+#include "msgq.h"
 #include "numeric.h"
 #include "numnicks.h"
 #include "s_conf.h"
@@ -48,9 +48,12 @@
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 /** Global list of messages of the day. */
 static struct MotdList_s {
@@ -103,21 +106,162 @@ motd_create(const char *hostmask, const char *path, int maxcount)
   return tmp;
 }
 
-/** This function reads a motd out of a file (if needed) and caches it.
- * If a matching cache entry already exists, reuse it.  Otherwise,
- * allocate and populate a new MotdCache for it.
+/** Release a MotdCache entry's preformatted lines.
+ * @param[in] cache MOTD cache entry.
+ */
+static void
+motd_unload(struct MotdCache *cache)
+{
+  int i;
+
+  if (cache->count < 0) /* never read */
+    return;
+
+  for (i = 0; i <= cache->count; i++) /* release the preformatted lines */
+    msgq_clean(cache->lines[i]);
+  MyFree(cache->lines);
+  cache->lines = 0;
+  cache->count = -1;
+}
+
+/** Remember the identity of a MOTD file, to notice when it changes.
+ * @param[in,out] cache MOTD cache entry.
+ * @param[in] sb Status of the file.
+ */
+static void
+motd_stamp(struct MotdCache *cache, const struct stat *sb)
+{
+  cache->mtime = sb->st_mtime;
+  cache->size = sb->st_size;
+  cache->dev = sb->st_dev;
+  cache->ino = sb->st_ino;
+  cache->modtime = *localtime(&cache->mtime); /* store modtime */
+}
+
+/** Unlink and free a MotdCache entry.
+ * @param[in] cache MOTD cache entry with no references.
+ */
+static void
+motd_free(struct MotdCache *cache)
+{
+  assert(0 == cache->ref);
+
+  if (cache->next) /* delink from list and free */
+    cache->next->prev_p = cache->prev_p;
+  *cache->prev_p = cache->next;
+
+  motd_unload(cache);
+  MyFree(cache->path); /* free path info... */
+  MyFree(cache);
+}
+
+/** Free the MotdCache entries that nothing has used since the previous
+ * rehash.
+ */
+static void
+motd_sweep(void)
+{
+  struct MotdCache *cache, *next;
+
+  for (cache = MotdList.cachelist; cache; cache = next) {
+    next = cache->next;
+    if (!cache->ref)
+      motd_free(cache);
+  }
+}
+
+/** Add one line of text to a MOTD being read.
+ * @param[in,out] cache MOTD cache entry.
+ * @param[in] text Start of line.
+ * @param[in] len Length of line.
+ */
+static void
+motd_addline(struct MotdCache *cache, const char *text, size_t len)
+{
+  char line[MOTD_LINESIZE];
+
+  memcpy(line, text, len);
+  line[len] = '\0';
+  cache->count++;
+  cache->lines[cache->count] = msgq_fit(msgq_make(0, ":- %s", line));
+}
+
+/** Read the text of a MOTD file and preformat its lines.
+ * The file is mapped into memory and split into lines in place, and
+ * each line becomes the shared text of an RPL_MOTD reply.  Lines
+ * longer than MOTD_LINESIZE - 1 characters are split.
+ * @param[in,out] cache MOTD cache entry that has not been read yet.
+ */
+static void
+motd_read(struct MotdCache *cache)
+{
+  struct stat sb;
+  const char *text = 0, *p, *end, *eol;
+  void *map = MAP_FAILED;
+  size_t len;
+  int fd;
+
+  assert(cache->count < 0);
+
+  cache->lines = (struct MsgBuf **)MyMalloc(sizeof(struct MsgBuf *) *
+                                            (cache->maxcount + 1));
+  cache->count = 0;
+
+  if ((fd = open(cache->path, O_RDONLY)) < 0 || fstat(fd, &sb) < 0)
+    log_write(LS_SYSTEM, L_WARNING, 0, "Couldn't open \"%s\": %s",
+              cache->path, strerror(errno));
+  else if (motd_stamp(cache, &sb), sb.st_size > 0) {
+    map = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+      log_write(LS_SYSTEM, L_WARNING, 0, "Couldn't map \"%s\": %s",
+                cache->path, strerror(errno));
+    else
+      text = map;
+  }
+  if (fd >= 0)
+    close(fd);
+
+  cache->lines[0] = msgq_fit(msgq_make(0, ":- %d-%d-%d %d:%02d",
+                                       cache->modtime.tm_year + 1900,
+                                       cache->modtime.tm_mon + 1,
+                                       cache->modtime.tm_mday,
+                                       cache->modtime.tm_hour,
+                                       cache->modtime.tm_min));
+
+  for (p = text, end = text ? text + sb.st_size : 0;
+       p < end && cache->count < cache->maxcount; p = eol + 1) {
+    if (!(eol = memchr(p, '\n', end - p)))
+      eol = end;
+    /* text stops at the first \r, as it always has */
+    for (len = 0; p + len < eol && p[len] != '\r'; len++)
+      ;
+    while (len > MOTD_LINESIZE - 1 && cache->count < cache->maxcount) {
+      motd_addline(cache, p, MOTD_LINESIZE - 1);
+      p += MOTD_LINESIZE - 1;
+      len -= MOTD_LINESIZE - 1;
+    }
+    if (cache->count < cache->maxcount)
+      motd_addline(cache, p, len);
+  }
+
+  if (map != MAP_FAILED)
+    munmap(map, sb.st_size);
+}
+
+/** Find or create the cache entry for a MOTD.
+ * If an entry for the same file and line limit exists, it is reused
+ * unless the file's modification time, size or inode has changed.
+ * Only the file's status is checked here; its text is read the first
+ * time the MOTD is sent.
  * @param[in] motd Specification for MOTD file.
  * @return Matching MotdCache entry.
  */
 static struct MotdCache *
 motd_cache(struct Motd *motd)
 {
-  FBFILE*		file;
   struct MotdCache*	cache;
+  struct MotdCache*	next;
   struct stat		sb;
-  char			line[MOTD_LINESIZE + 2]; /* \r\n */
-  char*			tmp;
-  int			i;
 
   assert(0 != motd);
   assert(0 != motd->path);
@@ -125,72 +269,50 @@ motd_cache(struct Motd *motd)
   if (motd->cache)
     return motd->cache;
 
-  /* try to find it in the list of cached files... */
-  for (cache = MotdList.cachelist; cache; cache = cache->next) {
-    if (!strcmp(cache->path, motd->path) &&
-	cache->maxcount == motd->maxcount) { /* found one... */
-      cache->ref++; /* increase reference count... */
-      motd->cache = cache; /* remember cache... */
-      return motd->cache; /* return it */
-    }
-  }
-
-  /* gotta read in the file, now */
-  if (!(file = fbopen(motd->path, "r"))) {
+  if (stat(motd->path, &sb) < 0) {
     log_write(LS_SYSTEM, L_WARNING, 0, "Couldn't open \"%s\": %s", motd->path,
 	   strerror(errno));
     return 0;
   }
 
-  /* need the file's modification time */
-  if (-1 == fbstat(&sb, file)) {
-    fbclose(file);
-    return 0;
+  /* try to find it in the list of cached files... */
+  for (cache = MotdList.cachelist; cache; cache = next) {
+    next = cache->next;
+    if (strcmp(cache->path, motd->path) || cache->maxcount != motd->maxcount)
+      continue;
+    if (cache->mtime == sb.st_mtime && cache->size == sb.st_size &&
+        cache->dev == sb.st_dev && cache->ino == sb.st_ino) {
+      cache->ref++; /* increase reference count... */
+      motd->cache = cache; /* remember cache... */
+      return motd->cache; /* return it */
+    }
+    if (!cache->ref) /* file has changed; drop the stale copy */
+      motd_free(cache);
   }
 
-  /* Ok, allocate a structure; we'll realloc later to trim memory */
-  cache = (struct MotdCache *)MyMalloc(sizeof(struct MotdCache) +
-				       (MOTD_LINESIZE * (MOTD_MAXLINES - 1)));
+  /* Ok, allocate a structure; the text is read when it is first sent */
+  cache = (struct MotdCache *)MyMalloc(sizeof(struct MotdCache));
 
   cache->ref = 1;
   DupString(cache->path, motd->path);
   cache->maxcount = motd->maxcount;
-
-  cache->modtime = *localtime((time_t *) &sb.st_mtime); /* store modtime */
-
-  cache->count = 0;
-  while (cache->count < cache->maxcount && fbgets(line, sizeof(line), file)) {
-    /* copy over line, stopping when we overflow or hit line end */
-    for (tmp = line, i = 0;
-	 i < (MOTD_LINESIZE - 1) && *tmp && *tmp != '\r' && *tmp != '\n';
-	 tmp++, i++)
-      cache->motd[cache->count][i] = *tmp;
-    cache->motd[cache->count][i] = '\0';
-
-    cache->count++;
-  }
-
-  fbclose(file); /* close the file */
-
-  /* trim memory usage a little */
-  motd->cache = (struct MotdCache*)MyMalloc(sizeof(struct MotdCache) +
-                                            (MOTD_LINESIZE * (cache->count - 1)));
-  memcpy(motd->cache, cache, sizeof(struct MotdCache) +
-         (MOTD_LINESIZE * (cache->count - 1)));
-  MyFree(cache);
+  motd_stamp(cache, &sb);
+  cache->count = -1;
+  cache->lines = 0;
 
   /* now link it in... */
-  motd->cache->next = MotdList.cachelist;
-  motd->cache->prev_p = &MotdList.cachelist;
+  cache->next = MotdList.cachelist;
+  cache->prev_p = &MotdList.cachelist;
   if (MotdList.cachelist)
-    MotdList.cachelist->prev_p = &motd->cache->next;
-  MotdList.cachelist = motd->cache;
+    MotdList.cachelist->prev_p = &cache->next;
+  MotdList.cachelist = cache;
 
-  return motd->cache;
+  return motd->cache = cache;
 }
 
 /** Clear and dereference the Motd::cache element of \a motd.
- * If the MotdCache::ref count goes to zero, free it.
+ * The MotdCache is kept until the next rehash even if its reference
+ * count goes to zero; see motd_sweep().
  * @param[in] motd MOTD to uncache.
  */
 static void
@@ -205,15 +327,8 @@ motd_decache(struct Motd *motd)
 
   motd->cache = 0; /* zero the cache */
 
-  if (!--cache->ref) { /* reduce reference count... */
-    if (cache->next) /* ref is 0, delink from list and free */
-      cache->next->prev_p = cache->prev_p;
-    *cache->prev_p = cache->next;
-
-    MyFree(cache->path); /* free path info... */
-
-    MyFree(cache); /* very simple for a reason... */
-  }
+  assert(0 < cache->ref);
+  cache->ref--; /* reduce reference count... */
 }
 
 /** Deallocate a MOTD structure.
@@ -275,12 +390,15 @@ motd_lookup(struct Client *cptr)
 
 /** Send the content of a MotdCache to a user.
  * If \a cache is NULL, simply send ERR_NOMOTD to the client.
+ * Only the numeric prefix is formatted for the user; the text of each
+ * line is shared with everyone else reading the same MOTD.
  * @param[in] cptr Client to send MOTD to.
  * @param[in] cache MOTD body to send to client.
  */
 static int
 motd_forward(struct Client *cptr, struct MotdCache *cache)
 {
+  struct MsgBuf *head;
   int i;
 
   assert(0 != cptr);
@@ -288,15 +406,17 @@ motd_forward(struct Client *cptr, struct MotdCache *cache)
   if (!cache) /* no motd to send */
     return send_reply(cptr, ERR_NOMOTD);
 
+  if (cache->count < 0) /* first use since the file was cached */
+    motd_read(cache);
+
   /* send the motd */
   send_reply(cptr, RPL_MOTDSTART, cli_name(&me));
-  send_reply(cptr, SND_EXPLICIT | RPL_MOTD, ":- %d-%d-%d %d:%02d",
-	     cache->modtime.tm_year + 1900, cache->modtime.tm_mon + 1,
-	     cache->modtime.tm_mday, cache->modtime.tm_hour,
-	     cache->modtime.tm_min);
 
-  for (i = 0; i < cache->count; i++)
-    send_reply(cptr, RPL_MOTD, cache->motd[i]);
+  head = msgq_make_head(cli_from(cptr), "%:#C %s %C ", &me,
+                        get_error_numeric(RPL_MOTD)->str, cptr);
+  for (i = 0; i <= cache->count; i++)
+    send_buffer_tail(cptr, head, cache->lines[i], 0);
+  msgq_clean(head);
 
   return send_reply(cptr, RPL_ENDOFMOTD); /* end */
 }
@@ -343,13 +463,17 @@ motd_signon(struct Client* cptr)
 }
 
 /** Clear all cached MOTD bodies.
- * The local and remote MOTDs are re-cached immediately.
+ * The local and remote MOTDs are re-cached immediately, and the others
+ * when they are next used.  Files that have not changed are not read
+ * again.
  */
 void
 motd_recache(void)
 {
   struct Motd* tmp;
 
+  motd_sweep(); /* free files unused since the last rehash */
+
   motd_decache(MotdList.local); /* decache local and remote MOTDs */
   motd_decache(MotdList.remote);
 
@@ -418,6 +542,8 @@ motd_clear(void)
 {
   struct Motd *ptr, *next;
 
+  motd_sweep(); /* free files unused since the last rehash */
+
   motd_decache(MotdList.local); /* decache local and remote MOTDs */
   motd_decache(MotdList.remote);
 
@@ -487,7 +613,9 @@ motd_memory_count(struct Client *cptr)
   for (cache = MotdList.cachelist; cache; cache = cache->next)
   {
     mtc++;
-    mtcm += sizeof(struct MotdCache) + (MOTD_LINESIZE * (cache->count - 1));
+    mtcm += sizeof(struct MotdCache) + strlen(cache->path) + 1;
+    if (cache->lines)
+      mtcm += sizeof(struct MsgBuf *) * (cache->maxcount + 1);
   }
 
   if (MotdList.freelist)
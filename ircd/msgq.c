@@ -22,6 +22,7 @@
 #include "config.h"
 
 #include "msgq.h"
+#include "client.h"
 #include "ircd.h"
 #include "ircd_alloc.h"
 #include "ircd_defs.h"
@@ -33,6 +34,7 @@
 #include "send.h"
 #include "s_debug.h"
 #include "s_stats.h"
+#include "struct.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
 #include <stdarg.h>
@@ -61,6 +63,36 @@ struct MsgBuf {
 struct Msg {
   struct Msg *next;		/**< next msg */
   struct MsgBuf *msg;		/**< actual message in queue */
+  struct MsgBuf *tail;		/**< shared rest of the message, or NULL */
+  unsigned int wait;		/**< barriers that must be sent first */
+  unsigned char barrier;	/**< non-zero if this is a barrier */
+  unsigned char droppable;	/**< non-zero if msgq_prune() may drop it */
+};
+
+/** Return the total length of the message in \a m. */
+#define msglength(m)	((m)->msg->length + ((m)->tail ? (m)->tail->length : 0))
+
+/** Number of messages each class may send per turn, indexed by
+ * enum MsgQClass.
+ */
+static const unsigned short msgq_weight[MQ_CLASSES] = { 1, 4, 8 };
+
+/** Position of msgq_mapiov() or msgq_delete() in a message queue. */
+struct MsgQIter {
+  struct Msg *next[MQ_CLASSES];	/**< next message of each class */
+  unsigned int passed;		/**< barriers sent so far */
+  unsigned short cur;		/**< class whose turn it is */
+  unsigned short left;		/**< messages left in \a cur's turn */
+};
+
+/** Buffers referenced by one zero-copy send, kept until the kernel
+ * reports that it is done with them.
+ */
+struct MsgHold {
+  struct MsgHold *next;		/**< next newer hold */
+  unsigned int id;		/**< kernel's sequence number for the send */
+  unsigned int count;		/**< number of buffers in \a bufs */
+  struct MsgBuf *bufs[1];	/**< held buffers (really \a count of them) */
 };
 
 /** Statistics tracking for message sizes. */
@@ -87,6 +119,25 @@ static struct MQData_s {
   struct MsgSizes sizes;	/**< histogram of message sizes */
 } MQData;
 
+/** Release a Msg that has been taken off its queue.
+ * @param[in] m Message to release, along with its buffers.
+ */
+static void
+msgq_freemsg(struct Msg *m)
+{
+  msgq_clean(m->msg); /* free up the struct MsgBuf */
+  m->msg = 0; /* don't let it point anywhere nasty, please */
+  if (m->tail) {
+    msgq_clean(m->tail);
+    m->tail = 0;
+  }
+
+  MQData.msgs.used--; /* struct Msg is not in use anymore */
+
+  m->next = MQData.msgs.free; /* throw it onto the free list */
+  MQData.msgs.free = m;
+}
+
 /*
  * This routine is used to remove a certain amount of data from a given
  * queue and release the Msg (and MsgBuf) structure if needed
@@ -109,26 +160,20 @@ msgq_delmsg(struct MsgQ *mq, struct MsgQList *qlist, unsigned int *length_p)
 
   m = qlist->head; /* find the msg we're deleting from */
 
-  msglen = m->msg->length - qlist->sent; /* calculate how much is left */
+  msglen = msglength(m) - qlist->sent; /* calculate how much is left */
 
   if (*length_p >= msglen) { /* deleted it all? */
     mq->length -= msglen; /* decrement length */
     mq->count--; /* decrement the message count */
     *length_p -= msglen;
 
-    msgq_clean(m->msg); /* free up the struct MsgBuf */
-    m->msg = 0; /* don't let it point anywhere nasty, please */
-
     qlist->sent = 0; /* haven't sent any of the next message */
     if (qlist->head == qlist->tail) /* figure out if we emptied the queue */
       qlist->head = qlist->tail = 0;
     else
       qlist->head = m->next; /* just shift the list down some */
 
-    MQData.msgs.used--; /* struct Msg is not in use anymore */
-
-    m->next = MQData.msgs.free; /* throw it onto the free list */
-    MQData.msgs.free = m;
+    msgq_freemsg(m);
   } else {
     mq->length -= *length_p; /* decrement queue length */
     qlist->sent += *length_p; /* this much of the message has been sent */
@@ -144,12 +189,73 @@ msgq_init(struct MsgQ *mq)
 {
   assert(0 != mq);
 
-  mq->length = 0;
-  mq->count = 0;
-  mq->queue.head = 0;
-  mq->queue.tail = 0;
-  mq->prio.head = 0;
-  mq->prio.tail = 0;
+  memset(mq, 0, sizeof(*mq));
+}
+
+/** Start iterating over the messages of a queue in sending order.
+ * @param[in] mq Message queue.
+ * @param[out] it Iterator to initialize.
+ */
+static void
+msgq_iter_init(const struct MsgQ *mq, struct MsgQIter *it)
+{
+  int i;
+
+  for (i = 0; i < MQ_CLASSES; i++)
+    it->next[i] = mq->list[i].head;
+  it->passed = mq->passed;
+  it->cur = mq->cur;
+  it->left = mq->left;
+}
+
+/** Check whether the next message of a class may be sent.
+ * @param[in] it Iterator.
+ * @param[in] i Class to check.
+ * @return Non-zero if class \a i has a message with no unsent
+ * barrier queued ahead of it.
+ */
+static int
+msgq_iter_ready(const struct MsgQIter *it, int i)
+{
+  return it->next[i] && (int) (it->passed - it->next[i]->wait) >= 0;
+}
+
+/** Choose the class of the next message to send.
+ * The current class keeps sending until its turn is used up; then
+ * the next class, in order of decreasing priority, with a message
+ * ready to go gets a turn of msgq_weight[] messages.
+ * @param[in,out] it Iterator.
+ * @return Class of the next message, or -1 if there is none.
+ */
+static int
+msgq_iter_pick(struct MsgQIter *it)
+{
+  int i, c;
+
+  if (it->left && msgq_iter_ready(it, it->cur))
+    return it->cur;
+  for (i = 1; i <= MQ_CLASSES; i++) {
+    c = (it->cur + MQ_CLASSES - i) % MQ_CLASSES;
+    if (msgq_iter_ready(it, c)) {
+      it->cur = c;
+      it->left = msgq_weight[c];
+      return c;
+    }
+  }
+  return -1;
+}
+
+/** Step an iterator past the message it picked.
+ * @param[in,out] it Iterator.
+ * @param[in] c Class returned by msgq_iter_pick().
+ */
+static void
+msgq_iter_next(struct MsgQIter *it, int c)
+{
+  if (it->next[c]->barrier)
+    it->passed++;
+  it->next[c] = it->next[c]->next;
+  it->left--;
 }
 
 /** Delete bytes from the front of a message queue.
@@ -159,18 +265,226 @@ msgq_init(struct MsgQ *mq)
 void
 msgq_delete(struct MsgQ *mq, unsigned int length)
 {
+  struct MsgQIter it;
+  unsigned int count, barrier;
+  int c;
+
   assert(0 != mq);
 
   while (length > 0) {
-    if (mq->queue.sent > 0) /* partial msg on norm q */
-      msgq_delmsg(mq, &mq->queue, &length);
-    else if (mq->prio.head) /* message (partial or complete) on prio queue */
-      msgq_delmsg(mq, &mq->prio, &length);
-    else if (mq->queue.head) /* message on normal queue */
-      msgq_delmsg(mq, &mq->queue, &length);
-    else
+    msgq_iter_init(mq, &it);
+    if ((c = msgq_iter_pick(&it)) < 0)
       break;
+    mq->cur = it.cur; /* it may be a new class's turn */
+    mq->left = it.left;
+    count = mq->count;
+    barrier = mq->list[c].head->barrier;
+    msgq_delmsg(mq, &mq->list[c], &length);
+    if (mq->count != count) { /* deleted a whole message */
+      mq->left--;
+      if (barrier)
+	mq->passed++;
+    }
+  }
+}
+
+/** Drop the droppable messages from a queue.
+ * A message that has been partly sent is kept, since the rest of it
+ * must still follow, and so are barriers.
+ * @param[in,out] mq Message queue to prune.
+ * @return Number of messages dropped.
+ */
+unsigned int
+msgq_prune(struct MsgQ *mq)
+{
+  struct MsgQList *qlist;
+  struct Msg **mp, *m, *prev;
+  unsigned int dropped = 0;
+  int i;
+
+  assert(0 != mq);
+
+  for (i = 0; i < MQ_CLASSES; i++) {
+    qlist = &mq->list[i];
+    mp = &qlist->head;
+    prev = 0;
+    while ((m = *mp)) {
+      if (!m->droppable || m->barrier || (m == qlist->head && qlist->sent)) {
+        prev = m;
+        mp = &m->next;
+        continue;
+      }
+      *mp = m->next; /* unlink it... */
+      if (qlist->tail == m)
+        qlist->tail = prev;
+      mq->length -= msglength(m);
+      mq->count--;
+      msgq_freemsg(m);
+      dropped++;
+    }
   }
+
+  return dropped;
+}
+
+/** Collect the buffers covering the start of a queue.
+ * @param[in] mq Message queue.
+ * @param[in] length Number of bytes to cover, in sending order.
+ * @param[out] bufs Array to store the buffers in, or NULL to only
+ * count them.
+ * @return Number of buffers.
+ */
+static unsigned int
+msgq_holdbufs(const struct MsgQ *mq, unsigned int length,
+	      struct MsgBuf **bufs)
+{
+  struct MsgQIter it;
+  struct Msg *m;
+  unsigned int n = 0, sent, len;
+  int c;
+
+  msgq_iter_init(mq, &it);
+  while (length > 0 && (c = msgq_iter_pick(&it)) >= 0) {
+    m = it.next[c];
+    /* only the head of the current class can be partly sent */
+    sent = (m == mq->list[c].head) ? mq->list[c].sent : 0;
+    len = 0;
+    if (sent < m->msg->length) {
+      if (bufs)
+	bufs[n] = m->msg;
+      n++;
+      len = m->msg->length - sent;
+    }
+    if (m->tail && length > len) {
+      if (bufs)
+	bufs[n] = m->tail;
+      n++;
+    }
+    len = msglength(m) - sent;
+    length -= (length < len) ? length : len;
+    msgq_iter_next(&it, c);
+  }
+
+  return n;
+}
+
+/** Hold the buffers of data that the kernel is sending without
+ * copying.  The first \a length bytes of \a mq are about to be
+ * deleted, but their buffers must not be reused until msgq_release()
+ * is called with \a id.
+ * @param[in,out] mq Message queue that the data was sent from.
+ * @param[in] length Number of bytes sent.
+ * @param[in] id Kernel's sequence number for the send.
+ */
+void
+msgq_hold(struct MsgQ *mq, unsigned int length, unsigned int id)
+{
+  struct MsgHold *hold;
+  unsigned int i, n;
+
+  assert(0 != mq);
+  assert(length <= mq->length);
+
+  n = msgq_holdbufs(mq, length, 0);
+  hold = (struct MsgHold *)MyMalloc(sizeof(struct MsgHold) +
+				    n * sizeof(struct MsgBuf *));
+  hold->next = 0;
+  hold->id = id;
+  hold->count = msgq_holdbufs(mq, length, hold->bufs);
+  for (i = 0; i < hold->count; i++)
+    hold->bufs[i]->ref++;
+
+  if (mq->hold_tail)
+    mq->hold_tail->next = hold;
+  else
+    mq->hold_head = hold;
+  mq->hold_tail = hold;
+  mq->held++;
+}
+
+/** Release the buffers of completed zero-copy sends.
+ * @param[in,out] mq Message queue the data was sent from.
+ * @param[in] lo First completed sequence number.
+ * @param[in] hi Last completed sequence number; the range may wrap.
+ * @return Number of sends released.
+ */
+unsigned int
+msgq_release(struct MsgQ *mq, unsigned int lo, unsigned int hi)
+{
+  struct MsgHold **hp, *hold;
+  unsigned int i, released = 0;
+
+  assert(0 != mq);
+
+  for (hp = &mq->hold_head; (hold = *hp); ) {
+    if (hold->id - lo > hi - lo) { /* not in the range */
+      mq->hold_tail = hold;
+      hp = &hold->next;
+      continue;
+    }
+    *hp = hold->next;
+    for (i = 0; i < hold->count; i++)
+      msgq_clean(hold->bufs[i]);
+    MyFree(hold);
+    released++;
+  }
+  if (!mq->hold_head)
+    mq->hold_tail = 0;
+  mq->held -= released;
+
+  return released;
+}
+
+/** Move the buffers held for zero-copy sends to another queue, for
+ * instance to keep them after the queue itself is cleared.
+ * @param[out] to Queue to hold the buffers; it must hold none.
+ * @param[in,out] from Queue to take the held buffers from.
+ */
+void
+msgq_move_holds(struct MsgQ *to, struct MsgQ *from)
+{
+  assert(0 != to);
+  assert(0 != from);
+  assert(0 == to->held);
+
+  to->hold_head = from->hold_head;
+  to->hold_tail = from->hold_tail;
+  to->held = from->held;
+  from->hold_head = from->hold_tail = 0;
+  from->held = 0;
+}
+
+/** Map the unsent part of one message to an I/O vector.
+ * @param[in] m Message to map.
+ * @param[in] sent Number of bytes of \a m already sent.
+ * @param[out] iov Output vector.
+ * @param[in] count Number of elements in \a iov (at least one).
+ * @param[out] len Incremented by the number of bytes mapped.
+ * @return Number of elements filled in \a iov.
+ */
+static int
+msgq_mapmsg(const struct Msg *m, unsigned int sent, struct iovec *iov,
+	    int count, unsigned int *len)
+{
+  int i = 0;
+
+  if (sent < m->msg->length) {
+    iov[i].iov_base = m->msg->msg + sent;
+    iov[i].iov_len = m->msg->length - sent;
+    *len += iov[i].iov_len;
+    sent = 0;
+    i++;
+  } else
+    sent -= m->msg->length;
+
+  if (m->tail && i < count) {
+    iov[i].iov_base = m->tail->msg + sent;
+    iov[i].iov_len = m->tail->length - sent;
+    *len += iov[i].iov_len;
+    i++;
+  }
+
+  return i;
 }
 
 /** Map data from a message queue to an I/O vector.
@@ -184,9 +498,10 @@ int
 msgq_mapiov(const struct MsgQ *mq, struct iovec *iov, int count,
 	    unsigned int *len)
 {
-  struct Msg *queue;
-  struct Msg *prio;
+  struct MsgQIter it;
+  struct Msg *m;
   int i = 0;
+  int c;
 
   assert(0 != mq);
   assert(0 != iov);
@@ -196,53 +511,54 @@ msgq_mapiov(const struct MsgQ *mq, struct iovec *iov, int count,
   if (mq->length <= 0) /* no data to map */
     return 0;
 
-  if (mq->queue.sent > 0) { /* partial msg on norm q */
-    iov[i].iov_base = mq->queue.head->msg->msg + mq->queue.sent;
-    iov[i].iov_len = mq->queue.head->msg->length - mq->queue.sent;
-    *len += iov[i].iov_len;
-
-    queue = mq->queue.head->next; /* where we start later... */
-
-    i++; /* filled an iovec... */
-    if (!--count) /* check for space */
-      return i;
-  } else
-    queue = mq->queue.head; /* start at head of queue */
-
-  if (mq->prio.sent > 0) { /* partial msg on prio q */
-    iov[i].iov_base = mq->prio.head->msg->msg + mq->prio.sent;
-    iov[i].iov_len = mq->prio.head->msg->length - mq->prio.sent;
-    *len += iov[i].iov_len;
-
-    prio = mq->prio.head->next; /* where we start later... */
-
-    i++; /* filled an iovec... */
-    if (!--count) /* check for space */
-      return i;
-  } else
-    prio = mq->prio.head; /* start at head of prio */
-
-  for (; prio; prio = prio->next) { /* go through prio queue */
-    iov[i].iov_base = prio->msg->msg; /* store message */
-    iov[i].iov_len = prio->msg->length;
-    *len += iov[i].iov_len;
-
-    i++; /* filled an iovec... */
-    if (!--count) /* check for space */
-      return i;
+  /* Walk the queue in exactly the order msgq_delete() will drop it. */
+  msgq_iter_init(mq, &it);
+  while (i < count && (c = msgq_iter_pick(&it)) >= 0) {
+    m = it.next[c];
+    /* only the head of the current class can be partly sent */
+    i += msgq_mapmsg(m, m == mq->list[c].head ? mq->list[c].sent : 0,
+		     iov + i, count - i, len);
+    msgq_iter_next(&it, c);
   }
 
-  for (; queue; queue = queue->next) { /* go through normal queue */
-    iov[i].iov_base = queue->msg->msg;
-    iov[i].iov_len = queue->msg->length;
-    *len += iov[i].iov_len;
+  return i;
+}
 
-    i++; /* filled an iovec... */
-    if (!--count) /* check for space */
-      return i;
+/** Copy the start of a queue into a contiguous buffer.
+ * The data is copied in the order msgq_mapiov() would map it.
+ * @param[in] mq Message queue to copy from.
+ * @param[out] buf Buffer to copy into.
+ * @param[in] size Number of bytes to copy at most.
+ * @return Number of bytes copied.
+ */
+unsigned int
+msgq_flatten(const struct MsgQ *mq, char *buf, unsigned int size)
+{
+  struct MsgQIter it;
+  struct iovec iov[2];
+  struct Msg *m;
+  unsigned int len = 0, n;
+  int c, i, count;
+
+  assert(0 != mq);
+  assert(0 != buf);
+
+  msgq_iter_init(mq, &it);
+  while (len < size && (c = msgq_iter_pick(&it)) >= 0) {
+    m = it.next[c];
+    n = 0;
+    /* only the head of the current class can be partly sent */
+    count = msgq_mapmsg(m, m == mq->list[c].head ? mq->list[c].sent : 0,
+			iov, 2, &n);
+    for (i = 0; i < count && len < size; i++) {
+      n = (iov[i].iov_len < size - len) ? iov[i].iov_len : size - len;
+      memcpy(buf + len, iov[i].iov_base, n);
+      len += n;
+    }
+    msgq_iter_next(&it, c);
   }
 
-  return i;
+  return len;
 }
 
 /** Allocate a message buffer large enough to hold \a length bytes.
@@ -317,19 +633,16 @@ msgq_clear_freembs(void)
     }
 }
 
-/** Format a message buffer for a client from a format string.
- * @param[in] dest %Client that receives the data (may be NULL).
- * @param[in] format Format string for message.
- * @param[in] vl Argument list for \a format.
- * @return Allocated MsgBuf.
+/** Allocate an empty message buffer of maximum size.
+ * If buffer memory is exhausted, try to recover by flushing or
+ * killing connections before giving up.
+ * @return Allocated MsgBuf, linked into the list of all buffers.
  */
-struct MsgBuf *
-msgq_vmake(struct Client *dest, const char *format, va_list vl)
+static struct MsgBuf *
+msgq_new(void)
 {
   struct MsgBuf *mb;
 
-  assert(0 != format);
-
   if (!(mb = msgq_alloc(0, BUFSIZE))) {
     if (feature_bool(FEAT_HAS_FERGUSON_FLUSHER)) {
       /*
@@ -373,6 +686,55 @@ msgq_vmake(struct Client *dest, const char *format, va_list vl)
   mb->next = MQData.msglist; /* initialize the msgbuf */
   mb->prev_p = &MQData.msglist;
 
+  if (MQData.msglist) /* link it into the list */
+    MQData.msglist->prev_p = &mb->next;
+  MQData.msglist = mb;
+
+  return mb;
+}
+
+/** Format the start of a message for a client from a format string.
+ * Unlike msgq_make(), no \r\n is added; the buffer is meant to be
+ * queued with msgq_add_tail() in front of a shared rest of the line.
+ * @param[in] dest %Client that receives the data (may be NULL).
+ * @param[in] format Format string for message.
+ * @return Allocated MsgBuf.
+ */
+struct MsgBuf *
+msgq_make_head(struct Client *dest, const char *format, ...)
+{
+  struct MsgBuf *mb;
+  va_list vl;
+
+  assert(0 != format);
+
+  mb = msgq_new();
+
+  va_start(vl, format);
+  mb->length = ircd_vsnprintf(dest, mb->msg, bufsize(mb), format, vl);
+  va_end(vl);
+
+  if (mb->length > bufsize(mb) - 1)
+    mb->length = bufsize(mb) - 1;
+
+  return mb;
+}
+
+/** Format a message buffer for a client from a format string.
+ * @param[in] dest %Client that receives the data (may be NULL).
+ * @param[in] format Format string for message.
+ * @param[in] vl Argument list for \a format.
+ * @return Allocated MsgBuf.
+ */
+struct MsgBuf *
+msgq_vmake(struct Client *dest, const char *format, va_list vl)
+{
+  struct MsgBuf *mb;
+
+  assert(0 != format);
+
+  mb = msgq_new();
+
   /* fill the buffer */
   mb->length = ircd_vsnprintf(dest, mb->msg, bufsize(mb) - 1, format, vl);
 
@@ -385,10 +747,6 @@ msgq_vmake(struct Client *dest, const char *format, va_list vl)
 
   assert(mb->length <= bufsize(mb));
 
-  if (MQData.msglist) /* link it into the list */
-    MQData.msglist->prev_p = &mb->next;
-  MQData.msglist = mb;
-
   return mb;
 }
 
@@ -410,6 +768,82 @@ msgq_make(struct Client *dest, const char *format, ...)
   return mb;
 }
 
+/** Append a string to a message, truncating it at \a end.
+ * @param[in] p Current end of the message.
+ * @param[in] end End of the space available for the message.
+ * @param[in] str String to append.
+ * @param[in] len Length of \a str.
+ * @return New end of the message.
+ */
+static char *
+msgq_copy(char *p, const char *end, const char *str, size_t len)
+{
+  if (len > (size_t)(end - p))
+    len = end - p;
+  memcpy(p, str, len);
+  return p + len;
+}
+
+/** Build a message buffer for a text command such as PRIVMSG.
+ * This produces the same buffer as
+ * msgq_make(dest, "%:#C %s %s :%s", from, cmd, target, text), but
+ * copies the parts together instead of going through
+ * ircd_vsnprintf(), and uses the cached prefixes of \a from.
+ * @param[in] dest %Client that receives the data (may be NULL).
+ * @param[in] from %Client that originated the message.
+ * @param[in] cmd Command or token to send.
+ * @param[in] target Target of the command (channel name, nick or numnick).
+ * @param[in] text Text of the message.
+ * @return Allocated MsgBuf.
+ */
+struct MsgBuf *
+msgq_make_text(struct Client *dest, struct Client *from, const char *cmd,
+               const char *target, const char *text)
+{
+  struct MsgBuf *mb;
+  const char *prefix;
+  unsigned int len;
+  char *p, *end;
+
+  assert(0 != from);
+  assert(0 != cmd);
+  assert(0 != target);
+  assert(0 != text);
+
+  mb = msgq_new();
+  p = mb->msg;
+  end = mb->msg + bufsize(mb) - 2; /* leave room for \r\n */
+
+  if (dest && (IsServer(dest) || IsMe(dest))) { /* numeric prefix */
+    prefix = client_numnick(from);
+    p = msgq_copy(p, end, prefix, strlen(prefix));
+  } else {
+    *p++ = ':';
+    if (IsServer(from) || IsMe(from)) {
+      prefix = *cli_name(from) ? cli_name(from) : "*";
+      len = strlen(prefix);
+    } else
+      prefix = client_prefix(from, &len);
+    p = msgq_copy(p, end, prefix, len);
+  }
+
+  p = msgq_copy(p, end, " ", 1);
+  p = msgq_copy(p, end, cmd, strlen(cmd));
+  p = msgq_copy(p, end, " ", 1);
+  p = msgq_copy(p, end, target, strlen(target));
+  p = msgq_copy(p, end, " :", 2);
+  p = msgq_copy(p, end, text, strlen(text));
+
+  *p++ = '\r'; /* add \r\n to buffer */
+  *p++ = '\n';
+  *p = '\0';
+  mb->length = p - mb->msg;
+
+  assert(mb->length <= bufsize(mb));
+
+  return mb;
+}
+
 /** Append text to an existing message buffer.
  * @param[in] dest %Client for whom to format the message.
  * @param[in] mb Message buffer to append to.
@@ -471,37 +905,15 @@ msgq_clean(struct MsgBuf *mb)
   }
 }
 
-/** Append a message to a peer's message queue.
- * @param[in] mq Message queue to append to.
- * @param[in] mb Message to append.
- * @param[in] prio If non-zero, use the high-priority (lag-busting) message list; else use the normal list.
+/** Get the close-fitting buffer a message is queued from.
+ * The first time a MsgBuf is queued, its contents are copied into the
+ * smallest buffer that holds them; later queueings share that copy.
+ * @param[in] mb Message being queued.
+ * @return Real buffer for \a mb, with its reference count incremented.
  */
-void
-msgq_add(struct MsgQ *mq, struct MsgBuf *mb, int prio)
+static struct MsgBuf *
+msgq_real(struct MsgBuf *mb)
 {
-  struct MsgQList *qlist;
-  struct Msg *msg;
-
-  assert(0 != mq);
-  assert(0 != mb);
-  assert(0 < mb->ref);
-  assert(0 < mb->length);
-
-  Debug((DEBUG_SEND, "Adding buffer %p [%.*s] length %u to %s queue", mb,
-	 mb->length - 2, mb->msg, mb->length, prio ? "priority" : "normal"));
-
-  qlist = prio ? &mq->prio : &mq->queue;
-
-  if (!(msg = MQData.msgs.free)) { /* do I need to allocate one? */
-    msg = (struct Msg *)MyMalloc(sizeof(struct Msg));
-    MQData.msgs.alloc++; /* we allocated another */
-  } else /* shift the free list */
-    MQData.msgs.free = MQData.msgs.free->next;
-
-  MQData.msgs.used++; /* we're using another */
-
-  msg->next = 0; /* initialize the msg */
-
   /* Get the real buffer, allocating one if necessary */
   if (!mb->real) {
     struct MsgBuf *tmp;
@@ -532,7 +944,86 @@ msgq_add(struct MsgQ *mq, struct MsgBuf *mb, int prio)
   mb = mb->real; /* work with the real buffer */
   mb->ref++; /* increment the ref count on the buffer */
 
-  msg->msg = mb; /* point at the real message buffer now */
+  return mb;
+}
+
+/** Move a message into the smallest buffer that holds it.
+ * This is meant for messages that are kept around to be queued many
+ * times, so they do not hold on to a full-size buffer.
+ * @param[in] mb Message to move; the caller's reference is released.
+ * @return Close-fitting message, with one reference for the caller.
+ */
+struct MsgBuf *
+msgq_fit(struct MsgBuf *mb)
+{
+  struct MsgBuf *real;
+
+  assert(0 != mb);
+  assert(0 < mb->length);
+
+  real = msgq_real(mb);
+  msgq_clean(mb);
+
+  return real;
+}
+
+/** Append a message to a peer's message queue.
+ * @param[in] mq Message queue to append to.
+ * @param[in] mb Message to append.
+ * @param[in] prio Priority class (enum MsgQClass), possibly ORed with
+ * MQ_BARRIER or MQ_DROPPABLE.
+ */
+void
+msgq_add(struct MsgQ *mq, struct MsgBuf *mb, int prio)
+{
+  msgq_add_tail(mq, mb, 0, prio);
+}
+
+/** Append a message made of two buffers to a peer's message queue.
+ * This lets many clients share the bulk of a message that only
+ * differs in its first few bytes, such as the destination nick.
+ * @param[in] mq Message queue to append to.
+ * @param[in] head Start of the message, usually from msgq_make_head().
+ * @param[in] tail Rest of the message, ending with \r\n (may be NULL).
+ * @param[in] prio Priority class (enum MsgQClass), possibly ORed with
+ * MQ_BARRIER or MQ_DROPPABLE.
+ */
+void
+msgq_add_tail(struct MsgQ *mq, struct MsgBuf *head, struct MsgBuf *tail,
+	      int prio)
+{
+  struct MsgQList *qlist;
+  struct Msg *msg;
+
+  assert(0 != mq);
+  assert(0 != head);
+  assert(0 < head->ref);
+  assert(0 < head->length);
+  assert(0 == tail || 0 < tail->ref);
+  assert(MQ_CLASS(prio) < MQ_CLASSES);
+
+  Debug((DEBUG_SEND, "Adding buffer %p [%.*s] length %u to class %d queue",
+	 head, head->length - (tail ? 0 : 2), head->msg, head->length,
+	 MQ_CLASS(prio)));
+
+  qlist = &mq->list[MQ_CLASS(prio)];
+
+  if (!(msg = MQData.msgs.free)) { /* do I need to allocate one? */
+    msg = (struct Msg *)MyMalloc(sizeof(struct Msg));
+    MQData.msgs.alloc++; /* we allocated another */
+  } else /* shift the free list */
+    MQData.msgs.free = MQData.msgs.free->next;
+
+  MQData.msgs.used++; /* we're using another */
+
+  msg->next = 0; /* initialize the msg */
+  msg->wait = mq->barriers; /* barriers queued ahead of this one */
+  if ((msg->barrier = (prio & MQ_BARRIER) != 0))
+    mq->barriers++;
+  msg->droppable = (prio & MQ_DROPPABLE) != 0;
+
+  msg->msg = msgq_real(head); /* point at the real message buffers now */
+  msg->tail = tail ? msgq_real(tail) : 0;
 
   if (!qlist->head) /* queue list was empty; head and tail point to msg */
     qlist->head = qlist->tail = msg;
@@ -543,7 +1034,7 @@ msgq_add(struct MsgQ *mq, struct MsgBuf *mb, int prio)
     qlist->tail = msg;
   }
 
-  mq->length += mb->length; /* update the queue length */
+  mq->length += msglength(msg); /* update the queue length */
   mq->count++; /* and the queue count */
 }
 
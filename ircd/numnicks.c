@@ -146,8 +146,8 @@ unsigned int base64toint(const char* s)
  * @param[out] buf Output buffer.
  * @param[in] v Value to encode.
  * @param[in] count Number of numnick digits to write to \a buf.
+ * @return \a buf
  */
-static
 const char* inttobase64(char* buf, unsigned int v, unsigned int count)
 {
   buf[count] = '\0';
@@ -73,6 +73,12 @@
 #include <unistd.h>
 #endif
 
+#ifdef MSG_ZEROCOPY
+/* _XOPEN_SOURCE hides the Linux socket options, including SO_ZEROCOPY. */
+#include <asm/socket.h>
+#include <linux/errqueue.h>
+#endif
+
 #if defined(IPV6_BINDV6ONLY) &&!defined(IPV6_V6ONLY)
 # define IPV6_V6ONLY IPV6_BINDV6ONLY
 #endif
@@ -386,6 +392,20 @@ int os_set_tos(int fd,int tos)
 #endif
 }
 
+/** Allow zero-copy sends on a socket.
+ * @param[in] fd %Socket file descriptor to manipulate.
+ * @return Non-zero on success, or zero if it is not supported.
+ */
+int os_set_zerocopy(int fd)
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  unsigned int opt = 1;
+  return (0 == setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)));
+#else
+  return 0;
+#endif
+}
+
 /** Disable IP options on a socket.
  * @param[in] fd %Socket file descriptor to manipulate.
  * @return Non-zero on success, or zero on failure.
@@ -547,10 +567,42 @@ IOResult os_send_nonb(int fd, const char* buf, unsigned int length,
   }
 }
 
+/** Map the start of a message queue for a vectored write.
+ * @param[in] buf Message queue to send from.
+ * @param[out] iov Vector to fill in; it must have IOV_MAX elements.
+ * @param[in,out] count_in On input, the most bytes to map, or 0 for
+ *   no limit; on output, the number of bytes mapped from \a buf.
+ * @return Number of elements of \a iov used.
+ */
+static int os_mapiov(struct MsgQ* buf, struct iovec* iov,
+                     unsigned int* count_in)
+{
+  int res;
+  int count;
+  unsigned int limit;
+
+  limit = *count_in;
+  *count_in = 0;
+  count = msgq_mapiov(buf, iov, IOV_MAX, count_in);
+
+  if (limit && *count_in > limit) { /* trim the vector to the limit */
+    unsigned int len = 0;
+
+    for (res = 0; len + iov[res].iov_len < limit; ++res)
+      len += iov[res].iov_len;
+    iov[res].iov_len = limit - len;
+    count = res + 1;
+    *count_in = limit;
+  }
+
+  return count;
+}
+
 /** Attempt a vectored write on a connected socket.
  * @param[in] fd File descriptor to write to.
  * @param[in] buf Message queue to send from.
- * @param[out] count_in Number of bytes mapped from \a buf.
+ * @param[in,out] count_in On input, the most bytes to write, or 0 for
+ *   no limit; on output, the number of bytes mapped from \a buf.
  * @param[out] count_out Receives number of bytes actually written.
  * @return An IOResult value indicating status.
  */
@@ -565,8 +617,7 @@ IOResult os_sendv_nonb(int fd, struct MsgQ* buf, unsigned int* count_in,
   assert(0 != count_in);
   assert(0 != count_out);
 
-  *count_in = 0;
-  count = msgq_mapiov(buf, iov, IOV_MAX, count_in);
+  count = os_mapiov(buf, iov, count_in);
 
   if (-1 < (res = writev(fd, iov, count))) {
     *count_out = (unsigned) res;
@@ -577,6 +628,132 @@ IOResult os_sendv_nonb(int fd, struct MsgQ* buf, unsigned int* count_in,
   }
 }
 
+/** Attempt a write of many small messages on a connected socket.
+ * This is like os_sendv_nonb(), but copies the start of \a buf into
+ * one contiguous buffer first, which is cheaper than handing the
+ * kernel one iovec per message when the messages are small.
+ * @param[in] fd File descriptor to write to.
+ * @param[in] buf Message queue to send from.
+ * @param[in] size Most bytes to copy; at most 65536.
+ * @param[in,out] count_in On input, the most bytes to write, or 0 for
+ *   no limit; on output, the number of bytes copied from \a buf.
+ * @param[out] count_out Receives number of bytes actually written.
+ * @return An IOResult value indicating status.
+ */
+IOResult os_send_coalesced(int fd, struct MsgQ* buf, unsigned int size,
+                           unsigned int* count_in, unsigned int* count_out)
+{
+  static char flat[65536];
+  int res;
+
+  assert(0 != buf);
+  assert(0 != count_in);
+  assert(0 != count_out);
+
+  if (size > sizeof(flat))
+    size = sizeof(flat);
+  if (*count_in && *count_in < size)
+    size = *count_in;
+  *count_in = msgq_flatten(buf, flat, size);
+
+  if (-1 < (res = send(fd, flat, *count_in, 0))) {
+    *count_out = (unsigned) res;
+    return IO_SUCCESS;
+  } else {
+    *count_out = 0;
+    return is_blocked(errno) ? IO_BLOCKED : IO_FAILURE;
+  }
+}
+
+/** Attempt a zero-copy vectored write on a connected socket.
+ * This is like os_sendv_nonb(), but the kernel may keep referring to
+ * the buffers in \a buf until it reports the send as complete through
+ * os_zerocopy_done().  The socket must have been set up with
+ * os_set_zerocopy().
+ * @param[in] fd File descriptor to write to.
+ * @param[in] buf Message queue to send from.
+ * @param[in,out] count_in On input, the most bytes to write, or 0 for
+ *   no limit; on output, the number of bytes mapped from \a buf.
+ * @param[out] count_out Receives number of bytes actually written.
+ * @return An IOResult value indicating status.
+ */
+IOResult os_sendv_zerocopy(int fd, struct MsgQ* buf, unsigned int* count_in,
+			   unsigned int* count_out)
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  int res;
+  struct msghdr msg;
+  struct iovec iov[IOV_MAX];
+
+  assert(0 != buf);
+  assert(0 != count_in);
+  assert(0 != count_out);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = os_mapiov(buf, iov, count_in);
+
+  if (-1 < (res = sendmsg(fd, &msg, MSG_ZEROCOPY))) {
+    *count_out = (unsigned) res;
+    return IO_SUCCESS;
+  } else {
+    *count_out = 0;
+    return is_blocked(errno) ? IO_BLOCKED : IO_FAILURE;
+  }
+#else
+  return os_sendv_nonb(fd, buf, count_in, count_out);
+#endif
+}
+
+/** Read a zero-copy completion from a socket's error queue.
+ * Each completion covers a range of sends, numbered from zero in the
+ * order os_sendv_zerocopy() wrote them.  Other error queue entries are
+ * skipped.
+ * @param[in] fd File descriptor to read from.
+ * @param[out] lo First completed send.
+ * @param[out] hi Last completed send.
+ * @param[out] copied Set to non-zero if the kernel copied the data
+ *   after all.
+ * @return Non-zero if a completion was read, zero if there are none.
+ */
+int os_zerocopy_done(int fd, unsigned int* lo, unsigned int* hi,
+                     int* copied)
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  struct msghdr msg;
+  struct cmsghdr *cm;
+  struct sock_extended_err *serr;
+  char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+
+  assert(0 != lo);
+  assert(0 != hi);
+  assert(0 != copied);
+
+  for (;;) {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+      return 0;
+
+    for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+        continue;
+      serr = (struct sock_extended_err *) CMSG_DATA(cm);
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      *lo = serr->ee_info;
+      *hi = serr->ee_data;
+      *copied = (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+      return 1;
+    }
+  }
+#else
+  return 0;
+#endif
+}
+
 /** Open a TCP or UDP socket on a particular address.
  * @param[in] local Local address to bind to.
  * @param[in] type SOCK_STREAM or SOCK_DGRAM.
@@ -601,6 +601,8 @@ static int preregister_user(struct Client *cptr)
 {
   static time_t last_too_many1;
   static time_t last_too_many2;
+  static struct SnoAggregate unauth_notices =
+    SNO_AGGREGATE_INIT("unauthorized connections");
 
   ircd_strncpy(cli_user(cptr)->host, cli_sockhost(cptr), HOSTLEN);
   ircd_strncpy(cli_user(cptr)->realhost, cli_sockhost(cptr), HOSTLEN);
@@ -614,8 +616,9 @@ static int preregister_user(struct Client *cptr)
   case ACR_OK:
     break;
   case ACR_NO_AUTHORIZATION:
-    sendto_opmask(0, SNO_UNAUTH, "Unauthorized connection from %s.",
-                  get_client_name(cptr, HIDE_IP));
+    sendto_opmask_aggregate(0, SNO_UNAUTH, &unauth_notices, &cli_ip(cptr),
+                            "Unauthorized connection from %s.",
+                            get_client_name(cptr, HIDE_IP));
     ++ServerStats->is_ref;
     return exit_client(cptr, cptr, &me,
                        "No Authorization - use another server");
@@ -1549,6 +1552,7 @@ static void iauth_write(struct IAuth *iauth)
   if (IAuthHas(iauth, IAUTH_BLOCKED))
     return;
   while (MsgQLength(i_sendQ(iauth)) > 0) {
+    bytes_tried = 0;
     iores = os_sendv_nonb(s_fd(i_socket(iauth)), i_sendQ(iauth), &bytes_tried, &bytes_sent);
     switch (iores) {
     case IO_SUCCESS:
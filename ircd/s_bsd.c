@@ -114,7 +114,28 @@ static const char* const SELECT_ERROR_MSG
 
 
 static void client_sock_callback(struct Event* ev);
-static void client_timer_callback(struct Event* ev);
+static void input_drop(struct Connection* con);
+
+/** Connections with complete messages waiting to be parsed. */
+static struct Connection* input_queue;
+/** Next connection for input_run() to serve. */
+static struct Connection* input_cursor;
+/** Non-zero if a queued connection could parse more right away. */
+static int input_busy;
+
+/** A closed connection's socket, kept open until the kernel has
+ * finished with the buffers of its zero-copy writes.
+ */
+struct ZeroCopyOrphan {
+  struct ZeroCopyOrphan* next;  /**< Next orphaned socket. */
+  int                    fd;    /**< The socket. */
+  struct MsgQ            holds; /**< Buffers still used by the kernel. */
+};
+
+/** Sockets waiting for zero-copy completions. */
+static struct ZeroCopyOrphan* zerocopy_orphans;
+/** Timer to reap #zerocopy_orphans. */
+static struct Timer zerocopy_timer;
 
 
 /*
@@ -283,21 +304,147 @@ static int connect_inet(struct ConfItem* aconf, struct Client* cptr)
   return 1;
 }
 
+/** Fewest queued messages worth coalescing before a write. */
+#define COALESCE_MIN_COUNT 32
+/** Average queued message length below which writes are coalesced. */
+#define COALESCE_MAX_AVG   128
+
+/** Write queued data to a client by copying it into the kernel.
+ * Backlogs of short messages are first coalesced into one buffer;
+ * that costs a copy, but is cheaper than one iovec per message.
+ * @param cptr Client to write to.
+ * @param buf Message queue to send from.
+ * @param count_in Most bytes to write, or 0; receives bytes mapped.
+ * @param count_out Receives number of bytes written.
+ * @return An IOResult value indicating status.
+ */
+static IOResult deliver_copy(struct Client *cptr, struct MsgQ *buf,
+                             unsigned int *count_in, unsigned int *count_out)
+{
+  unsigned int size = feature_uint(FEAT_SEND_COALESCE);
+
+  if (size && MsgQCount(buf) >= COALESCE_MIN_COUNT
+      && MsgQLength(buf) / MsgQCount(buf) < COALESCE_MAX_AVG)
+    return os_send_coalesced(cli_fd(cptr), buf, (size < 16384) ? 16384 : size,
+                             count_in, count_out);
+  return os_sendv_nonb(cli_fd(cptr), buf, count_in, count_out);
+}
+
+/** Release the buffers of zero-copy writes that the kernel has
+ * finished sending to a client.
+ * @param cptr Client with zero-copy writes in flight.
+ */
+static void zerocopy_reap(struct Client *cptr)
+{
+  unsigned int lo, hi;
+  int copied;
+
+  while (os_zerocopy_done(cli_fd(cptr), &lo, &hi, &copied)) {
+    msgq_release(&(cli_sendQ(cptr)), lo, hi);
+    if (copied)
+      cli_zc_copied(cptr) += hi - lo + 1;
+  }
+}
+
+/** Reap completions for orphaned zero-copy sockets, and close those
+ * whose buffers have all been released.
+ * @param ev Timer event.
+ */
+static void zerocopy_orphan_reap(struct Event* ev)
+{
+  struct ZeroCopyOrphan** pp;
+  struct ZeroCopyOrphan* orphan;
+  unsigned int lo, hi;
+  int copied;
+
+  if (ev_type(ev) != ET_EXPIRE)
+    return;
+
+  for (pp = &zerocopy_orphans; (orphan = *pp); ) {
+    while (os_zerocopy_done(orphan->fd, &lo, &hi, &copied))
+      msgq_release(&orphan->holds, lo, hi);
+    if (MsgQHeld(&orphan->holds)) {
+      pp = &orphan->next;
+      continue;
+    }
+    *pp = orphan->next;
+    close(orphan->fd);
+    MyFree(orphan);
+  }
+
+  if (!zerocopy_orphans)
+    timer_del(&zerocopy_timer);
+}
+
+/** Close a client's socket.  If the kernel may still be sending from
+ * the buffers of zero-copy writes, the buffers must not be reused
+ * until it says it is done, and it can only say so on an open socket.
+ * The socket is then shut down and kept open, along with the buffers,
+ * until all completions have arrived.
+ * @param cptr Client whose socket to close.
+ */
+static void zerocopy_close(struct Client *cptr)
+{
+  struct ZeroCopyOrphan* orphan;
+
+  if (MsgQHeld(&(cli_sendQ(cptr))))
+    zerocopy_reap(cptr);
+  if (!MsgQHeld(&(cli_sendQ(cptr)))) {
+    close(cli_fd(cptr));
+    return;
+  }
+
+  shutdown(cli_fd(cptr), SHUT_RDWR);
+  orphan = (struct ZeroCopyOrphan*) MyMalloc(sizeof(struct ZeroCopyOrphan));
+  orphan->fd = cli_fd(cptr);
+  msgq_init(&orphan->holds);
+  msgq_move_holds(&orphan->holds, &(cli_sendQ(cptr)));
+  orphan->next = zerocopy_orphans;
+  zerocopy_orphans = orphan;
+  if (!t_active(&zerocopy_timer))
+    timer_add(timer_init(&zerocopy_timer), zerocopy_orphan_reap, 0,
+              TT_PERIODIC, 1);
+}
+
 /** Attempt to send a sequence of bytes to the connection.
  * As a side effect, updates \a cptr's FLAG_BLOCKED setting
  * and sendB/sendK fields.
+ * Large writes to connections with FLAG_ZEROCOPY are sent without
+ * copying, and their buffers are held until the kernel is done.
  * @param cptr Client that should receive data.
  * @param buf Message buffer to send to client.
+ * @param limit Most bytes to send, or 0 for no limit.
  * @return Negative on connection-fatal error; otherwise
  *  number of bytes sent.
  */
-unsigned int deliver_it(struct Client *cptr, struct MsgQ *buf)
+unsigned int deliver_it(struct Client *cptr, struct MsgQ *buf,
+                        unsigned int limit)
 {
   unsigned int bytes_written = 0;
-  unsigned int bytes_count = 0;
+  unsigned int bytes_count = limit;
+  unsigned int length;
+  IOResult result;
   assert(0 != cptr);
 
-  switch (os_sendv_nonb(cli_fd(cptr), buf, &bytes_count, &bytes_written)) {
+  length = (limit && limit < MsgQLength(buf)) ? limit : MsgQLength(buf);
+  if (!IsZeroCopy(cptr))
+    result = deliver_copy(cptr, buf, &bytes_count, &bytes_written);
+  else if (!feature_bool(FEAT_SERVER_ZEROCOPY)
+           || length < feature_uint(FEAT_ZEROCOPY_MIN)) {
+    result = deliver_copy(cptr, buf, &bytes_count, &bytes_written);
+    cli_zc_small(cptr)++;
+  } else {
+    if (MsgQHeld(buf))
+      zerocopy_reap(cptr);
+    result = os_sendv_zerocopy(cli_fd(cptr), buf, &bytes_count,
+                               &bytes_written);
+    if (bytes_written) {
+      msgq_hold(buf, bytes_written, cli_zc_next(cptr)++);
+      cli_zc_sends(cptr)++;
+    }
+  }
+
+  switch (result) {
   case IO_SUCCESS:
     ClrFlag(cptr, FLAG_BLOCKED);
 
@@ -426,10 +573,13 @@ void close_connection(struct Client *cptr)
   else
     ServerStats->is_ni++;
 
+  /* Must happen while the socket is open; see sno_subscribe(). */
+  set_snomask(cptr, 0, SNO_SET);
+
   if (-1 < cli_fd(cptr)) {
     flush_connections(cptr);
     LocalClientArray[cli_fd(cptr)] = 0;
-    close(cli_fd(cptr));
+    zerocopy_close(cptr);
     socket_del(&(cli_socket(cptr))); /* queue a socket delete */
     cli_fd(cptr) = -1;
     cli_freeflag(cptr) &= ~FREEFLAG_SOCKET;
@@ -438,9 +588,9 @@ void close_connection(struct Client *cptr)
 
   MsgQClear(&(cli_sendQ(cptr)));
   client_drop_sendq(cli_connect(cptr));
+  input_drop(cli_connect(cptr));
   DBufClear(&(cli_recvQ(cptr)));
   memset(cli_passwd(cptr), 0, sizeof(cli_passwd(cptr)));
-  set_snomask(cptr, 0, SNO_SET);
 
   det_confs_butmask(cptr, 0);
 
@@ -580,30 +730,205 @@ void update_write(struct Client* cptr)
 {
   /* If there are messages that need to be sent along, or if the client
    * is in the middle of a /list, then we need to tell the engine that
-   * we're interested in writable events--otherwise, we need to drop
-   * that interest.
+   * we're interested in writable events--otherwise, or while output is
+   * held back by the class send rate, we need to drop that interest.
    */
   socket_events(&(cli_socket(cptr)),
-		((MsgQLength(&cli_sendQ(cptr)) || cli_listing(cptr)) ?
+		((!IsShaped(cptr) &&
+		  (MsgQLength(&cli_sendQ(cptr)) || cli_listing(cptr))) ?
 		 SOCK_ACTION_ADD : SOCK_ACTION_DEL) | SOCK_EVENT_WRITABLE);
 }
 
+/** Add a connection to the input queue.
+ * @param[in] con Connection with complete messages left to parse.
+ */
+static void input_add(struct Connection* con)
+{
+  if (!con_inq_prev_p(con)) { /* not waiting yet... */
+    con_inq_prev_p(con) = &input_queue;
+    con_inq_next(con) = input_queue;
+
+    if (input_queue)
+      con_inq_prev_p(input_queue) = &(con_inq_next(con));
+    input_queue = con;
+  }
+}
+
+/** Remove a connection from the input queue.
+ * @param[in] con Connection with nothing left to parse.
+ */
+static void input_drop(struct Connection* con)
+{
+  if (con_inq_prev_p(con)) { /* on the input queue... */
+    if (input_cursor == con)
+      input_cursor = con_inq_next(con);
+    if (con_inq_next(con))
+      con_inq_prev_p(con_inq_next(con)) = con_inq_prev_p(con);
+    *(con_inq_prev_p(con)) = con_inq_next(con);
+
+    con_inq_next(con) = 0;
+    con_inq_prev_p(con) = 0;
+  }
+  con_deficit(con) = 0;
+}
+
+/** Return the number of input bytes a client may parse per turn. */
+static int input_quantum(void)
+{
+  unsigned int quantum = feature_uint(FEAT_INPUT_QUANTUM);
+
+  return quantum < 16 ? 16 : (quantum > BUFSIZE * 16 ? BUFSIZE * 16 : quantum);
+}
+
+/** Parse complete messages from a client's receive queue.
+ * Parsing stops when the client has used up its deficit for this
+ * turn or when the flood limits hold back its next message.  In
+ * either case the client is left on the input queue so input_run()
+ * can continue later.
+ * @param[in] cptr Client whose messages to parse.
+ * @return Positive number on success, CPTR_KILLED if the client was
+ *   killed.
+ */
+static int process_input(struct Client *cptr)
+{
+  struct Connection *con = cli_connect(cptr);
+  unsigned int dolen = 0;
+  int blocked = 0;
+  int allow;
+
+  while (DBufLength(&(cli_recvQ(cptr))) && !NoNewLine(cptr) &&
+         con_deficit(con) > 0)
+  {
+    /* A class message rate replaces the default flood limit. */
+    if (!IsTrusted(cptr)) {
+      if ((allow = class_msg_take(cptr)) < 0)
+        allow = cli_since(cptr) - CurrentTime < 10;
+      if (!allow) {
+        blocked = 1;
+        break;
+      }
+    }
+    dolen = dbuf_getmsg(&(cli_recvQ(cptr)), cli_buffer(cptr), BUFSIZE);
+    con_deficit(con) -= dolen ? dolen : 1;
+    /*
+     * Devious looking...whats it do ? well..if a client
+     * sends a *long* message without any CR or LF, then
+     * dbuf_getmsg fails and we pull it out using this
+     * loop which just gets the next 512 bytes and then
+     * deletes the rest of the buffer contents.
+     * -avalon
+     */
+    if (dolen == 0)
+    {
+      if (DBufLength(&(cli_recvQ(cptr))) < 510)
+        SetFlag(cptr, FLAG_NONL);
+      else
+      {
+        /* More than 512 bytes in the line - drop the input and yell
+         * at the client.
+         */
+        DBufClear(&(cli_recvQ(cptr)));
+        send_reply(cptr, ERR_INPUTTOOLONG);
+      }
+    }
+    else if (client_dopacket(cptr, dolen) == CPTR_KILLED)
+      return CPTR_KILLED;
+    /*
+     * If it has become registered as a Server
+     * then skip the per-message parsing below.
+     */
+    if (IsHandshake(cptr) || IsServer(cptr))
+    {
+      input_drop(con);
+      while (-1)
+      {
+        dolen = dbuf_get(&(cli_recvQ(cptr)), readbuf, sizeof(readbuf));
+        if (dolen <= 0)
+          return 1;
+        else if (dolen == 0)
+        {
+          if (DBufLength(&(cli_recvQ(cptr))) < 510)
+            SetFlag(cptr, FLAG_NONL);
+          else
+            DBufClear(&(cli_recvQ(cptr)));
+        }
+        else if ((IsServer(cptr) &&
+                  server_dopacket(cptr, readbuf, dolen) == CPTR_KILLED) ||
+                 (!IsServer(cptr) &&
+                  connect_dopacket(cptr, readbuf, dolen) == CPTR_KILLED))
+          return CPTR_KILLED;
+      }
+    }
+  }
+
+  /* If there's still data to process, wait for the next turn.  A
+   * client held back by the flood limits starts that turn afresh.
+   */
+  if (DBufLength(&(cli_recvQ(cptr))) && !NoNewLine(cptr)) {
+    if (blocked)
+      con_deficit(con) = 0;
+    else
+      input_busy = 1;
+    input_add(con);
+  } else
+    input_drop(con);
+  return 1;
+}
+
+/** Give each client on the input queue one turn at parsing its
+ * waiting messages.  This is deficit round robin: every turn adds
+ * INPUT_QUANTUM bytes to a client's deficit, and each message parsed
+ * takes its length away, so clients sending long messages cannot
+ * crowd out those sending short ones.
+ */
+void input_run(void)
+{
+  struct Connection *con;
+  int quantum = input_quantum();
+
+  input_busy = 0;
+  for (input_cursor = input_queue; (con = input_cursor); ) {
+    input_cursor = con_inq_next(con);
+    assert(0 != con_client(con));
+    con_deficit(con) += quantum;
+    process_input(con_client(con));
+  }
+}
+
+/** Calculate how long the event engine may sleep.
+ * Clients that could parse more right away need the engine to return
+ * at once; clients held back by the flood limits need it to return as
+ * soon as the clock reaches the next second.
+ * @param[in] wait Milliseconds until the next timer, or -1 for none.
+ * @return Milliseconds to sleep, or -1 to wait indefinitely.
+ */
+int input_delay(int wait)
+{
+  struct timeval tv;
+  int delay;
+
+  if (!input_queue)
+    return wait;
+  if (input_busy)
+    return 0;
+  gettimeofday(&tv, 0);
+  delay = 1000 - tv.tv_usec / 1000;
+  return (wait < 0 || delay < wait) ? delay : wait;
+}
+
 /** Read a 'packet' of data from a connection and process it.  Read in
  * 8k chunks to give a better performance rating (for server
  * connections).  Do some tricky stuff for client connections to make
  * sure they don't do any flooding >:-) -avalon
  * @param cptr Client from which to read data.
- * @param socket_ready If non-zero, more data can be read from the client's socket.
  * @return Positive number on success, zero on connection-fatal failure, negative
  *   if user is killed.
  */
-static int read_packet(struct Client *cptr, int socket_ready)
+static int read_packet(struct Client *cptr)
 {
-  unsigned int dolen = 0;
   unsigned int length = 0;
 
-  if (socket_ready &&
-      !(IsUser(cptr) &&
+  if (!(IsUser(cptr) &&
 	DBufLength(&(cli_recvQ(cptr))) > feature_uint(FEAT_CLIENT_FLOOD))) {
     switch (os_recv_nonb(cli_fd(cptr), readbuf, sizeof(readbuf), &length)) {
     case IO_SUCCESS:
@@ -646,71 +971,14 @@ static int read_packet(struct Client *cptr, int socket_ready)
     if (DBufLength(&(cli_recvQ(cptr))) > feature_uint(FEAT_CLIENT_FLOOD))
       return exit_client(cptr, cptr, &me, "Excess Flood");
 
-    while (DBufLength(&(cli_recvQ(cptr))) && !NoNewLine(cptr) && 
-           (IsTrusted(cptr) || cli_since(cptr) - CurrentTime < 10))
-    {
-      dolen = dbuf_getmsg(&(cli_recvQ(cptr)), cli_buffer(cptr), BUFSIZE);
-      /*
-       * Devious looking...whats it do ? well..if a client
-       * sends a *long* message without any CR or LF, then
-       * dbuf_getmsg fails and we pull it out using this
-       * loop which just gets the next 512 bytes and then
-       * deletes the rest of the buffer contents.
-       * -avalon
-       */
-      if (dolen == 0)
-      {
-        if (DBufLength(&(cli_recvQ(cptr))) < 510)
-          SetFlag(cptr, FLAG_NONL);
-        else
-        {
-          /* More than 512 bytes in the line - drop the input and yell
-           * at the client.
-           */
-          DBufClear(&(cli_recvQ(cptr)));
-          send_reply(cptr, ERR_INPUTTOOLONG);
-        }
-      }
-      else if (client_dopacket(cptr, dolen) == CPTR_KILLED)
-        return CPTR_KILLED;
-      /*
-       * If it has become registered as a Server
-       * then skip the per-message parsing below.
-       */
-      if (IsHandshake(cptr) || IsServer(cptr))
-      {
-        while (-1)
-        {
-          dolen = dbuf_get(&(cli_recvQ(cptr)), readbuf, sizeof(readbuf));
-          if (dolen <= 0)
-            return 1;
-          else if (dolen == 0)
-          {
-            if (DBufLength(&(cli_recvQ(cptr))) < 510)
-              SetFlag(cptr, FLAG_NONL);
-            else
-              DBufClear(&(cli_recvQ(cptr)));
-          }
-          else if ((IsServer(cptr) &&
-                    server_dopacket(cptr, readbuf, dolen) == CPTR_KILLED) ||
-                   (!IsServer(cptr) &&
-                    connect_dopacket(cptr, readbuf, dolen) == CPTR_KILLED))
-            return CPTR_KILLED;
-        }
-      }
-    }
-
-    /* If there's still data to process, wait 2 seconds first */
-    if (DBufLength(&(cli_recvQ(cptr))) && !NoNewLine(cptr) &&
-	!t_onqueue(&(cli_proc(cptr))))
-    {
-      Debug((DEBUG_LIST, "Adding client process timer for %C", cptr));
-      cli_freeflag(cptr) |= FREEFLAG_TIMER;
-      timer_add(&(cli_proc(cptr)), client_timer_callback, cli_connect(cptr),
-		TT_RELATIVE, 2);
-    }
+    /* A client that is already waiting keeps its place in line;
+     * anyone else gets a turn straight away.
+     */
+    if (con_inq_prev_p(cli_connect(cptr)))
+      return 1;
+    con_deficit(cli_connect(cptr)) = input_quantum();
+    return process_input(cptr);
   }
-  return 1;
 }
 
 /** Start a connection to another server.
@@ -888,6 +1156,10 @@ static void client_sock_callback(struct Event* ev)
     break;
 
   case ET_ERROR: /* an error occurred */
+    if (!ev_data(ev)) { /* only the error queue has something for us */
+      zerocopy_reap(cptr);
+      break;
+    }
     fallback = cli_info(cptr);
     cli_error(cptr) = ev_data(ev);
     /* If the OS told us we have a bad file descriptor, we should
@@ -928,9 +1200,12 @@ static void client_sock_callback(struct Event* ev)
     break;
 
   case ET_READ: /* socket is readable */
+    /* select() reports zero-copy completions as readable */
+    if (MsgQHeld(&(cli_sendQ(cptr))))
+      zerocopy_reap(cptr);
     if (!IsDead(cptr)) {
       Debug((DEBUG_DEBUG, "Reading data from %C", cptr));
-      if (read_packet(cptr, 1) == 0) /* error while reading packet */
+      if (read_packet(cptr) == 0) /* error while reading packet */
 	fallback = "EOF from client";
     }
     break;
@@ -949,38 +1224,3 @@ static void client_sock_callback(struct Event* ev)
     exit_client_msg(cptr, cptr, &me, fmt, msg);
   }
 }
-
-/** Process a timer on client socket.
- * @param ev Timer event that has a struct Connection as its
- * associated data.
- */
-static void client_timer_callback(struct Event* ev)
-{
-  struct Client* cptr;
-  struct Connection* con;
-
-  assert(0 != ev_timer(ev));
-  assert(0 != t_data(ev_timer(ev)));
-  assert(ET_DESTROY == ev_type(ev) || ET_EXPIRE == ev_type(ev));
-
-  con = (struct Connection*) t_data(ev_timer(ev));
-
-  assert(0 != con_client(con) || ev_type(ev) == ET_DESTROY);
-
-  cptr = con_client(con);
-
-  assert(0 == cptr || con == cli_connect(cptr));
-
-  if (ev_type(ev)== ET_DESTROY) {
-    con_freeflag(con) &= ~FREEFLAG_TIMER; /* timer has expired... */
-
-    if (!con_freeflag(con) && !cptr)
-      free_connection(con); /* client is being destroyed */
-  } else {
-    Debug((DEBUG_LIST, "Client process timer for %C expired; processing",
-	   cptr));
-    read_packet(cptr, 0); /* read_packet will re-add timer if needed */
-  }
-
-  assert(0 == cptr || 0 == cli_connect(cptr) || con == cli_connect(cptr));
-}
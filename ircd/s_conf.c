@@ -34,7 +34,9 @@
 #include "ircd.h"
 #include "ircd_alloc.h"
 #include "ircd_chattr.h"
+#include "ircd_events.h"
 #include "ircd_log.h"
+#include "ircd_osdep.h"
 #include "ircd_reply.h"
 #include "ircd_snprintf.h"
 #include "ircd_string.h"
@@ -87,6 +89,10 @@ struct DenyConf*   denyConfList;
 
 static
 int read_configuration_file(void);
+static int conf_apply(struct Client *cptr, int sig, const char *records,
+                      size_t length);
+static int deny_match(const struct DenyConf *deny, struct Client *cptr);
+static int deny_notify(const struct DenyConf *deny, struct Client *cptr);
 
 /** Tell a user that they are banned, dumping the message from a file.
  * @param sptr Client being rejected
@@ -245,7 +251,7 @@ static void conf_dns_callback(void* vptr, const struct irc_in_addr *addr, const
  */
 static void conf_dns_lookup(struct ConfItem* aconf)
 {
-  if (!aconf->dns_pending) {
+  if (!aconf->dns_pending && !conf_checking) {
     char            buf[HOSTLEN + 1];
 
     host_from_uh(buf, aconf->host, HOSTLEN);
@@ -764,11 +770,12 @@ const struct CRuleConf* conf_get_crule_list(void)
   return cruleConfList;
 }
 
-/** Free all deny rules from #denyConfList. */
-static void conf_erase_deny_list(void)
+/** Free a list of deny rules.
+ * @param[in] p First rule of the list.
+ */
+static void conf_free_deny_list(struct DenyConf* p)
 {
   struct DenyConf* next;
-  struct DenyConf* p = denyConfList;
   for ( ; p; p = next) {
     next = p->next;
     MyFree(p->hostmask);
@@ -777,7 +784,117 @@ static void conf_erase_deny_list(void)
     MyFree(p->realmask);
     MyFree(p);
   }
-  denyConfList = 0;
+}
+
+/** Compare two optional strings.
+ * @param[in] a First string (may be NULL).
+ * @param[in] b Second string (may be NULL).
+ * @return Non-zero if both are NULL or both are equal strings.
+ */
+static int conf_str_equal(const char* a, const char* b)
+{
+  return (a && b) ? !strcmp(a, b) : (a == b);
+}
+
+/** Hash an optional string into \a hash.
+ * @param[in] hash Hash value so far.
+ * @param[in] str String to add (may be NULL).
+ * @return Updated hash value.
+ */
+static unsigned int conf_str_hash(unsigned int hash, const char* str)
+{
+  if (str)
+    while (*str)
+      hash = (hash ^ (unsigned char) *str++) * 16777619U;
+  return (hash ^ 0xff) * 16777619U;
+}
+
+/** Calculate a hash over the fields of a deny rule that select clients.
+ * @param[in] deny Deny rule.
+ * @return Hash value.
+ */
+static unsigned int deny_hash(const struct DenyConf* deny)
+{
+  unsigned int hash = 2166136261U;
+
+  hash = conf_str_hash(hash, deny->usermask);
+  hash = conf_str_hash(hash, deny->realmask);
+  if (deny->bits > 0) {
+    const unsigned char* addr = (const unsigned char*) &deny->address;
+    size_t i;
+
+    for (i = 0; i < sizeof(deny->address); i++)
+      hash = (hash ^ addr[i]) * 16777619U;
+    hash = (hash ^ deny->bits) * 16777619U;
+  } else
+    hash = conf_str_hash(hash, deny->hostmask);
+  return hash;
+}
+
+/** Check whether two deny rules select the same clients.
+ * @param[in] a First deny rule.
+ * @param[in] b Second deny rule.
+ * @return Non-zero if the rules are equivalent for find_kill().
+ */
+static int deny_equal(const struct DenyConf* a, const struct DenyConf* b)
+{
+  if (a->bits != b->bits
+      || !conf_str_equal(a->usermask, b->usermask)
+      || !conf_str_equal(a->realmask, b->realmask))
+    return 0;
+  if (a->bits > 0)
+    return !memcmp(&a->address, &b->address, sizeof(a->address));
+  return conf_str_equal(a->hostmask, b->hostmask);
+}
+
+/** Find the rules in #denyConfList that were not in the old list.
+ * Only those rules can match clients that are already connected.
+ * Client, Connect, Operator and most other blocks are not diffed, but
+ * reloaded as a whole.
+ * @param[in] old Deny list from before the rehash.
+ * @param[out] added Receives a newly allocated array of the new rules,
+ * or NULL if there are none.
+ * @return Number of elements in \a added.
+ */
+static unsigned int conf_diff_deny_list(const struct DenyConf* old,
+                                        const struct DenyConf*** added)
+{
+  const struct DenyConf** table;
+  const struct DenyConf* deny;
+  unsigned int size = 16, count = 0, n = 0, i;
+
+  *added = 0;
+  for (deny = old; deny; deny = deny->next)
+    count++;
+  while (size < 2 * count)
+    size <<= 1;
+
+  /* Put the old rules in an open-addressed hash table. */
+  table = (const struct DenyConf**) MyCalloc(size, sizeof(*table));
+  for (deny = old; deny; deny = deny->next) {
+    for (i = deny_hash(deny) & (size - 1); table[i]; i = (i + 1) & (size - 1))
+      ;
+    table[i] = deny;
+  }
+
+  for (deny = denyConfList; deny; deny = deny->next) {
+    for (i = deny_hash(deny) & (size - 1); table[i]; i = (i + 1) & (size - 1))
+      if (deny_equal(deny, table[i]))
+        break;
+    if (table[i])
+      continue;
+    if (!*added) {
+      const struct DenyConf* p;
+
+      for (count = 0, p = deny; p; p = p->next)
+        count++;
+      *added = (const struct DenyConf**) MyMalloc(count * sizeof(**added));
+    }
+    (*added)[n++] = deny;
+  }
+
+  MyFree(table);
+  return n;
 }
 
 /** Return #denyConfList.
@@ -861,6 +978,10 @@ static void webirc_remove_stale(void)
 
 /** When non-zero, indicates that a configuration error has been seen in this pass. */
 static int conf_error;
+/** Non-zero in a child process that only checks the configuration file. */
+int conf_checking;
+/** Socket on which a checking child reports to the server. */
+static int conf_check_fd = -1;
 /** When non-zero, indicates that the configuration file was loaded at least once. */
 static int conf_already_read;
 extern void yyparse(void);
@@ -883,12 +1004,52 @@ int read_configuration_file(void)
   return 1;
 }
 
+/** Length of the header of a frame from the checking child: the kind
+ * of frame, then the length of the data that follows. */
+#define CONF_FRAME_HEADER (1 + sizeof(unsigned int))
+
+/** Send a frame from the checking child to the server.  The child
+ * exits if the server has gone away.
+ * @param[in] kind 'E' for an error, 'W' for a warning, 'R' for a
+ *   configuration record or 'D' for the end of the parse.
+ * @param[in] data Contents of the frame.
+ * @param[in] length Length of \a data.
+ */
+static void conf_check_send(char kind, const void *data, unsigned int length)
+{
+  char header[CONF_FRAME_HEADER];
+
+  header[0] = kind;
+  memcpy(header + 1, &length, sizeof(length));
+  if (write(conf_check_fd, header, sizeof(header)) != sizeof(header)
+      || (length > 0
+          && write(conf_check_fd, data, length) != (ssize_t) length))
+    _exit(1);
+}
+
+/** Send an error or warning from the checking child to the server.
+ * @param[in] kind 'E' for an error or 'W' for a warning.
+ * @param[in] msg Text of the message.
+ */
+static void conf_check_message(char kind, const char *msg)
+{
+  char buf[BUFSIZE * 3];
+
+  ircd_snprintf(0, buf, sizeof(buf), "%d %s", yylineno, msg);
+  conf_check_send(kind, buf, strlen(buf) + 1);
+}
+
 /** Report an error message about the configuration file.
  * @param msg The error to report.
  */
 void
 yyerror(const char *msg)
 {
+ if (conf_checking) {
+   conf_check_message('E', msg);
+   conf_error = 1;
+   return;
+ }
  sendto_opmask(0, SNO_ALL, "Config file parse error line %d: %s",
                yylineno, msg);
  log_write(LS_CONFIG, L_ERROR, 0, "Config file parse error line %d: %s",
@@ -925,6 +1086,10 @@ yywarning(const char *fmt, ...)
   va_start(vl, fmt);
   ircd_vsnprintf(NULL, warn_buffer, sizeof(warn_buffer), fmt, vl);
   va_end(vl);
+  if (conf_checking) {
+    conf_check_message('W', warn_buffer);
+    return;
+  }
   sendto_opmask(0, SNO_ALL, "Config warning on line %d: %s",
                 yylineno, warn_buffer);
   log_write(LS_CONFIG, L_WARNING, 0, "Config warning on line %d: %s",
@@ -1042,25 +1207,730 @@ static void close_mappings(void)
   GlobalServiceMapList = NULL;
 }
 
-/** Reload the configuration file.
- * @param cptr Client that requested rehash (if a signal, &me).
- * @param sig Type of rehash (0 = oper-requested, 1 = signal, 2 =
- *   oper-requested but do not restart resolver)
- * @return CPTR_KILLED if any client was K/G-lined because of the
- * rehash; otherwise 0.
+/** Largest number of values in a configuration record. */
+#define CONF_RECORD_MAX 13
+
+/** One value of a configuration record. */
+union ConfValue {
+  int num;                    /**< Number ('i'). */
+  char *str;                  /**< String, possibly NULL ('s'). */
+  struct {
+    int count;                /**< Number of strings. */
+    char **list;              /**< The strings. */
+  } vec;                      /**< List of strings ('v'). */
+  struct irc_in_addr addr;    /**< Address ('a'). */
+  struct Privs privs;         /**< Privileges ('p'). */
+  struct ListenerFlags flags; /**< Listener flags ('l'). */
+};
+
+/** Take a string out of a record, so that it is not freed with it.
+ * @param[in,out] v Value holding the string.
+ * @return The string.
  */
-int rehash(struct Client *cptr, int sig)
+static char *conf_take(union ConfValue *v)
+{
+  char *str = v->str;
+
+  v->str = NULL;
+  return str;
+}
+
+/** Link a #CRT_JUPE record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_jupe(union ConfValue *v)
+{
+  addNickJupes(v[0].str);
+}
+
+/** Link a #CRT_GENERAL record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_general(union ConfValue *v)
+{
+  /* Zero out the vhost addresses, in case they were removed. */
+  memset(&VirtualHost_v4.addr, 0, sizeof(VirtualHost_v4.addr));
+  memset(&VirtualHost_v6.addr, 0, sizeof(VirtualHost_v6.addr));
+}
+
+/** Link a #CRT_NUMERIC record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_numeric(union ConfValue *v)
+{
+  localConf.numeric = v[0].num;
+}
+
+/** Link a #CRT_NAME record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_name(union ConfValue *v)
+{
+  MyFree(localConf.name);
+  localConf.name = conf_take(&v[0]);
+}
+
+/** Link a #CRT_DESCRIPTION record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_description(union ConfValue *v)
+{
+  MyFree(localConf.description);
+  localConf.description = conf_take(&v[0]);
+  ircd_strncpy(cli_info(&me), localConf.description, REALLEN);
+}
+
+/** Link a #CRT_VHOST record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_vhost(union ConfValue *v)
+{
+  if (irc_in_addr_is_ipv4(&v[0].addr))
+    memcpy(&VirtualHost_v4.addr, &v[0].addr, sizeof(v[0].addr));
+  else
+    memcpy(&VirtualHost_v6.addr, &v[0].addr, sizeof(v[0].addr));
+}
+
+/** Link a #CRT_DNS_VHOST record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_dns_vhost(union ConfValue *v)
+{
+  if (v[0].num)
+    memcpy(&VirtualHost_dns_v4.addr, &v[2].addr, sizeof(v[2].addr));
+  if (v[1].num)
+    memcpy(&VirtualHost_dns_v6.addr, &v[2].addr, sizeof(v[2].addr));
+}
+
+/** Link a #CRT_DNS_SERVER record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_dns_server(union ConfValue *v)
+{
+  add_nameserver(v[0].str);
+}
+
+/** Link a #CRT_ADMIN record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_admin(union ConfValue *v)
+{
+  MyFree(localConf.location1);
+  MyFree(localConf.location2);
+  MyFree(localConf.contact);
+  if (!(localConf.location1 = conf_take(&v[0])))
+    DupString(localConf.location1, "");
+  if (!(localConf.location2 = conf_take(&v[1])))
+    DupString(localConf.location2, "");
+  if (!(localConf.contact = conf_take(&v[2])))
+    DupString(localConf.contact, "");
+}
+
+/** Link a #CRT_CLASS record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_class(union ConfValue *v)
+{
+  struct ConnectionClass *c_class;
+  char *name = conf_take(&v[0]);
+
+  add_class(name, v[1].num, v[2].num, v[3].num, v[4].num);
+  c_class = find_class(name);
+  MyFree(c_class->default_umode);
+  c_class->default_umode = conf_take(&v[5]);
+  memcpy(&c_class->privs, &v[6].privs, sizeof(c_class->privs));
+  memcpy(&c_class->privs_dirty, &v[7].privs, sizeof(c_class->privs_dirty));
+  SendRate(c_class) = v[8].num;
+  SendBurst(c_class) = v[9].num;
+  MsgRate(c_class) = v[10].num;
+  MsgBurst(c_class) = v[11].num;
+  SendqDrop(c_class) = v[12].num;
+}
+
+/** Link a #CRT_CONNECT record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_connect(union ConfValue *v)
+{
+  struct ConnectionClass *c_class;
+  struct ConfItem *aconf;
+
+  if (!(c_class = find_class(v[4].str)))
+    return;
+  aconf = make_conf(CONF_SERVER);
+  aconf->name = conf_take(&v[0]);
+  aconf->origin_name = conf_take(&v[1]);
+  aconf->passwd = conf_take(&v[2]);
+  aconf->host = conf_take(&v[3]);
+  aconf->conn_class = c_class;
+  aconf->address.port = v[5].num;
+  aconf->maximum = v[6].num;
+  aconf->hub_limit = conf_take(&v[7]);
+  aconf->flags = v[8].num;
+  lookup_confhost(aconf);
+}
+
+/** Link a #CRT_UWORLD record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_uworld(union ConfValue *v)
+{
+  conf_make_uworld(conf_take(&v[0]), v[1].num);
+}
+
+/** Link a #CRT_OPERATOR record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_operator(union ConfValue *v)
+{
+  struct ConnectionClass *c_class;
+  struct ConfItem *aconf;
+
+  if (!(c_class = find_class(v[3].str)))
+    return;
+  aconf = make_conf(CONF_OPERATOR);
+  aconf->name = conf_take(&v[0]);
+  aconf->passwd = conf_take(&v[1]);
+  conf_parse_userhost(aconf, v[2].str);
+  aconf->conn_class = c_class;
+  memcpy(&aconf->privs, &v[4].privs, sizeof(aconf->privs));
+  memcpy(&aconf->privs_dirty, &v[5].privs, sizeof(aconf->privs_dirty));
+}
+
+/** Link a #CRT_PORT record into the configuration.  The checking
+ * child does not open listeners.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_port(union ConfValue *v)
+{
+  if (!conf_checking)
+    add_listener(v[0].num, v[1].str, v[2].str, &v[3].flags);
+}
+
+/** Link a #CRT_CLIENT record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_client(union ConfValue *v)
+{
+  struct ConnectionClass *c_class;
+  struct ConfItem *aconf;
+
+  if (!(c_class = find_class(v[6].str)))
+    return;
+  aconf = make_conf(CONF_CLIENT);
+  aconf->username = conf_take(&v[0]);
+  aconf->host = conf_take(&v[1]);
+  aconf->name = conf_take(&v[2]);
+  memcpy(&aconf->address.addr, &v[3].addr, sizeof(aconf->address.addr));
+  aconf->addrbits = v[4].num;
+  aconf->address.port = v[5].num;
+  aconf->conn_class = c_class;
+  aconf->maximum = v[7].num;
+  aconf->passwd = conf_take(&v[8]);
+}
+
+/** Link a #CRT_KILL record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_kill(union ConfValue *v)
+{
+  struct DenyConf *dconf = (struct DenyConf*) MyCalloc(1, sizeof(*dconf));
+
+  dconf->usermask = conf_take(&v[0]);
+  dconf->hostmask = conf_take(&v[1]);
+  dconf->realmask = conf_take(&v[2]);
+  dconf->message = conf_take(&v[3]);
+  dconf->flags = v[4].num;
+  memcpy(&dconf->address, &v[5].addr, sizeof(dconf->address));
+  dconf->bits = v[6].num;
+  dconf->next = denyConfList;
+  denyConfList = dconf;
+}
+
+/** Link a #CRT_CRULE record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_crule(union ConfValue *v)
+{
+  struct CRuleConf *p;
+  struct CRuleNode *node;
+
+  if (!(node = crule_unflatten((const char * const *) v[3].vec.list,
+                               v[3].vec.count)))
+    return;
+  p = (struct CRuleConf*) MyMalloc(sizeof(*p));
+  p->hostmask = conf_take(&v[0]);
+  p->rule = conf_take(&v[1]);
+  p->type = v[2].num;
+  p->node = node;
+  p->next = cruleConfList;
+  cruleConfList = p;
+}
+
+/** Link a #CRT_MOTD record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_motd(union ConfValue *v)
+{
+  motd_add(v[0].str, v[1].str);
+}
+
+/** Link a #CRT_FEATURE record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_feature(union ConfValue *v)
+{
+  feature_set(NULL, (const char * const *) v[0].vec.list, v[0].vec.count);
+}
+
+/** Link a #CRT_QUARANTINE record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_quarantine(union ConfValue *v)
+{
+  struct qline *qconf = MyCalloc(1, sizeof(*qconf));
+
+  qconf->chname = conf_take(&v[0]);
+  qconf->reason = conf_take(&v[1]);
+  qconf->next = GlobalQuarantineList;
+  GlobalQuarantineList = qconf;
+}
+
+/** Link a #CRT_PSEUDO record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_pseudo(union ConfValue *v)
+{
+  struct s_map *smap = MyCalloc(1, sizeof(struct s_map));
+  struct nick_host *nh;
+  const char *nick;
+  size_t slen;
+  int ii;
+
+  smap->command = conf_take(&v[0]);
+  smap->name = conf_take(&v[1]);
+  smap->prepend = conf_take(&v[2]);
+  smap->flags = v[3].num;
+  /* Keep the targets in the order the record lists them. */
+  for (ii = v[4].vec.count - 1; ii >= 0; --ii) {
+    nick = v[4].vec.list[ii];
+    slen = strlen(nick);
+    nh = MyMalloc(sizeof(*nh) + slen);
+    memcpy(nh->nick, nick, slen + 1);
+    nh->nicklen = strchr(nick, '@') - nick;
+    nh->next = smap->services;
+    smap->services = nh;
+  }
+  if (register_mapping(smap))
+  {
+    smap->next = GlobalServiceMapList;
+    GlobalServiceMapList = smap;
+  }
+  else
+    free_mapping(smap);
+}
+
+/** Link a #CRT_IAUTH record into the configuration.  The checking
+ * child does not start IAuth.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_iauth(union ConfValue *v)
+{
+  if (!conf_checking)
+    auth_spawn(v[0].vec.count, v[0].vec.list);
+}
+
+/** Link a #CRT_WEBIRC record into the configuration.
+ * @param[in] v Values of the record.
+ */
+static void conf_link_webirc(union ConfValue *v)
+{
+  struct wline *wline;
+
+  /* Search for a wline with the same IP (mask) and password. */
+  for (wline = GlobalWebircList; wline; wline = wline->next) {
+    if ((v[3].num == wline->bits)
+        && ipmask_check(&v[2].addr, &wline->ip, wline->bits)
+        && (0 == strcmp(v[0].str, wline->passwd)))
+      break;
+  }
+
+  /* Update it, or create a new structure. */
+  if (wline) {
+    MyFree(wline->description);
+  } else {
+    wline = (struct wline *) MyMalloc(sizeof(*wline));
+    memcpy(&wline->ip, &v[2].addr, sizeof(wline->ip));
+    wline->bits = v[3].num;
+    wline->passwd = conf_take(&v[0]);
+    wline->next = GlobalWebircList;
+    GlobalWebircList = wline;
+  }
+  wline->stale = 0;
+  wline->hidden = v[4].num;
+  wline->description = conf_take(&v[1]);
+}
+
+/** Description of each kind of configuration record, in the order of
+ * enum ConfRecordType.
+ */
+static const struct ConfRecordDesc {
+  const char *values;                  /**< Types of the values: 'i', 's',
+                                          'v', 'a', 'p' or 'l' as in
+                                          union ConfValue. */
+  void (*link)(union ConfValue *v);    /**< Links the record in. */
+} conf_records[CRT_LAST] = {
+  { "s", conf_link_jupe },
+  { "", conf_link_general },
+  { "i", conf_link_numeric },
+  { "s", conf_link_name },
+  { "s", conf_link_description },
+  { "a", conf_link_vhost },
+  { "iia", conf_link_dns_vhost },
+  { "s", conf_link_dns_server },
+  { "sss", conf_link_admin },
+  { "siiiisppiiiii", conf_link_class },
+  { "sssssiisi", conf_link_connect },
+  { "si", conf_link_uworld },
+  { "sssspp", conf_link_operator },
+  { "issl", conf_link_port },
+  { "sssaiisis", conf_link_client },
+  { "ssssiai", conf_link_kill },
+  { "ssiv", conf_link_crule },
+  { "ss", conf_link_motd },
+  { "v", conf_link_feature },
+  { "ss", conf_link_quarantine },
+  { "sssiv", conf_link_pseudo },
+  { "v", conf_link_iauth },
+  { "ssaii", conf_link_webirc },
+};
+
+/** Free the values of a configuration record.
+ * @param[in] type Kind of record.
+ * @param[in] v Values of the record.
+ */
+static void conf_record_free(enum ConfRecordType type, union ConfValue *v)
+{
+  const char *values = conf_records[type].values;
+  int ii, jj;
+
+  for (ii = 0; values[ii]; ++ii) {
+    if (values[ii] == 's')
+      MyFree(v[ii].str);
+    else if (values[ii] == 'v') {
+      for (jj = 0; jj < v[ii].vec.count; ++jj)
+        MyFree(v[ii].vec.list[jj]);
+      MyFree(v[ii].vec.list);
+    }
+  }
+}
+
+/** Append data to an encoded configuration record.
+ * @param[out] out Buffer for the record, or NULL to only count.
+ * @param[in] used Length of the record so far.
+ * @param[in] data Data to append.
+ * @param[in] length Length of \a data.
+ * @return Length of the record with \a data.
+ */
+static size_t conf_record_put(char *out, size_t used, const void *data,
+                              size_t length)
+{
+  if (out)
+    memcpy(out + used, data, length);
+  return used + length;
+}
+
+/** Append a string, which may be NULL, to an encoded configuration
+ * record.
+ * @param[out] out Buffer for the record, or NULL to only count.
+ * @param[in] used Length of the record so far.
+ * @param[in] str String to append.
+ * @return Length of the record with \a str.
+ */
+static size_t conf_record_put_string(char *out, size_t used,
+                                     const char *str)
+{
+  int length = str ? (int) strlen(str) : -1;
+
+  used = conf_record_put(out, used, &length, sizeof(length));
+  return str ? conf_record_put(out, used, str, length) : used;
+}
+
+/** Encode a configuration record for the server.
+ * @param[out] out Buffer for the record, or NULL to only count.
+ * @param[in] type Kind of record.
+ * @param[in] v Values of the record.
+ * @return Length of the encoded record.
+ */
+static size_t conf_record_encode(char *out, enum ConfRecordType type,
+                                 const union ConfValue *v)
+{
+  const char *values = conf_records[type].values;
+  unsigned char kind = type;
+  size_t used;
+  int ii, jj;
+
+  used = conf_record_put(out, 0, &kind, sizeof(kind));
+  for (ii = 0; values[ii]; ++ii) {
+    switch (values[ii]) {
+    case 'i':
+      used = conf_record_put(out, used, &v[ii].num, sizeof(v[ii].num));
+      break;
+    case 's':
+      used = conf_record_put_string(out, used, v[ii].str);
+      break;
+    case 'v':
+      used = conf_record_put(out, used, &v[ii].vec.count,
+                             sizeof(v[ii].vec.count));
+      for (jj = 0; jj < v[ii].vec.count; ++jj)
+        used = conf_record_put_string(out, used, v[ii].vec.list[jj]);
+      break;
+    case 'a':
+      used = conf_record_put(out, used, &v[ii].addr, sizeof(v[ii].addr));
+      break;
+    case 'p':
+      used = conf_record_put(out, used, &v[ii].privs, sizeof(v[ii].privs));
+      break;
+    case 'l':
+      used = conf_record_put(out, used, &v[ii].flags, sizeof(v[ii].flags));
+      break;
+    }
+  }
+  return used;
+}
+
+/** Take data from an encoded configuration record.
+ * @param[in,out] pos Position in the record.
+ * @param[in] end End of the record.
+ * @param[out] data Receives the data.
+ * @param[in] length Length of \a data.
+ * @return Non-zero if the record held enough data.
+ */
+static int conf_record_get(const char **pos, const char *end, void *data,
+                           size_t length)
+{
+  if ((size_t) (end - *pos) < length)
+    return 0;
+  memcpy(data, *pos, length);
+  *pos += length;
+  return 1;
+}
+
+/** Take a string from an encoded configuration record.
+ * @param[in,out] pos Position in the record.
+ * @param[in] end End of the record.
+ * @param[out] str Receives a copy of the string, or NULL.
+ * @return Non-zero if the record held a whole string.
+ */
+static int conf_record_get_string(const char **pos, const char *end,
+                                  char **str)
+{
+  int length;
+
+  *str = NULL;
+  if (!conf_record_get(pos, end, &length, sizeof(length)))
+    return 0;
+  if (length < 0)
+    return 1;
+  if (end - *pos < length)
+    return 0;
+  *str = (char*) MyMalloc(length + 1);
+  memcpy(*str, *pos, length);
+  (*str)[length] = '\0';
+  *pos += length;
+  return 1;
+}
+
+/** Decode a configuration record from the checking child.
+ * @param[in] pos Start of the record.
+ * @param[in] end End of the record.
+ * @param[out] v Receives the values of the record.
+ * @return Kind of record, or #CRT_LAST if it is not a valid record.
+ */
+static enum ConfRecordType conf_record_decode(const char *pos,
+                                              const char *end,
+                                              union ConfValue *v)
+{
+  enum ConfRecordType type;
+  const char *values;
+  unsigned char kind;
+  int ok = 1;
+  int ii, jj;
+
+  memset(v, 0, sizeof(*v) * CONF_RECORD_MAX);
+  if (!conf_record_get(&pos, end, &kind, sizeof(kind)) || kind >= CRT_LAST)
+    return CRT_LAST;
+  type = kind;
+  values = conf_records[type].values;
+  for (ii = 0; ok && values[ii]; ++ii) {
+    switch (values[ii]) {
+    case 'i':
+      ok = conf_record_get(&pos, end, &v[ii].num, sizeof(v[ii].num));
+      break;
+    case 's':
+      ok = conf_record_get_string(&pos, end, &v[ii].str);
+      break;
+    case 'v':
+      ok = conf_record_get(&pos, end, &jj, sizeof(jj))
+        && jj >= 0 && jj <= end - pos;
+      if (!ok)
+        break;
+      v[ii].vec.list = (char**) MyCalloc(jj + 1, sizeof(char*));
+      for (v[ii].vec.count = 0; ok && v[ii].vec.count < jj; )
+        ok = conf_record_get_string(&pos, end,
+                                    &v[ii].vec.list[v[ii].vec.count++]);
+      break;
+    case 'a':
+      ok = conf_record_get(&pos, end, &v[ii].addr, sizeof(v[ii].addr));
+      break;
+    case 'p':
+      ok = conf_record_get(&pos, end, &v[ii].privs, sizeof(v[ii].privs));
+      break;
+    case 'l':
+      ok = conf_record_get(&pos, end, &v[ii].flags, sizeof(v[ii].flags));
+      break;
+    }
+  }
+  if (!ok || pos != end) {
+    conf_record_free(type, v);
+    return CRT_LAST;
+  }
+  return type;
+}
+
+/** Link a block or setting of the configuration file into the
+ * running configuration.  The values are copied, so the caller keeps
+ * its own.  In a checking child, the record is also sent to the
+ * server, which links the same records in once the check succeeds
+ * instead of parsing the file again.
+ * @param[in] type Kind of record.
+ * @param[in] ... Values of the record, as listed for \a type: ints,
+ *   strings (which may be NULL), an int count and a const char **
+ *   for a list of strings, and pointers to a struct irc_in_addr,
+ *   struct Privs or struct ListenerFlags.
+ */
+void conf_link(enum ConfRecordType type, ...)
+{
+  union ConfValue v[CONF_RECORD_MAX];
+  const char * const *list;
+  const char *values;
+  const char *str;
+  char *out;
+  size_t length;
+  va_list vl;
+  int ii, jj;
+
+  assert(type < CRT_LAST);
+  values = conf_records[type].values;
+  assert(strlen(values) <= CONF_RECORD_MAX);
+  memset(v, 0, sizeof(v));
+  va_start(vl, type);
+  for (ii = 0; values[ii]; ++ii) {
+    switch (values[ii]) {
+    case 'i':
+      v[ii].num = va_arg(vl, int);
+      break;
+    case 's':
+      if ((str = va_arg(vl, const char *)))
+        DupString(v[ii].str, str);
+      break;
+    case 'v':
+      v[ii].vec.count = va_arg(vl, int);
+      list = va_arg(vl, const char **);
+      v[ii].vec.list = (char**) MyCalloc(v[ii].vec.count + 1, sizeof(char*));
+      for (jj = 0; jj < v[ii].vec.count; ++jj)
+        DupString(v[ii].vec.list[jj], list[jj]);
+      break;
+    case 'a':
+      memcpy(&v[ii].addr, va_arg(vl, const struct irc_in_addr *),
+             sizeof(v[ii].addr));
+      break;
+    case 'p':
+      memcpy(&v[ii].privs, va_arg(vl, const struct Privs *),
+             sizeof(v[ii].privs));
+      break;
+    case 'l':
+      memcpy(&v[ii].flags, va_arg(vl, const struct ListenerFlags *),
+             sizeof(v[ii].flags));
+      break;
+    }
+  }
+  va_end(vl);
+
+  if (conf_checking) {
+    length = conf_record_encode(NULL, type, v);
+    out = (char*) MyMalloc(length);
+    conf_record_encode(out, type, v);
+    conf_check_send('R', out, length);
+    MyFree(out);
+  }
+  conf_records[type].link(v);
+  conf_record_free(type, v);
+}
+
+/** Find a frame in the output of the checking child.
+ * @param[in] pos Start of the frame.
+ * @param[in] end End of the output.
+ * @param[out] kind Kind of frame, as for conf_check_send().
+ * @param[out] data Start of the frame's data.
+ * @param[out] length Length of the frame's data.
+ * @return Start of the next frame, or NULL if no whole frame starts
+ * at \a pos.
+ */
+static const char *conf_check_frame(const char *pos, const char *end,
+                                    char *kind, const char **data,
+                                    unsigned int *length)
+{
+  if ((size_t) (end - pos) < CONF_FRAME_HEADER)
+    return NULL;
+  memcpy(length, pos + 1, sizeof(*length));
+  if ((size_t) (end - pos) - CONF_FRAME_HEADER < *length)
+    return NULL;
+  *kind = pos[0];
+  *data = pos + CONF_FRAME_HEADER;
+  return *data + *length;
+}
+
+/** Link in the configuration records that a checking child sent, as
+ * read_configuration_file() would have set up the same configuration
+ * by parsing the file.
+ * @param[in] pos Start of the child's output.
+ * @param[in] end End of the child's output.
+ */
+static void conf_link_records(const char *pos, const char *end)
+{
+  union ConfValue v[CONF_RECORD_MAX];
+  enum ConfRecordType type;
+  const char *data;
+  unsigned int length;
+  char kind;
+
+  feature_unmark(); /* unmark all features for resetting later */
+  clear_nameservers(); /* clear previous list of DNS servers */
+  while ((pos = conf_check_frame(pos, end, &kind, &data, &length))) {
+    if (kind != 'R')
+      continue;
+    if ((type = conf_record_decode(data, data + length, v)) == CRT_LAST) {
+      log_write(LS_CONFIG, L_ERROR, 0, "Ignoring a malformed "
+                "configuration record from the checking process");
+      continue;
+    }
+    conf_records[type].link(v);
+    conf_record_free(type, v);
+  }
+  feature_mark(); /* reset unmarked features */
+}
+
+/** Release the configuration that a reload replaces.  Objects that
+ * are still in use are only marked, so that the new configuration can
+ * reuse them or they can be swept once they are unused.
+ * @return The previous list of Kill blocks.
+ */
+static struct DenyConf *conf_unload(void)
 {
   struct ConfItem** tmp = &GlobalConfList;
   struct ConfItem*  tmp2;
-  struct Client*    acptr;
-  int               i;
-  int               ret = 0;
-  int               found_g = 0;
-
-  if (1 == sig)
-    sendto_opmask(0, SNO_OLDSNO,
-                  "Got signal SIGHUP, reloading ircd conf. file");
+  struct DenyConf*  old_denies;
 
   while ((tmp2 = *tmp)) {
     if (tmp2->clients) {
@@ -1085,7 +1955,8 @@ int rehash(struct Client *cptr, int sig)
   }
   conf_erase_uworld_list();
   conf_erase_crule_list();
-  conf_erase_deny_list();
+  old_denies = denyConfList; /* kept to find the new rules */
+  denyConfList = 0;
   motd_clear();
 
   /*
@@ -1100,8 +1971,47 @@ int rehash(struct Client *cptr, int sig)
   auth_mark_closing();
   webirc_mark_stale();
   close_mappings();
+  return old_denies;
+}
 
-  read_configuration_file();
+/** Replace the running configuration, either with the records a
+ * checking child sent or by reading the configuration file.
+ * @param cptr Client that requested rehash (if a signal, &me).
+ * @param sig Type of rehash (0 = oper-requested, 1 = signal, 2 =
+ *   oper-requested but do not restart resolver)
+ * @param records Output of a checking child, or NULL to read the file.
+ * @param length Length of \a records.
+ * @return CPTR_KILLED if any client was K/G-lined because of the
+ * rehash; otherwise 0.
+ */
+static int conf_apply(struct Client *cptr, int sig, const char *records,
+                      size_t length)
+{
+  struct ConfItem** tmp;
+  struct ConfItem*  tmp2;
+  struct Client*    acptr;
+  struct DenyConf*  old_denies;
+  const struct DenyConf** new_denies;
+  unsigned int      n_new_denies;
+  unsigned int      j;
+  int               glines_were_disabled;
+  int               recheck_glines;
+  int               i;
+  int               ret = 0;
+  int               found_g = 0;
+
+  glines_were_disabled = feature_bool(FEAT_DISABLE_GLINES);
+  old_denies = conf_unload();
+
+  if (records)
+    conf_link_records(records, records + length);
+  else
+    read_configuration_file();
+
+  n_new_denies = conf_diff_deny_list(old_denies, &new_denies);
+  conf_free_deny_list(old_denies);
+  /* G-lines only need checking if they were just enabled. */
+  recheck_glines = glines_were_disabled && !feature_bool(FEAT_DISABLE_GLINES);
 
   if (sig != 2)
     restart_resolver();
@@ -1134,9 +2044,17 @@ int rehash(struct Client *cptr, int sig)
         det_confs_butmask(acptr, ~(CONF_ILLEGAL));
       /* Because admin's are getting so uppity about people managing to
        * get past K/G's etc, we'll "fix" the bug by actually explaining
-       * whats going on.
+       * whats going on.  Clients were checked against the old rules
+       * already, so only the new ones are tried.
        */
-      if ((found_g = find_kill(acptr))) {
+      found_g = 0;
+      if (recheck_glines)
+        found_g = find_kill(acptr);
+      else if (cli_user(acptr))
+        for (j = 0; j < n_new_denies && !found_g; j++)
+          if (deny_match(new_denies[j], acptr))
+            found_g = deny_notify(new_denies[j], acptr);
+      if (found_g) {
         sendto_opmask(0, found_g == -2 ? SNO_GLINE : SNO_OPERKILL,
                       found_g == -2 ? "G-line active for %s%s" :
                       "K-line active for %s%s",
@@ -1153,12 +2071,255 @@ int rehash(struct Client *cptr, int sig)
     }
   }
 
+  MyFree(new_denies);
   update_uworld_flags(&me);
   webirc_remove_stale();
 
   return ret;
 }
 
+/** State of a configuration check running in a child process. */
+static struct ConfCheck {
+  struct Socket sock;     /**< Our end of the result socket. */
+  struct Timer  timer;    /**< Starts a check requested meanwhile. */
+  int           active;   /**< Non-zero while a check is running. */
+  int           sig;      /**< Type of rehash to apply afterwards. */
+  int           again;    /**< Rehash requested while checking. */
+  int           again_sig; /**< Type of that rehash. */
+  int           done;     /**< Non-zero once the child finished. */
+  unsigned int  errors;   /**< Number of errors the child reported. */
+  char         *buf;      /**< Output of the child. */
+  size_t        length;   /**< Bytes of output in \a buf. */
+  size_t        size;     /**< Allocated size of \a buf. */
+} conf_check;
+
+/** Parse the configuration file in a freshly forked child.  The child
+ * has a private copy of the running configuration, so the parser can
+ * build the new one exactly as a rehash would without affecting the
+ * server.  Every descriptor except the result socket is closed first,
+ * so that nothing the parser does can reach a client, listener or the
+ * event engine of the parent.  The child reads the file and the files
+ * it includes once, and sends the server each error and warning, a
+ * record of each block for conf_link_records(), and finally a 'D'
+ * frame; see conf_check_send().
+ * @param[in] fd Child's end of the result socket.
+ */
+static void conf_check_child(int fd)
+{
+  int i;
+
+  for (i = 3; i < maxconnections; ++i)
+    if (i != fd)
+      close(i);
+  HighestFd = -1;
+  conf_checking = 1;
+  conf_check_fd = fd;
+  conf_unload();
+  read_configuration_file();
+  conf_check_send('D', NULL, 0);
+  _exit(0);
+}
+
+/** Report the errors and warnings a checking child sent, and whether
+ * it finished.
+ */
+static void conf_check_report(void)
+{
+  const char *pos = conf_check.buf;
+  const char *end = conf_check.buf + conf_check.length;
+  const char *data;
+  unsigned int length;
+  char line[BUFSIZE * 3];
+  char *msg;
+  char kind;
+
+  while ((pos = conf_check_frame(pos, end, &kind, &data, &length))) {
+    if (kind == 'D')
+      conf_check.done = 1;
+    else if (kind == 'E')
+      conf_check.errors++;
+    if ((kind != 'E' && kind != 'W') || length == 0 || length > sizeof(line)
+        || data[length - 1] != '\0')
+      continue;
+    memcpy(line, data, length);
+    if (!(msg = strchr(line, ' ')))
+      continue;
+    *msg++ = '\0';
+    if (kind == 'E') {
+      sendto_opmask(0, SNO_ALL, "Config file parse error line %s: %s",
+                    line, msg);
+      log_write(LS_CONFIG, L_ERROR, 0, "Config file parse error line %s: %s",
+                line, msg);
+    } else {
+      sendto_opmask(0, SNO_ALL, "Config warning on line %s: %s", line, msg);
+      log_write(LS_CONFIG, L_WARNING, 0, "Config warning on line %s: %s",
+                line, msg);
+    }
+  }
+}
+
+static int conf_check_start(int sig);
+
+/** Start a check that was requested while another one was running.
+ * @param[in] ev Timer event.
+ */
+static void conf_check_again(struct Event *ev)
+{
+  if (ev_type(ev) != ET_EXPIRE || conf_check.active || !conf_check.again)
+    return;
+  conf_check.again = 0;
+  if (!conf_check_start(conf_check.again_sig))
+    conf_apply(&me, conf_check.again_sig, NULL, 0);
+}
+
+/** Finish a configuration check, linking in the records of the new
+ * configuration if the child parsed it without errors.
+ */
+static void conf_check_finish(void)
+{
+  int sig = conf_check.sig;
+
+  close(s_fd(&conf_check.sock));
+  socket_del(&conf_check.sock);
+  conf_check.active = 0;
+
+  conf_check_report();
+  if (!conf_check.done) {
+    sendto_opmask(0, SNO_OLDSNO, "Checking %s failed; keeping the current "
+                  "configuration", configfile);
+    log_write(LS_CONFIG, L_ERROR, LOG_NOSNOTICE, "Checking %s failed; "
+              "keeping the current configuration", configfile);
+  } else if (conf_check.errors) {
+    sendto_opmask(0, SNO_OLDSNO, "%u error%s in %s; keeping the current "
+                  "configuration", conf_check.errors,
+                  conf_check.errors == 1 ? "" : "s", configfile);
+    log_write(LS_CONFIG, L_ERROR, LOG_NOSNOTICE, "%u error%s in %s; "
+              "keeping the current configuration", conf_check.errors,
+              conf_check.errors == 1 ? "" : "s", configfile);
+  } else
+    conf_apply(&me, sig, conf_check.buf, conf_check.length);
+  MyFree(conf_check.buf);
+  conf_check.buf = NULL;
+
+  /* Check again if the file was changed and rehashed meanwhile.  The
+   * socket is only released once this callback returns, so start the
+   * next check from a timer.
+   */
+  if (conf_check.again)
+    timer_add(timer_init(&conf_check.timer), conf_check_again, 0,
+              TT_RELATIVE, 0);
+}
+
+/** Read the output of the checking child.
+ * @param[in] ev Event on the result socket.
+ */
+static void conf_check_callback(struct Event *ev)
+{
+  unsigned int count;
+
+  assert(ev_socket(ev) == &conf_check.sock);
+
+  switch (ev_type(ev)) {
+  case ET_READ:
+  case ET_EOF:
+    /* The child may have exited already; read whatever it left. */
+    for (;;) {
+      if (conf_check.length == conf_check.size)
+        conf_check.buf = (char*) MyRealloc(conf_check.buf,
+                                           conf_check.size *= 2);
+      switch (os_recv_nonb(s_fd(&conf_check.sock),
+                           conf_check.buf + conf_check.length,
+                           conf_check.size - conf_check.length, &count)) {
+      case IO_SUCCESS:
+        conf_check.length += count;
+        continue;
+      case IO_BLOCKED:
+        if (ev_type(ev) == ET_READ)
+          return;
+        break;
+      case IO_FAILURE:
+        break;
+      }
+      break;
+    }
+    conf_check_finish();
+    break;
+  case ET_ERROR:
+    conf_check_finish();
+    break;
+  default:
+    break;
+  }
+}
+
+/** Start checking the configuration file in a child process.
+ * @param[in] sig Type of rehash to apply when the check succeeds.
+ * @return Non-zero if the check was started.
+ */
+static int conf_check_start(int sig)
+{
+  int fd[2];
+  pid_t pid;
+
+  if (os_socketpair(fd))
+    return 0;
+  if (!os_set_nonblocking(fd[0])
+      || !socket_add(&conf_check.sock, conf_check_callback, 0,
+                     SS_CONNECTED, SOCK_EVENT_READABLE, fd[0])) {
+    close(fd[0]);
+    close(fd[1]);
+    return 0;
+  }
+  if ((pid = fork()) < 0) {
+    close(fd[0]);
+    socket_del(&conf_check.sock);
+    close(fd[1]);
+    return 0;
+  }
+  if (pid == 0)
+    conf_check_child(fd[1]);
+  close(fd[1]);
+  conf_check.active = 1;
+  conf_check.sig = sig;
+  conf_check.done = 0;
+  conf_check.errors = 0;
+  conf_check.size = 8192;
+  conf_check.buf = (char*) MyMalloc(conf_check.size);
+  conf_check.length = 0;
+  return 1;
+}
+
+/** Reload the configuration file.  The file is parsed and checked by
+ * a child process, so that the server keeps running during the parse
+ * and a file with errors is not loaded at all.  The child sends back
+ * a record of each block it parsed, and once the check succeeds
+ * conf_apply() only links those records in; the server itself does
+ * not read the file or the files it includes again, so it loads
+ * exactly what was checked.  If no child can be started, the file is
+ * loaded directly.
+ * @param cptr Client that requested rehash (if a signal, &me).
+ * @param sig Type of rehash (0 = oper-requested, 1 = signal, 2 =
+ *   oper-requested but do not restart resolver)
+ * @return CPTR_KILLED if any client was K/G-lined because of the
+ * rehash; otherwise 0.
+ */
+int rehash(struct Client *cptr, int sig)
+{
+  if (1 == sig)
+    sendto_opmask(0, SNO_OLDSNO,
+                  "Got signal SIGHUP, reloading ircd conf. file");
+
+  if (conf_check.active) {
+    conf_check.again = 1;
+    conf_check.again_sig = sig;
+    return 0;
+  }
+  conf_check.again = 0;
+  if (conf_check_start(sig))
+    return 0;
+  return conf_apply(cptr, sig, NULL, 0);
+}
+
 /** Read configuration file for the very first time.
  * @return Non-zero on success, zero on failure.
  */
@@ -1189,6 +2350,52 @@ int init_conf(void)
   return 0;
 }
 
+/** Check whether a deny rule matches a client.
+ * @param deny Deny rule to check.
+ * @param cptr Client with a user structure.
+ * @return Non-zero if \a deny applies to \a cptr.
+ */
+static int deny_match(const struct DenyConf *deny, struct Client *cptr)
+{
+  const char*      host = cli_sockhost(cptr);
+  const char*      name = cli_user(cptr)->username;
+  const char*      realname = cli_info(cptr);
+
+  assert(strlen(host) <= HOSTLEN);
+  assert((name ? strlen(name) : 0) <= HOSTLEN);
+  assert((realname ? strlen(realname) : 0) <= REALLEN);
+
+  if (deny->usermask && match(deny->usermask, name))
+    return 0;
+  if (deny->realmask && match(deny->realmask, realname))
+    return 0;
+  if (deny->bits > 0) {
+    if (!ipmask_check(&cli_ip(cptr), &deny->address, deny->bits))
+      return 0;
+  } else if (deny->hostmask && match(deny->hostmask, host))
+    return 0;
+  return 1;
+}
+
+/** Tell a client why a deny rule rejects it.
+ * @param deny Deny rule that matched.
+ * @param cptr Client being rejected.
+ * @return -1, for the convenience of find_kill().
+ */
+static int deny_notify(const struct DenyConf *deny, struct Client *cptr)
+{
+  if (EmptyString(deny->message))
+    send_reply(cptr, SND_EXPLICIT | ERR_YOUREBANNEDCREEP,
+               ":Connection from your host is refused on this server.");
+  else {
+    if (deny->flags & DENY_FLAGS_FILE)
+      killcomment(cptr, deny->message);
+    else
+      send_reply(cptr, SND_EXPLICIT | ERR_YOUREBANNEDCREEP, ":%s.", deny->message);
+  }
+  return -1;
+}
+
 /** Searches for a K/G-line for a client.  If one is found, notify the
  * user and disconnect them.
  * @param cptr Client to search for.
@@ -1197,9 +2404,6 @@ int init_conf(void)
  */
 int find_kill(struct Client *cptr)
 {
-  const char*      host;
-  const char*      name;
-  const char*      realname;
   struct DenyConf* deny;
   struct Gline*    agline = NULL;
 
@@ -1208,39 +2412,12 @@ int find_kill(struct Client *cptr)
   if (!cli_user(cptr))
     return 0;
 
-  host = cli_sockhost(cptr);
-  name = cli_user(cptr)->username;
-  realname = cli_info(cptr);
-
-  assert(strlen(host) <= HOSTLEN);
-  assert((name ? strlen(name) : 0) <= HOSTLEN);
-  assert((realname ? strlen(realname) : 0) <= REALLEN);
-
   /* 2000-07-14: Rewrote this loop for massive speed increases.
    *             -- Isomer
    */
-  for (deny = denyConfList; deny; deny = deny->next) {
-    if (deny->usermask && match(deny->usermask, name))
-      continue;
-    if (deny->realmask && match(deny->realmask, realname))
-      continue;
-    if (deny->bits > 0) {
-      if (!ipmask_check(&cli_ip(cptr), &deny->address, deny->bits))
-        continue;
-    } else if (deny->hostmask && match(deny->hostmask, host))
-      continue;
-
-    if (EmptyString(deny->message))
-      send_reply(cptr, SND_EXPLICIT | ERR_YOUREBANNEDCREEP,
-                 ":Connection from your host is refused on this server.");
-    else {
-      if (deny->flags & DENY_FLAGS_FILE)
-        killcomment(cptr, deny->message);
-      else
-        send_reply(cptr, SND_EXPLICIT | ERR_YOUREBANNEDCREEP, ":%s.", deny->message);
-    }
-    return -1;
-  }
+  for (deny = denyConfList; deny; deny = deny->next)
+    if (deny_match(deny, cptr))
+      return deny_notify(deny, cptr);
 
   if (!feature_bool(FEAT_DISABLE_GLINES) && (agline = gline_lookup(cptr, 0))) {
     /*
@@ -52,6 +52,7 @@
 #include "s_stats.h"
 #include "s_user.h"
 #include "send.h"
+#include "silence.h"
 #include "struct.h"
 #include "uping.h"
 #include "userload.h"
@@ -216,6 +217,7 @@ static void exit_one_client(struct Client* bcptr, const char* comment)
       cli_user(bcptr)->silence = bp->next;
       free_ban(bp);
     }
+    silence_update(cli_user(bcptr));
 
     /* Clean up snotice lists */
     if (MyUser(bcptr))
@@ -357,6 +359,7 @@ int exit_client(struct Client *cptr,
     struct Client* killer,
     const char* comment)
 {
+  static struct SnoAggregate exit_notices = SNO_AGGREGATE_INIT("exits");
   struct Client* acptr = 0;
   struct DLink *dlp;
   time_t on_for;
@@ -368,7 +371,7 @@ int exit_client(struct Client *cptr,
     SetFlag(victim, FLAG_CLOSING);
 
     if (feature_bool(FEAT_CONNEXIT_NOTICES) && IsUser(victim))
-      sendto_opmask(0, SNO_CONNEXIT,
+      sendto_opmask_aggregate(0, SNO_CONNEXIT, &exit_notices, &cli_ip(victim),
                     "Client exiting: %s (%s@%s) [%s] [%s] <%s%s>",
                     cli_name(victim), cli_user(victim)->username,
                     cli_user(victim)->host, comment,
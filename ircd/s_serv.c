@@ -33,7 +33,9 @@
 #include "hash.h"
 #include "ircd.h"
 #include "ircd_alloc.h"
+#include "ircd_features.h"
 #include "ircd_log.h"
+#include "ircd_osdep.h"
 #include "ircd_reply.h"
 #include "ircd_string.h"
 #include "ircd_snprintf.h"
@@ -139,6 +141,10 @@ int server_estab(struct Client *cptr, struct ConfItem *aconf)
     hAddClient(cptr);
   SetServer(cptr);
   cli_handler(cptr) = SERVER_HANDLER;
+  if (feature_bool(FEAT_SERVER_ZEROCOPY) && os_set_zerocopy(cli_fd(cptr))) {
+    SetFlag(cptr, FLAG_ZEROCOPY);
+    socket_errqueue(&(cli_socket(cptr)));
+  }
   Count_unknownbecomesserver(UserStats);
   SetBurst(cptr);
 
@@ -419,6 +419,7 @@ static void
 stats_links(struct Client* sptr, const struct StatDesc* sd, char* name)
 {
   struct Client *acptr;
+  unsigned int writes, hits;
   int i;
   int wilds = 0;
 
@@ -432,7 +433,7 @@ stats_links(struct Client* sptr, const struct StatDesc* sd, char* name)
    * a wild card based search to list it.
    */
   send_reply(sptr, SND_EXPLICIT | RPL_STATSLINKINFO, "Connection SendQ "
-             "SendM SendKBytes RcveM RcveKBytes :Open since");
+             "SendM SendKBytes RcveM RcveKBytes ZcWrites ZcHit :Open since");
     for (i = 0; i <= HighestFd; i++)
     {
       if (!(acptr = LocalClientArray[i]))
@@ -450,12 +451,17 @@ stats_links(struct Client* sptr, const struct StatDesc* sd, char* name)
       /* Skip all that do not match the specific query */
       if (!(!name || wilds) && 0 != ircd_strcmp(name, cli_name(acptr)))
         continue;
+      /* Zero-copy hit ratio: writes that really were not copied. */
+      writes = cli_zc_sends(acptr) + cli_zc_small(acptr);
+      hits = cli_zc_sends(acptr) - cli_zc_copied(acptr);
       send_reply(sptr, SND_EXPLICIT | RPL_STATSLINKINFO,
-                 "%s %u %u %Lu %u %Lu :%Tu",
+                 "%s %u %u %Lu %u %Lu %u %u :%Tu",
                  (*(cli_name(acptr))) ? cli_name(acptr) : "<unregistered>",
                  (int)MsgQLength(&(cli_sendQ(acptr))), (int)cli_sendM(acptr),
                  (cli_sendB(acptr) >> 10), (int)cli_receiveM(acptr),
-                 (cli_receiveB(acptr) >> 10), CurrentTime - cli_firsttime(acptr));
+                 (cli_receiveB(acptr) >> 10), cli_zc_sends(acptr),
+                 writes ? (unsigned int) (hits * 100ULL / writes) : 0,
+                 CurrentTime - cli_firsttime(acptr));
     }
 }
 
@@ -56,7 +56,9 @@
 #include "s_misc.h"
 #include "s_serv.h" /* max_client_count */
 #include "send.h"
+#include "silence.h"
 #include "struct.h"
+#include "target.h"
 #include "userload.h"
 #include "version.h"
 #include "whowas.h"
@@ -113,6 +115,8 @@ void free_user(struct User* user)
   if (--user->refcnt == 0) {
     if (user->away)
       MyFree(user->away);
+    if (user->silence_index)
+      MyFree(user->silence_index);
     /*
      * sanity check
      */
@@ -343,6 +347,7 @@ int hunt_server_prio_cmd(struct Client *from, const char *cmd, const char *tok,
  */
 int register_user(struct Client *cptr, struct Client *sptr)
 {
+  static struct SnoAggregate connect_notices = SNO_AGGREGATE_INIT("connects");
   char*            parv[4];
   char*            tmpstr;
   struct User*     user = cli_user(sptr);
@@ -391,7 +396,7 @@ int register_user(struct Client *cptr, struct Client *sptr)
     if (cli_snomask(sptr) & SNO_NOISY)
       set_snomask(sptr, cli_snomask(sptr) & SNO_NOISY, SNO_ADD);
     if (feature_bool(FEAT_CONNEXIT_NOTICES))
-      sendto_opmask(0, SNO_CONNEXIT,
+      sendto_opmask_aggregate(0, SNO_CONNEXIT, &connect_notices, &cli_ip(sptr),
                     "Client connecting: %s (%s@%s) [%s] {%s} [%s] <%s%s>",
                     cli_name(sptr), user->username, user->host,
                     cli_sock_ip(sptr), get_client_class(sptr),
@@ -641,6 +646,7 @@ int set_nick_name(struct Client* cptr, struct Client* sptr,
     if ((cli_name(sptr))[0])
       hRemClient(sptr);
     strcpy(cli_name(sptr), nick);
+    ClearPrefix(sptr);
     hAddClient(sptr);
   }
   else {
@@ -652,45 +658,20 @@ int set_nick_name(struct Client* cptr, struct Client* sptr,
   return 0;
 }
 
-/** Calculate the hash value for a target.
- * @param[in] target Pointer to target, cast to unsigned int.
- * @return Hash value constructed from the pointer.
- */
-static unsigned char hash_target(unsigned int target)
-{
-  return (unsigned char) (target >> 16) ^ (target >> 8);
-}
-
 /** Records \a target as a recent target for \a sptr.
- * @param[in] sptr User who has sent to a new target.
+ * The target is added behind \a sptr's own most recent targets, so
+ * that replying to it is free but it is forgotten sooner.
+ * @param[in] sptr User who has been sent a message by \a target.
  * @param[in] target Target to add.
  */
 void
 add_target(struct Client *sptr, void *target)
 {
-  /* Ok, this shouldn't work esp on alpha
-  */
-  unsigned char  hash = hash_target((unsigned long) target);
-  unsigned char* targets;
-  int            i;
   assert(0 != sptr);
   assert(cli_local(sptr));
 
-  targets = cli_targets(sptr);
-
-  /* 
-   * Already in table?
-   */
-  for (i = 0; i < MAXTARGETS; ++i) {
-    if (targets[i] == hash)
-      return;
-  }
-  /*
-   * New target
-   */
-  memmove(&targets[RESERVEDTARGETS + 1],
-          &targets[RESERVEDTARGETS], MAXTARGETS - RESERVEDTARGETS - 1);
-  targets[RESERVEDTARGETS] = hash;
+  if (!target_find(cli_targets(sptr), target))
+    target_add(&cli_targets(sptr), target, 1);
 }
 
 /** Check whether \a sptr can send to or join \a target yet.
@@ -703,30 +684,18 @@ add_target(struct Client *sptr, void *target)
 int check_target_limit(struct Client *sptr, void *target, const char *name,
     int created)
 {
-  unsigned char hash = hash_target((unsigned long) target);
-  int            i;
-  unsigned char* targets;
-
   assert(0 != sptr);
   assert(cli_local(sptr));
-  targets = cli_targets(sptr);
 
   /* If user is invited to channel, give him/her a free target */
   if (IsChannelName(name) && is_invited(sptr, target))
     return 0;
 
   /*
-   * Same target as last time?
+   * Recent target?
    */
-  if (targets[0] == hash)
+  if (target_touch(cli_targets(sptr), target))
     return 0;
-  for (i = 1; i < MAXTARGETS; ++i) {
-    if (targets[i] == hash) {
-      memmove(&targets[1], &targets[0], i);
-      targets[0] = hash;
-      return 0;
-    }
-  }
   /*
    * New target
    */
@@ -752,8 +721,7 @@ int check_target_limit(struct Client *sptr, void *target, const char *name,
         cli_nexttarget(sptr) = CurrentTime - (TARGET_DELAY * (MAXTARGETS - 1));
     }
   }
-  memmove(&targets[1], &targets[0], MAXTARGETS - 1);
-  targets[0] = hash;
+  target_add(&cli_targets(sptr), target, 0);
   return 0;
 }
 
@@ -905,6 +873,8 @@ hide_hostmask(struct Client *cptr, unsigned int flag)
     for (chan = (cli_user(cptr))->channel; chan;
          chan = chan->next_channel)
       ClearBanValid(chan);
+    /* Likewise for cached SILENCE results */
+    cli_serial(cptr) = ++ClientSerial;
     break;
   default:
     return 0;
@@ -917,6 +887,7 @@ hide_hostmask(struct Client *cptr, unsigned int flag)
   sendcmdto_common_channels(cptr, CMD_QUIT, cptr, ":Registered");
   ircd_snprintf(0, cli_user(cptr)->host, HOSTLEN, "%s.%s",
                 cli_user(cptr)->account, feature_str(FEAT_HIDDEN_HOST));
+  ClearPrefix(cptr);
 
   /* ok, the client is now fully hidden, so let them know -- hikari */
   if (MyConnect(cptr))
@@ -1383,28 +1354,6 @@ unsigned int umode_make_snomask(unsigned int oldmask, char *arg, int what)
   return newmask;
 }
 
-/** Remove \a cptr from the singly linked list \a list.
- * @param[in] cptr Client to remove from list.
- * @param[in,out] list Pointer to head of list containing \a cptr.
- */
-static void delfrom_list(struct Client *cptr, struct SLink **list)
-{
-  struct SLink* tmp;
-  struct SLink* prv = NULL;
-
-  for (tmp = *list; tmp; tmp = tmp->next) {
-    if (tmp->value.cptr == cptr) {
-      if (prv)
-        prv->next = tmp->next;
-      else
-        *list = tmp->next;
-      free_link(tmp);
-      break;
-    }
-    prv = tmp;
-  }
-}
-
 /** Set \a cptr's server notice mask, according to \a what.
  * @param[in,out] cptr Client whose snomask is updating.
  * @param[in] newmask Base value for new snomask.
@@ -1414,7 +1363,6 @@ void set_snomask(struct Client *cptr, unsigned int newmask, int what)
 {
   unsigned int oldmask, diffmask;        /* unsigned please */
   int i;
-  struct SLink *tmp;
 
   oldmask = cli_snomask(cptr);
 
@@ -1429,21 +1377,9 @@ void set_snomask(struct Client *cptr, unsigned int newmask, int what)
 
   diffmask = oldmask ^ newmask;
 
-  for (i = 0; diffmask >> i; i++) {
+  for (i = 0; diffmask >> i; i++)
     if (((diffmask >> i) & 1))
-    {
-      if (((newmask >> i) & 1))
-      {
-        tmp = make_link();
-        tmp->next = opsarray[i];
-        tmp->value.cptr = cptr;
-        opsarray[i] = tmp;
-      }
-      else
-        /* not real portable :( */
-        delfrom_list(cptr, &opsarray[i]);
-    }
-  }
+      sno_subscribe(cptr, 1U << i, (newmask >> i) & 1);
   cli_snomask(cptr) = newmask;
 }
 
@@ -1463,7 +1399,7 @@ int is_silenced(struct Client *sptr, struct Client *acptr)
   char buf[BUFSIZE];
 
   if (IsServer(sptr) || !(user = cli_user(acptr))
-      || !(found = find_ban(sptr, user->silence)))
+      || !(found = silence_find(sptr, user)))
     return 0;
   assert(!(found->flags & BAN_EXCEPTION));
   if (!MyConnect(sptr)) {
@@ -27,6 +27,9 @@
 #include "class.h"
 #include "client.h"
 #include "ircd.h"
+#include "ircd_alloc.h"
+#include "ircd_defs.h"
+#include "ircd_events.h"
 #include "ircd_features.h"
 #include "ircd_log.h"
 #include "ircd_snprintf.h"
@@ -43,16 +46,33 @@
 #include "struct.h"
 
 /* #include <assert.h> -- Now using assert in ircd_log.h */
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
 /** Last used marker value. */
 static int sentalong_marker;
-/** Array of users with the corresponding server notice mask bit set. */
-struct SLink *opsarray[32];     /* don't use highest bit unless you change
-				   atoi to strtoul in sendto_op_mask() */
+/** Number of bits in each word of a subscriber bitset. */
+#define SNO_WORDBITS (8 * sizeof(unsigned long))
+/** Bitsets of the file descriptors of local clients with the
+ * corresponding server notice mask bit set. */
+static unsigned long *sno_subscribers[32]; /* don't use highest bit unless
+					      you change atoi to strtoul in
+					      sendto_op_mask() */
+/** Number of words in each subscriber bitset. */
+static unsigned int sno_words;
+/** Aggregates with a summary waiting to be sent. */
+static struct SnoAggregate *sno_pending;
+/** Timer that sends summaries at the end of their interval. */
+static struct Timer sno_timer;
 /** Linked list of all connections with data queued to send. */
 static struct Connection *send_queues;
+/** Timer that resumes output held back by class send rates. */
+static struct Timer shape_timer;
+/** Connections reached by the current sendtextto_channels() call. */
+static struct Client **batch_dest;
+/** Number of entries allocated in #batch_dest. */
+static unsigned int batch_size;
 
 static void vsendto_opmask(struct Client *one, unsigned int mask,
 			   const char *pattern, va_list vl);
@@ -110,6 +130,43 @@ static int can_send(struct Client* to)
   return (IsDead(to) || IsMe(to) || -1 == cli_fd(to)) ? 0 : 1;
 }
 
+/** Account for channel messages dropped for a client.
+ * @param[in] to Local client.
+ * @param[in] cl Connection class of \a to.
+ * @param[in] dropped Number of messages dropped.
+ */
+static void send_shed_count(struct Client *to, struct ConnectionClass *cl,
+                            unsigned int dropped)
+{
+  if (!dropped)
+    return;
+  cl->sendq_dropped += dropped;
+  cli_dropped(to) += dropped;
+  if (!IsShedding(to)) {
+    SetFlag(to, FLAG_SHEDDING);
+    sendcmdto_one(&me, CMD_NOTICE, to, "%C :*** Notice -- Your connection "
+                  "is not keeping up; dropping channel messages to you",
+                  to);
+  }
+}
+
+/** Drop the channel chatter waiting in a client's sendq, if its class
+ * allows that.  The client is told the first time this happens.
+ * @param[in] to Local client whose sendq is full.
+ * @return Number of messages dropped.
+ */
+static unsigned int send_shed(struct Client *to)
+{
+  struct ConnectionClass *cl;
+  unsigned int dropped;
+
+  if (!(cl = class_sendq_drop(to)))
+    return 0;
+  dropped = msgq_prune(&(cli_sendQ(to)));
+  send_shed_count(to, cl, dropped);
+  return dropped;
+}
+
 /** Close the connection with the highest sendq.
  * This should be called when we need to free buffer memory.
  * @param[in] servers_too If non-zero, consider killing servers, too.
@@ -134,7 +191,7 @@ kill_highest_sendq(int servers_too)
     }
   }
 
-  if (highest_client)
+  if (highest_client && !send_shed(highest_client))
     dead_link(highest_client, "Buffer allocation error");
 }
 
@@ -165,6 +222,31 @@ void flush_connections(struct Client* cptr)
   }
 }
 
+/** Resume output that was held back by class send rates.
+ * @param[in] ev Timer event (ignored unless it is ET_EXPIRE).
+ */
+static void shape_expire(struct Event* ev)
+{
+  struct Connection *con, *next;
+  int shaped = 0;
+
+  if (ev_type(ev) != ET_EXPIRE)
+    return;
+
+  for (con = send_queues; con; con = next) {
+    next = con_next(con);
+    if (!HasFlag(con_client(con), FLAG_SHAPED))
+      continue;
+    ClrFlag(con_client(con), FLAG_SHAPED);
+    send_queued(con_client(con));
+    if (IsShaped(con_client(con)))
+      shaped = 1;
+  }
+
+  if (shaped)
+    timer_add(&shape_timer, shape_expire, 0, TT_RELATIVE, 1);
+}
+
 /*
  * send_queued
  *
@@ -177,17 +259,33 @@ void flush_connections(struct Client* cptr)
  */
 void send_queued(struct Client *to)
 {
+  unsigned int tokens = 0;
+
   assert(0 != to);
   assert(0 != cli_local(to));
 
-  if (IsBlocked(to) || !can_send(to))
+  if (IsBlocked(to) || IsShaped(to) || !can_send(to))
     return;                     /* Don't bother */
 
   while (MsgQLength(&(cli_sendQ(to))) > 0) {
     unsigned int len;
 
-    if ((len = deliver_it(to, &(cli_sendQ(to))))) {
+    if (!tokens && !(tokens = class_send_tokens(to))) {
+      /* Out of send tokens; shape_expire() resumes the output. */
+      SetFlag(to, FLAG_SHAPED);
+      update_write(to);
+      if (!t_active(&shape_timer))
+        timer_add(timer_init(&shape_timer), shape_expire, 0, TT_RELATIVE, 1);
+      return;
+    }
+
+    if ((len = deliver_it(to, &(cli_sendQ(to)),
+                          (tokens == UINT_MAX) ? 0 : tokens))) {
       msgq_delete(&(cli_sendQ(to)), len);
+      if (tokens != UINT_MAX) {
+        tokens -= len;
+        class_send_charge(to, len);
+      }
       cli_lastsq(to) = MsgQLength(&(cli_sendQ(to))) / 1024;
       if (IsBlocked(to)) {
 	update_write(to);
@@ -207,15 +305,39 @@ void send_queued(struct Client *to)
   /* Ok, sendq is now empty... */
   client_drop_sendq(cli_connect(to));
   update_write(to);
+
+  if (IsShedding(to)) {
+    ClrFlag(to, FLAG_SHEDDING);
+    sendcmdto_one(&me, CMD_NOTICE, to, "%C :*** Notice -- %u channel "
+                  "messages to you were dropped", to, cli_dropped(to));
+    cli_dropped(to) = 0;
+  }
 }
 
 /** Try to send a buffer to a client, queueing it if needed.
  * @param[in,out] to Client to send message to.
  * @param[in] buf Message to send.
- * @param[in] prio If non-zero, send as high priority.
+ * @param[in] prio Priority class (enum MsgQClass), possibly ORed with
+ * MQ_BARRIER.
  */
 void send_buffer(struct Client* to, struct MsgBuf* buf, int prio)
 {
+  send_buffer_tail(to, buf, 0, prio);
+}
+
+/** Try to send a message made of two buffers to a client, queueing it
+ * if needed.  See msgq_add_tail().
+ * @param[in,out] to Client to send message to.
+ * @param[in] buf Start of the message.
+ * @param[in] tail Shared rest of the message (may be NULL).
+ * @param[in] prio Priority class (enum MsgQClass), possibly ORed with
+ * MQ_BARRIER.
+ */
+void send_buffer_tail(struct Client* to, struct MsgBuf* buf,
+                      struct MsgBuf* tail, int prio)
+{
+  struct ConnectionClass *cl;
+
   assert(0 != to);
   assert(0 != buf);
 
@@ -229,16 +351,28 @@ void send_buffer(struct Client* to, struct MsgBuf* buf, int prio)
     return;
 
   if (MsgQLength(&(cli_sendQ(to))) > get_sendq(to)) {
-    if (IsServer(to))
-      sendto_opmask(0, SNO_OLDSNO, "Max SendQ limit exceeded for %C: %zu > %zu",
-                    to, MsgQLength(&(cli_sendQ(to))), get_sendq(to));
-    dead_link(to, "Max sendQ exceeded");
-    return;
+    /* Drop chatter rather than the user, if the class allows it, and
+     * keep everything else unless the sendq grows to twice its limit.
+     */
+    if ((cl = class_sendq_drop(to))) {
+      if (prio & MQ_DROPPABLE) {
+        send_shed_count(to, cl, 1);
+        return;
+      }
+      send_shed_count(to, cl, msgq_prune(&(cli_sendQ(to))));
+    }
+    if (MsgQLength(&(cli_sendQ(to))) > get_sendq(to) * (cl ? 2 : 1)) {
+      if (IsServer(to))
+        sendto_opmask(0, SNO_OLDSNO, "Max SendQ limit exceeded for %C: %zu > %zu",
+                      to, MsgQLength(&(cli_sendQ(to))), get_sendq(to));
+      dead_link(to, "Max sendQ exceeded");
+      return;
+    }
   }
 
   Debug((DEBUG_SEND, "Sending [%p] to %s", buf, cli_name(to)));
 
-  msgq_add(&(cli_sendQ(to)), buf, prio);
+  msgq_add_tail(&(cli_sendQ(to)), buf, tail, prio);
   client_add_sendq(cli_connect(to), &send_queues);
   update_write(to);
 
@@ -292,6 +426,28 @@ static int match_it(struct Client *from, struct Client *one, const char *mask,
   }
 }
 
+/** Choose the priority class of a command.
+ * Bans are only sent ahead of other traffic when they come from a
+ * server, since a user source might still be waiting to be introduced
+ * in the normal queue; server introductions are barriers for the same
+ * reason.
+ * @param[in] from Client originating the command.
+ * @param[in] tok Short name of command.
+ * @return Priority class for send_buffer().
+ */
+static int send_class(struct Client *from, const char *tok)
+{
+  if (!strcmp(tok, TOK_PING) || !strcmp(tok, TOK_PONG)
+      || !strcmp(tok, TOK_SETTIME))
+    return MQ_CONTROL;
+  if ((!strcmp(tok, TOK_GLINE) || !strcmp(tok, TOK_JUPE)) &&
+      (IsServer(from) || IsMe(from)))
+    return MQ_ENFORCE;
+  if (!strcmp(tok, TOK_SERVER))
+    return MQ_NORMAL | MQ_BARRIER;
+  return MQ_NORMAL;
+}
+
 /** Send an unprefixed line to a client.
  * @param[in] to Client receiving message.
  * @param[in] pattern Format string of message.
@@ -305,7 +461,7 @@ void sendrawto_one(struct Client *to, const char *pattern, ...)
   mb = msgq_vmake(to, pattern, vl);
   va_end(vl);
 
-  send_buffer(to, mb, 0);
+  send_buffer(to, mb, MQ_NORMAL);
 
   msgq_clean(mb);
 }
@@ -333,7 +489,36 @@ void sendcmdto_one(struct Client *from, const char *cmd, const char *tok,
 
   va_end(vd.vd_args);
 
-  send_buffer(to, mb, 0);
+  send_buffer(to, mb, send_class(from, tok));
+
+  msgq_clean(mb);
+}
+
+/** Send a text command such as PRIVMSG or NOTICE to a single user.
+ * This is equivalent to
+ * sendcmdto_one(from, cmd, tok, to, "%C :%s", to, text), but builds
+ * the message with msgq_make_text().
+ * @param[in] from Client sending the command.
+ * @param[in] cmd Long name of command (used if \a to is a user).
+ * @param[in] tok Short name of command (used if \a to is a server).
+ * @param[in] to Destination of command.
+ * @param[in] text Text of the message.
+ */
+void sendtextto_one(struct Client *from, const char *cmd, const char *tok,
+                    struct Client *to, const char *text)
+{
+  struct MsgBuf *mb;
+  struct Client *dest;
+
+  dest = cli_from(to);
+
+  if (IsServer(dest) || IsMe(dest))
+    mb = msgq_make_text(dest, from, tok, client_numnick(to), text);
+  else
+    mb = msgq_make_text(dest, from, cmd, *cli_name(to) ? cli_name(to) : "*",
+                        text);
+
+  send_buffer(dest, mb, MQ_NORMAL);
 
   msgq_clean(mb);
 }
@@ -362,7 +547,7 @@ void sendcmdto_prio_one(struct Client *from, const char *cmd, const char *tok,
 
   va_end(vd.vd_args);
 
-  send_buffer(to, mb, 1);
+  send_buffer(to, mb, MQ_CONTROL);
 
   msgq_clean(mb);
 }
@@ -386,6 +571,7 @@ void sendcmdto_flag_serv(struct Client *from, const char *cmd,
   struct VarData vd;
   struct MsgBuf *mb;
   struct DLink *lp;
+  int prio = send_class(from, tok);
 
   vd.vd_format = pattern; /* set up the struct VarData for %v */
   va_start(vd.vd_args, pattern);
@@ -406,7 +592,7 @@ void sendcmdto_flag_serv(struct Client *from, const char *cmd,
       continue;
     if ((forbid < FLAG_LAST_FLAG) && HasFlag(lp->value.cptr, forbid))
       continue;
-    send_buffer(lp->value.cptr, mb, 0);
+    send_buffer(lp->value.cptr, mb, prio);
   }
 
   msgq_clean(mb);
@@ -427,6 +613,7 @@ void sendcmdto_serv(struct Client *from, const char *cmd,
   struct VarData vd;
   struct MsgBuf *mb;
   struct DLink *lp;
+  int prio = send_class(from, tok);
 
   vd.vd_format = pattern; /* set up the struct VarData for %v */
   va_start(vd.vd_args, pattern);
@@ -443,7 +630,7 @@ void sendcmdto_serv(struct Client *from, const char *cmd,
   for (lp = cli_serv(&me)->down; lp; lp = lp->next) {
     if (lp->value.cptr == one)
       continue;
-    send_buffer(lp->value.cptr, mb, 0);
+    send_buffer(lp->value.cptr, mb, prio);
   }
 
   msgq_clean(mb);
@@ -514,16 +701,67 @@ void sendcmdto_common_channels(struct Client *from, const char *cmd,
           && member->user != one
           && cli_sentalong(member->user) != sentalong_marker) {
 	cli_sentalong(member->user) = sentalong_marker;
-	send_buffer(member->user, mb, 0);
+	send_buffer(member->user, mb, MQ_NORMAL);
       }
   }
 
   if (MyConnect(from) && from != one)
-    send_buffer(from, mb, 0);
+    send_buffer(from, mb, MQ_NORMAL);
 
   msgq_clean(mb);
 }
 
+/** Check whether a channel command is chatter, which may be dropped
+ * for users who cannot keep up with it.
+ * @param[in] tok Short name of command.
+ * @return Non-zero for PRIVMSG, NOTICE, WALLCHOPS and WALLVOICES.
+ */
+static int send_chatter(const char *tok)
+{
+  return (!strcmp(tok, TOK_PRIVATE) || !strcmp(tok, TOK_NOTICE) ||
+          !strcmp(tok, TOK_WALLCHOPS) || !strcmp(tok, TOK_WALLVOICES));
+}
+
+/** Send prepared buffers to all users on a channel, except for \a one
+ * and those matching \a skip, and release the buffers.
+ * @param[in] to Destination channel.
+ * @param[in] one Client direction to skip (or NULL).
+ * @param[in] skip Bitmask of SKIP_NONOPS, SKIP_NONVOICES, SKIP_DEAF, SKIP_BURST, SKIP_SERVERS.
+ * @param[in] user_mb Buffer to send to local users.
+ * @param[in] serv_mb Buffer to send to servers (or NULL).
+ * @param[in] prio Priority class and flags for send_buffer().
+ */
+static void send_channel_buffers(struct Channel *to, struct Client *one,
+                                 unsigned int skip, struct MsgBuf *user_mb,
+                                 struct MsgBuf *serv_mb, int prio)
+{
+  struct Membership *member;
+
+  /* send buffer along! */
+  bump_sentalong(one);
+  for (member = to->members; member; member = member->next_member) {
+    /* skip duplicates, zombies, and flagged users... */
+    if (cli_sentalong(member->user) == sentalong_marker ||
+        IsZombie(member) ||
+        (skip & SKIP_DEAF && IsDeaf(member->user)) ||
+        (skip & SKIP_NONOPS && !IsChanOp(member)) ||
+        (skip & SKIP_NONVOICES && !IsChanOp(member) && !HasVoice(member)) ||
+        (skip & SKIP_BURST && IsBurstOrBurstAck(cli_from(member->user))) ||
+        !(serv_mb || MyUser(member->user)) ||
+        cli_fd(cli_from(member->user)) < 0)
+      continue;
+    cli_sentalong(member->user) = sentalong_marker;
+
+    /* pick right buffer to send */
+    send_buffer(member->user, MyConnect(member->user) ? user_mb : serv_mb,
+                prio);
+  }
+
+  msgq_clean(user_mb);
+  if (serv_mb)
+    msgq_clean(serv_mb);
+}
+
 /** Send a (prefixed) command to all users on this channel, except for
  * \a one and those matching \a skip.
  * @warning \a pattern must not contain %v.
@@ -540,7 +778,6 @@ void sendcmdto_channel(struct Client *from, const char *cmd,
                        struct Client *one, unsigned int skip,
                        const char *pattern, ...)
 {
-  struct Membership *member;
   struct VarData vd;
   struct MsgBuf *user_mb;
   struct MsgBuf *serv_mb;
@@ -564,28 +801,134 @@ void sendcmdto_channel(struct Client *from, const char *cmd,
     va_end(vd.vd_args);
   }
 
-  /* send buffer along! */
-  bump_sentalong(one);
-  for (member = to->members; member; member = member->next_member) {
-    /* skip duplicates, zombies, and flagged users... */
-    if (cli_sentalong(member->user) == sentalong_marker ||
-        IsZombie(member) ||
-        (skip & SKIP_DEAF && IsDeaf(member->user)) ||
-        (skip & SKIP_NONOPS && !IsChanOp(member)) ||
-        (skip & SKIP_NONVOICES && !IsChanOp(member) && !HasVoice(member)) ||
-        (skip & SKIP_BURST && IsBurstOrBurstAck(cli_from(member->user))) ||
-        !(serv_mb || MyUser(member->user)) ||
-        cli_fd(cli_from(member->user)) < 0)
-      continue;
-    cli_sentalong(member->user) = sentalong_marker;
+  send_channel_buffers(to, one, skip, user_mb, serv_mb,
+                       send_chatter(tok) ? MQ_NORMAL | MQ_DROPPABLE
+                       : MQ_NORMAL);
+}
 
-    /* pick right buffer to send */
-    send_buffer(member->user, MyConnect(member->user) ? user_mb : serv_mb, 0);
+/** Send a text command such as PRIVMSG or NOTICE to all users on
+ * this channel, except for \a one and those matching \a skip.
+ * This is equivalent to sendcmdto_channel(from, cmd, tok, to, one,
+ * skip, "%H :%s", to, text), but builds the messages with
+ * msgq_make_text().
+ * @param[in] from Client originating the command.
+ * @param[in] cmd Long name of command.
+ * @param[in] tok Short name of command.
+ * @param[in] to Destination channel.
+ * @param[in] one Client direction to skip (or NULL).
+ * @param[in] skip Bitmask of SKIP_NONOPS, SKIP_NONVOICES, SKIP_DEAF, SKIP_BURST, SKIP_SERVERS.
+ * @param[in] text Text of the message.
+ */
+void sendtextto_channel(struct Client *from, const char *cmd,
+                        const char *tok, struct Channel *to,
+                        struct Client *one, unsigned int skip,
+                        const char *text)
+{
+  struct MsgBuf *user_mb;
+  struct MsgBuf *serv_mb;
+
+  /* Messages to @#channel are rare; leave them to the general code */
+  if (skip & (SKIP_NONOPS | SKIP_NONVOICES)) {
+    sendcmdto_channel(from, cmd, tok, to, one, skip, "%H :%s", to, text);
+    return;
   }
 
-  msgq_clean(user_mb);
-  if (serv_mb)
-    msgq_clean(serv_mb);
+  /* Build buffer to send to users */
+  user_mb = msgq_make_text(0, from, cmd, to->chname, text);
+
+  /* Build buffer to send to servers */
+  if ((skip & SKIP_SERVERS) || IsLocalChannel(to->chname))
+    serv_mb = NULL;
+  else
+    serv_mb = msgq_make_text(&me, from, tok, to->chname, text);
+
+  send_channel_buffers(to, one, skip, user_mb, serv_mb,
+                       MQ_NORMAL | MQ_DROPPABLE);
+}
+
+/** Send a text command such as PRIVMSG or NOTICE to several channels
+ * at once, except to \a one and users matching \a skip.
+ * All the messages are built first, then each channel's members are
+ * walked once to find the connections (local users and server links)
+ * that should receive each message.  Finally every connection gets
+ * all of its lines in a single pass, in the order of \a to.
+ * Users on several of the channels still get one line per channel,
+ * as do server links, since P10 PRIVMSG takes a single target.
+ * @param[in] from Client originating the command.
+ * @param[in] cmd Long name of command.
+ * @param[in] tok Short name of command.
+ * @param[in] to Destination channels.
+ * @param[in] count Number of channels in \a to (at most MAXTARGETS).
+ * @param[in] one Client direction to skip (or NULL).
+ * @param[in] skip Bitmask of SKIP_NONOPS, SKIP_NONVOICES, SKIP_DEAF, SKIP_BURST, SKIP_SERVERS.
+ * @param[in] text Text of the message.
+ */
+void sendtextto_channels(struct Client *from, const char *cmd,
+                         const char *tok, struct Channel **to,
+                         unsigned int count, struct Client *one,
+                         unsigned int skip, const char *text)
+{
+  struct MsgBuf *user_mb[MAXTARGETS];
+  struct MsgBuf *serv_mb[MAXTARGETS];
+  struct Membership *member;
+  struct Client *dest;
+  unsigned int ii, jj, ndest = 0;
+
+  assert(count <= MAXTARGETS);
+
+  /* Nothing to share for one channel, or for the rare @#channel */
+  if (count < 2 || skip & (SKIP_NONOPS | SKIP_NONVOICES)) {
+    for (ii = 0; ii < count; ++ii)
+      sendtextto_channel(from, cmd, tok, to[ii], one, skip, text);
+    return;
+  }
+
+  bump_sentalong(0);
+  for (ii = 0; ii < count; ++ii) {
+    user_mb[ii] = msgq_make_text(0, from, cmd, to[ii]->chname, text);
+    if ((skip & SKIP_SERVERS) || IsLocalChannel(to[ii]->chname))
+      serv_mb[ii] = NULL;
+    else
+      serv_mb[ii] = msgq_make_text(&me, from, tok, to[ii]->chname, text);
+
+    for (member = to[ii]->members; member; member = member->next_member) {
+      dest = cli_from(member->user);
+      if (dest == one ||
+          IsZombie(member) ||
+          (skip & SKIP_DEAF && IsDeaf(member->user)) ||
+          (skip & SKIP_BURST && IsBurstOrBurstAck(dest)) ||
+          !(serv_mb[ii] || MyUser(member->user)) ||
+          cli_fd(dest) < 0)
+        continue;
+
+      /* remember each connection once, with the channels it wants */
+      if (cli_sentalong(dest) != sentalong_marker) {
+        if (ndest == batch_size) {
+          batch_size = batch_size ? batch_size * 2 : 64;
+          batch_dest = (struct Client **) MyRealloc(batch_dest,
+                                                    batch_size * sizeof(*batch_dest));
+        }
+        batch_dest[ndest++] = dest;
+        cli_sentalong(dest) = sentalong_marker;
+        cli_sendmask(dest) = 0;
+      }
+      cli_sendmask(dest) |= 1U << ii;
+    }
+  }
+
+  for (jj = 0; jj < ndest; ++jj) {
+    dest = batch_dest[jj];
+    for (ii = 0; ii < count; ++ii)
+      if (cli_sendmask(dest) & (1U << ii))
+        send_buffer(dest, IsServer(dest) ? serv_mb[ii] : user_mb[ii],
+                    MQ_NORMAL | MQ_DROPPABLE);
+  }
+
+  for (ii = 0; ii < count; ++ii) {
+    msgq_clean(user_mb[ii]);
+    if (serv_mb[ii])
+      msgq_clean(serv_mb[ii]);
+  }
 }
 
 /** Send a (prefixed) WALL of type \a type to all users except \a one.
@@ -641,7 +984,7 @@ void sendwallto_group(struct Client *from, int type, struct Client *one,
          (!SendWallops(cptr) || (his_wallops && !IsAnOper(cptr)))) ||
         (type == WALL_WALLUSERS && !SendWallops(cptr)))
       continue; /* skip it */
-    send_buffer(cptr, mb, 1);
+    send_buffer(cptr, mb, MQ_CONTROL);
   }
 
   msgq_clean(mb);
@@ -655,7 +998,7 @@ void sendwallto_group(struct Client *from, int type, struct Client *one,
   for (lp = cli_serv(&me)->down; lp; lp = lp->next) {
     if (one && lp->value.cptr == cli_from(one))
       continue;
-    send_buffer(lp->value.cptr, mb, 1);
+    send_buffer(lp->value.cptr, mb, MQ_CONTROL);
   }
 
   msgq_clean(mb);
@@ -709,9 +1052,9 @@ void sendcmdto_match(struct Client *from, const char *cmd,
     cli_sentalong(cptr) = sentalong_marker;
 
     if (MyConnect(cptr)) /* send right buffer */
-      send_buffer(cptr, user_mb, 0);
+      send_buffer(cptr, user_mb, MQ_NORMAL);
     else
-      send_buffer(cptr, serv_mb, 0);
+      send_buffer(cptr, serv_mb, MQ_NORMAL);
   }
 
   msgq_clean(user_mb);
@@ -757,6 +1100,51 @@ void sendto_opmask_ratelimited(struct Client *one, unsigned int mask,
 }
 
 
+/** Return the subscriber bitset index of a server notice mask.
+ * @param[in] mask One of the SNO_* constants.
+ * @return Bit number of \a mask.
+ */
+static unsigned int sno_index(unsigned int mask)
+{
+  unsigned int i = 0; /* so that 1 points to sno_subscribers[0] */
+
+  while ((mask >>= 1))
+    i++;
+  return i;
+}
+
+/** Add or remove a local client from the subscribers of a server
+ * notice mask.  The bitsets are indexed by file descriptor, so this
+ * must be called while \a cptr still has its socket; any bit left
+ * behind is cleared the next time a notice is sent to that mask.
+ * @param[in] cptr Local client whose subscription changes.
+ * @param[in] mask One of the SNO_* constants.
+ * @param[in] on If non-zero, subscribe \a cptr; otherwise unsubscribe.
+ */
+void sno_subscribe(struct Client *cptr, unsigned int mask, int on)
+{
+  unsigned int i = sno_index(mask);
+  int fd = cli_fd(cptr);
+
+  if (fd < 0)
+    return;
+  assert(fd < maxconnections);
+
+  if (!sno_subscribers[i]) {
+    if (!on)
+      return;
+    if (!sno_words)
+      sno_words = (maxconnections + SNO_WORDBITS - 1) / SNO_WORDBITS;
+    sno_subscribers[i] = (unsigned long *) MyCalloc(sno_words,
+                                                    sizeof(unsigned long));
+  }
+
+  if (on)
+    sno_subscribers[i][fd / SNO_WORDBITS] |= 1UL << (fd % SNO_WORDBITS);
+  else
+    sno_subscribers[i][fd / SNO_WORDBITS] &= ~(1UL << (fd % SNO_WORDBITS));
+}
+
 /** Send a server notice to all users subscribing to the indicated \a
  * mask except for \a one.
  * @param[in] one Client direction to skip (or NULL).
@@ -768,30 +1156,187 @@ static void vsendto_opmask(struct Client *one, unsigned int mask,
 			   const char *pattern, va_list vl)
 {
   struct VarData vd;
-  struct MsgBuf *mb;
-  int i = 0; /* so that 1 points to opsarray[0] */
-  struct SLink *opslist;
+  struct MsgBuf *mb = 0;
+  struct Client *cptr;
+  unsigned long *set;
+  unsigned long word;
+  unsigned int i = sno_index(mask), w, b;
+  int fd;
 
-  while ((mask >>= 1))
-    i++;
+  if (!(set = sno_subscribers[i]) || HighestFd < 0)
+    return;
+
+  for (w = 0; w <= (unsigned int) HighestFd / SNO_WORDBITS; w++) {
+    for (word = set[w], b = 0; word; word >>= 1, b++) {
+      if (!(word & 1))
+        continue;
+      fd = w * SNO_WORDBITS + b;
+      if (!(cptr = LocalClientArray[fd]) || !(cli_snomask(cptr) & (1U << i))) {
+        /* stale bit left behind by a closed connection */
+        set[w] &= ~(1UL << b);
+        continue;
+      }
+      if (cptr == one)
+        continue;
+
+      if (!mb) {
+        /*
+         * build string; I don't want to bother with client nicknames, so
+         * I hope this is ok...
+         */
+        vd.vd_format = pattern;
+        va_copy(vd.vd_args, vl);
+        mb = msgq_make(0, ":%s " MSG_NOTICE " * :*** Notice -- %v",
+                       cli_name(&me), &vd);
+      }
+      send_buffer(cptr, mb, MQ_NORMAL);
+    }
+  }
 
-  if (!(opslist = opsarray[i]))
+  if (mb)
+    msgq_clean(mb);
+}
+
+/** Count a notice against the address prefix it came from.
+ * @param[in,out] agg Aggregate to update.
+ * @param[in] addr Address the notice is about (or NULL).
+ */
+static void sno_agg_count(struct SnoAggregate *agg,
+                          const struct irc_in_addr *addr)
+{
+  struct irc_in_addr pfx;
+  unsigned int i;
+
+  if (!addr || !irc_in_addr_valid(addr)) {
+    agg->other++;
     return;
+  }
 
-  /*
-   * build string; I don't want to bother with client nicknames, so I hope
-   * this is ok...
-   */
-  vd.vd_format = pattern;
-  va_copy(vd.vd_args, vl);
-  mb = msgq_make(0, ":%s " MSG_NOTICE " * :*** Notice -- %v", cli_name(&me),
-		 &vd);
+  memset(&pfx, 0, sizeof(pfx));
+  if (irc_in_addr_is_ipv4(addr)) {
+    pfx.in6_16[5] = addr->in6_16[5];
+    pfx.in6_16[6] = addr->in6_16[6];
+  } else {
+    pfx.in6_16[0] = addr->in6_16[0];
+    pfx.in6_16[1] = addr->in6_16[1];
+    pfx.in6_16[2] = addr->in6_16[2];
+  }
 
-  for (; opslist; opslist = opslist->next)
-    if (opslist->value.cptr != one)
-      send_buffer(opslist->value.cptr, mb, 0);
+  for (i = 0; i < agg->nprefix; i++)
+    if (!memcmp(&agg->prefix[i].addr, &pfx, sizeof(pfx))) {
+      agg->prefix[i].count++;
+      return;
+    }
+  if (agg->nprefix < SNO_AGG_PREFIXES) {
+    agg->prefix[agg->nprefix].addr = pfx;
+    agg->prefix[agg->nprefix++].count = 1;
+  } else
+    agg->other++;
+}
 
-  msgq_clean(mb);
+/** End an aggregate's interval and start a new one.  If any notices
+ * were withheld, a summary of the interval is sent first.
+ * @param[in,out] agg Aggregate to summarize; it must not be on the
+ * pending list.
+ */
+static void sno_agg_summary(struct SnoAggregate *agg)
+{
+  unsigned int i, secs = CurrentTime - agg->start;
+
+  for (i = 0; agg->suppressed && i < agg->nprefix; i++)
+    sendto_opmask(0, agg->mask, "%u %s from %s/%u in %us",
+                  agg->prefix[i].count, agg->what,
+                  ircd_ntoa(&agg->prefix[i].addr),
+                  irc_in_addr_is_ipv4(&agg->prefix[i].addr) ? 16 : 48, secs);
+  if (agg->suppressed && agg->other)
+    sendto_opmask(0, agg->mask, "%u %s from other addresses in %us",
+                  agg->other, agg->what, secs);
+
+  agg->start = CurrentTime;
+  agg->sent = agg->suppressed = agg->other = agg->nprefix = 0;
+}
+
+/** Send the summaries of aggregates whose interval has ended.
+ * @param[in] ev Timer event (ignored).
+ */
+static void sno_agg_expire(struct Event *ev)
+{
+  struct SnoAggregate *agg, **pagg;
+  int interval = feature_int(FEAT_SNOTICE_AGGREGATE_INTERVAL);
+  time_t next = 0;
+
+  if (ev_type(ev) != ET_EXPIRE)
+    return;
+
+  for (pagg = &sno_pending; (agg = *pagg); ) {
+    if (CurrentTime >= agg->start + interval) {
+      *pagg = agg->next;
+      sno_agg_summary(agg);
+    } else {
+      if (!next || agg->start + interval < next)
+        next = agg->start + interval;
+      pagg = &agg->next;
+    }
+  }
+
+  if (next)
+    timer_add(&sno_timer, sno_agg_expire, 0, TT_ABSOLUTE, next);
+}
+
+/** Send a server notice to all users subscribing to the indicated \a
+ * mask except for \a one, collapsing floods into summaries.
+ *
+ * Within each SNOTICE_AGGREGATE_INTERVAL seconds, the first
+ * SNOTICE_AGGREGATE_THRESHOLD notices are sent as usual.  Further
+ * notices are only counted, and when the interval ends a summary is
+ * sent giving the number of notices from each /16 (IPv4) or /48
+ * (IPv6) prefix, for example "1523 connects from 10.0.0.0/16 in 5s".
+ * @param[in] one Client direction to skip (or NULL).
+ * @param[in] mask One of the SNO_* constants.
+ * @param[in,out] agg Aggregation state for this kind of notice.
+ * @param[in] addr Address the notice is about (or NULL).
+ * @param[in] pattern Format string for server notice.
+ */
+void sendto_opmask_aggregate(struct Client *one, unsigned int mask,
+                             struct SnoAggregate *agg,
+                             const struct irc_in_addr *addr,
+                             const char *pattern, ...)
+{
+  struct SnoAggregate **pagg;
+  int interval = feature_int(FEAT_SNOTICE_AGGREGATE_INTERVAL);
+  va_list vl;
+
+  if (!sno_subscribers[sno_index(mask)])
+    return;
+
+  if (interval > 0) {
+    if (CurrentTime >= agg->start + interval) {
+      if (agg->suppressed) {
+        for (pagg = &sno_pending; *pagg != agg; pagg = &(*pagg)->next)
+          ;
+        *pagg = agg->next;
+      }
+      sno_agg_summary(agg);
+    }
+
+    agg->mask = mask;
+    sno_agg_count(agg, addr);
+    if (agg->sent >= (unsigned int) feature_int(FEAT_SNOTICE_AGGREGATE_THRESHOLD)) {
+      if (!agg->suppressed++) {
+        agg->next = sno_pending;
+        sno_pending = agg;
+        if (!t_active(&sno_timer))
+          timer_add(timer_init(&sno_timer), sno_agg_expire, 0, TT_ABSOLUTE,
+                    agg->start + interval);
+      }
+      return;
+    }
+    agg->sent++;
+  }
+
+  va_start(vl, pattern);
+  vsendto_opmask(one, mask, pattern, vl);
+  va_end(vl);
 }
 
 /** Send a server notice to all local users on this server.
@@ -816,7 +1361,7 @@ void sendto_lusers(const char *pattern, ...)
     if (!(cptr = LocalClientArray[i]) || !IsUser(cptr))
       continue; /* skip empty slots... */
 
-    send_buffer(cptr, mb, 1); /* send with high priority */
+    send_buffer(cptr, mb, MQ_CONTROL); /* send with high priority */
   }
 
   msgq_clean(mb); /* clean up after ourselves */
@@ -0,0 +1,338 @@
+/*
+ * IRC - Internet Relay Chat, ircd/silence.c
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Compiled SILENCE lists.
+ *
+ * Every private message to a user with a silence list is checked
+ * against that list, on each server the message crosses.  To keep
+ * this cheap, each list is compiled into a SilenceIndex when it
+ * changes:
+ *
+ * \li A nick!user part of "*!*" is skipped, and a literal nick with a
+ *   "*" username is compared directly instead of with match().
+ * \li A literal host part is compared by hash and length first.
+ * \li A wildcard host part must end with its literal suffix (the text
+ *   after its last wildcard) before match() is called.
+ *
+ * The result for the most recent senders is cached in the index,
+ * keyed on the sender and its identity serial (cli_serial()), so
+ * repeated messages from one sender are not checked again until the
+ * list or the sender's nick, host or account changes.
+ */
+#include "config.h"
+
+#include "silence.h"
+#include "channel.h"
+#include "client.h"
+#include "ircd_alloc.h"
+#include "ircd_chattr.h"
+#include "ircd_features.h"
+#include "ircd_log.h"
+#include "ircd_snprintf.h"
+#include "ircd_string.h"
+#include "match.h"
+#include "res.h"
+#include "struct.h"
+
+/* #include <assert.h> -- Now using assert in ircd_log.h */
+#include <string.h>
+
+/** Ways to match the nick!user part of a silence mask. */
+enum SilenceNU {
+  SNU_ANY,			/**< "*!*", matches everyone */
+  SNU_NICK,			/**< literal nick with "*" username */
+  SNU_WILD			/**< anything else; use match() */
+};
+
+/** Ways to match the host part of a silence mask. */
+enum SilenceHost {
+  SH_ANY,			/**< "*", matches everyone */
+  SH_EXACT,			/**< no wildcards; compare hash and text */
+  SH_WILD			/**< wildcards; check suffix, then match() */
+};
+
+/** A compiled silence mask. */
+struct SilenceMask {
+  struct Ban*   ban;		/**< Silence this was compiled from. */
+  unsigned int  host_hash;	/**< Hash of an SH_EXACT host. */
+  unsigned char nu_type;	/**< How to match nick!user (SilenceNU). */
+  unsigned char host_type;	/**< How to match the host (SilenceHost). */
+  unsigned char nick_len;	/**< Length of an SNU_NICK nick. */
+  unsigned char host_len;	/**< Length of an SH_EXACT host, or of the
+				   literal suffix of an SH_WILD host. */
+};
+
+/** A cached silence check result. */
+struct SilenceCache {
+  struct Client* sender;	/**< Sender that was checked. */
+  unsigned int   serial;	/**< cli_serial() of sender when checked. */
+  struct Ban*    found;		/**< Result of the check. */
+};
+
+/** Compiled form of a user's silence list. */
+struct SilenceIndex {
+  struct SilenceCache cache[SILENCE_CACHE]; /**< Recent results. */
+  unsigned int        count;	/**< Number of entries in \a mask. */
+  struct SilenceMask  mask[1];	/**< Compiled masks (really \a count). */
+};
+
+/** Host names of a sender, computed as they are needed. */
+struct SilenceSender {
+  struct Client* cptr;		/**< Sender being checked. */
+  int            nu_valid;	/**< Non-zero once \a nu is filled in. */
+  unsigned int   nhosts;	/**< Number of entries in \a host, or 0. */
+  const char*    host[3];	/**< Displayed, IP and account hosts. */
+  unsigned int   host_len[3];	/**< Lengths of the entries in \a host. */
+  unsigned int   host_hash[3];	/**< Hashes of the entries in \a host. */
+  char nu[NICKLEN + USERLEN + 2]; /**< nick!user of the sender. */
+  char iphost[SOCKIPLEN + 1];	/**< Text form of the sender's IP. */
+  char tmphost[HOSTLEN + 1];	/**< Account host of the sender. */
+};
+
+/** Calculate a case-insensitive hash and the length of a string.
+ * @param[in] str String to hash.
+ * @param[out] len Receives length of \a str.
+ * @return Hash value of \a str.
+ */
+static unsigned int silence_hash(const char *str, unsigned int *len)
+{
+  const char *s;
+  unsigned int hash = 0;
+
+  for (s = str; *s; s++)
+    hash = hash * 31 + (unsigned char) ToLower(*s);
+  *len = s - str;
+  return hash;
+}
+
+/** Compile one silence mask.
+ * @param[out] sm Compiled mask to fill in.
+ * @param[in] ban Silence to compile.
+ */
+static void silence_compile(struct SilenceMask *sm, struct Ban *ban)
+{
+  const char *host = ban->banstr + ban->nu_len + 1;
+  const char *bang, *s, *last_wild = 0;
+  unsigned int len;
+  int escaped = 0;
+
+  sm->ban = ban;
+
+  /* Classify the nick!user part. */
+  bang = memchr(ban->banstr, '!', ban->nu_len);
+  if (ban->nu_len == 3 && !strncmp(ban->banstr, "*!*", 3))
+    sm->nu_type = SNU_ANY;
+  else if (bang && bang + 2 == ban->banstr + ban->nu_len && bang[1] == '*'
+           && bang > ban->banstr
+           && !memchr(ban->banstr, '*', bang - ban->banstr)
+           && !memchr(ban->banstr, '?', bang - ban->banstr)
+           && !memchr(ban->banstr, '\\', bang - ban->banstr)) {
+    sm->nu_type = SNU_NICK;
+    sm->nick_len = bang - ban->banstr;
+  } else
+    sm->nu_type = SNU_WILD;
+
+  /* Classify the host part. */
+  for (s = host; *s; s++) {
+    if (*s == '*' || *s == '?')
+      last_wild = s;
+    else if (*s == '\\')
+      escaped = 1;
+  }
+  if (host[0] == '*' && host[1] == '\0')
+    sm->host_type = SH_ANY;
+  else if (escaped) {
+    /* Escapes make the suffix ambiguous; always use match(). */
+    sm->host_type = SH_WILD;
+    sm->host_len = 0;
+  } else if (last_wild) {
+    sm->host_type = SH_WILD;
+    sm->host_len = s - (last_wild + 1);
+  } else {
+    sm->host_type = SH_EXACT;
+    sm->host_hash = silence_hash(host, &len);
+    sm->host_len = len;
+  }
+}
+
+/** Rebuild the compiled form of a user's silence list.
+ * This must be called whenever User::silence changes.
+ * @param[in,out] user User whose silence list changed.
+ */
+void silence_update(struct User *user)
+{
+  struct SilenceIndex *idx;
+  struct Ban *ban;
+  unsigned int count;
+
+  if (user->silence_index) {
+    MyFree(user->silence_index);
+    user->silence_index = 0;
+  }
+
+  for (count = 0, ban = user->silence; ban; ban = ban->next)
+    count++;
+  if (!count)
+    return;
+
+  idx = (struct SilenceIndex *) MyMalloc(sizeof(struct SilenceIndex) +
+                                         (count - 1) * sizeof(struct SilenceMask));
+  memset(idx->cache, 0, sizeof(idx->cache));
+  idx->count = count;
+  for (count = 0, ban = user->silence; ban; ban = ban->next)
+    silence_compile(&idx->mask[count++], ban);
+  user->silence_index = idx;
+}
+
+/** Fill in the host names of a sender.
+ * These are the same names that find_ban() compares against.
+ * @param[in,out] ss Sender state.
+ */
+static void silence_hosts(struct SilenceSender *ss)
+{
+  struct Client *cptr = ss->cptr;
+  unsigned int ii;
+
+  ss->host[0] = cli_user(cptr)->host;
+  ircd_ntoa_r(ss->iphost, &cli_ip(cptr));
+  ss->host[1] = ss->iphost;
+  ss->nhosts = 2;
+  if (IsAccount(cptr)) {
+    if (HasHiddenHost(cptr))
+      ss->host[2] = cli_user(cptr)->realhost;
+    else {
+      ircd_snprintf(0, ss->tmphost, HOSTLEN, "%s.%s",
+                    cli_user(cptr)->account, feature_str(FEAT_HIDDEN_HOST));
+      ss->host[2] = ss->tmphost;
+    }
+    ss->nhosts = 3;
+  }
+  for (ii = 0; ii < ss->nhosts; ++ii)
+    ss->host_hash[ii] = silence_hash(ss->host[ii], &ss->host_len[ii]);
+}
+
+/** Check whether a compiled mask matches a sender.
+ * @param[in] sm Compiled silence mask.
+ * @param[in,out] ss Sender state.
+ * @return Non-zero if \a sm matches the sender.
+ */
+static int silence_match(const struct SilenceMask *sm,
+                         struct SilenceSender *ss)
+{
+  struct Ban *ban = sm->ban;
+  const char *host, *suffix;
+  unsigned int ii;
+  int res;
+
+  /* Compare nick!user portion of mask. */
+  switch (sm->nu_type) {
+  case SNU_ANY:
+    break;
+  case SNU_NICK:
+    if (ircd_strncmp(cli_name(ss->cptr), ban->banstr, sm->nick_len)
+        || cli_name(ss->cptr)[sm->nick_len] != '\0')
+      return 0;
+    break;
+  default:
+    if (!ss->nu_valid) {
+      ircd_snprintf(0, ss->nu, sizeof(ss->nu), "%s!%s",
+                    cli_name(ss->cptr), cli_user(ss->cptr)->username);
+      ss->nu_valid = 1;
+    }
+    ban->banstr[ban->nu_len] = '\0';
+    res = match(ban->banstr, ss->nu);
+    ban->banstr[ban->nu_len] = '@';
+    if (res)
+      return 0;
+    break;
+  }
+
+  /* Compare host portion of mask. */
+  if (sm->host_type == SH_ANY)
+    return 1;
+  if ((ban->flags & BAN_IPMASK)
+      && ipmask_check(&cli_ip(ss->cptr), &ban->address, ban->addrbits))
+    return 1;
+  if (!ss->nhosts)
+    silence_hosts(ss);
+  host = ban->banstr + ban->nu_len + 1;
+  suffix = (sm->host_type == SH_WILD) ? host + strlen(host) - sm->host_len : 0;
+  for (ii = 0; ii < ss->nhosts; ++ii) {
+    if (sm->host_type == SH_EXACT) {
+      if (ss->host_hash[ii] == sm->host_hash
+          && ss->host_len[ii] == sm->host_len
+          && !ircd_strcmp(ss->host[ii], host))
+        return 1;
+    } else if (ss->host_len[ii] >= sm->host_len
+               && !ircd_strcmp(ss->host[ii] + ss->host_len[ii] - sm->host_len,
+                               suffix)
+               && !match(host, ss->host[ii]))
+      return 1;
+  }
+  return 0;
+}
+
+/** Find the silence in \a user's list that applies to \a sptr.
+ * This gives the same result as find_ban(sptr, user->silence).
+ * @param[in] sptr User sending a message.
+ * @param[in] user Recipient of the message.
+ * @return Matching positive silence, or NULL if none matches or an
+ * exception matches.
+ */
+struct Ban *silence_find(struct Client *sptr, struct User *user)
+{
+  struct SilenceIndex *idx = user->silence_index;
+  struct SilenceCache *cache;
+  struct SilenceSender ss;
+  struct Ban *found;
+  unsigned int ii;
+
+  if (!idx)
+    return 0;
+  assert(cli_user(sptr));
+
+  ii = ((unsigned long) sptr >> 4) ^ ((unsigned long) sptr >> 10);
+  cache = &idx->cache[ii & (SILENCE_CACHE - 1)];
+  if (cache->sender == sptr && cache->serial == cli_serial(sptr))
+    return cache->found;
+
+  ss.cptr = sptr;
+  ss.nu_valid = 0;
+  ss.nhosts = 0;
+  for (found = 0, ii = 0; ii < idx->count; ++ii) {
+    const struct SilenceMask *sm = &idx->mask[ii];
+    /* If we have found a positive silence already, only consider
+     * exceptions. */
+    if (found && !(sm->ban->flags & BAN_EXCEPTION))
+      continue;
+    if (!silence_match(sm, &ss))
+      continue;
+    /* If an exception matches, no silence can match. */
+    if (sm->ban->flags & BAN_EXCEPTION) {
+      found = 0;
+      break;
+    }
+    found = sm->ban;
+  }
+
+  cache->sender = sptr;
+  cache->serial = cli_serial(sptr);
+  cache->found = found;
+  return found;
+}
@@ -0,0 +1,376 @@
+/*
+ * IRC - Internet Relay Chat, ircd/target.c
+ * Copyright (C) 2026 The ircu developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Recent target sets used for target change limiting.
+ *
+ * A target set remembers the most recent message and join targets of
+ * a local user.  It is a small open-addressed hash table with linear
+ * probing whose entries are also threaded on a doubly linked list in
+ * least recently used order, so lookups, promotions, insertions and
+ * evictions all take constant time.  The number of entries is given
+ * by the TARGET_HISTORY feature; a set is rebuilt at its next
+ * insertion when that feature changes.
+ *
+ * Targets are identified by a 32-bit key derived from their address.
+ * Sets are handed to the IP registry when a user disconnects, so the
+ * keys only need to be unique among live objects, not stable forever.
+ */
+#include "config.h"
+
+#include "target.h"
+#include "ircd.h"
+#include "ircd_alloc.h"
+#include "ircd_defs.h"
+#include "ircd_features.h"
+#include "ircd_log.h"
+#include "s_user.h"		/* TARGET_DELAY */
+
+/* #include <assert.h> -- Now using assert in ircd_log.h */
+#include <string.h>
+
+/** Marks the end of the LRU list. */
+#define TS_NONE 0xffff
+
+/** One slot of a TargetSet's hash table. */
+struct TargetSlot {
+  unsigned int   key;	/**< Target key, or 0 if the slot is empty. */
+  unsigned short prev;	/**< Next more recently used slot. */
+  unsigned short next;	/**< Next less recently used slot. */
+};
+
+/** Set of the most recent targets of a client. */
+struct TargetSet {
+  unsigned short limit;	/**< Maximum number of targets kept. */
+  unsigned short count;	/**< Number of targets in the set. */
+  unsigned short mask;	/**< Number of slots minus one. */
+  unsigned short head;	/**< Most recently used slot. */
+  unsigned short tail;	/**< Least recently used slot. */
+  struct TargetSlot slot[1]; /**< Hash table (really mask + 1 slots). */
+};
+
+/** Calculate the key for a target.
+ * @param[in] target Channel or client to compute a key for.
+ * @return Non-zero key for \a target.
+ */
+static unsigned int target_key(const void *target)
+{
+  unsigned long addr = (unsigned long) target;
+  unsigned int key;
+
+  /* Allocations are at least 8-byte aligned; fold in any high bits. */
+  key = (unsigned int) (addr >> 3);
+  if (sizeof(addr) > sizeof(key))
+    key ^= (unsigned int) (addr >> 31 >> 4);
+  return key ? key : 1;
+}
+
+/** Calculate the home slot of a key.
+ * @param[in] set Target set.
+ * @param[in] key Key to hash.
+ * @return Index of the first slot to probe for \a key.
+ */
+static unsigned int target_home(const struct TargetSet *set,
+                                unsigned int key)
+{
+  return ((key * 2654435761U) >> 16) & set->mask;
+}
+
+/** Look up the slot holding \a key.
+ * @param[in] set Target set.
+ * @param[in] key Key to look for.
+ * @return Slot index, or TS_NONE if \a key is not in the set.
+ */
+static unsigned int target_slot(const struct TargetSet *set,
+                                unsigned int key)
+{
+  unsigned int i;
+
+  for (i = target_home(set, key); set->slot[i].key; i = (i + 1) & set->mask)
+    if (set->slot[i].key == key)
+      return i;
+  return TS_NONE;
+}
+
+/** Remove slot \a i from the LRU list.
+ * @param[in,out] set Target set.
+ * @param[in] i Slot to unlink.
+ */
+static void target_unlink(struct TargetSet *set, unsigned int i)
+{
+  struct TargetSlot *slot = &set->slot[i];
+
+  if (slot->prev != TS_NONE)
+    set->slot[slot->prev].next = slot->next;
+  else
+    set->head = slot->next;
+  if (slot->next != TS_NONE)
+    set->slot[slot->next].prev = slot->prev;
+  else
+    set->tail = slot->prev;
+}
+
+/** Insert slot \a i into the LRU list after slot \a after.
+ * @param[in,out] set Target set.
+ * @param[in] i Slot to link.
+ * @param[in] after Slot to follow, or TS_NONE to make \a i the head.
+ */
+static void target_link(struct TargetSet *set, unsigned int i,
+                        unsigned int after)
+{
+  struct TargetSlot *slot = &set->slot[i];
+
+  slot->prev = after;
+  slot->next = (after == TS_NONE) ? set->head : set->slot[after].next;
+  if (slot->prev != TS_NONE)
+    set->slot[slot->prev].next = i;
+  else
+    set->head = i;
+  if (slot->next != TS_NONE)
+    set->slot[slot->next].prev = i;
+  else
+    set->tail = i;
+}
+
+/** Delete the key in slot \a i from the hash table.
+ * Later members of the probe sequence are shifted back so that no
+ * tombstones are needed; their list links are updated as they move.
+ * @param[in,out] set Target set.
+ * @param[in] i Slot to empty; it must already be unlinked.
+ */
+static void target_delete(struct TargetSet *set, unsigned int i)
+{
+  unsigned int j = i, k;
+
+  for (;;) {
+    j = (j + 1) & set->mask;
+    if (!set->slot[j].key)
+      break;
+    k = target_home(set, set->slot[j].key);
+    /* Leave the entry alone if its home lies cyclically in (i, j]. */
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+    set->slot[i] = set->slot[j];
+    if (set->slot[i].prev != TS_NONE)
+      set->slot[set->slot[i].prev].next = i;
+    else
+      set->head = i;
+    if (set->slot[i].next != TS_NONE)
+      set->slot[set->slot[i].next].prev = i;
+    else
+      set->tail = i;
+    i = j;
+  }
+  set->slot[i].key = 0;
+  set->count--;
+}
+
+/** Insert \a key into the hash table and the LRU list.
+ * @param[in,out] set Target set with room for another key.
+ * @param[in] key Key that is not yet in the set.
+ * @param[in] depth Number of more recently used entries to keep ahead
+ * of the new one.
+ */
+static void target_insert(struct TargetSet *set, unsigned int key,
+                          unsigned int depth)
+{
+  unsigned int i, after = TS_NONE;
+
+  assert(set->count < set->limit);
+  for (i = target_home(set, key); set->slot[i].key; i = (i + 1) & set->mask)
+    ;
+  set->slot[i].key = key;
+  set->count++;
+  while (depth-- && (after == TS_NONE ? set->head : set->slot[after].next)
+         != TS_NONE)
+    after = (after == TS_NONE) ? set->head : set->slot[after].next;
+  target_link(set, i, after);
+}
+
+/** Allocate an empty target set.
+ * @param[in] limit Maximum number of targets in the set.
+ * @return Newly allocated set.
+ */
+static struct TargetSet *target_alloc(unsigned int limit)
+{
+  struct TargetSet *set;
+  unsigned int slots = 4;
+
+  /* Keep the load factor at or below three quarters. */
+  while (slots * 3 < limit * 4)
+    slots <<= 1;
+  set = (struct TargetSet *) MyMalloc(sizeof(struct TargetSet) +
+                                      (slots - 1) * sizeof(struct TargetSlot));
+  memset(set->slot, 0, slots * sizeof(struct TargetSlot));
+  set->limit = limit;
+  set->count = 0;
+  set->mask = slots - 1;
+  set->head = set->tail = TS_NONE;
+  return set;
+}
+
+/** Return the configured number of targets to remember. */
+static unsigned int target_limit(void)
+{
+  unsigned int limit = feature_uint(FEAT_TARGET_HISTORY);
+
+  if (limit < 1)
+    return 1;
+  if (limit > TARGET_HISTORY_MAX)
+    return TARGET_HISTORY_MAX;
+  return limit;
+}
+
+/** Rebuild a set for a new size limit, keeping its newest entries.
+ * @param[in] old Set to rebuild; it is freed.
+ * @param[in] limit New size limit.
+ * @return Rebuilt set.
+ */
+static struct TargetSet *target_resize(struct TargetSet *old,
+                                       unsigned int limit)
+{
+  struct TargetSet *set = target_alloc(limit);
+  unsigned int i, n;
+
+  /* Find the oldest entry that fits, then re-add towards the head. */
+  for (i = old->head, n = 1;
+       i != TS_NONE && n < limit && old->slot[i].next != TS_NONE; n++)
+    i = old->slot[i].next;
+  for (; i != TS_NONE; i = old->slot[i].prev)
+    target_insert(set, old->slot[i].key, 0);
+  MyFree(old);
+  return set;
+}
+
+/** Check whether \a target is in a set.
+ * @param[in] set Target set (may be NULL).
+ * @param[in] target Target to look for.
+ * @return Non-zero if \a target is in the set.
+ */
+int target_find(const struct TargetSet *set, const void *target)
+{
+  return set && target_slot(set, target_key(target)) != TS_NONE;
+}
+
+/** Mark \a target as the most recently used target, if it is present.
+ * @param[in,out] set Target set (may be NULL).
+ * @param[in] target Target to look for.
+ * @return Non-zero if \a target was found in the set.
+ */
+int target_touch(struct TargetSet *set, const void *target)
+{
+  unsigned int i;
+
+  if (!set || (i = target_slot(set, target_key(target))) == TS_NONE)
+    return 0;
+  if (i != set->head) {
+    target_unlink(set, i);
+    target_link(set, i, TS_NONE);
+  }
+  return 1;
+}
+
+/** Add a target that is not yet in a set.
+ * The set is allocated or resized as needed, and if it is full its
+ * least recently used target is evicted.  Ordinary targets become the
+ * most recently used entry.  Reserved targets -- senders of messages
+ * to the client, which it may answer for free -- are placed behind
+ * the client's own most recent targets so that they are evicted
+ * first.
+ * @param[in,out] pset Pointer to target set (may point to NULL).
+ * @param[in] target Target to add.
+ * @param[in] reserved If non-zero, add \a target behind the reserved
+ * entries.
+ */
+void target_add(struct TargetSet **pset, const void *target, int reserved)
+{
+  struct TargetSet *set = *pset;
+  unsigned int limit = target_limit();
+
+  if (!set)
+    set = *pset = target_alloc(limit);
+  else if (set->limit != limit)
+    set = *pset = target_resize(set, limit);
+
+  if (set->count == set->limit) {
+    unsigned int i = set->tail;
+
+    target_unlink(set, i);
+    target_delete(set, i);
+  }
+  target_insert(set, target_key(target),
+                reserved ? limit * RESERVEDTARGETS / MAXTARGETS : 0);
+}
+
+/** Duplicate a target set.
+ * @param[in] set Set to copy (may be NULL).
+ * @return Newly allocated copy, or NULL if \a set is NULL.
+ */
+struct TargetSet *target_copy(const struct TargetSet *set)
+{
+  struct TargetSet *copy;
+  size_t size;
+
+  if (!set)
+    return 0;
+  size = sizeof(struct TargetSet) + set->mask * sizeof(struct TargetSlot);
+  copy = (struct TargetSet *) MyMalloc(size);
+  memcpy(copy, set, size);
+  return copy;
+}
+
+/** Release a target set.
+ * @param[in] set Set to free (may be NULL).
+ */
+void target_free(struct TargetSet *set)
+{
+  if (set)
+    MyFree(set);
+}
+
+/** Return the number of targets in a set.
+ * @param[in] set Target set (may be NULL).
+ * @return Number of targets in \a set.
+ */
+unsigned int target_count(const struct TargetSet *set)
+{
+  return set ? set->count : 0;
+}
+
+/** Calculate how many free target changes a client has.
+ * A client earns one free target every TARGET_DELAY seconds; the
+ * first one becomes available at \a next.
+ * @param[in] next Time at which the next free target is available.
+ * @return Number of free targets now available.
+ */
+unsigned int target_free_count(time_t next)
+{
+  if (next > CurrentTime)
+    return 0;
+  return (CurrentTime - next) / TARGET_DELAY + 1;
+}
+
+/** Calculate the next free target time for a number of free targets.
+ * This is the inverse of target_free_count().
+ * @param[in] free_targets Number of free targets to grant.
+ * @return Time at which the next free target becomes available.
+ */
+time_t target_next_time(unsigned int free_targets)
+{
+  return CurrentTime - (time_t) TARGET_DELAY * free_targets + 1;
+}
@@ -0,0 +1,230 @@
+/* expiry_t.c - Test file for the expiry timing wheel */
+
+#include "expiry.h"
+#include "ircd.h"
+#include "ircd_events.h"
+#include "ircd_log.h"
+#include <stdio.h>
+#include <string.h>
+
+/** Seconds covered by the wheel; must match EXPIRY_RANGE in expiry.c. */
+#define RANGE ((time_t) 1 << 24)
+
+time_t CurrentTime;
+
+/** The wheel's timer, once it has been added. */
+static struct Timer *wheel_timer;
+/** Number of calls to timer_add() and timer_chg(). */
+static unsigned int timer_calls;
+
+struct Timer *
+timer_init(struct Timer *timer)
+{
+    memset(timer, 0, sizeof(*timer));
+    return timer;
+}
+
+void
+timer_add(struct Timer *timer, EventCallBack call, void *data,
+          enum TimerType type, time_t value)
+{
+    assert(type == TT_ABSOLUTE);
+    assert(value > CurrentTime);
+    timer->t_header.gh_flags |= GEN_ACTIVE;
+    timer->t_header.gh_call = call;
+    timer->t_header.gh_data = data;
+    timer->t_type = type;
+    timer->t_value = value;
+    wheel_timer = timer;
+    timer_calls++;
+}
+
+void
+timer_chg(struct Timer *timer, enum TimerType type, time_t value)
+{
+    assert(t_active(timer));
+    assert(type == TT_ABSOLUTE);
+    assert(value > CurrentTime);
+    timer->t_value = value;
+    timer_calls++;
+}
+
+/** Advance the clock to each expiration of the wheel's timer, as
+ * timer_run() would, until it is no longer active or is due after
+ * \a limit.
+ * @param[in] limit Last second to run.
+ */
+static void
+run_until(time_t limit)
+{
+    struct Event ev;
+    unsigned int calls;
+
+    while (wheel_timer && t_active(wheel_timer)
+           && t_value(wheel_timer) <= limit) {
+        CurrentTime = t_value(wheel_timer);
+        memset(&ev, 0, sizeof(ev));
+        ev.ev_type = ET_EXPIRE;
+        ev.ev_gen.gen_timer = wheel_timer;
+        calls = timer_calls;
+        wheel_timer->t_header.gh_call(&ev);
+        /* A timer that is not added again is done. */
+        if (calls == timer_calls)
+            wheel_timer->t_header.gh_flags &= ~GEN_ACTIVE;
+    }
+    if (CurrentTime < limit)
+        CurrentTime = limit;
+}
+
+/** Object that owns an expiry entry. */
+struct item {
+    struct Expiry ex;  /**< Entry on the wheel. */
+    time_t due;        /**< Second at which it must fire. */
+    int fired;         /**< Number of times it fired. */
+};
+
+/** Expiry callback that records when an item fired.
+ * @param[in] ex Entry that expired.
+ */
+static void
+item_fired(struct Expiry *ex)
+{
+    struct item *item = ex_data(ex);
+
+    assert(item == (struct item *) ex);
+    assert(!ex_active(ex));
+    assert(CurrentTime == item->due);
+    item->fired++;
+}
+
+/** Schedule an item.
+ * @param[in] item Item to schedule.
+ * @param[in] call Callback to use.
+ * @param[in] due Second at which it must fire.
+ */
+static void
+item_add(struct item *item, ExpiryCallBack call, time_t due)
+{
+    item->due = due;
+    item->fired = 0;
+    expiry_add(&item->ex, call, item, due);
+}
+
+/** Delays around the level boundaries of the wheel. */
+static const time_t delays[] = {
+    1, 2, 62, 63, 64, 65, 127, 128, 4095, 4096, 4097, 8191, 8192,
+    262143, 262144, 262145, RANGE - 1
+};
+#define DELAYS (sizeof(delays) / sizeof(delays[0]))
+
+/** Offsets of the start time from a second aligned to every level. */
+static const time_t offsets[] = { 0, 1, 62, 63, 64, 4032, 4095, 4096 };
+#define OFFSETS (sizeof(offsets) / sizeof(offsets[0]))
+
+static void
+test_exact(void)
+{
+    static struct item items[DELAYS];
+    time_t base;
+    unsigned int i, j;
+
+    printf("Testing exact expiration times..\n");
+    for (j = 0; j < OFFSETS; j++) {
+        /* Start aligned so the offsets hit the cascade boundaries. */
+        base = ((CurrentTime + RANGE) & ~(RANGE - 1)) + offsets[j];
+        run_until(base);
+        assert(CurrentTime == base);
+        for (i = 0; i < DELAYS; i++)
+            item_add(&items[i], item_fired, base + delays[i]);
+        run_until(base + RANGE);
+        for (i = 0; i < DELAYS; i++) {
+            assert(items[i].fired == 1);
+            assert(!ex_active(&items[i].ex));
+        }
+    }
+}
+
+static void
+test_parked(void)
+{
+    static struct item items[4];
+    time_t base;
+    unsigned int i;
+
+    printf("Testing entries beyond the wheel's range..\n");
+    base = CurrentTime;
+    item_add(&items[0], item_fired, base + RANGE);
+    item_add(&items[1], item_fired, base + RANGE + 1);
+    item_add(&items[2], item_fired, base + RANGE + 4097);
+    item_add(&items[3], item_fired, base + 3 * RANGE + 12345);
+    run_until(base + RANGE - 1);
+    for (i = 0; i < 4; i++)
+        assert(items[i].fired == 0 && ex_active(&items[i].ex));
+    run_until(base + 4 * RANGE);
+    for (i = 0; i < 4; i++)
+        assert(items[i].fired == 1 && !ex_active(&items[i].ex));
+}
+
+/** Items used by the callbacks below. */
+static struct item first, second, later, past, fresh;
+
+/** The first of #first and #second to fire cancels the other one and
+ * #later, reschedules itself and adds new entries.
+ * @param[in] ex Entry that expired.
+ */
+static void
+pair_fired(struct Expiry *ex)
+{
+    struct item *item = ex_data(ex);
+    struct item *other = item == &first ? &second : &first;
+
+    item_fired(ex);
+    if (item->fired > 1)
+        return;
+    /* the other one is due in the same second */
+    assert(other->fired == 0 && ex_active(&other->ex));
+    expiry_del(&other->ex);
+    expiry_del(&later.ex);
+    expiry_add(&item->ex, pair_fired, item, CurrentTime + 64);
+    item->due = CurrentTime + 64;
+    /* times that have passed expire on the next second */
+    expiry_add(&past.ex, item_fired, &past, CurrentTime - 5);
+    past.due = CurrentTime + 1;
+    item_add(&fresh, item_fired, CurrentTime + 4096);
+}
+
+static void
+test_callbacks(void)
+{
+    time_t base;
+
+    printf("Testing changes from inside callbacks..\n");
+    base = CurrentTime;
+    item_add(&first, pair_fired, base + 100);
+    item_add(&second, pair_fired, base + 100);
+    item_add(&later, item_fired, base + 101);
+    run_until(base + 100);
+    assert(first.fired + second.fired == 1);
+    assert(ex_active(&first.ex) != ex_active(&second.ex));
+    assert(!ex_active(&later.ex));
+    assert(ex_active(&past.ex) && ex_active(&fresh.ex));
+    run_until(base + 101);
+    assert(past.fired == 1 && later.fired == 0 && fresh.fired == 0);
+    run_until(base + 164);
+    assert(first.fired + second.fired == 2);
+    assert(!ex_active(&first.ex) && !ex_active(&second.ex));
+    run_until(base + 100 + 4096);
+    assert(fresh.fired == 1 && later.fired == 0);
+    assert(!t_active(wheel_timer));
+}
+
+int
+main(int argc, char *argv[])
+{
+    CurrentTime = 1000000000;
+    test_exact();
+    test_parked();
+    test_callbacks();
+    printf("Passed.\n");
+    return 0;
+}
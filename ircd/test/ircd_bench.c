@@ -0,0 +1,921 @@
+/* ircd_bench.c - Microbenchmarks for hot ircd primitives
+ *
+ * Each benchmark is run with a doubling number of iterations until a
+ * run takes at least BENCH_MIN_NSEC, and the result is printed as one
+ * line of tab-separated fields:
+ *
+ *   <name> <iterations> <nanoseconds per iteration>
+ *
+ * Lines starting with '#' are comments.  With arguments, only the
+ * benchmarks whose names begin with one of them are run, for example
+ * "ircd_bench msgq_ dbuf_".
+ */
+
+#include "config.h"
+
+#include "client.h"
+#include "channel.h"
+#include "dbuf.h"
+#include "hash.h"
+#include "ircd.h"
+#include "ircd_alloc.h"
+#include "ircd_crypt.h"
+#include "ircd_crypt_pbkdf2.h"
+#include "ircd_crypt_sha512.h"
+#include "ircd_features.h"
+#include "ircd_osdep.h"
+#include "ircd_reply.h"
+#include "ircd_snprintf.h"
+#include "ircd_string.h"
+#include "match.h"
+#include "msg.h"
+#include "msgq.h"
+#include "numnicks.h"
+#include "random.h"
+#include "res.h"
+#include "s_bsd.h"
+#include "send.h"
+#include "silence.h"
+#include "struct.h"
+#include "target.h"
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Minimum duration of a measured run, in nanoseconds. */
+#define BENCH_MIN_NSEC	200000000ULL
+/** Number of users added to the client hash table. */
+#define BENCH_USERS	20000
+/** Number of messages queued per msgq_mapiov() call. */
+#define BENCH_QUEUE	16
+/** Number of entries in the benchmark silence list (default MAXSILES). */
+#define BENCH_SILENCES	25
+/** Number of messages kept queued by the send benchmarks. */
+#define BENCH_BACKLOG	5000
+
+/** Describes a single benchmark. */
+struct bench {
+  const char *name;			/**< name printed in results */
+  void (*func)(unsigned long count);	/**< run \a count iterations */
+  unsigned long start;			/**< first count, or 0 for 1000 */
+};
+
+/** Results are accumulated here so the compiler keeps the work. */
+static volatile unsigned long sink;
+
+static struct Client bench_server;	/**< remote server of the users */
+static struct Client *bench_users[BENCH_USERS]; /**< hashed users */
+static struct Channel *bench_channel;	/**< channel for %H */
+static struct User bench_silencer;	/**< user with a full silence list */
+
+/** Typical channel message text. */
+static const char text[] = "Lorem ipsum dolor sit amet, consectetur "
+  "adipiscing elit, sed do eiusmod";
+
+/*
+ * Stubs for functions of modules that are not linked in.
+ */
+
+time_t CurrentTime;
+int maxclients;
+struct irc_sockaddr VirtualHost_v4;
+const char* const BIND_ERROR_MSG = "bind error for %s: %s";
+const char* const CONNLIMIT_ERROR_MSG = "connection limit for %s: %s";
+const char* const NONB_ERROR_MSG = "error setting non-blocking for %s: %s";
+const char* const REUSEADDR_ERROR_MSG = "error setting SO_REUSEADDR for %s: %s";
+const char* const SOCKET_ERROR_MSG = "error creating socket for %s: %s";
+
+void
+report_error(const char *text, const char *who, int err)
+{
+}
+
+int
+feature_bool(enum Feature feat)
+{
+  return 0;
+}
+
+const char *
+feature_str(enum Feature feat)
+{
+  return "users.example.net";
+}
+
+unsigned int
+feature_uint(enum Feature feat)
+{
+  switch (feat) {
+  case FEAT_BUFFERPOOL:
+    return 27000000;
+  case FEAT_TARGET_HISTORY:
+    return MAXTARGETS;
+  default:
+    return 0;
+  }
+}
+
+void
+kill_highest_sendq(int servers_too)
+{
+}
+
+void
+flush_connections(struct Client *cptr)
+{
+}
+
+void
+server_panic(const char *message)
+{
+  fprintf(stderr, "server_panic: %s\n", message);
+  exit(1);
+}
+
+int
+send_reply(struct Client *to, int reply, ...)
+{
+  return 0;
+}
+
+void
+sendcmdto_one(struct Client *from, const char *cmd, const char *tok,
+              struct Client *to, const char *pattern, ...)
+{
+}
+
+unsigned int
+ircrandom(void)
+{
+  return rand();
+}
+
+struct Membership *
+find_channel_member(struct Client *cptr, struct Channel *chptr)
+{
+  return 0;
+}
+
+void
+channel_modes(struct Client *cptr, char *mbuf, char *pbuf, int buflen,
+              struct Channel *chptr, struct Membership *member)
+{
+  *mbuf = *pbuf = '\0';
+}
+
+int
+ircd_crypt_register_mech(crypt_mech_t *mechanism)
+{
+  return 0;
+}
+
+/*
+ * Benchmark fixtures.
+ */
+
+/** Create a client with a user structure, as if introduced by N.
+ * @param[in] num Index of the user; used for its name and numnick.
+ * @return Newly allocated client.
+ */
+static struct Client *
+make_user(unsigned int num)
+{
+  struct Client *cptr = (struct Client *)MyCalloc(1, sizeof(*cptr));
+  struct User *user = (struct User *)MyCalloc(1, sizeof(*user));
+
+  cli_status(cptr) = STAT_USER;
+  cli_serial(cptr) = num + 1;
+  ircd_snprintf(0, cli_name(cptr), NICKLEN + 1, "bench%u", num);
+  inttobase64(cli_yxx(cptr), num, 3);
+  user->server = &bench_server;
+  ircd_strncpy(user->username, "~bench", USERLEN);
+  ircd_snprintf(0, user->host, HOSTLEN + 1, "host%u.example.net", num);
+  cli_user(cptr) = user;
+  return cptr;
+}
+
+/** Set up the fake network used by the benchmarks. */
+static void
+setup(void)
+{
+  const char chname[] = "#benchmark";
+  unsigned int ii;
+
+  cli_status(&me) = STAT_ME;
+  ircd_strncpy(cli_name(&me), "bench.example.net", HOSTLEN);
+  ircd_strncpy(cli_yxx(&me), "AB", 2);
+
+  cli_status(&bench_server) = STAT_SERVER;
+  ircd_strncpy(cli_name(&bench_server), "leaf.example.net", HOSTLEN);
+  ircd_strncpy(cli_yxx(&bench_server), "AC", 2);
+
+  init_hash();
+  for (ii = 0; ii < BENCH_USERS; ++ii) {
+    bench_users[ii] = make_user(ii);
+    hAddClient(bench_users[ii]);
+  }
+
+  bench_channel = (struct Channel *)MyCalloc(1, sizeof(struct Channel) +
+                                             strlen(chname));
+  strcpy(bench_channel->chname, chname);
+  hAddChannel(bench_channel);
+
+  /* A full silence list, none of which matches the benchmark users. */
+  for (ii = 0; ii < BENCH_SILENCES; ++ii) {
+    struct Ban *ban = (struct Ban *)MyCalloc(1, sizeof(*ban));
+    char *sep;
+
+    switch (ii % 5) {
+    case 0:
+      ircd_snprintf(0, ban->banstr, sizeof(ban->banstr),
+                    "*!*@*.spam%u.example.com", ii);
+      break;
+    case 1:
+      ircd_snprintf(0, ban->banstr, sizeof(ban->banstr), "flood%u!*@*", ii);
+      break;
+    case 2:
+      ircd_snprintf(0, ban->banstr, sizeof(ban->banstr),
+                    "*!*@10.%u.0.0/16", ii);
+      break;
+    case 3:
+      ircd_snprintf(0, ban->banstr, sizeof(ban->banstr),
+                    "*!*@shell%u.example.org", ii);
+      break;
+    default:
+      ircd_snprintf(0, ban->banstr, sizeof(ban->banstr),
+                    "*!~troll%u@*", ii);
+      break;
+    }
+    sep = strrchr(ban->banstr, '@');
+    ban->nu_len = sep - ban->banstr;
+    if (ipmask_parse(sep + 1, &ban->address, &ban->addrbits))
+      ban->flags |= BAN_IPMASK;
+    ban->next = bench_silencer.silence;
+    bench_silencer.silence = ban;
+  }
+  silence_update(&bench_silencer);
+}
+
+/*
+ * Benchmarks.
+ */
+
+static void
+bench_match_literal(unsigned long count)
+{
+  while (count--)
+    sink += match("irc.example.net", "irc.example.net");
+}
+
+static void
+bench_match_wild(unsigned long count)
+{
+  while (count--)
+    sink += match("*!*@*.example.net", "someone!~user@host.dsl.example.net");
+}
+
+static void
+bench_match_miss(unsigned long count)
+{
+  while (count--)
+    sink += match("*!*@*.example.org", "someone!~user@host.dsl.example.net");
+}
+
+static void
+bench_matchexec(unsigned long count)
+{
+  char cmask[128];
+  int minlen, charset;
+
+  matchcomp(cmask, &minlen, &charset, "*!*@*.example.net");
+  while (count--)
+    sink += matchexec("someone!~user@host.dsl.example.net", cmask, minlen);
+}
+
+static void
+bench_mmatch(unsigned long count)
+{
+  while (count--)
+    sink += mmatch("*!*@*.example.net", "*!*@host?.dsl.example.net");
+}
+
+static void
+bench_ipmask_check(unsigned long count)
+{
+  struct irc_in_addr addr, mask;
+  unsigned char bits;
+
+  ipmask_parse("10.1.0.0/16", &mask, &bits);
+  ipmask_parse("10.1.200.17", &addr, 0);
+  while (count--)
+    sink += ipmask_check(&addr, &mask, bits);
+}
+
+static void
+bench_string_classify(unsigned long count)
+{
+  while (count--)
+    sink += string_classify(text);
+}
+
+static void
+bench_hash_seek_client(unsigned long count)
+{
+  char names[64][NICKLEN + 1];
+  unsigned int ii;
+
+  for (ii = 0; ii < 64; ++ii)
+    strcpy(names[ii], cli_name(bench_users[(ii * 313) % BENCH_USERS]));
+  for (ii = 0; count--; ++ii)
+    sink += (unsigned long)hSeekClient(names[ii & 63], STAT_USER);
+}
+
+static void
+bench_hash_seek_miss(unsigned long count)
+{
+  while (count--)
+    sink += (unsigned long)hSeekClient("NoSuchNick", STAT_USER);
+}
+
+static void
+bench_hash_seek_channel(unsigned long count)
+{
+  while (count--)
+    sink += (unsigned long)hSeekChannel("#BenchMark");
+}
+
+static void
+bench_msgq_make(unsigned long count)
+{
+  struct Client *from = bench_users[1], *to = bench_users[2];
+  struct MsgBuf *mb;
+
+  while (count--) {
+    mb = msgq_make(to, "%:#C %s %H :%s", from, MSG_PRIVATE, bench_channel,
+                   text);
+    msgq_clean(mb);
+  }
+}
+
+static void
+bench_msgq_make_server(unsigned long count)
+{
+  struct Client *from = bench_users[1];
+  struct MsgBuf *mb;
+
+  while (count--) {
+    mb = msgq_make(&bench_server, "%C %s %H :%s", from, TOK_PRIVATE,
+                   bench_channel, text);
+    msgq_clean(mb);
+  }
+}
+
+static void
+bench_msgq_make_text(unsigned long count)
+{
+  struct Client *from = bench_users[1], *to = bench_users[2];
+  struct MsgBuf *mb;
+
+  while (count--) {
+    mb = msgq_make_text(to, from, MSG_PRIVATE, bench_channel->chname, text);
+    msgq_clean(mb);
+  }
+}
+
+static void
+bench_msgq_make_text_server(unsigned long count)
+{
+  struct Client *from = bench_users[1];
+  struct MsgBuf *mb;
+
+  while (count--) {
+    mb = msgq_make_text(&bench_server, from, TOK_PRIVATE,
+                        bench_channel->chname, text);
+    msgq_clean(mb);
+  }
+}
+
+static void
+bench_msgq_add_mapiov_delete(unsigned long count)
+{
+  struct iovec iov[BENCH_QUEUE];
+  struct MsgQ mq;
+  struct MsgBuf *mb;
+  unsigned int len, ii;
+
+  memset(&mq, 0, sizeof(mq)); /* msgq_init() leaves the sent counts alone */
+  msgq_init(&mq);
+  mb = msgq_make(bench_users[2], "%:#C %s %H :%s", bench_users[1],
+                 MSG_PRIVATE, bench_channel, text);
+  for (; count >= BENCH_QUEUE; count -= BENCH_QUEUE) {
+    for (ii = 0; ii < BENCH_QUEUE; ++ii)
+      msgq_add(&mq, mb, 0);
+    len = 0;
+    sink += msgq_mapiov(&mq, iov, BENCH_QUEUE, &len);
+    msgq_delete(&mq, len);
+  }
+  msgq_clean(mb);
+}
+
+/** Writing end of the loopback connection for the send benchmarks. */
+static int bench_send_fd = -1;
+/** Reading end of the loopback connection for the send benchmarks. */
+static int bench_recv_fd = -1;
+
+/** Open a non-blocking loopback TCP connection for the send
+ * benchmarks.
+ */
+static void
+bench_send_setup(void)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof(sin);
+  int lfd;
+
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+      || bind(lfd, (struct sockaddr *)&sin, sizeof(sin))
+      || listen(lfd, 1)
+      || getsockname(lfd, (struct sockaddr *)&sin, &len)
+      || (bench_send_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+      || connect(bench_send_fd, (struct sockaddr *)&sin, sizeof(sin))
+      || (bench_recv_fd = accept(lfd, 0, 0)) < 0
+      || !os_set_nonblocking(bench_send_fd)
+      || !os_set_nonblocking(bench_recv_fd)) {
+    perror("bench_send_setup");
+    exit(1);
+  }
+  close(lfd);
+}
+
+/** Send messages over a loopback connection the way deliver_copy()
+ * does, keeping BENCH_BACKLOG of them queued.  The reader drains the
+ * connection after every write; that costs the same per byte for
+ * both paths.
+ * @param[in] count Number of messages to send.
+ * @param[in] length Length of each message, including CR LF.
+ * @param[in] size Buffer size for os_send_coalesced(), or 0 to gather
+ * with os_sendv_nonb().
+ */
+static void
+bench_send(unsigned long count, unsigned int length, unsigned int size)
+{
+  static char rbuf[65536];
+  char line[BUFSIZE];
+  struct MsgQ mq;
+  struct MsgBuf *mb;
+  unsigned int before, in, out;
+
+  if (bench_send_fd < 0)
+    bench_send_setup();
+  memset(&mq, 0, sizeof(mq));
+  msgq_init(&mq);
+  memset(line, 'x', length - 2);
+  line[length - 2] = '\0';
+  mb = msgq_make(bench_users[0], "%s", line);
+  while (count) {
+    while (MsgQCount(&mq) < BENCH_BACKLOG && MsgQCount(&mq) < count)
+      msgq_add(&mq, mb, 0);
+    before = MsgQCount(&mq);
+    in = 0;
+    if (size)
+      os_send_coalesced(bench_send_fd, &mq, size, &in, &out);
+    else
+      os_sendv_nonb(bench_send_fd, &mq, &in, &out);
+    msgq_delete(&mq, out);
+    count -= before - MsgQCount(&mq);
+    while (recv(bench_recv_fd, rbuf, sizeof(rbuf), 0) > 0)
+      ;
+  }
+  MsgQClear(&mq);
+  msgq_clean(mb);
+  while (recv(bench_recv_fd, rbuf, sizeof(rbuf), 0) > 0)
+    ;
+}
+
+/** Define gather and coalesce benchmarks for one message length. */
+#define BENCH_SEND(length) \
+static void \
+bench_send_gather_##length(unsigned long count) \
+{ \
+  bench_send(count, length, 0); \
+} \
+static void \
+bench_send_coalesce16k_##length(unsigned long count) \
+{ \
+  bench_send(count, length, 16384); \
+} \
+static void \
+bench_send_coalesce32k_##length(unsigned long count) \
+{ \
+  bench_send(count, length, 32768); \
+} \
+static void \
+bench_send_coalesce64k_##length(unsigned long count) \
+{ \
+  bench_send(count, length, 65536); \
+}
+
+BENCH_SEND(40)
+BENCH_SEND(80)
+BENCH_SEND(120)
+BENCH_SEND(160)
+BENCH_SEND(200)
+BENCH_SEND(500)
+
+/** A typical MOTD line, for the MOTD benchmarks. */
+static const char motd_line[] = "Welcome to the benchmark network; "
+  "please read the rules.";
+
+static void
+bench_motd_line_format(unsigned long count)
+{
+  struct iovec iov[BENCH_QUEUE];
+  struct MsgQ mq;
+  struct MsgBuf *mb;
+  unsigned int len, ii;
+
+  memset(&mq, 0, sizeof(mq));
+  msgq_init(&mq);
+  for (; count >= BENCH_QUEUE; count -= BENCH_QUEUE) {
+    for (ii = 0; ii < BENCH_QUEUE; ++ii) {
+      mb = msgq_make(bench_users[2], "%:#C %s %C :- %s", &me, "372",
+                     bench_users[2], motd_line);
+      msgq_add(&mq, mb, 0);
+      msgq_clean(mb);
+    }
+    len = 0;
+    sink += msgq_mapiov(&mq, iov, BENCH_QUEUE, &len);
+    msgq_delete(&mq, len);
+  }
+}
+
+static void
+bench_motd_line_shared(unsigned long count)
+{
+  struct iovec iov[2 * BENCH_QUEUE];
+  struct MsgQ mq;
+  struct MsgBuf *head, *tail;
+  unsigned int len, ii;
+
+  memset(&mq, 0, sizeof(mq));
+  msgq_init(&mq);
+  tail = msgq_fit(msgq_make(0, ":- %s", motd_line));
+  for (; count >= BENCH_QUEUE; count -= BENCH_QUEUE) {
+    head = msgq_make_head(bench_users[2], "%:#C %s %C ", &me, "372",
+                          bench_users[2]);
+    for (ii = 0; ii < BENCH_QUEUE; ++ii)
+      msgq_add_tail(&mq, head, tail, 0);
+    msgq_clean(head);
+    len = 0;
+    sink += msgq_mapiov(&mq, iov, 2 * BENCH_QUEUE, &len);
+    msgq_delete(&mq, len);
+  }
+  msgq_clean(tail);
+}
+
+static void
+bench_dbuf_put_getmsg(unsigned long count)
+{
+  char line[] = ":bench1!~bench@host1.example.net PRIVMSG #benchmark "
+    ":Lorem ipsum dolor sit amet, consectetur adipiscing elit\r\n";
+  char buf[512];
+  struct DBuf dyn;
+
+  memset(&dyn, 0, sizeof(dyn));
+  while (count--) {
+    dbuf_put(&dyn, line, sizeof(line) - 1);
+    sink += dbuf_getmsg(&dyn, buf, sizeof(buf));
+  }
+  dbuf_delete(&dyn, DBufLength(&dyn));
+}
+
+static void
+bench_dbuf_put_getmsg_batch(unsigned long count)
+{
+  char line[] = ":bench1!~bench@host1.example.net PRIVMSG #benchmark "
+    ":Lorem ipsum dolor sit amet, consectetur adipiscing elit\r\n";
+  char buf[512];
+  struct DBuf dyn;
+  unsigned int ii;
+
+  memset(&dyn, 0, sizeof(dyn));
+  for (; count >= 64; count -= 64) {
+    for (ii = 0; ii < 64; ++ii)
+      dbuf_put(&dyn, line, sizeof(line) - 1);
+    for (ii = 0; ii < 64; ++ii)
+      sink += dbuf_getmsg(&dyn, buf, sizeof(buf));
+  }
+  dbuf_delete(&dyn, DBufLength(&dyn));
+}
+
+static void
+bench_snprintf_C(unsigned long count)
+{
+  char buf[512];
+
+  while (count--)
+    sink += ircd_snprintf(bench_users[2], buf, sizeof(buf), ":%C",
+                          bench_users[1]);
+}
+
+static void
+bench_snprintf_C_prefix(unsigned long count)
+{
+  char buf[512];
+
+  while (count--)
+    sink += ircd_snprintf(bench_users[2], buf, sizeof(buf), "%:#C",
+                          bench_users[1]);
+}
+
+static void
+bench_snprintf_C_numeric(unsigned long count)
+{
+  char buf[512];
+
+  while (count--)
+    sink += ircd_snprintf(&bench_server, buf, sizeof(buf), "%C",
+                          bench_users[1]);
+}
+
+static void
+bench_snprintf_H(unsigned long count)
+{
+  char buf[512];
+
+  while (count--)
+    sink += ircd_snprintf(bench_users[2], buf, sizeof(buf), "%H",
+                          bench_channel);
+}
+
+/** Format a string through a nested %v, like the send.c helpers do.
+ * @param[out] buf Output buffer.
+ * @param[in] buflen Length of \a buf.
+ * @param[in] pattern Format for the nested arguments.
+ * @return Number of characters that would have been written.
+ */
+static int
+snprintf_v(char *buf, size_t buflen, const char *pattern, ...)
+{
+  struct VarData vd;
+  int res;
+
+  vd.vd_format = pattern;
+  va_start(vd.vd_args, pattern);
+  res = ircd_snprintf(bench_users[2], buf, buflen, "%:#C %s %v",
+                      bench_users[1], MSG_PRIVATE, &vd);
+  va_end(vd.vd_args);
+  return res;
+}
+
+static void
+bench_snprintf_v(unsigned long count)
+{
+  char buf[512];
+
+  while (count--)
+    sink += snprintf_v(buf, sizeof(buf), "%H :%s", bench_channel, text);
+}
+
+static void
+bench_base64toint(unsigned long count)
+{
+  static const char *nums[4] = { "AB", "ACAAB", "]]]]]", "B]AAAB" };
+  unsigned int ii;
+
+  for (ii = 0; count--; ++ii)
+    sink += base64toint(nums[ii & 3]);
+}
+
+static void
+bench_inttobase64(unsigned long count)
+{
+  char buf[8];
+
+  while (count--)
+    sink += *inttobase64(buf, count, 5);
+}
+
+/** Record a message to \a target the way check_target_limit() does.
+ * @param[in,out] pset Target set of the sender.
+ * @param[in] target Target of the message.
+ */
+static void
+bench_target_send(struct TargetSet **pset, const void *target)
+{
+  if (!target_touch(*pset, target))
+    target_add(pset, target, 0);
+}
+
+static void
+bench_target_recent(unsigned long count)
+{
+  struct TargetSet *set = 0;
+  unsigned int ii;
+
+  /* A busy user talking to a handful of channels and friends. */
+  for (ii = 0; count--; ++ii)
+    bench_target_send(&set, bench_users[ii % 10]);
+  sink += target_count(set);
+  target_free(set);
+}
+
+static void
+bench_target_new(unsigned long count)
+{
+  struct TargetSet *set = 0;
+  unsigned int ii;
+
+  /* A spammer reaching a new target with every message. */
+  for (ii = 0; count--; ++ii)
+    bench_target_send(&set, bench_users[ii % BENCH_USERS]);
+  sink += target_count(set);
+  target_free(set);
+}
+
+static void
+bench_target_mixed(unsigned long count)
+{
+  struct TargetSet *set = 0;
+  unsigned int ii;
+
+  /* Mostly recent targets, with a new one every 16 messages and
+   * incoming messages adding reserved targets. */
+  for (ii = 0; count--; ++ii) {
+    if ((ii & 15) == 0)
+      bench_target_send(&set, bench_users[(ii >> 4) % BENCH_USERS]);
+    else if ((ii & 15) == 1) {
+      if (!target_find(set, bench_users[BENCH_USERS - 1 - (ii >> 4) % 64]))
+        target_add(&set, bench_users[BENCH_USERS - 1 - (ii >> 4) % 64], 1);
+    } else
+      bench_target_send(&set, bench_users[ii % 12]);
+  }
+  sink += target_count(set);
+  target_free(set);
+}
+
+static void
+bench_silence_find(unsigned long count)
+{
+  unsigned int ii;
+
+  /* A different sender every time, so the result cache never hits. */
+  for (ii = 0; count--; ++ii)
+    sink += !!silence_find(bench_users[ii % BENCH_USERS], &bench_silencer);
+}
+
+static void
+bench_silence_find_cached(unsigned long count)
+{
+  while (count--)
+    sink += !!silence_find(bench_users[0], &bench_silencer);
+}
+
+static void
+bench_crypt_sha512(unsigned long count)
+{
+  while (count--)
+    sink += ircd_crypt_sha512("oper-password", "abcdefghijklmnop")[0];
+}
+
+static void
+bench_crypt_pbkdf2(unsigned long count)
+{
+  while (count--)
+    sink += ircd_crypt_pbkdf2("oper-password", "abcdefghijklmnop")[0];
+}
+
+/** All benchmarks, in the order they are run. */
+static const struct bench benchmarks[] = {
+  { "match_literal", bench_match_literal },
+  { "match_wild", bench_match_wild },
+  { "match_miss", bench_match_miss },
+  { "matchexec", bench_matchexec },
+  { "mmatch", bench_mmatch },
+  { "ipmask_check", bench_ipmask_check },
+  { "string_classify", bench_string_classify },
+  { "hash_seek_client", bench_hash_seek_client },
+  { "hash_seek_miss", bench_hash_seek_miss },
+  { "hash_seek_channel", bench_hash_seek_channel },
+  { "msgq_make", bench_msgq_make },
+  { "msgq_make_server", bench_msgq_make_server },
+  { "msgq_make_text", bench_msgq_make_text },
+  { "msgq_make_text_server", bench_msgq_make_text_server },
+  { "msgq_add_mapiov_delete", bench_msgq_add_mapiov_delete },
+  { "send_gather_40", bench_send_gather_40 },
+  { "send_coalesce16k_40", bench_send_coalesce16k_40 },
+  { "send_coalesce32k_40", bench_send_coalesce32k_40 },
+  { "send_coalesce64k_40", bench_send_coalesce64k_40 },
+  { "send_gather_80", bench_send_gather_80 },
+  { "send_coalesce16k_80", bench_send_coalesce16k_80 },
+  { "send_coalesce32k_80", bench_send_coalesce32k_80 },
+  { "send_coalesce64k_80", bench_send_coalesce64k_80 },
+  { "send_gather_120", bench_send_gather_120 },
+  { "send_coalesce16k_120", bench_send_coalesce16k_120 },
+  { "send_coalesce32k_120", bench_send_coalesce32k_120 },
+  { "send_coalesce64k_120", bench_send_coalesce64k_120 },
+  { "send_gather_160", bench_send_gather_160 },
+  { "send_coalesce16k_160", bench_send_coalesce16k_160 },
+  { "send_coalesce32k_160", bench_send_coalesce32k_160 },
+  { "send_coalesce64k_160", bench_send_coalesce64k_160 },
+  { "send_gather_200", bench_send_gather_200 },
+  { "send_coalesce16k_200", bench_send_coalesce16k_200 },
+  { "send_coalesce32k_200", bench_send_coalesce32k_200 },
+  { "send_coalesce64k_200", bench_send_coalesce64k_200 },
+  { "send_gather_500", bench_send_gather_500 },
+  { "send_coalesce16k_500", bench_send_coalesce16k_500 },
+  { "send_coalesce32k_500", bench_send_coalesce32k_500 },
+  { "send_coalesce64k_500", bench_send_coalesce64k_500 },
+  { "motd_line_format", bench_motd_line_format },
+  { "motd_line_shared", bench_motd_line_shared },
+  { "dbuf_put_getmsg", bench_dbuf_put_getmsg },
+  { "dbuf_put_getmsg_batch", bench_dbuf_put_getmsg_batch },
+  { "snprintf_C", bench_snprintf_C },
+  { "snprintf_C_prefix", bench_snprintf_C_prefix },
+  { "snprintf_C_numeric", bench_snprintf_C_numeric },
+  { "snprintf_H", bench_snprintf_H },
+  { "snprintf_v", bench_snprintf_v },
+  { "base64toint", bench_base64toint },
+  { "inttobase64", bench_inttobase64 },
+  { "target_recent", bench_target_recent },
+  { "target_new", bench_target_new },
+  { "target_mixed", bench_target_mixed },
+  { "silence_find", bench_silence_find },
+  { "silence_find_cached", bench_silence_find_cached },
+  { "crypt_sha512", bench_crypt_sha512, 1 },
+  { "crypt_pbkdf2", bench_crypt_pbkdf2, 1 },
+  { 0 }
+};
+
+/** Return the current monotonic time in nanoseconds. */
+static unsigned long long
+now_nsec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** Run a benchmark and print its result.
+ * @param[in] bench Benchmark to run.
+ */
+static void
+run_bench(const struct bench *bench)
+{
+  unsigned long long start, elapsed;
+  unsigned long count;
+
+  count = bench->start ? bench->start : 1000;
+  bench->func(count); /* warm caches and allocators */
+  for (; ; count *= 2) {
+    start = now_nsec();
+    bench->func(count);
+    elapsed = now_nsec() - start;
+    if (elapsed >= BENCH_MIN_NSEC || count >= (1UL << 30))
+      break;
+  }
+  printf("%s\t%lu\t%.2f\n", bench->name, count, (double)elapsed / count);
+  fflush(stdout);
+}
+
+/** Check whether a benchmark was selected on the command line.
+ * @param[in] name Name of the benchmark.
+ * @param[in] argc Number of arguments.
+ * @param[in] argv Arguments; name prefixes to run.
+ * @return Non-zero if the benchmark should be run.
+ */
+static int
+selected(const char *name, int argc, char *argv[])
+{
+  int ii;
+
+  if (argc < 2)
+    return 1;
+  for (ii = 1; ii < argc; ++ii)
+    if (!strncmp(name, argv[ii], strlen(argv[ii])))
+      return 1;
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const struct bench *bench;
+
+  setup();
+  printf("# name\titerations\tns_per_op\n");
+  for (bench = benchmarks; bench->name; ++bench)
+    if (selected(bench->name, argc, argv))
+      run_bench(bench);
+  return 0;
+}
@@ -0,0 +1,173 @@
+/* ircd_crypt_t.c - Test file for asynchronous password checks */
+
+#include "ircd_crypt.h"
+#include "ircd_events.h"
+#include "ircd_features.h"
+#include "ircd_log.h"
+#include "ircd_osdep.h"
+#include <stdio.h>
+#include <string.h>
+
+/** Hash of "secret" using the (slow) SHA-512 mechanism. */
+static const char slow_hash[] = "$6$liM5wXEddlteFY6f$DwT7ShipuXgGoislUde6Tf3"
+  "TsyYlLQxmBM822zt7/ZBlmU3ZT8ugWxTYhJzOipwZKXCtSc0gHOjdPPx5R6i2p1";
+
+int maxconnections;
+
+/** Value returned for FEAT_CRYPT_WORKERS. */
+static unsigned int crypt_workers;
+/** Number of calls to os_socketpair(). */
+static unsigned int socketpair_calls;
+/** Last timer added by the crypt code. */
+static struct Timer *last_timer;
+
+unsigned int
+feature_uint(enum Feature feat)
+{
+    assert(feat == FEAT_CRYPT_WORKERS);
+    return crypt_workers;
+}
+
+/* Workers never start: creating their socket always fails. */
+int
+os_socketpair(int sv[2])
+{
+    socketpair_calls++;
+    return -1;
+}
+
+int
+os_set_nonblocking(int fd)
+{
+    assert(0 && "no worker socket to set up");
+    return 0;
+}
+
+IOResult
+os_send_nonb(int fd, const char *buf, unsigned int length,
+             unsigned int *count_out)
+{
+    assert(0 && "no worker to send to");
+    return IO_FAILURE;
+}
+
+IOResult
+os_recv_nonb(int fd, char *buf, unsigned int length, unsigned int *count_out)
+{
+    assert(0 && "no worker to receive from");
+    return IO_FAILURE;
+}
+
+int
+socket_add(struct Socket *sock, EventCallBack call, void *data,
+           enum SocketState state, unsigned int events, int fd)
+{
+    assert(0 && "no worker socket to add");
+    return 0;
+}
+
+void
+socket_del(struct Socket *sock)
+{
+    assert(0 && "no worker socket to delete");
+}
+
+struct Timer *
+timer_init(struct Timer *timer)
+{
+    memset(timer, 0, sizeof(*timer));
+    return timer;
+}
+
+void
+timer_add(struct Timer *timer, EventCallBack call, void *data,
+          enum TimerType type, time_t value)
+{
+    timer->t_header.gh_flags |= GEN_ACTIVE;
+    timer->t_header.gh_call = call;
+    timer->t_header.gh_data = data;
+    timer->t_type = type;
+    timer->t_value = value;
+    last_timer = timer;
+}
+
+/** Expire the last timer added, as timer_run() would.
+ * @return Non-zero if a timer was pending.
+ */
+static int
+run_timer(void)
+{
+    struct Timer *timer = last_timer;
+    struct Event ev;
+
+    if (!timer || !t_active(timer))
+        return 0;
+    memset(&ev, 0, sizeof(ev));
+    ev.ev_type = ET_EXPIRE;
+    ev.ev_gen.gen_timer = timer;
+    timer->t_header.gh_call(&ev);
+    timer->t_header.gh_flags &= ~GEN_ACTIVE;
+    return 1;
+}
+
+/** Result of a password check. */
+struct check {
+    int calls; /**< Number of times the callback ran. */
+    int match; /**< Result passed to the last call. */
+};
+
+/** Callback for ircd_crypt_check().
+ * @param[in] ctx Check being completed.
+ * @param[in] match Result of the check.
+ */
+static void
+check_done(void *ctx, int match)
+{
+    struct check *check = ctx;
+
+    check->calls++;
+    check->match = match;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct CryptRequest *req;
+    struct check good, bad, gone;
+
+    ircd_crypt_init();
+
+    printf("Testing synchronous checks..\n");
+    memset(&good, 0, sizeof(good));
+    crypt_workers = 0;
+    req = ircd_crypt_check("secret", slow_hash, check_done, &good);
+    assert(req == NULL && good.calls == 1 && good.match == 1);
+    memset(&good, 0, sizeof(good));
+    crypt_workers = 2;
+    req = ircd_crypt_check("secret", "$PLAIN$secret", check_done, &good);
+    assert(req == NULL && good.calls == 1 && good.match == 1);
+    assert(socketpair_calls == 0);
+
+    printf("Testing checks when no worker can start..\n");
+    memset(&good, 0, sizeof(good));
+    memset(&bad, 0, sizeof(bad));
+    memset(&gone, 0, sizeof(gone));
+    req = ircd_crypt_check("secret", slow_hash, check_done, &good);
+    assert(req != NULL && good.calls == 0);
+    assert(socketpair_calls > 0);
+    req = ircd_crypt_check("wrong", slow_hash, check_done, &bad);
+    assert(req != NULL && bad.calls == 0);
+    req = ircd_crypt_check("secret", slow_hash, check_done, &gone);
+    assert(req != NULL && gone.calls == 0);
+    ircd_crypt_cancel(req);
+    assert(gone.calls == 1 && gone.match == -1);
+
+    assert(run_timer());
+    assert(good.calls == 1 && good.match == 1);
+    assert(bad.calls == 1 && bad.match == 0);
+    assert(gone.calls == 1);
+    assert(!run_timer());
+
+    printf("Passed.\n");
+    return 0;
+}
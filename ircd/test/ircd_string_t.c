@@ -6,12 +6,34 @@
 #include <stdlib.h>
 #include <string.h>
 
+/** Expected string_classify() results. */
+static const struct {
+  const char* text;
+  unsigned int flags;
+} classify_tests[] = {
+  { "hello world", 0 },
+  { "\00304red\003 text", TEXT_COLOR },
+  { "\033[1mansi", TEXT_COLOR },
+  { "\002bold\002 and \037underline", TEXT_FORMAT },
+  { "\001VERSION\001", TEXT_CTCP },
+  { "\001ACTION waves\001", TEXT_ACTION },
+  { "\001action \00304waves", TEXT_ACTION | TEXT_COLOR },
+  { "look: \001ACTION hidden\001", TEXT_CTCP },
+  { "caf\303\251", TEXT_HIGHBIT },
+  { "WHY IS EVERYONE SHOUTING", TEXT_CAPS },
+  { "OK LOL", 0 },
+  { "Hello There Everyone Here", 0 },
+  { "", 0 }
+};
+
 int main(void)
 {
   char* vector[20];
   char* names;
   int count;
   int i;
+  int failed = 0;
+  unsigned int flags;
 
   names = strdup(",,,a,b,a,X,ne,blah,A,z,#foo,&Bar,foo,,crud,Foo,z,x,bzet,,");
   printf("input: %s\n", names);
@@ -53,6 +75,15 @@ int main(void)
   printf("\n");
   free(names);
 
-  return 0;
+  for (i = 0; i < (int) (sizeof(classify_tests) / sizeof(classify_tests[0])); ++i) {
+    flags = string_classify(classify_tests[i].text);
+    printf("classify %d: %#x\n", i, flags);
+    if (flags != classify_tests[i].flags) {
+      printf("  expected %#x\n", classify_tests[i].flags);
+      failed = 1;
+    }
+  }
+
+  return failed;
 }
   
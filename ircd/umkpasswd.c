@@ -40,6 +40,8 @@
 #include "ircd_crypt_smd5.h"
 #include "ircd_crypt_native.h"
 #include "ircd_crypt_plain.h"
+#include "ircd_crypt_sha512.h"
+#include "ircd_crypt_pbkdf2.h"
 
 /* bleah, evil globals */
 static umkpasswd_conf_t* umkpasswd_conf;
@@ -139,6 +141,33 @@ long int n = 0;
 return tmp;
 }
 
+/** Length of the salts made by make_long_salt(). */
+#define LONG_SALT_LEN 16
+
+/* salt generator for the mechanisms that take long salts */
+static char *make_long_salt(const char *salts)
+{
+char *tmp = NULL;
+unsigned char rnd[LONG_SALT_LEN];
+FILE *fp;
+int i;
+
+ if (NULL == (fp = fopen("/dev/urandom", "r")))
+ {
+  fprintf(stderr, "Unable to open /dev/urandom\n");
+  return NULL;
+ }
+ if (fread(rnd, 1, sizeof(rnd), fp) == sizeof(rnd)
+     && (tmp = calloc(LONG_SALT_LEN + 1, sizeof(char))) != NULL)
+ {
+  for (i = 0; i < LONG_SALT_LEN; i++)
+   tmp[i] = salts[rnd[i] % strlen(salts)];
+ }
+ fclose(fp);
+
+return tmp;
+}
+
 /* our implementation of ircd_crypt_register_mech() */
 int ircd_crypt_register_mech(crypt_mech_t* mechanism)
 {
@@ -244,6 +273,8 @@ static void load_mechs(void)
  ircd_register_crypt_native();
  ircd_register_crypt_smd5();
  ircd_register_crypt_plain(); /* yes I know it's slightly pointless */
+ ircd_register_crypt_sha512();
+ ircd_register_crypt_pbkdf2();
 
 return;
 }
@@ -288,7 +319,14 @@ char* salt, *untagged, *tagged;
   return NULL;
  }
 
- salt = make_salt(default_salts);
+ if (0 == ircd_strcmp(MechName(crypt_mech->mech), "sha512")
+     || 0 == ircd_strcmp(MechName(crypt_mech->mech), "pbkdf2"))
+  salt = make_long_salt(default_salts);
+ else
+  salt = make_salt(default_salts);
+
+ if (NULL == salt)
+  return NULL;
 
  untagged = (char *)CryptFunc(crypt_mech->mech)(pw, salt);
  tagged = (char *)MyMalloc(strlen(untagged)+CryptTokSize(crypt_mech->mech)+1);
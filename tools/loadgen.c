@@ -0,0 +1,899 @@
+/*
+ * IRC - Internet Relay Chat, tools/loadgen.c
+ *
+ * See file AUTHORS in IRC package for additional names of
+ * the programmers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief Synthetic client load generator for end-to-end benchmarks.
+ *
+ * loadgen opens a (possibly very large) number of client connections
+ * to a single ircd, registers them, joins them to channels following
+ * a configurable channel-size distribution and then drives a mix of
+ * PRIVMSG, JOIN, PART, NICK and QUIT commands at a target rate.
+ *
+ * Every PRIVMSG carries the time it was sent, so each recipient can
+ * measure the delivery latency as observed by a client.  Since all
+ * connections to the server belong to loadgen, the number of lines
+ * received by all clients is the number of lines the server emitted;
+ * this is reported as the server-side message rate.
+ *
+ * It is built standalone, without the rest of the source tree:
+ *
+ *   cc -O2 -o loadgen loadgen.c
+ *   ./loadgen [-v] [-s server] [-p port] [-d seconds] scenario-file
+ *
+ * The scenario file format is documented in loadgen.scn, which is
+ * also the reference scenario used to compare ircd versions.  The
+ * summary is printed on stdout as "key value" lines so that it can
+ * be parsed by scripts.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#define LG_MAXGROUPS	32	/**< Maximum number of "channels" lines. */
+#define LG_MAXCHANS	10	/**< Maximum channels joined per client. */
+#define LG_RBUFSIZE	8192	/**< Size of per-client input buffer. */
+#define LG_TICK		10	/**< Scheduler tick, in milliseconds. */
+
+#define HIST_SUB_BITS	5	/**< Log2 of sub-buckets per power of two. */
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_SIZE	(HIST_SUB * (32 - HIST_SUB_BITS + 3))
+
+/** Commands in the traffic mix. */
+enum Action {
+  ACT_PRIVMSG,		/**< PRIVMSG to a joined channel */
+  ACT_PRIVMSG_USER,	/**< PRIVMSG to another client */
+  ACT_JOIN,		/**< JOIN an additional channel */
+  ACT_PART,		/**< PART a joined channel */
+  ACT_NICK,		/**< change nickname */
+  ACT_QUIT,		/**< QUIT and reconnect later */
+  ACT_COUNT		/**< number of actions */
+};
+
+/** Names of the actions, as used in the scenario file and summary. */
+static const char *action_names[ACT_COUNT] = {
+  "privmsg", "privmsg_user", "join", "part", "nick", "quit"
+};
+
+/** Connection states of a simulated client. */
+enum ClientState {
+  CS_DOWN,		/**< not connected */
+  CS_CONNECTING,	/**< non-blocking connect() in progress */
+  CS_REGISTERING,	/**< NICK/USER sent, waiting for RPL_WELCOME */
+  CS_READY,		/**< registered and eligible for actions */
+  CS_QUITTING		/**< QUIT sent, waiting for the server to close */
+};
+
+/** A channel-size group: \a count channels with \a size members each. */
+struct ChanGroup {
+  unsigned int count;	/**< number of channels in the group */
+  unsigned int size;	/**< initial members per channel */
+  unsigned int first;	/**< index of the first channel of the group */
+};
+
+/** One simulated client. */
+struct LgClient {
+  int fd;			/**< socket, or -1 */
+  enum ClientState state;	/**< connection state */
+  unsigned int gen;		/**< nick generation counter */
+  char nick[16];		/**< current nickname */
+  unsigned int plan[LG_MAXCHANS]; /**< channels to join on connect */
+  unsigned int nplan;		/**< number of entries in \a plan */
+  unsigned int chans[LG_MAXCHANS]; /**< channels currently joined */
+  unsigned int nchans;		/**< number of entries in \a chans */
+  char *wbuf;			/**< pending output */
+  size_t wlen;			/**< bytes in \a wbuf */
+  size_t wsize;			/**< allocated size of \a wbuf */
+  size_t rlen;			/**< bytes in \a rbuf */
+  char rbuf[LG_RBUFSIZE];	/**< partial input line */
+};
+
+/** Scenario description, as read from the scenario file. */
+static struct Scenario {
+  char server[64];		/**< server address */
+  unsigned int port;		/**< server port */
+  struct in_addr source;	/**< first local source address */
+  unsigned int nsources;	/**< number of source addresses */
+  unsigned int clients;		/**< number of clients */
+  unsigned int connect_rate;	/**< connection attempts per second */
+  unsigned int rate;		/**< actions per second */
+  unsigned int mix[ACT_COUNT];	/**< relative action weights */
+  unsigned int payload;		/**< bytes of PRIVMSG text */
+  unsigned int warmup;		/**< seconds of unmeasured traffic */
+  unsigned int duration;	/**< seconds of measured traffic */
+  unsigned int settle;		/**< seconds to wait for registrations */
+  unsigned int seed;		/**< PRNG seed */
+  char prefix[8];		/**< nickname and channel name prefix */
+  struct ChanGroup groups[LG_MAXGROUPS]; /**< channel-size distribution */
+  unsigned int ngroups;		/**< number of channel groups */
+  unsigned int nchannels;	/**< total number of channels */
+} scn;
+
+/** Counters collected during the measurement phase. */
+static struct Stats {
+  unsigned long sent[ACT_COUNT];	/**< actions issued */
+  unsigned long lines_in;		/**< lines received from the server */
+  unsigned long bytes_in;		/**< bytes received from the server */
+  unsigned long delivered;		/**< timestamped PRIVMSGs received */
+  unsigned long errors;			/**< error numerics received */
+  unsigned long disconnects;		/**< unexpected disconnections */
+  unsigned long latency[HIST_SIZE];	/**< delivery latency histogram */
+  unsigned long lat_max;		/**< largest latency seen */
+} stats;
+
+static struct LgClient *clients;	/**< array of simulated clients */
+static unsigned int ready;		/**< number of registered clients */
+static unsigned int *ready_list;	/**< indices of registered clients */
+static unsigned int *ready_pos;		/**< position in \a ready_list */
+static int measuring;			/**< non-zero when collecting stats */
+static int verbose;			/**< print per-second progress */
+static unsigned long rng_state;		/**< PRNG state */
+
+/** Print a message to stderr and exit.
+ * @param[in] fmt Format string for the message.
+ */
+static void
+die(const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  fputs("loadgen: ", stderr);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+  exit(1);
+}
+
+/** Return a pseudo-random number.  A local xorshift generator is used
+ * so that results do not depend on the C library's rand().
+ * @return Next value of the pseudo-random sequence.
+ */
+static unsigned long
+rng(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+/** Return the current monotonic time in microseconds. */
+static unsigned long long
+now_usec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** Map a latency to its histogram bucket.
+ * @param[in] usec Latency in microseconds.
+ * @return Index into Stats::latency.
+ */
+static unsigned int
+hist_index(unsigned long usec)
+{
+  unsigned int shift = 0;
+
+  if (usec > 0xffffffffUL)
+    usec = 0xffffffffUL;
+  if (usec < 2 * HIST_SUB)
+    return usec;
+  while ((usec >> shift) >= 2 * HIST_SUB)
+    shift++;
+  return HIST_SUB * (shift + 1) + (usec >> shift);
+}
+
+/** Map a histogram bucket back to the smallest latency it holds.
+ * @param[in] idx Index into Stats::latency.
+ * @return Latency in microseconds.
+ */
+static unsigned long
+hist_value(unsigned int idx)
+{
+  unsigned int shift;
+
+  if (idx < 2 * HIST_SUB)
+    return idx;
+  shift = idx / HIST_SUB - 2;
+  return (unsigned long)(idx - HIST_SUB * (shift + 1)) << shift;
+}
+
+/** Find a percentile in the latency histogram.
+ * @param[in] pct Percentile to find (0 to 100).
+ * @return Latency in microseconds.
+ */
+static unsigned long
+hist_percentile(double pct)
+{
+  unsigned long want, seen = 0;
+  unsigned int i;
+
+  if (!stats.delivered)
+    return 0;
+  want = (unsigned long)(stats.delivered * pct / 100.0);
+  if (want >= stats.delivered)
+    want = stats.delivered - 1;
+  for (i = 0; i < HIST_SIZE; i++)
+    if ((seen += stats.latency[i]) > want)
+      return hist_value(i);
+  return stats.lat_max;
+}
+
+/** Read the scenario file.
+ * @param[in] fname Name of the scenario file.
+ */
+static void
+read_scenario(const char *fname)
+{
+  char line[256], key[32], arg1[64], arg2[64];
+  unsigned int lineno = 0, i;
+  FILE *fp;
+  int n;
+
+  if (!(fp = fopen(fname, "r")))
+    die("unable to open %s: %s", fname, strerror(errno));
+
+  while (fgets(line, sizeof(line), fp)) {
+    lineno++;
+    if ((n = sscanf(line, "%31s %63s %63s", key, arg1, arg2)) < 1 ||
+        key[0] == '#')
+      continue;
+    if (n < 2)
+      die("%s:%u: missing value for %s", fname, lineno, key);
+
+    if (!strcmp(key, "server")) {
+      snprintf(scn.server, sizeof(scn.server), "%.63s", arg1);
+      if (n > 2)
+        scn.port = strtoul(arg2, 0, 10);
+    } else if (!strcmp(key, "source")) {
+      if (!inet_aton(arg1, &scn.source))
+        die("%s:%u: bad source address %s", fname, lineno, arg1);
+      scn.nsources = n > 2 ? strtoul(arg2, 0, 10) : 1;
+    } else if (!strcmp(key, "clients"))
+      scn.clients = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "connect_rate"))
+      scn.connect_rate = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "rate"))
+      scn.rate = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "payload"))
+      scn.payload = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "warmup"))
+      scn.warmup = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "duration"))
+      scn.duration = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "settle"))
+      scn.settle = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "seed"))
+      scn.seed = strtoul(arg1, 0, 10);
+    else if (!strcmp(key, "prefix"))
+      snprintf(scn.prefix, sizeof(scn.prefix), "%.7s", arg1);
+    else if (!strcmp(key, "channels")) {
+      if (n < 3)
+        die("%s:%u: usage: channels <count> <size>", fname, lineno);
+      if (scn.ngroups >= LG_MAXGROUPS)
+        die("%s:%u: too many channel groups", fname, lineno);
+      scn.groups[scn.ngroups].count = strtoul(arg1, 0, 10);
+      scn.groups[scn.ngroups].size = strtoul(arg2, 0, 10);
+      scn.groups[scn.ngroups].first = scn.nchannels;
+      scn.nchannels += scn.groups[scn.ngroups++].count;
+    } else if (!strcmp(key, "mix")) {
+      if (n < 3)
+        die("%s:%u: usage: mix <action> <weight>", fname, lineno);
+      for (i = 0; i < ACT_COUNT; i++)
+        if (!strcmp(arg1, action_names[i]))
+          break;
+      if (i == ACT_COUNT)
+        die("%s:%u: unknown action %s", fname, lineno, arg1);
+      scn.mix[i] = strtoul(arg2, 0, 10);
+    } else
+      die("%s:%u: unknown keyword %s", fname, lineno, key);
+  }
+  fclose(fp);
+}
+
+/** Queue a line of output for a client and try to send it.
+ * @param[in] cl Client to send from.
+ * @param[in] fmt Format string for the line (without CR LF).
+ */
+static void
+cl_send(struct LgClient *cl, const char *fmt, ...)
+{
+  char line[512];
+  va_list args;
+  ssize_t res;
+  int len;
+
+  if (cl->fd < 0)
+    return;
+
+  va_start(args, fmt);
+  len = vsnprintf(line, sizeof(line) - 2, fmt, args);
+  va_end(args);
+  if (len > (int)sizeof(line) - 3)
+    len = sizeof(line) - 3;
+  line[len++] = '\r';
+  line[len++] = '\n';
+
+  if (cl->wlen + len > cl->wsize) {
+    cl->wsize = (cl->wlen + len) * 2;
+    if (!(cl->wbuf = realloc(cl->wbuf, cl->wsize)))
+      die("out of memory");
+  }
+  memcpy(cl->wbuf + cl->wlen, line, len);
+  cl->wlen += len;
+
+  if (cl->state == CS_CONNECTING)
+    return;
+  res = write(cl->fd, cl->wbuf, cl->wlen);
+  if (res > 0) {
+    memmove(cl->wbuf, cl->wbuf + res, cl->wlen - res);
+    cl->wlen -= res;
+  }
+}
+
+/** Add a client to the list of clients eligible for actions.
+ * @param[in] idx Index of the client.
+ */
+static void
+ready_add(unsigned int idx)
+{
+  ready_pos[idx] = ready;
+  ready_list[ready++] = idx;
+}
+
+/** Remove a client from the list of clients eligible for actions.
+ * @param[in] idx Index of the client.
+ */
+static void
+ready_del(unsigned int idx)
+{
+  unsigned int last = ready_list[--ready];
+
+  ready_list[ready_pos[idx]] = last;
+  ready_pos[last] = ready_pos[idx];
+}
+
+/** Close a client's connection.
+ * @param[in] idx Index of the client.
+ * @param[in] expected Zero if the disconnection should be counted.
+ */
+static void
+cl_close(unsigned int idx, int expected)
+{
+  struct LgClient *cl = &clients[idx];
+
+  if (cl->state == CS_READY)
+    ready_del(idx);
+  if (!expected && measuring)
+    stats.disconnects++;
+  if (cl->fd >= 0)
+    close(cl->fd);
+  cl->fd = -1;
+  cl->state = CS_DOWN;
+  cl->wlen = cl->rlen = 0;
+  cl->nchans = 0;
+}
+
+/** Start connecting a client.
+ * @param[in] idx Index of the client.
+ */
+static void
+cl_connect(unsigned int idx)
+{
+  struct LgClient *cl = &clients[idx];
+  struct sockaddr_in sin;
+  int one = 1;
+
+  if ((cl->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    die("socket: %s", strerror(errno));
+  fcntl(cl->fd, F_SETFL, O_NONBLOCK);
+  setsockopt(cl->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  if (scn.nsources) {
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(ntohl(scn.source.s_addr) +
+                                idx % scn.nsources);
+    if (bind(cl->fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+      die("bind: %s", strerror(errno));
+  }
+
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(scn.port);
+  inet_aton(scn.server, &sin.sin_addr);
+
+  cl->state = CS_CONNECTING;
+  if (connect(cl->fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 &&
+      errno != EINPROGRESS) {
+    cl_close(idx, 0);
+    return;
+  }
+
+  snprintf(cl->nick, sizeof(cl->nick), "%s%u_%u", scn.prefix, idx,
+           cl->gen++ % 1000);
+  cl_send(cl, "NICK %s", cl->nick);
+  cl_send(cl, "USER %s%u 0 * :loadgen client", scn.prefix, idx);
+}
+
+/** Join a client to the channels in its plan, using a single JOIN so
+ * that it only costs one command's worth of flood penalty.
+ */
+static void
+cl_join_plan(struct LgClient *cl)
+{
+  char list[256];
+  unsigned int i, len = 0;
+
+  for (i = 0; i < cl->nplan; i++) {
+    if (len + 16 > sizeof(list))
+      break;
+    len += snprintf(list + len, sizeof(list) - len, "%s#%s%u", i ? "," : "",
+                    scn.prefix, cl->plan[i]);
+    cl->chans[cl->nchans++] = cl->plan[i];
+  }
+  if (len)
+    cl_send(cl, "JOIN %s", list);
+}
+
+/** Handle one line received from the server.
+ * @param[in] idx Index of the client that received the line.
+ * @param[in] line NUL-terminated line, without CR LF.
+ */
+static void
+cl_parse(unsigned int idx, char *line)
+{
+  struct LgClient *cl = &clients[idx];
+  char *cmd, *text;
+  unsigned long long sent, lat;
+
+  if (measuring)
+    stats.lines_in++;
+
+  if (!strncmp(line, "PING ", 5)) {
+    cl_send(cl, "PONG %s", line + 5);
+    return;
+  } else if (!strncmp(line, "ERROR ", 6)) {
+    cl_close(idx, cl->state == CS_QUITTING);
+    return;
+  } else if (line[0] != ':' || !(cmd = strchr(line, ' ')))
+    return;
+
+  cmd++;
+  if (!strncmp(cmd, "PRIVMSG ", 8)) {
+    if (!(text = strstr(cmd, " :lg ")) || !measuring)
+      return;
+    sent = strtoull(text + 5, 0, 10);
+    lat = now_usec() - sent;
+    stats.delivered++;
+    stats.latency[hist_index(lat)]++;
+    if (lat > stats.lat_max)
+      stats.lat_max = lat;
+  } else if (!strncmp(cmd, "001 ", 4)) {
+    if (cl->state == CS_REGISTERING) {
+      cl->state = CS_READY;
+      ready_add(idx);
+      cl_join_plan(cl);
+    }
+  } else if (!strncmp(cmd, "433 ", 4) && cl->state == CS_REGISTERING) {
+    snprintf(cl->nick, sizeof(cl->nick), "%s%u_%u", scn.prefix, idx,
+             cl->gen++ % 1000);
+    cl_send(cl, "NICK %s", cl->nick);
+  } else if (cmd[0] >= '4' && cmd[0] <= '5' && cmd[3] == ' ' && measuring)
+    stats.errors++;
+}
+
+/** Read available data from a client's connection.
+ * @param[in] idx Index of the client.
+ */
+static void
+cl_read(unsigned int idx)
+{
+  struct LgClient *cl = &clients[idx];
+  char *start, *end;
+  ssize_t res;
+
+  res = read(cl->fd, cl->rbuf + cl->rlen, sizeof(cl->rbuf) - cl->rlen - 1);
+  if (res <= 0) {
+    if (res < 0 && (errno == EAGAIN || errno == EINTR))
+      return;
+    cl_close(idx, cl->state == CS_QUITTING);
+    return;
+  }
+  if (measuring)
+    stats.bytes_in += res;
+  cl->rlen += res;
+  cl->rbuf[cl->rlen] = '\0';
+
+  for (start = cl->rbuf; (end = strchr(start, '\n')); start = end + 1) {
+    *end = '\0';
+    if (end > start && end[-1] == '\r')
+      end[-1] = '\0';
+    cl_parse(idx, start);
+    if (cl->fd < 0)
+      return;
+  }
+
+  cl->rlen -= start - cl->rbuf;
+  memmove(cl->rbuf, start, cl->rlen);
+  if (cl->rlen == sizeof(cl->rbuf) - 1) /* overlong line; discard it */
+    cl->rlen = 0;
+}
+
+/** Flush pending output for a client.
+ * @param[in] idx Index of the client.
+ */
+static void
+cl_write(unsigned int idx)
+{
+  struct LgClient *cl = &clients[idx];
+  ssize_t res;
+  int err = 0;
+  socklen_t len = sizeof(err);
+
+  if (cl->state == CS_CONNECTING) {
+    if (getsockopt(cl->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err) {
+      cl_close(idx, 0);
+      return;
+    }
+    cl->state = CS_REGISTERING;
+  }
+
+  if (!cl->wlen)
+    return;
+  res = write(cl->fd, cl->wbuf, cl->wlen);
+  if (res < 0) {
+    if (errno != EAGAIN && errno != EINTR)
+      cl_close(idx, 0);
+    return;
+  }
+  memmove(cl->wbuf, cl->wbuf + res, cl->wlen - res);
+  cl->wlen -= res;
+}
+
+/** Choose an action according to the scenario's mix weights.
+ * @return Selected action.
+ */
+static enum Action
+pick_action(void)
+{
+  unsigned int total = 0, i, pick;
+
+  for (i = 0; i < ACT_COUNT; i++)
+    total += scn.mix[i];
+  pick = rng() % total;
+  for (i = 0; i < ACT_COUNT - 1; i++) {
+    if (pick < scn.mix[i])
+      break;
+    pick -= scn.mix[i];
+  }
+  return i;
+}
+
+/** Perform one action for a random registered client. */
+static void
+do_action(void)
+{
+  char text[512];
+  struct LgClient *cl, *peer;
+  enum Action act;
+  unsigned int idx, chan, i;
+
+  if (!ready)
+    return;
+  idx = ready_list[rng() % ready];
+  cl = &clients[idx];
+  act = pick_action();
+
+  switch (act) {
+  case ACT_PRIVMSG:
+  case ACT_PRIVMSG_USER:
+    snprintf(text, sizeof(text), "lg %llu %.*s", now_usec(),
+             (int)(scn.payload < 400 ? scn.payload : 400),
+             "................................................................"
+             "................................................................"
+             "................................................................"
+             "................................................................"
+             "................................................................"
+             "................................................................"
+             "................................................................");
+    if (act == ACT_PRIVMSG && cl->nchans) {
+      chan = cl->chans[rng() % cl->nchans];
+      cl_send(cl, "PRIVMSG #%s%u :%s", scn.prefix, chan, text);
+    } else {
+      peer = &clients[ready_list[rng() % ready]];
+      act = ACT_PRIVMSG_USER;
+      cl_send(cl, "PRIVMSG %s :%s", peer->nick, text);
+    }
+    break;
+
+  case ACT_JOIN:
+    if (cl->nchans >= LG_MAXCHANS || !scn.nchannels)
+      return;
+    chan = rng() % scn.nchannels;
+    for (i = 0; i < cl->nchans; i++)
+      if (cl->chans[i] == chan)
+        return;
+    cl->chans[cl->nchans++] = chan;
+    cl_send(cl, "JOIN #%s%u", scn.prefix, chan);
+    break;
+
+  case ACT_PART:
+    if (!cl->nchans)
+      return;
+    i = rng() % cl->nchans;
+    cl_send(cl, "PART #%s%u", scn.prefix, cl->chans[i]);
+    cl->chans[i] = cl->chans[--cl->nchans];
+    break;
+
+  case ACT_NICK:
+    snprintf(cl->nick, sizeof(cl->nick), "%s%u_%u", scn.prefix, idx,
+             cl->gen++ % 1000);
+    cl_send(cl, "NICK %s", cl->nick);
+    break;
+
+  case ACT_QUIT:
+    cl_send(cl, "QUIT :loadgen");
+    ready_del(idx);
+    cl->state = CS_QUITTING;
+    break;
+
+  default:
+    return;
+  }
+
+  if (measuring)
+    stats.sent[act]++;
+}
+
+/** Assign every client the channels it joins after registering.
+ * Each channel of a group gets \a size distinct random members; a
+ * client that already has LG_MAXCHANS channels is skipped.
+ */
+static void
+plan_channels(void)
+{
+  unsigned int g, c, m, idx, tries;
+
+  for (g = 0; g < scn.ngroups; g++)
+    for (c = 0; c < scn.groups[g].count; c++)
+      for (m = 0; m < scn.groups[g].size && m < scn.clients; m++)
+        for (tries = 0; tries < 16; tries++) {
+          idx = rng() % scn.clients;
+          if (clients[idx].nplan < LG_MAXCHANS &&
+              (!clients[idx].nplan ||
+               clients[idx].plan[clients[idx].nplan - 1] !=
+               scn.groups[g].first + c)) {
+            clients[idx].plan[clients[idx].nplan++] = scn.groups[g].first + c;
+            break;
+          }
+        }
+}
+
+/** Raise the file descriptor limit as far as the system allows. */
+static void
+raise_fd_limit(void)
+{
+  struct rlimit limit;
+
+  if (getrlimit(RLIMIT_NOFILE, &limit) < 0)
+    return;
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur < scn.clients + 16)
+    fprintf(stderr, "loadgen: warning: only %lu file descriptors available\n",
+            (unsigned long)limit.rlim_cur);
+}
+
+/** Print the summary of the measurement phase. */
+static void
+report(double elapsed)
+{
+  unsigned long total = 0;
+  unsigned int i;
+
+  for (i = 0; i < ACT_COUNT; i++) {
+    printf("sent_%s %lu\n", action_names[i], stats.sent[i]);
+    total += stats.sent[i];
+  }
+  printf("clients %u\n", scn.clients);
+  printf("registered %u\n", ready);
+  printf("duration %.3f\n", elapsed);
+  printf("sent_total %lu\n", total);
+  printf("sent_rate %.1f\n", total / elapsed);
+  printf("server_lines %lu\n", stats.lines_in);
+  printf("server_bytes %lu\n", stats.bytes_in);
+  printf("server_msgs_per_sec %.1f\n", stats.lines_in / elapsed);
+  printf("delivered %lu\n", stats.delivered);
+  printf("delivered_per_sec %.1f\n", stats.delivered / elapsed);
+  printf("latency_p50_usec %lu\n", hist_percentile(50.0));
+  printf("latency_p99_usec %lu\n", hist_percentile(99.0));
+  printf("latency_max_usec %lu\n", stats.lat_max);
+  printf("errors %lu\n", stats.errors);
+  printf("disconnects %lu\n", stats.disconnects);
+}
+
+/** Print a usage message and exit. */
+static void
+usage(void)
+{
+  fprintf(stderr, "Usage: loadgen [-v] [-s server] [-p port] "
+          "[-d duration] [-r rate] [-c clients] scenario-file\n");
+  exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+  struct pollfd *pfds;
+  unsigned int *pidx;
+  unsigned long long start, now, phase_start = 0, last_report;
+  unsigned long actions = 0, connects = 0, last_lines = 0;
+  unsigned int i, npfds, cursor = 0, down;
+  int c, phase = 0; /* 0 = connect, 1 = warmup, 2 = measure */
+  const char *o_server = 0;
+  unsigned int o_port = 0, o_duration = 0, o_rate = 0, o_clients = 0;
+
+  while ((c = getopt(argc, argv, "vs:p:d:r:c:")) != -1)
+    switch (c) {
+    case 'v': verbose = 1; break;
+    case 's': o_server = optarg; break;
+    case 'p': o_port = strtoul(optarg, 0, 10); break;
+    case 'd': o_duration = strtoul(optarg, 0, 10); break;
+    case 'r': o_rate = strtoul(optarg, 0, 10); break;
+    case 'c': o_clients = strtoul(optarg, 0, 10); break;
+    default: usage();
+    }
+  if (optind != argc - 1)
+    usage();
+
+  /* defaults, then the scenario file, then the command line */
+  strcpy(scn.server, "127.0.0.1");
+  scn.port = 6667;
+  scn.clients = 100;
+  scn.connect_rate = 500;
+  scn.rate = 1000;
+  scn.payload = 60;
+  scn.warmup = 5;
+  scn.duration = 30;
+  scn.settle = 30;
+  scn.seed = 1;
+  strcpy(scn.prefix, "lg");
+  read_scenario(argv[optind]);
+  if (o_server)
+    snprintf(scn.server, sizeof(scn.server), "%s", o_server);
+  if (o_port)
+    scn.port = o_port;
+  if (o_duration)
+    scn.duration = o_duration;
+  if (o_rate)
+    scn.rate = o_rate;
+  if (o_clients)
+    scn.clients = o_clients;
+  for (i = 0, c = 0; i < ACT_COUNT; i++)
+    c += scn.mix[i];
+  if (!c)
+    scn.mix[ACT_PRIVMSG] = 1;
+  if (!scn.clients || !scn.connect_rate || !scn.duration)
+    die("clients, connect_rate and duration must be non-zero");
+
+  rng_state = scn.seed ? scn.seed : 1;
+  raise_fd_limit();
+
+  clients = calloc(scn.clients, sizeof(*clients));
+  ready_list = calloc(scn.clients, sizeof(*ready_list));
+  ready_pos = calloc(scn.clients, sizeof(*ready_pos));
+  pfds = calloc(scn.clients, sizeof(*pfds));
+  pidx = calloc(scn.clients, sizeof(*pidx));
+  if (!clients || !ready_list || !ready_pos || !pfds || !pidx)
+    die("out of memory");
+  for (i = 0; i < scn.clients; i++)
+    clients[i].fd = -1;
+  plan_channels();
+
+  start = last_report = now_usec();
+  for (;;) {
+    now = now_usec();
+
+    /* start new connections at the configured rate */
+    for (down = 0; connects < (now - start) * scn.connect_rate / 1000000 &&
+           down < scn.clients; down++, cursor = (cursor + 1) % scn.clients)
+      if (clients[cursor].state == CS_DOWN) {
+        cl_connect(cursor);
+        connects++;
+      }
+
+    /* move through the phases */
+    if (phase == 0 && (ready == scn.clients ||
+                       now - start > scn.settle * 1000000ULL)) {
+      fprintf(stderr, "loadgen: %u of %u clients registered, warming up\n",
+              ready, scn.clients);
+      phase = 1;
+      phase_start = now;
+      actions = 0;
+    } else if (phase == 1 && now - phase_start >= scn.warmup * 1000000ULL) {
+      phase = 2;
+      phase_start = now;
+      actions = 0;
+      measuring = 1;
+    } else if (phase == 2 &&
+               now - phase_start >= scn.duration * 1000000ULL) {
+      measuring = 0;
+      break;
+    }
+
+    /* issue actions at the configured rate */
+    if (phase > 0)
+      for (; actions < (now - phase_start) * scn.rate / 1000000; actions++)
+        do_action();
+
+    if (verbose && now - last_report >= 1000000) {
+      fprintf(stderr, "loadgen: %u ready, %lu lines/s, %lu delivered\n",
+              ready, stats.lines_in - last_lines, stats.delivered);
+      last_lines = stats.lines_in;
+      last_report = now;
+    }
+
+    for (i = 0, npfds = 0; i < scn.clients; i++) {
+      if (clients[i].fd < 0)
+        continue;
+      pfds[npfds].fd = clients[i].fd;
+      pfds[npfds].events = POLLIN;
+      if (clients[i].wlen || clients[i].state == CS_CONNECTING)
+        pfds[npfds].events |= POLLOUT;
+      pfds[npfds].revents = 0;
+      pidx[npfds++] = i;
+    }
+
+    if (poll(pfds, npfds, LG_TICK) < 0 && errno != EINTR)
+      die("poll: %s", strerror(errno));
+
+    for (i = 0; i < npfds; i++) {
+      if (pfds[i].revents & (POLLOUT | POLLERR | POLLHUP))
+        cl_write(pidx[i]);
+      if (clients[pidx[i]].fd >= 0 &&
+          (pfds[i].revents & (POLLIN | POLLERR | POLLHUP)))
+        cl_read(pidx[i]);
+    }
+  }
+
+  report((now - phase_start) / 1000000.0);
+
+  for (i = 0; i < scn.clients; i++)
+    if (clients[i].fd >= 0) {
+      cl_send(&clients[i], "QUIT :loadgen done");
+      close(clients[i].fd);
+    }
+  return 0;
+}
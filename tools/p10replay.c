@@ -0,0 +1,566 @@
+/*
+ * IRC - Internet Relay Chat, tools/p10replay.c
+ *
+ * See file AUTHORS in IRC package for additional names of
+ * the programmers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+/** @file
+ * @brief P10 server-link replay harness for burst and netsplit timing.
+ *
+ * p10replay pretends to be a server linking to a local ircd.  It
+ * completes the PASS/SERVER handshake, sends a net burst, waits for
+ * the END_OF_BURST acknowledgement and then SQUITs itself, timing
+ * each phase.  The burst is either generated synthetically (N users,
+ * M channels with a given number of members and K bans each) or read
+ * from a file of recorded P10 lines.  A generated burst can be saved
+ * with -w and replayed later with -r, so that exactly the same input
+ * is used against different ircd versions.
+ *
+ * Split cleanup is timed until an ordinary client connection, opened
+ * on the client port before the link, gets its PONG back: ircd only
+ * answers it once the SQUIT has been completely processed.
+ *
+ * It is built standalone, without the rest of the source tree:
+ *
+ *   cc -O2 -o p10replay p10replay.c
+ *   ./p10replay -u 50000 -c 10000 -m 20 -b 10 -P linkpass
+ *
+ * The ircd needs a Connect block for the fake server, e.g.
+ *
+ *   Connect {
+ *     name = "replay.example.net"; host = "127.0.0.1";
+ *     password = "linkpass"; port = 7799; class = "Server";
+ *     autoconnect = no;
+ *   };
+ *
+ * Options:
+ *   -s address     ircd address (default 127.0.0.1)
+ *   -p port        ircd server port (default 4400)
+ *   -o port        ircd client port for the observer (default 6667)
+ *   -P password    link password
+ *   -N name        fake server name (default replay.example.net)
+ *   -n numeric     fake server numeric, 0 to 4095 (default 4000)
+ *   -u users       number of users to burst
+ *   -c channels    number of channels to burst
+ *   -m members     members per channel
+ *   -b bans        bans per channel
+ *   -S seed        seed for the pseudo-random generator
+ *   -r file        replay recorded P10 lines instead of generating them
+ *   -w file        also write the generated burst to a file
+ *
+ * Recorded lines must use the numeric given with -n as their source.
+ * The results are printed on stdout as "key value" lines.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#define LINELEN		450	/**< Longest burst line we generate. */
+#define TIMEOUT		600	/**< Seconds to wait for any single phase. */
+
+/** Base64 alphabet used for P10 numerics (see ircd/numnicks.c). */
+static const char convert2y[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789[]";
+
+/** A buffered connection to the ircd. */
+struct Conn {
+  int fd;			/**< socket */
+  char *wbuf;			/**< output not yet written */
+  size_t woff;			/**< bytes of \a wbuf already written */
+  size_t wlen;			/**< bytes in \a wbuf */
+  size_t wsize;			/**< allocated size of \a wbuf */
+  size_t rlen;			/**< bytes in \a rbuf */
+  char rbuf[8192];		/**< partial input line */
+};
+
+static struct Conn link_conn;		/**< fake server link */
+static struct Conn obs_conn;		/**< observer client */
+static char yy[3];			/**< our server numeric */
+static const char *srvname = "replay.example.net"; /**< our server name */
+static unsigned long rng_state = 1;	/**< PRNG state */
+static FILE *record;			/**< file to save the burst to */
+static unsigned long burst_lines;	/**< lines of burst sent */
+static unsigned long burst_bytes;	/**< bytes of burst sent */
+
+/* Flags set by the line handlers. */
+static int got_eob;		/**< ircd finished its own burst */
+static int got_eoback;		/**< ircd acknowledged our burst */
+static int got_welcome;		/**< observer is registered */
+static int got_pong;		/**< observer got its PONG */
+static int link_closed;		/**< ircd closed the link */
+static int squit_sent;		/**< we split from the ircd */
+
+/** Print a message to stderr and exit.
+ * @param[in] fmt Format string for the message.
+ */
+static void
+die(const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  fputs("p10replay: ", stderr);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+  exit(1);
+}
+
+/** Return a pseudo-random number (xorshift). */
+static unsigned long
+rng(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+/** Return the current monotonic time in microseconds. */
+static unsigned long long
+now_usec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** Encode an integer as a P10 base64 string.
+ * @param[out] buf Output buffer, at least \a count + 1 bytes.
+ * @param[in] v Value to encode.
+ * @param[in] count Number of base64 digits to produce.
+ * @return \a buf
+ */
+static char *
+inttobase64(char *buf, unsigned int v, unsigned int count)
+{
+  buf[count] = '\0';
+  while (count > 0) {
+    buf[--count] = convert2y[v & 63];
+    v >>= 6;
+  }
+  return buf;
+}
+
+/** Open a TCP connection.
+ * @param[out] conn Connection to initialize.
+ * @param[in] addr IPv4 address to connect to.
+ * @param[in] port Port to connect to.
+ */
+static void
+conn_open(struct Conn *conn, const char *addr, unsigned int port)
+{
+  struct sockaddr_in sin;
+  int one = 1;
+
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_port = htons(port);
+  if (!inet_aton(addr, &sin.sin_addr))
+    die("bad address %s", addr);
+
+  if ((conn->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    die("socket: %s", strerror(errno));
+  if (connect(conn->fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+    die("connect to %s/%u: %s", addr, port, strerror(errno));
+  setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(conn->fd, F_SETFL, O_NONBLOCK);
+}
+
+/** Queue a line of output on a connection.
+ * @param[in] conn Connection to send on.
+ * @param[in] fmt Format string for the line (without CR LF).
+ */
+static void
+conn_send(struct Conn *conn, const char *fmt, ...)
+{
+  char line[512];
+  va_list args;
+  int len;
+
+  va_start(args, fmt);
+  len = vsnprintf(line, sizeof(line) - 2, fmt, args);
+  va_end(args);
+  if (len > (int)sizeof(line) - 3)
+    len = sizeof(line) - 3;
+  line[len++] = '\r';
+  line[len++] = '\n';
+
+  if (conn->woff + conn->wlen + len > conn->wsize) {
+    conn->wsize = (conn->woff + conn->wlen + len) * 2;
+    if (!(conn->wbuf = realloc(conn->wbuf, conn->wsize)))
+      die("out of memory");
+  }
+  memcpy(conn->wbuf + conn->woff + conn->wlen, line, len);
+  conn->wlen += len;
+}
+
+/** Queue one line of burst, recording it if requested.
+ * @param[in] line Line to send (without CR LF).
+ */
+static void
+burst_send(const char *line)
+{
+  conn_send(&link_conn, "%s", line);
+  burst_lines++;
+  burst_bytes += strlen(line) + 2;
+  if (record)
+    fprintf(record, "%s\n", line);
+}
+
+/** Handle a line received on the server link.
+ * @param[in] line NUL-terminated line, without CR LF.
+ */
+static void
+link_parse(char *line)
+{
+  char *tok, *end;
+
+  if (!strncmp(line, "ERROR ", 6))
+    die("server closed link: %s", line + 6);
+  if (!(tok = strchr(line, ' ')))
+    return;
+  tok++;
+  /* EB and EA are sent with an empty parameter list */
+  for (end = tok + strlen(tok); end > tok && end[-1] == ' '; end--)
+    end[-1] = '\0';
+  if (!strcmp(tok, "EB")) {
+    got_eob = 1;
+    conn_send(&link_conn, "%s EA", yy);
+  } else if (!strcmp(tok, "EA"))
+    got_eoback = 1;
+  else if (!strncmp(tok, "G ", 2))
+    conn_send(&link_conn, "%s Z %s %s", yy, yy, tok + 2);
+}
+
+/** Handle a line received on the observer connection.
+ * @param[in] line NUL-terminated line, without CR LF.
+ */
+static void
+obs_parse(char *line)
+{
+  char *tok;
+
+  if (!strncmp(line, "PING ", 5)) {
+    conn_send(&obs_conn, "PONG %s", line + 5);
+    return;
+  }
+  if (line[0] != ':' || !(tok = strchr(line, ' ')))
+    return;
+  tok++;
+  if (!strncmp(tok, "001 ", 4))
+    got_welcome = 1;
+  else if (!strncmp(tok, "PONG ", 5) && strstr(tok, ":p10replay"))
+    got_pong = 1;
+}
+
+/** Read and dispatch available lines from a connection.
+ * @param[in] conn Connection to read from.
+ * @param[in] parse Line handler.
+ * @return Zero on end of file, non-zero otherwise.
+ */
+static int
+conn_read(struct Conn *conn, void (*parse)(char *))
+{
+  char *start, *end;
+  ssize_t res;
+
+  res = read(conn->fd, conn->rbuf + conn->rlen, sizeof(conn->rbuf) -
+             conn->rlen - 1);
+  if (res < 0)
+    return errno == EAGAIN || errno == EINTR;
+  if (res == 0)
+    return 0;
+  conn->rlen += res;
+  conn->rbuf[conn->rlen] = '\0';
+  for (start = conn->rbuf; (end = strchr(start, '\n')); start = end + 1) {
+    *end = '\0';
+    if (end > start && end[-1] == '\r')
+      end[-1] = '\0';
+    parse(start);
+  }
+  conn->rlen -= start - conn->rbuf;
+  memmove(conn->rbuf, start, conn->rlen);
+  if (conn->rlen == sizeof(conn->rbuf) - 1)
+    conn->rlen = 0;
+  return 1;
+}
+
+/** Flush queued output of a connection.
+ * @param[in] conn Connection to write to.
+ */
+static void
+conn_write(struct Conn *conn)
+{
+  ssize_t res;
+
+  if (!conn->wlen)
+    return;
+  if ((res = write(conn->fd, conn->wbuf + conn->woff, conn->wlen)) < 0) {
+    if (errno != EAGAIN && errno != EINTR)
+      die("write: %s", strerror(errno));
+    return;
+  }
+  conn->wlen -= res;
+  conn->woff = conn->wlen ? conn->woff + res : 0;
+}
+
+/** Run the I/O loop until a flag becomes set.
+ * @param[in] flag Flag to wait for.
+ * @param[in] what Description of the phase, for error messages.
+ */
+static void
+run_until(int *flag, const char *what)
+{
+  struct pollfd pfd[2];
+  unsigned long long deadline = now_usec() + TIMEOUT * 1000000ULL;
+  int n;
+
+  while (!*flag) {
+    if (now_usec() > deadline)
+      die("timed out waiting for %s", what);
+    if (link_closed && !squit_sent)
+      die("server closed link while waiting for %s", what);
+    n = 0;
+    if (link_conn.fd >= 0 && !link_closed) {
+      pfd[n].fd = link_conn.fd;
+      pfd[n++].events = POLLIN | (link_conn.wlen ? POLLOUT : 0);
+    }
+    pfd[n].fd = obs_conn.fd;
+    pfd[n++].events = POLLIN | (obs_conn.wlen ? POLLOUT : 0);
+    if (poll(pfd, n, 1000) < 0 && errno != EINTR)
+      die("poll: %s", strerror(errno));
+
+    if (link_conn.fd >= 0 && !link_closed) {
+      if (pfd[0].revents & POLLOUT)
+        conn_write(&link_conn);
+      if ((pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) &&
+          !conn_read(&link_conn, link_parse))
+        link_closed = 1;
+    }
+    if (pfd[n - 1].revents & POLLOUT)
+      conn_write(&obs_conn);
+    if ((pfd[n - 1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+        !conn_read(&obs_conn, obs_parse))
+      die("observer connection closed while waiting for %s", what);
+  }
+}
+
+/** Generate a synthetic burst.
+ * @param[in] users Number of users.
+ * @param[in] channels Number of channels.
+ * @param[in] members Members per channel.
+ * @param[in] bans Bans per channel.
+ */
+static void
+generate_burst(unsigned int users, unsigned int channels,
+               unsigned int members, unsigned int bans)
+{
+  char line[512], num[4], ip[7];
+  unsigned int i, j, len, head, ops, first, user;
+  time_t ts = time(0) - 86400;
+
+  for (i = 0; i < users; i++)
+    snprintf(line, sizeof(line), "%s N rp%u 1 %lu replay u%u.replay.example "
+             "+i %s %s%s :p10replay user %u", yy, i, (unsigned long)ts, i,
+             inttobase64(ip, (10u << 24) | i, 6), yy,
+             inttobase64(num, i, 3), i), burst_send(line);
+
+  for (i = 0; i < channels; i++) {
+    /* members, plain ones first and then about 1 in 10 as ops; they
+     * are consecutive users so that nobody is listed twice */
+    ops = members / 10;
+    first = users ? rng() % users : 0;
+    head = len = snprintf(line, sizeof(line), "%s B #rp%u %lu +nt", yy, i,
+                          (unsigned long)ts);
+    for (j = 0; j < members && j < users; j++) {
+      if (len > LINELEN) {
+        burst_send(line);
+        head = len = snprintf(line, sizeof(line), "%s B #rp%u %lu", yy, i,
+                              (unsigned long)ts);
+      }
+      user = (first + j) % users;
+      len += snprintf(line + len, sizeof(line) - len, "%c%s%s%s",
+                      len > head ? ',' : ' ', yy, inttobase64(num, user, 3),
+                      (j == members - ops || (len == head && j > members - ops))
+                      ? ":o" : "");
+    }
+
+    /* bans */
+    for (j = 0; j < bans; j++) {
+      if (len > LINELEN) {
+        burst_send(line);
+        head = len = snprintf(line, sizeof(line), "%s B #rp%u %lu", yy, i,
+                              (unsigned long)ts);
+      }
+      len += snprintf(line + len, sizeof(line) - len, "%s*!*@b%u.c%u.example",
+                      j == 0 || len == head ? " :%" : " ", j, i);
+    }
+    if (len > head)
+      burst_send(line);
+  }
+}
+
+/** Replay a recorded burst.
+ * @param[in] fname File containing P10 lines.
+ */
+static void
+replay_burst(const char *fname)
+{
+  char line[600];
+  size_t len;
+  FILE *fp;
+
+  if (!(fp = fopen(fname, "r")))
+    die("unable to open %s: %s", fname, strerror(errno));
+  while (fgets(line, sizeof(line), fp)) {
+    len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = '\0';
+    if (len > 0 && strncmp(line + 3, "EB", 2))
+      burst_send(line);
+  }
+  fclose(fp);
+}
+
+/** Print a usage message and exit. */
+static void
+usage(void)
+{
+  fprintf(stderr, "Usage: p10replay [-s address] [-p port] [-o port] "
+          "[-P password] [-N name] [-n numeric]\n"
+          "                 [-u users] [-c channels] [-m members] "
+          "[-b bans] [-S seed]\n"
+          "                 [-r file | -w file]\n");
+  exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *server = "127.0.0.1", *password = "", *replay = 0;
+  unsigned int port = 4400, obs_port = 6667, numeric = 4000;
+  unsigned int users = 1000, channels = 100, members = 10, bans = 0;
+  unsigned long long t_start, t_hs, t_sent, t_ack, t_eof, t_split;
+  char mask[4];
+  int c;
+
+  while ((c = getopt(argc, argv, "s:p:o:P:N:n:u:c:m:b:S:r:w:")) != -1)
+    switch (c) {
+    case 's': server = optarg; break;
+    case 'p': port = strtoul(optarg, 0, 10); break;
+    case 'o': obs_port = strtoul(optarg, 0, 10); break;
+    case 'P': password = optarg; break;
+    case 'N': srvname = optarg; break;
+    case 'n': numeric = strtoul(optarg, 0, 10); break;
+    case 'u': users = strtoul(optarg, 0, 10); break;
+    case 'c': channels = strtoul(optarg, 0, 10); break;
+    case 'm': members = strtoul(optarg, 0, 10); break;
+    case 'b': bans = strtoul(optarg, 0, 10); break;
+    case 'S': rng_state = strtoul(optarg, 0, 10) | 1; break;
+    case 'r': replay = optarg; break;
+    case 'w':
+      if (!(record = fopen(optarg, "w")))
+        die("unable to create %s: %s", optarg, strerror(errno));
+      break;
+    default: usage();
+    }
+  if (optind != argc || numeric > 4095 || users > 262144 ||
+      (replay && record))
+    usage();
+  inttobase64(yy, numeric, 2);
+
+  /* register the observer first so it does not wait behind the burst */
+  link_conn.fd = -1;
+  conn_open(&obs_conn, server, obs_port);
+  conn_send(&obs_conn, "NICK p10obs%u", (unsigned int)getpid() % 10000);
+  conn_send(&obs_conn, "USER p10replay 0 * :p10replay observer");
+  run_until(&got_welcome, "observer registration");
+
+  /* handshake */
+  t_start = now_usec();
+  conn_open(&link_conn, server, port);
+  conn_send(&link_conn, "PASS :%s", password);
+  conn_send(&link_conn, "SERVER %s 1 %lu %lu J10 %s]]] +h :p10replay harness",
+            srvname, (unsigned long)time(0), (unsigned long)time(0),
+            inttobase64(mask, numeric, 2));
+  run_until(&got_eob, "the server's burst");
+  t_hs = now_usec();
+
+  /* our burst */
+  if (replay)
+    replay_burst(replay);
+  else
+    generate_burst(users, channels, members, bans);
+  conn_send(&link_conn, "%s EB", yy);
+  if (record)
+    fclose(record);
+  while (link_conn.wlen && !got_eoback) {
+    struct pollfd pfd;
+
+    pfd.fd = link_conn.fd;
+    pfd.events = POLLOUT | POLLIN;
+    if (poll(&pfd, 1, 1000) < 0 && errno != EINTR)
+      die("poll: %s", strerror(errno));
+    if (pfd.revents & POLLOUT)
+      conn_write(&link_conn);
+    if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) &&
+        !conn_read(&link_conn, link_parse))
+      die("server closed link during burst");
+  }
+  t_sent = now_usec();
+  run_until(&got_eoback, "END_OF_BURST_ACK");
+  t_ack = now_usec();
+
+  /* split */
+  conn_send(&link_conn, "%s SQ %s 0 :p10replay done", yy, srvname);
+  squit_sent = 1;
+  run_until(&link_closed, "the link to close");
+  t_eof = now_usec();
+  conn_send(&obs_conn, "PING :p10replay");
+  run_until(&got_pong, "the observer's PONG");
+  t_split = now_usec();
+
+  printf("users %u\n", replay ? 0 : users);
+  printf("channels %u\n", replay ? 0 : channels);
+  printf("members_per_channel %u\n", replay ? 0 : members);
+  printf("bans_per_channel %u\n", replay ? 0 : bans);
+  printf("burst_lines %lu\n", burst_lines);
+  printf("burst_bytes %lu\n", burst_bytes);
+  printf("handshake_usec %llu\n", t_hs - t_start);
+  printf("burst_send_usec %llu\n", t_sent - t_hs);
+  printf("eob_ack_usec %llu\n", t_ack - t_sent);
+  printf("burst_total_usec %llu\n", t_ack - t_hs);
+  printf("split_close_usec %llu\n", t_eof - t_ack);
+  printf("split_total_usec %llu\n", t_split - t_ack);
+
+  conn_send(&obs_conn, "QUIT :p10replay done");
+  conn_write(&obs_conn);
+  return 0;
+}